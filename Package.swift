@@ -20,17 +20,25 @@ let package = Package(
     .target(
       name: "Driver",
       dependencies: [
-        "Cocodol", "CodeGen", "LLVM",
+        "Cocodol", "CodeGen", "LLVM", "CLLVMLinker",
         .product(name: "ArgumentParser", package: "swift-argument-parser"),
       ]),
 
+    // The C API of LLVM's bitcode reader and linker, with which the driver links the runtime's
+    // bitcode into optimized programs. LLVMSwift doesn't wrap it.
+    .systemLibrary(name: "CLLVMLinker", pkgConfig: "cllvm"),
+
     // Targets related to the C core and its wrapper.
     .target(name: "Cocodol", dependencies: ["CCocodol"]),
-    .target(name: "CCocodol", exclude: ["build/", "src/main.c", "Makefile"]),
+    .target(
+      name: "CCocodol",
+      exclude: ["bench/", "build/", "tests/", "src/main.c", "Makefile"],
+      linkerSettings: [.linkedLibrary("pthread", .when(platforms: [.linux]))]),
 
     // The code generator's target.
     .target(name: "CodeGen", dependencies: ["Cocodol", "LLVM"]),
 
     // Test targets.
     .testTarget(name: "CocodolTests", dependencies: ["Cocodol"]),
+    .testTarget(name: "CodeGenTests", dependencies: ["Cocodol", "CodeGen", "LLVM"]),
   ])
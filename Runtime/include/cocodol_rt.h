@@ -54,6 +54,20 @@
 #define TOK_NOT                   (20 | TOK_OPER_BIT                             | TOK_PRFX_BIT)
 #define TOK_TILDE                 (21 | TOK_OPER_BIT                             | TOK_PRFX_BIT)
 
+// ------------------------------------------------------------------------------------------------
+// MARK: Closure environments
+// ------------------------------------------------------------------------------------------------
+
+// A closure's environment is an array of objects preceded by a 64-bit header. The header stores
+// the number of objects in its low 31 bits, a flag in bit 31 and a reference count in its high 32
+// bits. Environments are shared between the copies of a function, unless they are flagged unique,
+// in which case they are copied eagerly: a function that assigns its captured values would
+// otherwise mutate the environment of all its copies.
+
+#define COCODOL_RT_ENV_COUNT_MASK     0x7fffffffll
+#define COCODOL_RT_ENV_UNIQUE         (1ll << 31)
+#define COCODOL_RT_ENV_REFCOUNT_ONE   (1ll << 32)
+
 // ------------------------------------------------------------------------------------------------
 // MARK: Runtime library
 // ------------------------------------------------------------------------------------------------
@@ -63,11 +77,21 @@ typedef struct AnyObject {
 } AnyObject;
 
 /// Deinitializes and deallocates the given value.
+///
+/// Dropping a function releases its environment, which is deallocated with its last reference.
 void _cocodol_drop      (int64_t _0, int64_t _1);
 
 /// Copies the given value.
+///
+/// Copying a function retains its environment, unless it is unique.
 AnyObject _cocodol_copy (int64_t _0, int64_t _1);
 
+/// Initializes the header of a new closure environment whose `count` objects have been stored.
+///
+/// The environment is flagged unique if `is_mutating` is set, or if it contains a function whose
+/// environment is unique.
+void _cocodol_env_init  (AnyObject* env, int64_t count, int64_t is_mutating);
+
 /// Prints the given value.
 void _cocodol_print     (int64_t _0, int64_t _1);
 
@@ -77,4 +101,13 @@ AnyObject _cocodol_binop(int64_t _a0, int64_t _a1, int64_t _b0, int64_t _b1, uin
 /// Applies the specified binary operator on the given operand.
 AnyObject _cocodol_unop (int64_t _a0, int64_t _a1, uint32_t op);
 
+/// Reads an integer from the standard input.
+AnyObject _cocodol_read_int(void);
+
+/// Reads a floating-point number from the standard input.
+AnyObject _cocodol_read_float(void);
+
+/// Returns whether the standard input has been exhausted, ignoring trailing white spaces.
+AnyObject _cocodol_at_eof(void);
+
 #endif
@@ -1,38 +1,105 @@
 #include "cocodol_rt.h"
 
+#include <errno.h>
 #include <math.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
+
+#define INPUT_BUFFER_SIZE (1 << 20)
+
+/// The buffered contents of the standard input.
+static struct {
+  size_t  index;
+  size_t  count;
+  bool    eof;
+  char    data[INPUT_BUFFER_SIZE];
+} _cocodol_input;
+
+#ifdef COCODOL_RT_STATS
+/// The number of calls to `_cocodol_copy` and `_cocodol_drop` made by the program, including the
+/// recursive calls on the captures of an environment.
+static struct {
+  int64_t copies;
+  int64_t drops;
+} _cocodol_stats;
+
+/// Reports the calls to `_cocodol_copy` and `_cocodol_drop` on the standard error when the program
+/// exits.
+__attribute__((destructor))
+static void _cocodol_report_stats(void) {
+  fprintf(stderr, "copies: %lld, drops: %lld\n",
+          (long long)_cocodol_stats.copies, (long long)_cocodol_stats.drops);
+}
+#endif
+
+/// Returns whether the given value is a function whose environment is unique.
+static inline bool _cocodol_is_unique(int64_t _0, int64_t _1) {
+  return (_1 != 0)
+      && ((_0 & 3) == COCODOL_RT_FUNCTION)
+      && ((((int64_t*)_1)[-1] & COCODOL_RT_ENV_UNIQUE) != 0);
+}
+
+void _cocodol_env_init(AnyObject* env, int64_t count, int64_t is_mutating) {
+  bool is_unique = is_mutating;
+  for (int64_t i = 0; (i < count) && !is_unique; ++i) {
+    is_unique = _cocodol_is_unique(env[i]._0, env[i]._1);
+  }
+
+  int64_t* header = (int64_t*)env - 1;
+  *header = count | COCODOL_RT_ENV_REFCOUNT_ONE | (is_unique ? COCODOL_RT_ENV_UNIQUE : 0);
+}
 
 void _cocodol_drop(int64_t _0, int64_t _1) {
+#ifdef COCODOL_RT_STATS
+  _cocodol_stats.drops++;
+#endif
   if ((_1 != 0) && ((_0 & 3) == COCODOL_RT_FUNCTION)) {
-    void*       base      = (void*)_1 - sizeof(int64_t);
-    int64_t     env_size  = *((int64_t*)base);
+    int64_t*    base      = (int64_t*)_1 - 1;
     AnyObject*  env       = (AnyObject*)_1;
 
+    // Release the environment if it has other references.
+    if (*base >= 2 * COCODOL_RT_ENV_REFCOUNT_ONE) {
+      *base -= COCODOL_RT_ENV_REFCOUNT_ONE;
+      return;
+    }
+
+    int64_t     env_size  = *base & COCODOL_RT_ENV_COUNT_MASK;
     for (int64_t i = 0; i < env_size; ++i) {
       _cocodol_drop(env[i]._0, env[i]._1);
     }
 
 #ifdef DEBUG
-    printf("drop function env %p\n", base);
+    printf("drop function env %p\n", (void*)base);
 #endif
     free(base);
   }
 }
 
 AnyObject _cocodol_copy(int64_t _0, int64_t _1) {
+#ifdef COCODOL_RT_STATS
+  _cocodol_stats.copies++;
+#endif
   AnyObject dst = { _0, _1 };
 
   if ((_1 != 0) && ((_0 & 3) == COCODOL_RT_FUNCTION)) {
-    void*       base      = (void*)_1 - sizeof(int64_t);
-    int64_t     env_size  = *((int64_t*)base);
+    int64_t*    base      = (int64_t*)_1 - 1;
+
+    // Share the environment unless it is unique.
+    if ((*base & COCODOL_RT_ENV_UNIQUE) == 0) {
+      *base += COCODOL_RT_ENV_REFCOUNT_ONE;
+      return dst;
+    }
+
+    int64_t     env_size  = *base & COCODOL_RT_ENV_COUNT_MASK;
     AnyObject*  env       = (AnyObject*)_1;
-    void*       new_base  = malloc(sizeof(int64_t) + env_size * sizeof(AnyObject));
+    int64_t*    new_base  = malloc(sizeof(int64_t) + env_size * sizeof(AnyObject));
 #ifdef DEBUG
-    printf("copy function env %p to %p\n", base, new_base);
+    printf("copy function env %p to %p\n", (void*)base, (void*)new_base);
 #endif
-    AnyObject*  new_env   = (AnyObject*)(new_base + sizeof(int64_t));
+    *new_base = env_size | COCODOL_RT_ENV_REFCOUNT_ONE | COCODOL_RT_ENV_UNIQUE;
+    AnyObject*  new_env   = (AnyObject*)(new_base + 1);
     for (int64_t i = 0; i < env_size; ++i) {
       new_env[i] = _cocodol_copy(env[i]._0, env[i]._1);
     }
@@ -305,3 +372,150 @@ AnyObject _cocodol_unop(int64_t _a0, int64_t _a1, uint32_t op) {
       abort();
   }
 }
+
+// ------------------------------------------------------------------------------------------------
+// MARK: Input
+// ------------------------------------------------------------------------------------------------
+
+/// Refills the input buffer, returning `false` if the end of the input has been reached.
+static bool _cocodol_input_refill(void) {
+  if (_cocodol_input.eof) { return false; }
+
+  ssize_t count;
+  do {
+    count = read(STDIN_FILENO, _cocodol_input.data, INPUT_BUFFER_SIZE);
+  } while (count < 0 && errno == EINTR);
+
+  _cocodol_input.index = 0;
+  _cocodol_input.count = count > 0 ? (size_t)count : 0;
+  _cocodol_input.eof = count <= 0;
+  return !_cocodol_input.eof;
+}
+
+/// Returns the next character of the input without consuming it, or `-1` at the end of the input.
+static inline int _cocodol_input_peek(void) {
+  if ((_cocodol_input.index == _cocodol_input.count) && !_cocodol_input_refill()) { return -1; }
+  return (unsigned char)_cocodol_input.data[_cocodol_input.index];
+}
+
+/// Skips white spaces, returning `false` if the end of the input has been reached.
+static bool _cocodol_input_skip_spaces(void) {
+  while (true) {
+    while (_cocodol_input.index < _cocodol_input.count) {
+      char ch = _cocodol_input.data[_cocodol_input.index];
+      if ((ch != ' ') && ((ch < '\t') || (ch > '\r'))) { return true; }
+      _cocodol_input.index++;
+    }
+    if (!_cocodol_input_refill()) { return false; }
+  }
+}
+
+/// Parses an optional sign, returning `true` if it denotes a negative number.
+static bool _cocodol_input_sign(void) {
+  int ch = _cocodol_input_peek();
+  if ((ch == '-') || (ch == '+')) {
+    _cocodol_input.index++;
+    return ch == '-';
+  }
+  return false;
+}
+
+/// Consumes decimal digits, accumulating at most 19 of them into `mantissa`.
+///
+/// The number of digits that were consumed but not accumulated is added to `dropped`.
+static size_t _cocodol_input_digits(uint64_t* mantissa, int* dropped) {
+  size_t count = 0;
+  while ((_cocodol_input.index < _cocodol_input.count) || _cocodol_input_refill()) {
+    unsigned int digit = (unsigned char)_cocodol_input.data[_cocodol_input.index] - '0';
+    if (digit > 9) { break; }
+
+    if (*mantissa < 1000000000000000000ull) {
+      *mantissa = *mantissa * 10 + digit;
+    } else {
+      *dropped += 1;
+    }
+    _cocodol_input.index++;
+    count++;
+  }
+  return count;
+}
+
+AnyObject _cocodol_read_int(void) {
+  if (!_cocodol_input_skip_spaces()) { abort(); }
+  bool negative = _cocodol_input_sign();
+
+  // Reject values that are not representable, as malformed input.
+  uint64_t limit = negative ? (uint64_t)INT64_MAX + 1 : INT64_MAX;
+  uint64_t value = 0;
+  size_t count = 0;
+  while ((_cocodol_input.index < _cocodol_input.count) || _cocodol_input_refill()) {
+    unsigned int digit = (unsigned char)_cocodol_input.data[_cocodol_input.index] - '0';
+    if (digit > 9) { break; }
+    if (value > (limit - digit) / 10) { abort(); }
+    value = value * 10 + digit;
+    _cocodol_input.index++;
+    count++;
+  }
+  if (count == 0) { abort(); }
+
+  // Negate the magnitude without overflowing when it is `INT64_MAX + 1`.
+  AnyObject res = {
+    COCODOL_RT_INTEGER,
+    (negative && (value > 0)) ? -(int64_t)(value - 1) - 1 : (int64_t)value
+  };
+  return res;
+}
+
+AnyObject _cocodol_read_float(void) {
+  static const double powers[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+  };
+
+  if (!_cocodol_input_skip_spaces()) { abort(); }
+  bool negative = _cocodol_input_sign();
+
+  // Parse the integral and fractional parts.
+  uint64_t mantissa = 0;
+  int exponent = 0;
+  size_t count = _cocodol_input_digits(&mantissa, &exponent);
+  if (_cocodol_input_peek() == '.') {
+    _cocodol_input.index++;
+    int dropped = 0;
+    size_t fraction_count = _cocodol_input_digits(&mantissa, &dropped);
+    exponent -= (int)fraction_count - dropped;
+    count += fraction_count;
+  }
+  if (count == 0) { abort(); }
+
+  // Parse the exponent, if any.
+  int ch = _cocodol_input_peek();
+  if ((ch == 'e') || (ch == 'E')) {
+    _cocodol_input.index++;
+    bool negative_exponent = _cocodol_input_sign();
+    uint64_t value = 0;
+    int dropped = 0;
+    if (_cocodol_input_digits(&value, &dropped) == 0) { abort(); }
+    if (value > 9999) { value = 9999; }
+    exponent += negative_exponent ? -(int)value : (int)value;
+  }
+
+  // Compute the value, exactly whenever the mantissa and the exponent are small enough.
+  double value = (double)mantissa;
+  if ((mantissa < (1ull << 53)) && (exponent >= -22) && (exponent <= 22)) {
+    value = exponent < 0 ? value / powers[-exponent] : value * powers[exponent];
+  } else {
+    value = value * pow(10.0, exponent);
+  }
+  if (negative) { value = -value; }
+
+  AnyObject res;
+  res._0 = COCODOL_RT_FLOAT;
+  *(double*)(&res._1) = value;
+  return res;
+}
+
+AnyObject _cocodol_at_eof(void) {
+  AnyObject res = { COCODOL_RT_BOOL, _cocodol_input_skip_spaces() ? 0 : 1 };
+  return res;
+}
@@ -0,0 +1,117 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "lexer.h"
+#include "scan.h"
+#include "token.h"
+
+/// The approximate size of the generated sources, in bytes.
+#define SOURCE_SIZE (8 << 20)
+
+/// The number of times each source is tokenized.
+#define ITERATION_COUNT 10
+
+/// A fragment of program, repeated to generate the benchmark's input.
+typedef struct Workload {
+
+  /// The name of the workload.
+  const char* name;
+
+  /// The fragment, as a format string that accepts the index of the fragment twice.
+  const char* fragment;
+
+} Workload;
+
+static const Workload workloads[] = {
+  // Dense code, with few comments and shallow indentation.
+  { "code",
+    "// Computes the %zu-th element of the sequence.\n"
+    "fun element_%zu(n, iffy, variable) {\n"
+    "  var result = 0\n"
+    "  var i = 0\n"
+    "  while i < n {\n"
+    "    if (i %% 2 == 0) and not_done { result = result + iffy * 3 } else { nxt }\n"
+    "    result = result + variable / 1.5 - (i << 2)\n"
+    "    i = i + 1\n"
+    "  }\n"
+    "  ret result >= 42\n"
+    "}\n"
+    "\n" },
+
+  // Generated code, with long comments and deep indentation.
+  { "trivia",
+    "// ----------------------------------------------------------------------------------------\n"
+    "// Generated function %zu. The body below mirrors the structure of the specification, and\n"
+    "// every block is annotated with the rule from which it has been derived.\n"
+    "// ----------------------------------------------------------------------------------------\n"
+    "fun generated_function_%zu(argument_one, argument_two) {\n"
+    "                // Rule 1: initialize the accumulator with the first argument.\n"
+    "                var accumulator = argument_one\n"
+    "                while accumulator < argument_two {\n"
+    "                                // Rule 2: increment until we reach the upper bound.\n"
+    "                                accumulator = accumulator + 1\n"
+    "                }\n"
+    "                ret accumulator\n"
+    "}\n"
+    "\n" },
+};
+
+/// Returns the current time, in seconds.
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/// Tokenizes the given workload and prints the best throughput.
+static void run(const Workload* workload, const ScanKernels* kernels) {
+  // Generate the source.
+  char* source = malloc(SOURCE_SIZE + 1024);
+  size_t size = 0;
+  for (size_t i = 0; size < SOURCE_SIZE; ++i) {
+    size += sprintf(source + size, workload->fragment, i, i);
+  }
+
+  // Tokenize the source.
+  size_t token_count = 0;
+  double best = 1e9;
+  for (size_t i = 0; i < ITERATION_COUNT; ++i) {
+    LexerState lexer;
+    Token token;
+    token_count = 0;
+
+    double start = now();
+    lexer_init(&lexer, source, NULL);
+    lexer.scan = kernels;
+    while (lexer_next(&lexer, &token)) {
+      token_count++;
+    }
+    lexer_deinit(&lexer);
+
+    double elapsed = now() - start;
+    if (elapsed < best) { best = elapsed; }
+  }
+
+  printf("%-8s %-8s %zu bytes, %zu tokens, best of %d: %.2f ms, %.1f MB/s, %.1f Mtokens/s\n",
+         workload->name, kernels->name, size, token_count,
+         ITERATION_COUNT, best * 1e3, size / best / 1e6, token_count / best / 1e6);
+
+  free(source);
+}
+
+int main(int argc, char** argv) {
+  // Select the scanning kernels.
+  const ScanKernels* kernels = (argc > 1) ? scan_kernels_named(argv[1]) : scan_kernels();
+  if (kernels == NULL) {
+    fprintf(stderr, "error: kernels '%s' are not available\n", argv[1]);
+    return 1;
+  }
+
+  for (size_t i = 0; i < sizeof(workloads) / sizeof(Workload); ++i) {
+    run(&workloads[i], kernels);
+  }
+
+  return 0;
+}
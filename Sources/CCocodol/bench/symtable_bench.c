@@ -0,0 +1,333 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "symtable.h"
+#include "utils.h"
+
+/// The number of operations performed by each workload.
+#define OPERATION_COUNT (1 << 24)
+
+/// The number of times each workload is run.
+#define ITERATION_COUNT 5
+
+// ------------------------------------------------------------------------------------------------
+// MARK: Reference table
+// ------------------------------------------------------------------------------------------------
+
+/// The linear-probing table that `SymTable` replaced, used as the baseline of the benchmark.
+///
+/// Its search has been fixed to step over tombstones, as it would otherwise loop forever in the
+/// workloads that remove entries.
+typedef struct RefEntry {
+  Symbol    key;
+  uint32_t  flags;
+  void*     val;
+} RefEntry;
+
+typedef struct RefTable {
+  RefEntry* buckets;
+  size_t    count;
+  size_t    capacity;
+} RefTable;
+
+#define REF_TOMB 1
+#define REF_USED 2
+
+static void ref_init(RefTable* self) {
+  self->capacity = 16;
+  self->count = 0;
+  self->buckets = calloc(self->capacity, sizeof(RefEntry));
+}
+
+static void ref_deinit(RefTable* self) {
+  free(self->buckets);
+}
+
+static void ref_resize(RefTable* self) {
+  size_t new_capacity = self->capacity * 2;
+  RefEntry* new_buckets = calloc(new_capacity, sizeof(RefEntry));
+  size_t new_count = 0;
+  for (size_t i = 0; i < self->capacity; ++i) {
+    if (self->buckets[i].flags & REF_USED) {
+      size_t position = self->buckets[i].key & (new_capacity - 1);
+      while (new_buckets[position].flags != 0) {
+        position = (position + 1) & (new_capacity - 1);
+      }
+      new_buckets[position] = self->buckets[i];
+      new_count++;
+    }
+  }
+  free(self->buckets);
+  self->buckets = new_buckets;
+  self->count = new_count;
+  self->capacity = new_capacity;
+}
+
+static RefEntry* ref_search(RefTable* self, Symbol key) {
+  size_t position = key & (self->capacity - 1);
+  while (self->buckets[position].flags != 0) {
+    if ((self->buckets[position].flags & REF_USED) && (self->buckets[position].key == key)) {
+      return &self->buckets[position];
+    }
+    position = (position + 1) & (self->capacity - 1);
+  }
+  return NULL;
+}
+
+static void ref_insert(RefTable* self, Symbol key, void* val) {
+  if ((float)self->count / (float)self->capacity > 0.75) {
+    ref_resize(self);
+  }
+  if (ref_search(self, key) != NULL) { return; }
+
+  size_t position = key & (self->capacity - 1);
+  while (self->buckets[position].flags & REF_USED) {
+    position = (position + 1) & (self->capacity - 1);
+  }
+  if (self->buckets[position].flags == 0) {
+    self->count++;
+  }
+  self->buckets[position] = (RefEntry){ key, REF_USED, val };
+}
+
+static void* ref_get(RefTable* self, Symbol key) {
+  RefEntry* entry = ref_search(self, key);
+  return (entry != NULL) ? entry->val : NULL;
+}
+
+static void ref_remove(RefTable* self, Symbol key) {
+  RefEntry* entry = ref_search(self, key);
+  if (entry != NULL) { entry->flags = REF_TOMB; }
+}
+
+// ------------------------------------------------------------------------------------------------
+// MARK: Workloads
+// ------------------------------------------------------------------------------------------------
+
+/// Returns the current time, in seconds.
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/// A pseudo-random generator, so that both tables see the same keys.
+static uint32_t next_random(uint32_t* state) {
+  *state = *state * 1664525 + 1013904223;
+  return *state >> 8;
+}
+
+/// The number of keys generated for each workload, which are looked up in a loop.
+///
+/// Keys are generated before the tables are timed, so that the cost of generating them doesn't
+/// drown that of the lookups.
+#define KEY_COUNT (1 << 16)
+
+/// The number of frames searched by the `chain` workload.
+#define CHAIN_LENGTH 4
+
+/// Runs a workload on both tables and prints their best times.
+///
+/// `table_size` is the number of entries in each table, and `key_space` is the range of the keys
+/// that are looked up. Keys above `table_size` miss. If `churn` is set, each lookup is followed by
+/// the removal and the reinsertion of a random key.
+static void run(const char* name, size_t table_size, size_t key_space, bool chain, bool churn) {
+  size_t table_count = chain ? CHAIN_LENGTH : 1;
+  double best_ref = 1e9;
+  double best_new = 1e9;
+  uintptr_t checksum_ref = 0;
+  uintptr_t checksum_new = 0;
+
+  // Generate the keys that are looked up and, if `churn` is set, those that are reinserted.
+  static Symbol keys[KEY_COUNT];
+  static Symbol victims[KEY_COUNT];
+  uint32_t state = 42;
+  for (size_t i = 0; i < KEY_COUNT; ++i) {
+    keys[i] = (Symbol)(next_random(&state) % (key_space * table_count));
+    victims[i] = (Symbol)(next_random(&state) % table_size);
+  }
+
+  for (size_t iteration = 0; iteration < ITERATION_COUNT; ++iteration) {
+    // Benchmark the reference table. Chained tables hold disjoint keys, as the locals of nested
+    // frames would.
+    RefTable ref[CHAIN_LENGTH];
+    for (size_t t = 0; t < table_count; ++t) {
+      ref_init(&ref[t]);
+      for (size_t k = 0; k < table_size; ++k) {
+        ref_insert(&ref[t], (Symbol)(k * table_count + t), (void*)(k + 1));
+      }
+    }
+
+    uintptr_t checksum = 0;
+    double start = now();
+    for (size_t i = 0; i < OPERATION_COUNT; ++i) {
+      Symbol key = keys[i & (KEY_COUNT - 1)];
+      for (size_t t = 0; t < table_count; ++t) {
+        void* val = ref_get(&ref[t], key);
+        if (val != NULL) {
+          checksum += (uintptr_t)val;
+          break;
+        }
+      }
+      if (churn) {
+        Symbol victim = victims[i & (KEY_COUNT - 1)];
+        ref_remove(&ref[0], victim);
+        ref_insert(&ref[0], victim, (void*)(uintptr_t)(victim + 1));
+      }
+    }
+    double elapsed = now() - start;
+    if (elapsed < best_ref) { best_ref = elapsed; }
+    checksum_ref = checksum;
+    for (size_t t = 0; t < table_count; ++t) { ref_deinit(&ref[t]); }
+
+    // Benchmark the new table, computing each hash once per lookup.
+    SymTable tables[CHAIN_LENGTH];
+    for (size_t t = 0; t < table_count; ++t) {
+      symtable_init(&tables[t]);
+      for (size_t k = 0; k < table_size; ++k) {
+        symtable_insert(&tables[t], (Symbol)(k * table_count + t), (void*)(k + 1));
+      }
+    }
+
+    checksum = 0;
+    start = now();
+    for (size_t i = 0; i < OPERATION_COUNT; ++i) {
+      Symbol key = keys[i & (KEY_COUNT - 1)];
+      uint64_t hash = symtable_hash(key);
+      for (size_t t = 0; t < table_count; ++t) {
+        void* val = symtable_get_hashed(&tables[t], key, hash);
+        if (val != NULL) {
+          checksum += (uintptr_t)val;
+          break;
+        }
+      }
+      if (churn) {
+        Symbol victim = victims[i & (KEY_COUNT - 1)];
+        symtable_remove(&tables[0], victim);
+        symtable_insert(&tables[0], victim, (void*)(uintptr_t)(victim + 1));
+      }
+    }
+    elapsed = now() - start;
+    if (elapsed < best_new) { best_new = elapsed; }
+    checksum_new = checksum;
+    for (size_t t = 0; t < table_count; ++t) { symtable_deinit(&tables[t]); }
+  }
+
+  printf("%-8s reference %7.2f ms, swiss %7.2f ms, speedup %.2fx%s\n",
+         name, best_ref * 1e3, best_new * 1e3, best_ref / best_new,
+         (checksum_ref == checksum_new) ? "" : " (checksum mismatch)");
+}
+
+/// The number of locals of each frame created by `run_frames`.
+#define FRAME_LOCAL_COUNT 3
+
+/// Creates and destroys many small tables, as function calls do with their locals.
+static void run_frames(void) {
+  size_t frame_count = OPERATION_COUNT / 8;
+  double best_ref = 1e9;
+  double best_new = 1e9;
+  uintptr_t checksum_ref = 0;
+  uintptr_t checksum_new = 0;
+
+  for (size_t iteration = 0; iteration < ITERATION_COUNT; ++iteration) {
+    uintptr_t checksum = 0;
+    double start = now();
+    for (size_t i = 0; i < frame_count; ++i) {
+      RefTable table;
+      ref_init(&table);
+      for (size_t k = 0; k < FRAME_LOCAL_COUNT; ++k) {
+        ref_insert(&table, (Symbol)(i + k), (void*)(k + 1));
+      }
+      for (size_t k = 0; k <= FRAME_LOCAL_COUNT; ++k) {
+        checksum += (uintptr_t)ref_get(&table, (Symbol)(i + k));
+      }
+      ref_deinit(&table);
+    }
+    double elapsed = now() - start;
+    if (elapsed < best_ref) { best_ref = elapsed; }
+    checksum_ref = checksum;
+
+    checksum = 0;
+    start = now();
+    for (size_t i = 0; i < frame_count; ++i) {
+      SymTable table;
+      symtable_init(&table);
+      for (size_t k = 0; k < FRAME_LOCAL_COUNT; ++k) {
+        symtable_insert(&table, (Symbol)(i + k), (void*)(k + 1));
+      }
+      for (size_t k = 0; k <= FRAME_LOCAL_COUNT; ++k) {
+        checksum += (uintptr_t)symtable_get(&table, (Symbol)(i + k));
+      }
+      symtable_deinit(&table);
+    }
+    elapsed = now() - start;
+    if (elapsed < best_new) { best_new = elapsed; }
+    checksum_new = checksum;
+  }
+
+  printf("%-8s reference %7.2f ms, swiss %7.2f ms, speedup %.2fx%s\n",
+         "frames", best_ref * 1e3, best_new * 1e3, best_ref / best_new,
+         (checksum_ref == checksum_new) ? "" : " (checksum mismatch)");
+}
+
+/// Hashes identifiers of various lengths with the former and the new name hashes.
+static void run_hashes(void) {
+  // Generate identifiers of 1 to 24 characters.
+  enum { NAME_COUNT = 4096 };
+  static char names[NAME_COUNT][24];
+  size_t lengths[NAME_COUNT];
+  uint32_t state = 7;
+  for (size_t i = 0; i < NAME_COUNT; ++i) {
+    lengths[i] = 1 + next_random(&state) % 24;
+    for (size_t j = 0; j < lengths[i]; ++j) {
+      names[i][j] = "abcdefghijklmnopqrstuvwxyz_0123456789"[next_random(&state) % 37];
+    }
+  }
+
+  double best_fnv = 1e9;
+  double best_name = 1e9;
+  uint64_t checksum = 0;
+  for (size_t iteration = 0; iteration < ITERATION_COUNT; ++iteration) {
+    double start = now();
+    for (size_t i = 0; i < OPERATION_COUNT; ++i) {
+      size_t n = i & (NAME_COUNT - 1);
+      checksum += fnv1_hash_buffer(names[n], lengths[n]);
+    }
+    double elapsed = now() - start;
+    if (elapsed < best_fnv) { best_fnv = elapsed; }
+
+    start = now();
+    for (size_t i = 0; i < OPERATION_COUNT; ++i) {
+      size_t n = i & (NAME_COUNT - 1);
+      checksum += name_hash_buffer(names[n], lengths[n]);
+    }
+    elapsed = now() - start;
+    if (elapsed < best_name) { best_name = elapsed; }
+  }
+
+  printf("%-8s fnv1      %7.2f ms, name  %7.2f ms, speedup %.2fx (%llx)\n",
+         "hash", best_fnv * 1e3, best_name * 1e3, best_fnv / best_name,
+         (unsigned long long)(checksum & 0xff));
+}
+
+int main(void) {
+  // Small tables, as the locals of a function.
+  run("locals", 8, 8, false, false);
+
+  // Large tables, as the globals of a program.
+  run("globals", 1 << 14, 1 << 14, false, false);
+
+  // Lookups that go through several frames, half of which miss.
+  run("chain", 256, 512, true, false);
+
+  // Lookups interleaved with removals and reinsertions.
+  run("churn", 1 << 10, 1 << 10, false, true);
+
+  // Tables created for a handful of entries and destroyed right away, as the locals of a call.
+  run_frames();
+
+  run_hashes();
+  return 0;
+}
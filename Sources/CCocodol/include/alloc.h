@@ -0,0 +1,82 @@
+#ifndef COCODOL_ALLOC_H
+#define COCODOL_ALLOC_H
+
+#include "common.h"
+
+/// The category of a memory allocation.
+typedef enum AllocCategory {
+  ac_ident    ,
+  ac_value    ,
+  ac_frame    ,
+  ac_env      ,
+  ac_symtable ,
+  ac_input    ,
+  ac_tokens   ,
+  ac_ast      ,
+
+  /// The number of allocation categories.
+  ac_count    ,
+} AllocCategory;
+
+/// A set of hooks through which the C core allocates and frees memory.
+typedef struct Allocator {
+
+  /// Allocates `size` bytes for an object of the given category.
+  void* (*allocate)(void* user, size_t size, AllocCategory category);
+
+  /// Frees the memory at `ptr`, which has been allocated with `size` bytes for the given category.
+  void  (*deallocate)(void* user, void* ptr, size_t size, AllocCategory category);
+
+  /// A pointer to arbitrary user data that is passed to the hooks.
+  void* user;
+
+} Allocator;
+
+/// Allocation statistics for a single category.
+typedef struct AllocStats {
+
+  /// The number of allocations performed.
+  size_t alloc_count;
+
+  /// The number of bytes allocated.
+  size_t byte_count;
+
+  /// The maximum number of bytes that were allocated at the same time.
+  size_t peak_byte_count;
+
+  /// The number of allocations that have not been freed yet.
+  size_t live_count;
+
+  /// The number of bytes that have not been freed yet.
+  size_t live_byte_count;
+
+} AllocStats;
+
+/// Installs the given allocator, or restores the default one (based on `malloc`) if `allocator` is
+/// `NULL`.
+///
+/// The allocator should be installed before any allocation is performed, as memory must be freed
+/// with the same hooks that allocated it.
+void cocodol_set_allocator(const Allocator* allocator);
+
+/// Allocates `size` bytes for an object of the given category.
+void* cocodol_alloc(AllocCategory category, size_t size);
+
+/// Frees the memory at `ptr`, which has been allocated with `size` bytes for the given category.
+///
+/// This function has no effect if `ptr` is `NULL`.
+void  cocodol_free(AllocCategory category, void* ptr, size_t size);
+
+/// Returns the allocation statistics of the given category.
+AllocStats cocodol_alloc_stats(AllocCategory category);
+
+/// Returns the number of allocations that have not been freed yet, in all categories.
+size_t cocodol_live_alloc_count(void);
+
+/// Resets the allocation statistics of all categories, except for their live counts.
+void cocodol_reset_alloc_stats(void);
+
+/// Returns a character string describing the given category.
+const char* alloc_category_name(AllocCategory category);
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef COCODOL_ARENA_H
+#define COCODOL_ARENA_H
+
+#include "common.h"
+
+/// A block of memory from which an arena allocates.
+///
+/// The block's storage immediately follows this header.
+typedef struct ArenaBlock {
+
+  /// The block that was added to the arena before this one, or `NULL`.
+  struct ArenaBlock* prev;
+
+  /// The size of the block's storage, in bytes.
+  size_t size;
+
+} ArenaBlock;
+
+/// A bump allocator, which carves allocations out of large blocks and releases them all at once.
+///
+/// Allocations can't be freed individually. Blocks are obtained with `cocodol_alloc`, and their
+/// sizes grow geometrically so that an arena holds few of them.
+typedef struct Arena {
+
+  /// The block from which memory is currently allocated, or `NULL`.
+  ArenaBlock* head;
+
+  /// The oldest block of the arena, or `NULL`.
+  ArenaBlock* tail;
+
+  /// The address of the next allocation in `head`.
+  char* cursor;
+
+  /// The address past the end of `head`'s storage.
+  char* limit;
+
+  /// The size of the next block to allocate.
+  size_t next_block_size;
+
+} Arena;
+
+/// Initializes an empty arena.
+void arena_init(Arena*);
+
+/// Frees all the memory allocated by an arena.
+///
+/// This takes time proportional to the number of blocks in the arena, regardless of the number of
+/// allocations that were performed.
+void arena_deinit(Arena*);
+
+/// Allocates `size` bytes from the given arena, aligned on 16 bytes.
+///
+/// The memory is not initialized.
+void* arena_alloc(Arena*, size_t size);
+
+/// Transfers the ownership of all the memory allocated by `other` to an arena, and leaves `other`
+/// empty.
+///
+/// Allocations of `other` remain valid, and are freed with the arena that adopted them.
+void arena_adopt(Arena*, Arena* other);
+
+#endif
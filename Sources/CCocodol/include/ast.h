@@ -1,11 +1,11 @@
 #ifndef COCODOL_AST_H
 #define COCODOL_AST_H
 
+#include <string.h>
+
 #include "common.h"
 #include "token.h"
 
-#define MAX_CAPTURE_COUNT 64
-
 #define NODE_DECL_BIT (1 << 16)
 #define NODE_EXPR_BIT (1 << 17)
 #define NODE_STMT_BIT (1 << 18)
@@ -38,31 +38,31 @@ typedef enum NodeKind: unsigned int {
   nk_ret_stmt     = 7 | NODE_STMT_BIT,
 } NodeKind;
 
-/// A linked list of declarations.
-typedef struct DeclList {
-  NodeID decl;
-  struct DeclList* prev;
-} DeclList;
-
 /// An AST node.
+///
+/// Nodes are 36 bytes wide. Their variable-length contents (e.g., the statements of a brace
+/// statement) are stored in the `extra` array of the context that owns them, and referred to by
+/// their index in that array.
 typedef struct Node {
 
   /// The node's kind.
   NodeKind kind;
 
   /// The index at which the node starts in the source input.
-  size_t start;
+  uint32_t start;
 
   /// The index at which the node ends in the source input.
-  size_t end;
+  uint32_t end;
 
   /// The contents of the node.
   union NodeContents {
 
-    /// An array containing the indices of each statement in the top-level declaration.
+    /// The indices of each statement in the top-level declaration.
+    ///
+    /// `stmts` is the position in the context's extra data of an array of `stmtc` node indices.
     struct {
-      size_t  stmtc;
-      NodeID* stmtv;
+      uint32_t  stmtc;
+      uint32_t  stmts;
     } top_decl;
 
     /// The name of the declaration and its initializer, if any.
@@ -70,22 +70,25 @@ typedef struct Node {
     /// If the declaration has no initializer, its index is set to the maximum representable value
     /// of `NodeID` (i.e., `~0`).
     struct {
-      Token   name;
-      NodeID  initializer;
+      Token     name;
+      NodeID    initializer;
     } var_decl;
 
     /// The name of the function, its parameters and its body.
+    ///
+    /// `params` is the position in the context's extra data of the parameter count, followed by
+    /// the position of the function's capture list and by the parameter tokens (see
+    /// `context_get_param` and `context_get_captures`).
     struct {
-      Token   name;
-      size_t  paramc;
-      Token*  paramv;
-      NodeID  body;
+      Token     name;
+      uint32_t  params;
+      NodeID    body;
     } fun_decl;
 
     /// The name of the type and its body.
     struct {
-      Token   name;
-      NodeID  body;
+      Token     name;
+      NodeID    body;
     } obj_decl;
 
     /// The name of the symbol being referred.
@@ -94,48 +97,55 @@ typedef struct Node {
     /// The Boolean value.
     bool bool_expr;
 
-    /// The number's value.
-    long int integer_expr;
+    /// The number's value (see `node_integer_value`).
+    uint32_t integer_expr[2];
 
-    /// The number's value.
-    double float_expr;
+    /// The number's value (see `node_float_value`).
+    uint32_t float_expr[2];
 
     /// The prefix operator and the operand's expression.
     struct {
-      Token   op;
-      NodeID  subexpr;
+      Token     op;
+      NodeID    subexpr;
     } unary_expr;
 
     /// The infix operator and each operand's expression.
     struct {
-      Token   op;
-      NodeID  lhs;
-      NodeID  rhs;
+      Token     op;
+      NodeID    lhs;
+      NodeID    rhs;
     } binary_expr;
 
     /// The base expression and the member's name.
     struct {
-      NodeID  base;
-      Token   member;
+      NodeID    base;
+      Token     member;
     } member_expr;
 
     /// The callee's expression and and the arguments of the application.
+    ///
+    /// `args` is the position in the context's extra data of an array of `argc` node indices.
     struct {
-      NodeID  callee;
-      size_t  argc;
-      NodeID* argv;
+      NodeID    callee;
+      uint32_t  argc;
+      uint32_t  args;
     } apply_expr;
 
     /// The sub-expression.
     NodeID paren_expr;
 
-    /// An array containing the indices of each statement the index of the parent scope and a
-    /// pointer to a linked list of named declarations.
+    /// The indices of each statement, the index of the parent scope and a linked list of named
+    /// declarations.
+    ///
+    /// `stmts` is the position in the context's extra data of an array of `stmtc` node indices.
+    /// `last_decl` is the position in the context's extra data of the last link in the list of
+    /// declarations, or `~0` if the scope doesn't declare any name. Each link consists of two
+    /// words: the index of a declaration and the position of the previous link.
     struct {
-      size_t  stmtc;
-      NodeID* stmtv;
-      NodeID  parent;
-      DeclList* last_decl;
+      uint32_t  stmtc;
+      uint32_t  stmts;
+      NodeID    parent;
+      uint32_t  last_decl;
     } brace_stmt;
 
     /// The expression being wrapped.
@@ -146,15 +156,15 @@ typedef struct Node {
     /// It then "else" branch is not defined, then its index is set to the maximum representable
     /// value of `NodeID` (i.e., `~0`).
     struct {
-      NodeID  cond;
-      NodeID  then_;
-      NodeID  else_;
+      NodeID    cond;
+      NodeID    then_;
+      NodeID    else_;
     } if_stmt;
 
     /// The statement's condition and its body.
     struct {
-      NodeID  cond;
-      NodeID  body;
+      NodeID    cond;
+      NodeID    body;
     } while_stmt;
 
     /// The expression of the return value.
@@ -164,10 +174,48 @@ typedef struct Node {
 
 } Node;
 
-/// Deinitializes a node.
+/// Returns the value of an integer literal.
+static inline int64_t node_integer_value(const Node* self) {
+  int64_t value;
+  memcpy(&value, self->bits.integer_expr, sizeof(int64_t));
+  return value;
+}
+
+/// Sets the value of an integer literal.
+static inline void node_set_integer_value(Node* self, int64_t value) {
+  memcpy(self->bits.integer_expr, &value, sizeof(int64_t));
+}
+
+/// Returns the value of a floating-point literal.
+static inline double node_float_value(const Node* self) {
+  double value;
+  memcpy(&value, self->bits.float_expr, sizeof(double));
+  return value;
+}
+
+/// Sets the value of a floating-point literal.
+static inline void node_set_float_value(Node* self, double value) {
+  memcpy(self->bits.float_expr, &value, sizeof(double));
+}
+
+/// Offsets the indices of the nodes and extra data that a node refers to.
 ///
-/// This frees the memory optionally allocated for the node's contents.
-void node_deinit(Node*);
+/// This serves to move a node from one context into another, when the nodes and extra data of the
+/// former are appended to those of the latter. `context` is the context that currently holds the
+/// node's extra data, which are updated in place. Undefined indices (i.e., `~0`) are left
+/// unchanged.
+void node_relocate(Node*, struct Context* context, NodeID node_offset, uint32_t extra_offset);
+
+/// Shifts the source offsets of a node and of the tokens that it holds.
+///
+/// This serves to update a node that follows an edit of the program source. Offsets that are
+/// greater than or equal to `from` are moved by `delta` bytes, while the others are left unchanged.
+/// `context` is the context that holds the node's extra data (i.e., its parameters, if the node is
+/// a function declaration), which are updated in place. The node's children are not shifted.
+///
+/// The tokens of a node are always within its range, so that nodes ending before `from` are left
+/// unchanged without being inspected further.
+void node_shift(Node*, struct Context* context, uint32_t from, int64_t delta);
 
 /// Walks an AST, calling the given function every time the walker enters or exits a node.
 ///
@@ -183,23 +231,13 @@ void node_deinit(Node*);
 ///
 /// This function returns `false` if the walk was aborted in post-order mode, otherwise it always
 /// returns `true`.
+///
+/// The walk uses an explicit stack rather than recursion, so that deep ASTs don't overflow the C
+/// stack. `visit` may start other walks, but it must not modify the children of the nodes that
+/// have been entered and not yet exited.
 bool node_walk(NodeID index,
                struct Context* context,
                void*  user,
                bool   (*visit)(NodeID, NodeKind, bool, void*));
 
-/// Returns the set of identifiers captured by the given function declaration.
-///
-/// This represents the set of variables identifiers that occur free in the function, and that
-/// are said to be "captured" from the environment that surrounds the function declaration. A
-/// variable is free if refers to a binding outside of the function declaration.
-///
-/// The 3rd parameter `symv` must be an array of token pointers, that is large enough to store
-/// `MAX_CAPTURE_COUNT` elements. The function returns the number of token pointers written. The
-///  function uses it as the buckets of a hash set.
-///
-/// The 4th parameter `pack_result` is a flag indicating whether results should be packed at the
-/// beginning of `symv`.
-size_t capture_set(NodeID fun_index, struct Context* self, Token** symv, bool defrag);
-
 #endif
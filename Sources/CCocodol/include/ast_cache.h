@@ -0,0 +1,70 @@
+#ifndef COCODOL_AST_CACHE_H
+#define COCODOL_AST_CACHE_H
+
+#include "common.h"
+
+/// The version of the AST cache format.
+///
+/// This number must be incremented whenever the representation of nodes changes (e.g., if a node
+/// kind is added or if the contents of a node are laid out differently), so that stale entries
+/// are ignored.
+#define AST_CACHE_VERSION 3
+
+/// A parsed program mapped from an entry of the AST cache.
+///
+/// An entry stores the nodes, the extra data and the interned names of a context, together with
+/// its top-level declarations. It only contains indices and source offsets, so that it can be
+/// mapped at any address and directly serve as the storage of a context.
+typedef struct AstCacheFile {
+
+  /// The contents of the entry, or `NULL` if no entry is mapped.
+  void* base;
+
+  /// The size of the memory mapping that holds `base`.
+  size_t mapping_size;
+
+} AstCacheFile;
+
+/// Returns the key identifying the cache entry of the given program source.
+uint64_t ast_cache_key(const char* source, size_t length);
+
+/// Loads the AST of a context's source from the cache.
+///
+/// The context must be empty, and `key` must have been computed from its source. If a valid entry
+/// is found, the function returns `true`, stores the context's top-level declarations into a newly
+/// allocated buffer at `declv`, and their number at `declc`. The context's nodes are then backed by
+/// the mapped entry, which must be closed with `ast_cache_close` after the context has been
+/// deinitialized.
+///
+/// Otherwise, if there is no entry for the source or if it is invalid, the function returns
+/// `false`, leaves the context unchanged and the file empty. Entries are validated against the
+/// source, the current format and a checksum of their contents, after which their nodes are
+/// trusted as they are.
+bool ast_cache_load(AstCacheFile*, struct Context* context, uint64_t key,
+                    NodeID** declv, size_t* declc);
+
+/// Stores the AST of a context's source, with the given top-level declarations, into the cache.
+///
+/// The entry is written atomically, so that concurrent processes never observe it partially
+/// written. The least recently used entries are then removed until the entries of the cache fit
+/// in its capacity (see `ast_cache_capacity`). The function returns `false` if the entry could not
+/// be written or is larger than the capacity, which is not an error.
+bool ast_cache_store(struct Context* context, uint64_t key, const NodeID* declv, size_t declc);
+
+/// Unmaps a cache entry.
+void ast_cache_close(AstCacheFile*);
+
+/// Returns the maximum total size of the entries of the AST cache, in bytes.
+///
+/// The capacity is `$COCODOL_CACHE_SIZE` megabytes if this variable is set, or 256 megabytes
+/// otherwise. No entry is stored if the capacity is 0.
+size_t ast_cache_capacity(void);
+
+/// Writes the path of the AST cache directory into `buffer`, which has the given size.
+///
+/// The directory is `$COCODOL_CACHE_DIR` if this variable is set, or `cocodol` in the user's cache
+/// directory (i.e., `$XDG_CACHE_HOME` or `~/.cache`) otherwise. The function returns `false` if
+/// no directory is configured or if the path doesn't fit in the buffer.
+bool ast_cache_directory(char* buffer, size_t size);
+
+#endif
@@ -3,13 +3,21 @@
 
 #include "common.h"
 
+#include "alloc.h"
+#include "arena.h"
+#include "ast_cache.h"
 #include "ast.h"
 #include "context.h"
 #include "eval.h"
+#include "interner.h"
 #include "lexer.h"
 #include "parser.h"
+#include "resolver.h"
+#include "scan.h"
+#include "source.h"
 #include "symtable.h"
 #include "token.h"
+#include "token_buffer.h"
 #include "value.h"
 
 #endif
@@ -3,14 +3,18 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
+struct  Arena;
 struct  Context;
-struct  DeclList;
+struct  Interner;
 struct  LexerState;
 struct  EvalError;
 struct  EvalState;
 struct  ParseError;
 struct  ParserState;
+struct  ScanKernels;
+struct  SourceStream;
 struct  Node;
 struct  SymTable;
 struct  Token;
@@ -26,6 +30,9 @@ typedef void(*EvalErrorCallback)(struct EvalError, const struct EvalState*);
 typedef void(*ParseErrorCallback)(struct ParseError, const struct ParserState*);
 
 /// The index of an AST node.
-typedef size_t NodeID;
+typedef uint32_t NodeID;
+
+/// The dense identifier of an interned name.
+typedef uint32_t Symbol;
 
 #endif
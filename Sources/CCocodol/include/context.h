@@ -1,46 +1,415 @@
 #ifndef COCODOL_CONTEXT_H
 #define COCODOL_CONTEXT_H
 
+#include <string.h>
+
+#include "arena.h"
 #include "ast.h"
 #include "common.h"
+#include "interner.h"
+
+/// The number of extra data words occupied by each parameter of a function declaration.
+#define PARAM_WORD_COUNT    (sizeof(Token) / sizeof(uint32_t))
+
+/// The number of extra data words that precede the parameters of a function declaration, i.e.,
+/// the parameter count, the capture count and the position of the capture list.
+#define PARAM_HEADER_WORD_COUNT 3
+
+/// The position of the capture list of a function whose captures haven't been resolved.
+#define UNRESOLVED_CAPTURES ((uint32_t)~0)
+
+/// The base-2 logarithm of the number of nodes in a node segment.
+#define NODE_SEGMENT_SHIFT  10
+
+/// The number of nodes in a node segment.
+#define NODE_SEGMENT_SIZE   (1 << NODE_SEGMENT_SHIFT)
+
+/// The base-2 logarithm of the number of words in an extra data segment.
+#define EXTRA_SEGMENT_SHIFT 12
+
+/// The number of words in an extra data segment.
+#define EXTRA_SEGMENT_SIZE  (1 << EXTRA_SEGMENT_SHIFT)
+
+/// The number of sizes of the extra data runs that are reused after being freed, i.e., runs of 1
+/// to `EXTRA_FREE_LIST_COUNT` words.
+#define EXTRA_FREE_LIST_COUNT 32
+
+/// The number of recorded shifts that may have yet to be applied to a top-level node.
+///
+/// `context_log_shift` settles a fraction of the top-level nodes after each shift, so that all of
+/// them are settled at least once every `SHIFT_LOG_CAPACITY / 2` shifts.
+#define SHIFT_LOG_CAPACITY 512
+
+/// A shift of the offsets that are greater than or equal to `from` by `delta`, recorded in the
+/// shift log of a context.
+///
+/// Each entry also summarizes the shifts that were recorded after it, so that the shift of a node
+/// that is moved by all of them or by none of them can be computed without replaying them.
+typedef struct ShiftLogEntry {
+
+  /// The offset from which offsets are shifted.
+  uint32_t from;
+
+  /// The smallest `from` of the shifts recorded after this one, or `UINT32_MAX` if there is none.
+  ///
+  /// A node that starts before this offset is moved by none of these shifts.
+  uint32_t min_from;
+
+  /// The shift to apply, which may be negative.
+  int64_t delta;
+
+  /// The sum of the deltas of this shift and of all the shifts recorded before it.
+  int64_t total;
+
+  /// The largest `s.from - p.total` of the shifts `s` recorded after this one, where `p` is the
+  /// shift recorded right before `s`, or `INT64_MIN` if there is none.
+  ///
+  /// A node that starts at `start` is moved by all of these shifts if `start - total` is greater
+  /// than or equal to this value.
+  int64_t max_threshold;
+
+} ShiftLogEntry;
 
 /// A structure that holds AST nodes along with other long-lived metadata.
+///
+/// Nodes and extra data are stored in fixed-size segments, so that growing the context never moves
+/// existing nodes. All segments are allocated from the context's arena, and are freed at once when
+/// the context is deinitialized. Segments are zero-initialized, so that the unused parts of nodes
+/// and the padding between extra data runs have deterministic contents.
 typedef struct Context {
 
   /// The input string representing the program source.
+  ///
+  /// The source must be followed by a zero byte, which the lexer uses as a sentinel.
   const char* source;
 
-  /// The buffer containing the AST nodes managed by this context.
-  Node* nodes;
+  /// The length of the program source, in bytes.
+  size_t source_length;
+
+  /// The arena from which the context's memory is allocated.
+  Arena arena;
+
+  /// The interner that assigns a symbol to each name of the program source.
+  Interner interner;
 
-  /// The number of nodes in the context.
+  /// The segments containing the AST nodes managed by this context.
+  ///
+  /// The node at index `i` is stored at position `i % NODE_SEGMENT_SIZE` of the segment
+  /// `i / NODE_SEGMENT_SIZE`.
+  Node** node_segments;
+
+  /// The number of allocated node segments.
+  size_t node_segment_count;
+
+  /// The capacity of the node segment table.
+  size_t node_segment_capacity;
+
+  /// The number of nodes in the context, including deleted ones.
   size_t node_count;
 
-  /// The capacity of the node buffer.
-  size_t node_capacity;
+  /// The index of the last deleted node, or `~0` if no node has been deleted.
+  ///
+  /// Deleted nodes form a linked list, through which their slots are reused by `context_new_node`.
+  /// Each deleted node is an error node whose `paren_expr` field holds the index of the previously
+  /// deleted node.
+  NodeID free_list;
+
+  /// The number of deleted nodes in `free_list`.
+  size_t free_count;
+
+  /// The segments containing the variable-length contents of the AST nodes (e.g., the statements
+  /// of a brace statement), as 32-bit words.
+  ///
+  /// The contents of a node are always contiguous. Contents that are larger than a segment are
+  /// stored in consecutive segments that belong to the same allocation.
+  uint32_t** extra_segments;
+
+  /// The number of allocated extra data segments.
+  size_t extra_segment_count;
+
+  /// The capacity of the extra data segment table.
+  size_t extra_segment_capacity;
+
+  /// The number of words of extra data in the context, including the padding that is inserted to
+  /// keep the contents of each node contiguous.
+  size_t extra_count;
+
+  /// The position of the last freed extra data run of each size, or `~0` if there is none.
+  ///
+  /// The list at index `i` holds runs of `i + 1` words. Freed runs form linked lists, through which
+  /// they are reused by `context_append_extra`. The first word of each freed run holds the position
+  /// of the previously freed run of the same size.
+  uint32_t extra_free_lists[EXTRA_FREE_LIST_COUNT];
+
+  /// The generation up to which the shifts of the shift log have been applied to each top-level
+  /// node, indexed by node, or `NULL` if top-level nodes aren't tracked (see `context_track_root`).
+  ///
+  /// The entry of a node that isn't tracked is 0, which is never a valid generation.
+  uint32_t* root_generations;
+
+  /// The number of entries in `root_generations`.
+  size_t root_capacity;
+
+  /// The shifts of the offsets of the top-level nodes that have been recorded by
+  /// `context_log_shift`, indexed by generation modulo `SHIFT_LOG_CAPACITY`, or `NULL` if
+  /// top-level nodes aren't tracked.
+  ShiftLogEntry* shift_log;
+
+  /// The generation of the last recorded shift.
+  uint32_t shift_generation;
+
+  /// The generation up to which the shifts of all top-level nodes have been applied.
+  uint32_t settled_generation;
+
+  /// The index in `root_generations` from which the next top-level nodes are settled in the
+  /// background by `context_log_shift`.
+  size_t settle_cursor;
 
 } Context;
 
-/// Initializes a context.
-void context_init(Context*, const char* source);
+/// Initializes a context with a program source of the given length.
+void context_init(Context*, const char* source, size_t source_length);
 
 /// Deinitializes a context.
+///
+/// This frees all the memory of the context at once, regardless of its number of nodes.
 void context_deinit(Context*);
 
 /// Allocates a new node and returns its index in the context.
 ///
-/// Calling this function may invalidate all existing node pointers.
+/// The node reuses the slot of a deleted node if there is any. Its contents are zero-initialized.
+/// Existing node pointers remain valid.
 NodeID context_new_node(Context*);
 
-/// Deallocate the node at the given index.
+/// Ensures that the context can hold `count` additional nodes without allocating new segments.
+void context_reserve(Context*, size_t count);
+
+/// Appends `count` words to the extra data of the context and returns the position of the first.
+///
+/// The words are stored contiguously, reusing a freed run of the same size if there is any.
+/// Existing extra data pointers remain valid.
+uint32_t context_append_extra(Context*, const uint32_t* words, size_t count);
+
+/// Frees the run of `count` words of extra data at the given position, so that it can be reused by
+/// `context_append_extra`.
+///
+/// Runs of more than `EXTRA_FREE_LIST_COUNT` words are not reclaimed before the context is
+/// deinitialized.
+void context_free_extra(Context*, uint32_t position, size_t count);
+
+/// Rounds the given number of nodes up to a multiple of `NODE_SEGMENT_SIZE`.
+static inline size_t node_segment_align(size_t count) {
+  return (count + NODE_SEGMENT_SIZE - 1) & ~(size_t)(NODE_SEGMENT_SIZE - 1);
+}
+
+/// Rounds the given number of extra data words up to a multiple of `EXTRA_SEGMENT_SIZE`.
+static inline size_t extra_segment_align(size_t count) {
+  return (count + EXTRA_SEGMENT_SIZE - 1) & ~(size_t)(EXTRA_SEGMENT_SIZE - 1);
+}
+
+/// Appends the nodes and extra data of `other` to this context, without copying them, and leaves
+/// `other` empty.
+///
+/// The segments of `other` are adopted as they are, starting at the next segment boundaries of
+/// this context (i.e., at `node_segment_align(node_count)` and `extra_segment_align(extra_count)`).
+/// Hence, the nodes of `other` must have been relocated accordingly. The gap before the adopted
+/// nodes is filled with error nodes.
+///
+/// The symbols in the nodes of `other` must have been assigned by this context's interner, which is
+/// left unchanged. `other` must not have any deleted node, freed extra data or tracked node.
+void context_adopt(Context*, Context* other);
+
+/// Uses the given storage as the nodes and extra data of an empty context, without copying them.
+///
+/// `nodes` must hold `node_segment_align(node_count)` nodes and `extra` must hold
+/// `extra_segment_align(extra_count)` words, so that both consist of whole segments. The storage
+/// must remain valid and writable until the context is deinitialized, as new nodes may be stored
+/// after the existing ones.
+void context_attach(Context*, Node* nodes, size_t node_count, uint32_t* extra, size_t extra_count);
+
+/// Deletes the node at the given index, so that its slot can be reused by `context_new_node`.
+///
+/// The node's extra data is freed (see `context_free_extra`), and it is no longer tracked as a
+/// top-level node. Its children are left untouched.
 void context_delete_node(Context*, NodeID index);
 
+/// Starts tracking the offsets of the given top-level node, if it isn't already tracked.
+///
+/// A top-level node is either a top-level declaration, whose own offsets are tracked, or one of
+/// the statements of the program, whose offsets and descendants' are tracked. Tracked nodes are
+/// shifted lazily (see `context_log_shift`), and untracked as they are deleted.
+void context_track_root(Context*, NodeID index);
+
+/// Returns whether the offsets of the given node are tracked as those of a top-level node.
+static inline bool context_is_root(const Context* self, NodeID index) {
+  return (index < self->root_capacity) && (self->root_generations[index] != 0);
+}
+
+/// Records that the offsets of the tracked top-level nodes whose first token starts at or after
+/// `from` (see `context_get_first_offset`) must be shifted by `delta`, which may be negative,
+/// without shifting them.
+///
+/// Other tracked nodes are not shifted; those that enclose `from` should be shifted right away with
+/// `context_shift_root`. The recorded shifts are applied lazily, as nodes are settled. A bounded
+/// number of nodes is settled by each call, so that the log never overflows and the cost of a
+/// shift does not depend on the size of the program.
+void context_log_shift(Context*, uint32_t from, int64_t delta);
+
+/// Returns the offset of the first token of the given node, which is not necessarily its start
+/// (e.g., a binary expression starts at its operator).
+///
+/// The offset of a top-level declaration is its start.
+uint32_t context_get_first_offset(Context*, NodeID index);
+
+/// Returns the shift that has yet to be applied to the offsets of the given node, modulo 2^32.
+///
+/// The result is 0 for untracked nodes. The offsets of a tracked node's descendants must not be
+/// read before it is settled, since their shifts are pending along with its own.
+uint32_t context_get_pending_shift(Context*, NodeID index);
+
+/// Applies the pending shifts of the given tracked top-level node.
+void context_settle_root(Context*, NodeID index);
+
+/// Shifts the offsets of the given tracked top-level node with `node_shift`, after having settled
+/// it.
+void context_shift_root(Context*, NodeID index, uint32_t from, int64_t delta);
+
+/// Applies the pending shifts of all tracked top-level nodes.
+void context_settle_all(Context*);
+
+/// Applies the pending shifts of all tracked top-level nodes, if any.
+///
+/// This function must be called before the offsets of nodes are read after an incremental reparse
+/// (see `reparse`).
+static inline void context_settle(Context* self) {
+  if (self->settled_generation != self->shift_generation) { context_settle_all(self); }
+}
+
 /// Returns a pointer to the node with the specified ID.
 ///
-/// The returned pointer is not guaranteed after the node list is mutated. In particular, a call to
-/// either `context_new_node` or `context_delete_node` may invalidate it.
+/// The returned pointer remains valid until the context is deinitialized, or until the node is
+/// deleted with `context_delete_node`.
 static inline Node* context_get_nodeptr(Context* self, NodeID index) {
-  return self->nodes + index;
+  return self->node_segments[index >> NODE_SEGMENT_SHIFT] + (index & (NODE_SEGMENT_SIZE - 1));
+}
+
+/// Returns a pointer to the extra data at the given position.
+///
+/// The returned pointer remains valid until the context is deinitialized.
+static inline uint32_t* context_get_extra(const Context* self, uint32_t position) {
+  return self->extra_segments[position >> EXTRA_SEGMENT_SHIFT]
+    + (position & (EXTRA_SEGMENT_SIZE - 1));
+}
+
+/// Returns the number of parameters of the given function declaration.
+static inline size_t context_get_paramc(const Context* self, const Node* fun_decl) {
+  return *context_get_extra(self, fun_decl->bits.fun_decl.params);
+}
+
+/// Returns the `i`-th parameter of the given function declaration.
+static inline Token context_get_param(const Context* self, const Node* fun_decl, size_t i) {
+  Token param;
+  memcpy(&param,
+         context_get_extra(self, fun_decl->bits.fun_decl.params)
+           + PARAM_HEADER_WORD_COUNT + i * PARAM_WORD_COUNT,
+         sizeof(Token));
+  return param;
+}
+
+/// Returns the position of the capture list of the given function declaration in the context's
+/// extra data, or `UNRESOLVED_CAPTURES` if its captures haven't been resolved yet.
+///
+/// A capture list holds one token per captured identifier, laid out like parameters (see
+/// `resolve_captures`).
+static inline uint32_t context_get_captures(const Context* self, const Node* fun_decl) {
+  return context_get_extra(self, fun_decl->bits.fun_decl.params)[2];
+}
+
+/// Returns the number of identifiers captured by the given function declaration, whose captures
+/// must have been resolved.
+static inline size_t context_get_capturec(const Context* self, const Node* fun_decl) {
+  return context_get_extra(self, fun_decl->bits.fun_decl.params)[1];
+}
+
+/// Returns the `i`-th identifier captured by the given function declaration, whose captures must
+/// have been resolved.
+static inline Token context_get_capture(const Context* self, const Node* fun_decl, size_t i) {
+  Token capture;
+  memcpy(&capture,
+         context_get_extra(self, context_get_captures(self, fun_decl)) + i * PARAM_WORD_COUNT,
+         sizeof(Token));
+  return capture;
+}
+
+/// Returns the number of children of the given node, i.e., the nodes that `node_walk` visits
+/// between its entry and its exit.
+static inline size_t context_get_childc(const Context* self, const Node* node) {
+  (void)self;
+  switch (node->kind) {
+    case nk_top_decl:
+      return node->bits.top_decl.stmtc;
+    case nk_var_decl:
+      return (node->bits.var_decl.initializer != (NodeID)~0) ? 1 : 0;
+    case nk_apply_expr:
+      return 1 + node->bits.apply_expr.argc;
+    case nk_brace_stmt:
+      return node->bits.brace_stmt.stmtc;
+    case nk_if_stmt:
+      return (node->bits.if_stmt.else_ != (NodeID)~0) ? 3 : 2;
+    case nk_binary_expr:
+    case nk_while_stmt:
+      return 2;
+    case nk_fun_decl:
+    case nk_obj_decl:
+    case nk_unary_expr:
+    case nk_member_expr:
+    case nk_paren_expr:
+    case nk_expr_stmt:
+    case nk_ret_stmt:
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+/// Returns the `i`-th child of the given node, in the order in which `node_walk` visits them.
+static inline NodeID context_get_child(const Context* self, const Node* node, size_t i) {
+  switch (node->kind) {
+    case nk_top_decl:
+      return *context_get_extra(self, node->bits.top_decl.stmts + (uint32_t)i);
+    case nk_var_decl:
+      return node->bits.var_decl.initializer;
+    case nk_fun_decl:
+      return node->bits.fun_decl.body;
+    case nk_obj_decl:
+      return node->bits.obj_decl.body;
+    case nk_unary_expr:
+      return node->bits.unary_expr.subexpr;
+    case nk_binary_expr:
+      return (i == 0) ? node->bits.binary_expr.lhs : node->bits.binary_expr.rhs;
+    case nk_member_expr:
+      return node->bits.member_expr.base;
+    case nk_apply_expr:
+      return (i == 0)
+        ? node->bits.apply_expr.callee
+        : *context_get_extra(self, node->bits.apply_expr.args + (uint32_t)(i - 1));
+    case nk_paren_expr:
+      return node->bits.paren_expr;
+    case nk_brace_stmt:
+      return *context_get_extra(self, node->bits.brace_stmt.stmts + (uint32_t)i);
+    case nk_expr_stmt:
+      return node->bits.expr_stmt;
+    case nk_if_stmt:
+      return (i == 0) ? node->bits.if_stmt.cond
+        : (i == 1) ? node->bits.if_stmt.then_
+        : node->bits.if_stmt.else_;
+    case nk_while_stmt:
+      return (i == 0) ? node->bits.while_stmt.cond : node->bits.while_stmt.body;
+    case nk_ret_stmt:
+      return node->bits.ret_stmt;
+    default:
+      return (NodeID)~0;
+  }
 }
 
 #endif
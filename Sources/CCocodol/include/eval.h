@@ -2,12 +2,14 @@
 #define COCODOL_EVAL_H
 
 #include "common.h"
+#include "resolver.h"
 #include "symtable.h"
 #include "value.h"
 
 #define VALUE_STACK_SIZE 1024
 
 struct EvalFrame;
+struct InputBuffer;
 
 /// The state of an interpreter.
 typedef struct EvalState {
@@ -21,9 +23,15 @@ typedef struct EvalState {
   /// The table of global symbols.
   SymTable globals;
 
+  /// The resolver that determines the identifiers captured by the functions of the program.
+  ResolverState resolver;
+
   /// A pointer to the current local frame.
   struct EvalFrame* frame;
 
+  /// The buffered reader of the standard input, allocated the first time a value is read.
+  struct InputBuffer* input;
+
   /// The current index in the value stack.
   size_t value_index;
 
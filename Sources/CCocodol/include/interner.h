@@ -0,0 +1,100 @@
+#ifndef COCODOL_INTERNER_H
+#define COCODOL_INTERNER_H
+
+#include "common.h"
+
+/// A value denoting the absence of a symbol (e.g., in a token that is not a name).
+#define NO_SYMBOL ((Symbol)~0)
+
+/// The symbols reserved for the names of the built-in functions.
+///
+/// These names are interned before any other, so that their symbols are the same in every
+/// context.
+enum {
+  sym_print         ,
+  sym_read_int      ,
+  sym_read_float    ,
+  sym_at_eof        ,
+
+  /// The number of reserved symbols.
+  sym_builtin_count ,
+};
+
+/// The textual representation of an interned name.
+typedef struct SymbolInfo {
+
+  /// The first character of the name.
+  ///
+  /// Names are not copied. The text points into the program source, or into static storage for
+  /// reserved symbols, and it is not null-terminated.
+  const char* text;
+
+  /// The length of the name, in bytes.
+  uint32_t length;
+
+  /// The hash of the name.
+  uint32_t hash;
+
+} SymbolInfo;
+
+/// A table that assigns a dense symbol to each distinct name.
+///
+/// Symbols are assigned in order of first occurrence, starting with the reserved ones, so that
+/// they can be used to index arrays. Two names are equal if and only if they have the same symbol.
+typedef struct Interner {
+
+  /// The interned names, indexed by symbol.
+  SymbolInfo* symbols;
+
+  /// The number of interned names.
+  size_t count;
+
+  /// The capacity of `symbols`.
+  size_t capacity;
+
+  /// An open-addressing hash table mapping names onto their symbols, with `NO_SYMBOL` marking free
+  /// slots.
+  Symbol* slots;
+
+  /// The number of slots in the hash table, which is a power of two.
+  size_t slot_count;
+
+} Interner;
+
+/// Initializes an interner with the reserved symbols.
+void interner_init(Interner*);
+
+/// Deinitializes an interner.
+void interner_deinit(Interner*);
+
+/// Returns the symbol of the name of `length` bytes at `text`, interning it if necessary.
+///
+/// The name is not copied, and must outlive the interner.
+Symbol interner_intern(Interner*, const char* text, size_t length);
+
+/// Returns the symbol of the given name if it has been interned, or `NO_SYMBOL` otherwise.
+Symbol interner_find(const Interner*, const char* text, size_t length);
+
+/// Updates the text of the interned names after an edit of the program source in which they occur.
+///
+/// The range [start, end) of `old_source`, which has `old_length` bytes, has been replaced so that
+/// the text that followed it is moved by `delta` bytes in `new_source`. Names that do not overlap
+/// the replaced range are pointed into `new_source`, whereas the others are copied into `arena`,
+/// as they no longer occur in the source. Reserved names are left unchanged.
+///
+/// `old_source` must still be valid when this function is called.
+void interner_rebase(Interner*,
+                     const char* old_source,
+                     size_t old_length,
+                     const char* new_source,
+                     size_t start,
+                     size_t end,
+                     int64_t delta,
+                     struct Arena* arena);
+
+/// Returns the textual representation of an interned name.
+static inline const SymbolInfo* interner_get(const Interner* self, Symbol symbol) {
+  return self->symbols + symbol;
+}
+
+#endif
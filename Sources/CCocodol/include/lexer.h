@@ -12,10 +12,18 @@ typedef struct LexerState {
   /// The index from which the input is being tokenized.
   size_t index;
 
+  /// The routines used to scan runs of characters in bulk.
+  const struct ScanKernels* scan;
+
+  /// The interner that assigns symbols to names, or `NULL` if names should not be interned.
+  struct Interner* interner;
+
 } LexerState;
 
 /// Initializes a lexer's state.
-void lexer_init(LexerState*, const char* source);
+///
+/// Names are interned with `interner`, unless it is `NULL`.
+void lexer_init(LexerState*, const char* source, struct Interner* interner);
 
 /// Deinitializes a lexer's state.
 void lexer_deinit(LexerState*);
@@ -24,6 +32,9 @@ void lexer_deinit(LexerState*);
 ///
 /// If a token is successfully tokenized, this function returns `true` and stores the value of the
 /// token at `token`. Otherwise, it returns `false` and the value at `token` is undefined.
+///
+/// Token offsets are stored on 32 bits. Past that limit, they are truncated while `index` keeps
+/// tracking the actual position of the lexer.
 bool lexer_next(LexerState*, struct Token* token);
 
 #endif
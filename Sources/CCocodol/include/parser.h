@@ -4,6 +4,7 @@
 #include "common.h"
 #include "lexer.h"
 #include "token.h"
+#include "token_buffer.h"
 
 #define TOKEN_BUFFER_LENGTH 8
 
@@ -16,13 +17,34 @@ typedef struct ParserState {
   /// The lexer that tokenizes the parser's input.
   LexerState lexer;
 
+  /// The tokens of the parser's input, if they have been tokenized up front.
+  ///
+  /// If this field is `NULL`, tokens are pulled from `lexer` as the parser consumes them.
+  /// Otherwise, they are read from this buffer and `lexer` is unused.
+  TokenBuffer* tokens;
+
+  /// The position of the next token in `tokens`.
+  size_t token_index;
+
+  /// The position past the last token that the parser may read from `tokens`.
+  size_t token_limit;
+
+  /// A flag indicating whether the parser is responsible for deinitializing `tokens`.
+  bool owns_tokens;
+
   /// The lookahead buffer.
+  ///
+  /// If the parser reads from `tokens`, the token at position `i` is decoded into the slot at
+  /// `i % TOKEN_BUFFER_LENGTH`, so that it remains valid until `TOKEN_BUFFER_LENGTH` other tokens
+  /// have been consumed.
   Token lookahead_buffer[TOKEN_BUFFER_LENGTH];
 
   /// The current start index of the lookahead buffer.
   size_t lookahead_start;
 
   /// The current end index of the lookahead buffer.
+  ///
+  /// If the parser reads from `tokens`, this is the number of tokens that have been decoded.
   size_t lookahead_end;
 
   /// The index from which the input is being parser.
@@ -31,6 +53,16 @@ typedef struct ParserState {
   /// The current lexical scope.
   NodeID scope;
 
+  /// A stack of node indices, on which the statements of the lists being parsed are accumulated
+  /// before being copied into the context's extra data.
+  NodeID* scratch;
+
+  /// The number of node indices on the scratch stack.
+  size_t scratch_count;
+
+  /// The capacity of the scratch stack.
+  size_t scratch_capacity;
+
   /// A pointer to arbitrary user data.
   void* user_data;
 
@@ -47,9 +79,44 @@ typedef struct ParseError {
 
 } ParseError;
 
+/// A replacement of a range of the program source by new text.
+typedef struct SourceEdit {
+
+  /// The position of the first replaced byte in the old source.
+  size_t start;
+
+  /// The position past the last replaced byte in the old source.
+  size_t end;
+
+  /// The length of the replacement text, in bytes.
+  size_t length;
+
+} SourceEdit;
+
+/// The type of a callback that is notified of top-level declarations parsed from a stream.
+///
+/// The callback receives the declarations, their number and the user data of the parser.
+typedef void(*ParseDeclsCallback)(const NodeID* declv, size_t declc, void* user_data);
+
 /// Initializes a parser's state.
 void parser_init(ParserState*, struct Context* context, void* user_data);
 
+/// Initializes a parser's state, tokenizing the whole source up front.
+///
+/// The parser falls back to pull tokens from the lexer if the source can't be stored in a token
+/// buffer (see `token_buffer_init`).
+void parser_init_buffered(ParserState*, struct Context* context, void* user_data);
+
+/// Initializes a parser's state to read the tokens in the range [begin, end) of the given buffer.
+///
+/// The parser doesn't take ownership of the token buffer, which must outlive it.
+void parser_init_slice(ParserState*,
+                       struct Context* context,
+                       TokenBuffer* tokens,
+                       size_t begin,
+                       size_t end,
+                       void* user_data);
+
 /// Deinitializes a parser's state.
 void parser_deinit(ParserState*);
 
@@ -59,6 +126,70 @@ void parser_deinit(ParserState*);
 /// responsible for disposing of the allocated the memory.
 size_t parse(ParserState*, NodeID** declv, ParseErrorCallback);
 
+/// Parses a sequence of top-level declarations from the input buffer, using up to `thread_count`
+/// threads.
+///
+/// The function splits the parser's tokens at top-level declaration boundaries and parses each
+/// chunk on a separate context, before merging the results into the parser's context. The
+/// resulting trees are structurally equal to those produced by `parse`, although node indices and
+/// the layout of the context's storage may differ. If any diagnostic is reported, the input is
+/// parsed again serially so that diagnostics are reported in order.
+///
+/// The function falls back to `parse` if the parser doesn't read from a token buffer, or if the
+/// input is too small to benefit from parallelism.
+size_t parse_parallel(ParserState*,
+                      NodeID** declv,
+                      size_t thread_count,
+                      ParseErrorCallback);
+
+/// Parses a sequence of top-level declarations from a source stream, as it is being read.
+///
+/// The context's source must be the text of the stream. Each time the stream delivers a chunk of
+/// input, the function parses the top-level declarations that are known to be complete and passes
+/// them to `handle_decls`. A function or type declaration is complete as soon as its body is
+/// closed; other declarations and statements are complete once the next declaration starts.
+///
+/// Complete declarations are parsed and handled one boundary at a time, so that the batches passed
+/// to `handle_decls`, and the diagnostics reported in between, don't depend on how the stream
+/// splits its input into chunks.
+///
+/// This function returns `false` if an error occurred while reading the stream.
+bool parse_stream(struct Context* context,
+                  struct SourceStream* stream,
+                  void* user_data,
+                  ParseErrorCallback report_diag,
+                  ParseDeclsCallback handle_decls);
+
+/// Updates the AST of a context after an edit of its source, reparsing as little as possible.
+///
+/// `declv` must point to the top-level declarations of the context, as returned by `parse` or by a
+/// previous call to this function, and `declc` must be their number. `source` is the edited program
+/// source, which has `source_length` bytes and must be followed by a zero byte. It replaces the
+/// source of the context, which must remain valid until the function returns.
+///
+/// The function re-tokenizes and re-parses the smallest brace statement that strictly encloses the
+/// edit, provided that it still parses as a single brace statement ending at the same closing
+/// brace. Otherwise, it re-parses the top-level statements from the one preceding the edit until it
+/// reaches a statement that starts at the same token after the edit as before. In both cases, the
+/// result is identical to that of parsing the whole edited source, except that diagnostics are
+/// only reported for the reparsed region.
+///
+/// Nodes outside of the reparsed region are reused, and the offsets of those that follow the edit
+/// are shifted. The shifts of the top-level statements that follow the edit are deferred, so that
+/// the cost of an edit does not depend on the size of the program: `context_settle` must be called
+/// before the offsets of nodes are read. Replaced nodes are deleted, so that their indices and
+/// extra data may be reused for other nodes.
+/// The buffer at `declv` may be reallocated. The function returns the new number of top-level
+/// declarations.
+size_t reparse(struct Context* context,
+               const char* source,
+               size_t source_length,
+               SourceEdit edit,
+               NodeID** declv,
+               size_t declc,
+               void* user_data,
+               ParseErrorCallback report_diag);
+
 /// Parses a single declaration and returns its index in the context.
 NodeID parse_decl(ParserState* self, ParseErrorCallback);
 
@@ -0,0 +1,81 @@
+#ifndef COCODOL_RESOLVER_H
+#define COCODOL_RESOLVER_H
+
+#include "common.h"
+#include "token.h"
+
+/// The state of a resolver, which determines the identifiers captured by function declarations.
+///
+/// The identifiers captured by a function are those that occur free in its body, i.e., that refer
+/// to a binding outside of the function declaration. Captures are resolved once per function, and
+/// stored in the context's extra data (see `context_get_captures`).
+///
+/// The resolver keeps its tables from one call to `resolve_captures` to the next, so that it can
+/// serve to resolve the declarations of a program as they are parsed.
+typedef struct ResolverState {
+
+  /// The context of the declarations being resolved.
+  struct Context* context;
+
+  /// The nesting level of the innermost function in which each symbol is bound, or 0 if the
+  /// symbol is not bound in any of the functions being resolved.
+  ///
+  /// The table is indexed by symbol. All its entries are 0 between two calls to
+  /// `resolve_captures`.
+  uint32_t* levels;
+
+  /// The nesting level of the innermost function that captures each symbol, or 0 if the symbol
+  /// isn't captured by any of the functions being resolved.
+  ///
+  /// The table is indexed by symbol. All its entries are 0 between two calls to
+  /// `resolve_captures`.
+  uint32_t* marks;
+
+  /// The number of entries in `levels` and `marks`.
+  size_t symbol_capacity;
+
+  /// The previous values of the entries of `levels` that have been overwritten, as pairs of a
+  /// symbol and a level, which are restored when leaving scopes and functions.
+  ///
+  /// Each scope is preceded by the position at which the enclosing scope starts. Each function
+  /// is also preceded by the number of captures of the enclosing functions.
+  uint32_t* undo;
+
+  /// The number of words in `undo`.
+  size_t undo_count;
+
+  /// The capacity of `undo`.
+  size_t undo_capacity;
+
+  /// The identifiers captured by the functions being resolved, from the outermost to the
+  /// innermost.
+  Token* captures;
+
+  /// The entries of `marks` that have been overwritten when each identifier of `captures` was
+  /// captured, which are restored when leaving the function that captured it.
+  uint32_t* saved_marks;
+
+  /// The number of tokens in `captures`.
+  size_t capture_count;
+
+  /// The capacity of `captures`.
+  size_t capture_capacity;
+
+} ResolverState;
+
+/// Initializes a resolver's state.
+void resolver_init(ResolverState*, struct Context* context);
+
+/// Deinitializes a resolver's state.
+void resolver_deinit(ResolverState*);
+
+/// Resolves the captures of all the function declarations in the given declarations and in their
+/// descendants.
+///
+/// Functions whose captures have already been resolved are skipped, together with the functions
+/// that they contain, so that resolving the declarations of a program again costs only a walk of
+/// its top-level statements. A capture list holds one token per captured identifier, namely its
+/// first occurrence in the function, in the order of occurrence. Captures are resolved by symbol.
+void resolve_captures(ResolverState*, const NodeID* declv, size_t declc);
+
+#endif
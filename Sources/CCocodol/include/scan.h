@@ -0,0 +1,40 @@
+#ifndef COCODOL_SCAN_H
+#define COCODOL_SCAN_H
+
+#include "common.h"
+
+/// A set of routines that scan runs of characters in bulk.
+///
+/// Each routine accepts a pointer into a NUL-terminated buffer and returns a pointer to the first
+/// character that does not belong to the run it scans. The terminating NUL never belongs to any
+/// run, so that routines always stop at the end of the buffer.
+///
+/// Vectorized routines may read past the end of the buffer, but never across an aligned boundary
+/// that is larger than the size of their vectors. Hence, they never touch an unmapped page.
+typedef struct ScanKernels {
+
+  /// The name of the kernels (e.g., "sse2").
+  const char* name;
+
+  /// Skips a run of whitespace characters.
+  const char* (*skip_spaces)(const char* stream);
+
+  /// Skips the remainder of a line, stopping at a line terminator (i.e., '\n' or '\r').
+  const char* (*skip_line)(const char* stream);
+
+  /// Skips a run of identifier characters (i.e., ASCII letters, digits and underscores).
+  const char* (*skip_ident)(const char* stream);
+
+  /// Skips a run of decimal digits.
+  const char* (*skip_digits)(const char* stream);
+
+} ScanKernels;
+
+/// Returns the fastest kernels supported by the host CPU.
+const ScanKernels* scan_kernels(void);
+
+/// Returns the kernels with the given name (i.e., "scalar", "sse2" or "avx2"), or `NULL` if they
+/// are not available on the host CPU.
+const ScanKernels* scan_kernels_named(const char* name);
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef COCODOL_SOURCE_H
+#define COCODOL_SOURCE_H
+
+#include "common.h"
+
+/// A program source loaded from a file.
+///
+/// The contents of the file are mapped read-only into memory, rather than copied, and are always
+/// followed by at least one zero byte, so that they can directly serve as the source of a context.
+typedef struct SourceFile {
+
+  /// The contents of the file, followed by a zero byte.
+  const char* text;
+
+  /// The size of the file, in bytes.
+  size_t length;
+
+  /// The size of the memory mapping that holds `text`.
+  size_t mapping_size;
+
+} SourceFile;
+
+/// Maps the file at the given path into memory.
+///
+/// This function returns `false` and sets `errno` if the file could not be mapped, in which case
+/// the source is left empty. Otherwise, the source must be closed with `source_file_close`.
+bool source_file_open(SourceFile*, const char* path);
+
+/// Unmaps a source file.
+void source_file_close(SourceFile*);
+
+/// A program source read incrementally from a file descriptor (e.g., a pipe).
+///
+/// The contents are appended into a single reservation of address space, whose pages are committed
+/// as chunks are read. Hence, `text` is never moved, so that offsets into the source and pointers
+/// to it remain valid while the stream is being read. The contents are always followed by at
+/// least one zero byte.
+typedef struct SourceStream {
+
+  /// The contents read so far, followed by a zero byte.
+  const char* text;
+
+  /// The number of bytes read so far.
+  size_t length;
+
+  /// The number of bytes of the reservation that are committed.
+  size_t committed_size;
+
+  /// The size of the reservation.
+  size_t reserved_size;
+
+  /// The file descriptor from which the source is read.
+  int fd;
+
+  /// The error that occurred while reading the source, or `0`.
+  int error;
+
+  /// A flag indicating whether the end of the input has been reached.
+  bool at_end;
+
+} SourceStream;
+
+/// Initializes a source stream reading from the given file descriptor.
+///
+/// This function returns `false` and sets `errno` if address space could not be reserved for the
+/// source. The stream doesn't take ownership of the file descriptor.
+bool source_stream_open(SourceStream*, int fd);
+
+/// Reads the next chunk of the source, blocking until some input is available.
+///
+/// This function returns `false` once the end of the input has been reached, or if an error
+/// occurred, in which case `error` is set.
+bool source_stream_read(SourceStream*);
+
+/// Releases the memory of a source stream.
+void source_stream_close(SourceStream*);
+
+#endif
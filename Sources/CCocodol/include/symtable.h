@@ -3,63 +3,141 @@
 
 #include "common.h"
 
-struct SymTableEntry;
+/// The number of entries that a symbol table stores inline, before it spills to the heap.
+#define SYMTABLE_INLINE_CAPACITY 4
 
-/// A symbol table, mapping identifiers to arbitrary data.
+/// An entry of a symbol table.
+typedef struct SymTableEntry {
+
+  /// The key of the entry, or `NO_SYMBOL` if the entry is not occupied.
+  Symbol key;
+
+  /// The value of the entry.
+  void* val;
+
+} SymTableEntry;
+
+/// A symbol table, mapping interned identifiers to arbitrary data.
+///
+/// Small tables, such as the locals of most frames and the environments of most closures, keep
+/// their entries inline, in `small`, and never allocate. Once a table holds more than
+/// `SYMTABLE_INLINE_CAPACITY` entries, they spill to the heap.
+///
+/// On the heap, the table is an open-addressing hash table in the style of Swiss tables. Each slot
+/// has a control byte that tells whether it is empty, deleted, or full, in which case the byte
+/// holds 7 bits of the key's hash. Lookups compare the control bytes of a whole group of slots at
+/// once (with SSE2 when available) and only inspect the slots whose bytes match.
+///
+/// Keys are the symbols assigned by an `Interner`. Because symbols are dense, their hashes are
+/// cheap to compute (see `symtable_hash`), and callers that look up the same symbol in several
+/// tables can compute its hash once and use the `*_hashed` entry points.
 typedef struct SymTable {
 
-  /// The buckets of the table.
-  struct SymTableEntry* buckets;
+  /// The control bytes of the table, one per slot followed by copies of the first bytes, so that a
+  /// group of control bytes can be loaded from any position.
+  ///
+  /// This is `NULL` if the table's entries are stored inline.
+  int8_t* ctrl;
+
+  /// The slots of the table.
+  SymTableEntry* slots;
 
-  /// The number of used entries in `buckets`, including tombstones.
+  /// The number of entries in the table.
   size_t count;
 
-  /// The capacity of `buckets`.
+  /// The number of slots in the table, which is either 0 if the table's entries are stored inline,
+  /// or a power of two.
   size_t capacity;
 
+  /// The number of empty slots that can be filled before the table must grow.
+  ///
+  /// Deleted slots are not counted, so that tombstones are reclaimed when the table grows.
+  size_t growth_left;
+
+  /// The entries of the table, if they are stored inline, in their order of insertion.
+  ///
+  /// Only the first `count` entries are occupied.
+  SymTableEntry small[SYMTABLE_INLINE_CAPACITY];
 } SymTable;
 
+/// Returns the hash of the given symbol.
+///
+/// The low half of the hash is the symbol itself, which selects the first slot probed, so that the
+/// dense symbols of a table rarely collide. The high half is a mix of the symbol's bits, which
+/// tells apart the symbols that share a group of slots.
+static inline uint64_t symtable_hash(Symbol key) {
+  return ((uint64_t)(key * 0x9e3779b9u) << 32) | key;
+}
+
 /// Initializes a symbol table.
 void symtable_init(SymTable*);
 
 /// Deinitializes a symbol table.
-void symtable_deinit(SymTable*, bool delete_keys);
+void symtable_deinit(SymTable*);
 
 /// Inserts the given entry in the symbol table.
 ///
 /// The function returns `NULL` if a new entry was inserted, or the value of the existing entry if
 /// `key` was already in the table.
-void* symtable_insert(SymTable*, const char* key, void* value);
+void* symtable_insert(SymTable*, Symbol key, void* value);
+
+/// Inserts the given entry in the symbol table, given the hash of its key.
+void* symtable_insert_hashed(SymTable*, Symbol key, uint64_t hash, void* value);
 
 /// Inserts or updates the given entry in the symbol table.
 ///
 /// The function returns `NULL` if a new entry was inserted, or the value that was overridden if
 /// `key` was already in the table.
-void* symtable_update(SymTable*, const char* key, void* value);
+void* symtable_update(SymTable*, Symbol key, void* value);
 
 /// Removes the entry indexed by the given key from the symbol table.
 ///
 /// The function returns the value of the existing entry for `key`,  or `NULL` if `key` is not in
 /// the table.
-void* symtable_remove(SymTable*, const char* key);
+void* symtable_remove(SymTable*, Symbol key);
+
+/// Retrieves the value for the given key in the symbol table, given the hash of the key, probing
+/// the table past the first slot if necessary.
+///
+/// This function is the slow path of `symtable_get_hashed`.
+void* symtable_get_probing(SymTable*, Symbol key, uint64_t hash);
+
+/// Retrieves the value for the given key in the symbol table, given the hash of the key.
+///
+/// The first slot probed is checked inline, as most lookups of dense symbols hit it. Slots that
+/// aren't full have no key, so a hit can be detected without reading control bytes.
+static inline void* symtable_get_hashed(SymTable* self, Symbol key, uint64_t hash) {
+  if (self->capacity > 0) {
+    SymTableEntry* entry = &self->slots[(size_t)(uint32_t)hash & (self->capacity - 1)];
+    if (entry->key == key) { return entry->val; }
+  }
+  return symtable_get_probing(self, key, hash);
+}
 
 /// Retrieves the value for the given key in the symbol table.
-void* symtable_get(SymTable*, const char* key);
+static inline void* symtable_get(SymTable* self, Symbol key) {
+  return symtable_get_hashed(self, key, symtable_hash(key));
+}
 
 /// Returns the number of entries in the table.
 size_t symtable_entry_count(SymTable*);
 
 /// Executes the given function on each entry of the table.
 ///
+/// Only the occupied entries are visited, so that mapping over a table costs in proportion to its
+/// number of entries rather than its capacity.
+///
 /// The parameter `results` is a reference to an array of arbitrary pointers, in which the result
 /// of each call to `transform` will be stored. `results` should be at least as large as the number
 /// of entries in the table. The function returns the number of elements stored in `results`. If it
 /// is passed as `NULL`, then no result is stored.
-size_t symtable_map(SymTable*, void** results, void*(*transform)(const char*, void*));
+size_t symtable_map(SymTable*, void** results, void*(*transform)(Symbol, void*));
 
-/// Exevutes the given function on each entry of the table.
+/// Executes the given function on each entry of the table.
+///
+/// Like `symtable_map`, the function visits only the occupied entries.
 ///
 /// The second parameter is a pointer to arbitrary data that is passed to the given function.
-void symtable_foreach(SymTable* self, void* user, void(*action)(const char*, void*, void*));
+void symtable_foreach(SymTable* self, void* user, void(*action)(Symbol, void*, void*));
 
 #endif
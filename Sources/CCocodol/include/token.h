@@ -76,10 +76,16 @@ typedef struct Token {
   TokenKind kind;
 
   /// The index at which the token starts in the source input.
-  size_t start;
+  uint32_t start;
 
   /// The index at which the token ends in the source input.
-  size_t end;
+  uint32_t end;
+
+  /// The symbol of the token's text if the token is a name, or `NO_SYMBOL` otherwise.
+  ///
+  /// Names are only interned when they are tokenized in a context (see `Interner`). Their symbols
+  /// are `NO_SYMBOL` otherwise.
+  Symbol symbol;
 
 } Token;
 
@@ -89,6 +95,8 @@ static inline size_t token_text_len(Token* token) {
 }
 
 /// Returns whether the textual representations of two token are equal.
+///
+/// Tokens that have symbols are compared by symbol. Others are compared by text.
 bool token_text_equal(struct Context* context, Token* lhs, Token* rhs);
 
 #endif
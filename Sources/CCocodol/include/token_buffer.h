@@ -0,0 +1,80 @@
+#ifndef COCODOL_TOKEN_BUFFER_H
+#define COCODOL_TOKEN_BUFFER_H
+
+#include <stdint.h>
+
+#include "common.h"
+#include "token.h"
+
+/// Returns the 1-byte code of a token kind.
+///
+/// The code packs the 5 low bits of the kind (i.e., its index in its category) together with its
+/// category bits (i.e., `TOK_DECL_BIT`, `TOK_STMT_BIT` or `TOK_OPER_BIT`).
+#define token_kind_code(kind)  ((uint8_t)(((kind) & 0x1f) | (((kind) >> 11) & 0xe0)))
+
+/// A buffer of tokens, stored as parallel arrays.
+///
+/// The buffer stores the kind, the start offset and the symbol of each token. Token lengths are
+/// derived from their kinds, either because the kind has a fixed textual representation (e.g.,
+/// `tk_while`), from their symbols for interned names, or by re-scanning the source (e.g.,
+/// `tk_integer`).
+typedef struct TokenBuffer {
+
+  /// The input string representing the program source.
+  const char* source;
+
+  /// The kind codes of the tokens (see `token_kind_code`).
+  uint8_t* kinds;
+
+  /// The offsets at which the tokens start in the source.
+  uint32_t* starts;
+
+  /// The symbols of the tokens (see `Token.symbol`).
+  Symbol* symbols;
+
+  /// The interner with which names are interned, or `NULL`.
+  struct Interner* interner;
+
+  /// The number of tokens in the buffer.
+  size_t count;
+
+  /// The number of tokens that the buffer can hold.
+  size_t capacity;
+
+} TokenBuffer;
+
+/// Initializes a token buffer with the tokens of the given source, interning names with
+/// `interner` unless it is `NULL`.
+///
+/// This function returns `false` if the source is too large for its offsets to be represented on
+/// 32 bits, in which case the buffer is left empty. In either case, the buffer must be
+/// deinitialized with `token_buffer_deinit`.
+bool token_buffer_init(TokenBuffer*, const char* source, struct Interner* interner);
+
+/// Initializes an empty token buffer for a source that is still being read.
+///
+/// Tokens are added with `token_buffer_append` as the source grows. The source must not be moved
+/// in the meantime, and its offsets must fit on 32 bits.
+void token_buffer_init_empty(TokenBuffer*, const char* source, struct Interner* interner);
+
+/// Appends the tokens of the source that start at offset `start` or later, and returns the offset
+/// from which tokenization should resume once more of the source is available.
+///
+/// `length` is the number of bytes of the source that are currently available. Unless `is_final`
+/// is `true`, tokenization stops before any token that reaches the end of the available source,
+/// as its remainder may not have been read yet (e.g., `whi` could be the start of `while`).
+size_t token_buffer_append(TokenBuffer*, size_t start, size_t length, bool is_final);
+
+/// Deinitializes a token buffer.
+void token_buffer_deinit(TokenBuffer*);
+
+/// Returns the kind of the token at the given position.
+TokenKind token_buffer_kind(const TokenBuffer*, size_t position);
+
+/// Returns the offset at which the token at the given position ends in the source.
+size_t token_buffer_end(const TokenBuffer*, size_t position);
+
+/// Stores the token at the given position into `token`.
+void token_buffer_get(const TokenBuffer*, size_t position, Token* token);
+
+#endif
@@ -10,4 +10,43 @@ uint64_t fnv1_hash_buffer(const char* bytes, size_t count);
 /// Hashes the given string.
 uint64_t fnv1_hash_string(const char* str);
 
+/// Hashes the given buffer, reading it 8 bytes at a time.
+///
+/// This function is much faster than `fnv1_hash_buffer` on large buffers (e.g., program sources),
+/// but slower on short ones (e.g., identifiers).
+uint64_t wide_hash_buffer(const char* bytes, size_t count);
+
+/// The state of a hash computed incrementally over the parts of a buffer that is not contiguous
+/// in memory.
+///
+/// The result is equal to that of `wide_hash_buffer` called on the concatenation of the parts.
+typedef struct WideHasher {
+
+  /// The hash of the words that have been consumed.
+  uint64_t state;
+
+  /// The bytes of the word being accumulated.
+  char word[8];
+
+  /// The number of bytes in `word`.
+  size_t word_count;
+
+} WideHasher;
+
+/// Initializes a hasher for a buffer of `count` bytes.
+void wide_hasher_init(WideHasher*, size_t count);
+
+/// Feeds the next `count` bytes of the buffer to a hasher.
+void wide_hasher_update(WideHasher*, const char* bytes, size_t count);
+
+/// Returns the hash of the bytes fed to a hasher, which must be as many as announced by
+/// `wide_hasher_init`.
+uint64_t wide_hasher_finalize(WideHasher*);
+
+/// Hashes the given short buffer (e.g., an identifier), reading it a word at a time.
+///
+/// This function is faster than `fnv1_hash_buffer` on names of more than a few bytes, as it
+/// multiplies once per word rather than once per byte.
+uint64_t name_hash_buffer(const char* bytes, size_t count);
+
 #endif
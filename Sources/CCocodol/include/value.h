@@ -8,13 +8,16 @@ typedef struct RuntimeValue {
 
   /// The value's kind.
   enum {
-    rv_junk     ,
-    rv_print    ,
-    rv_lazy     ,
-    rv_function ,
-    rv_bool     ,
-    rv_integer  ,
-    rv_float    ,
+    rv_junk       ,
+    rv_print      ,
+    rv_read_int   ,
+    rv_read_float ,
+    rv_at_eof     ,
+    rv_lazy       ,
+    rv_function   ,
+    rv_bool       ,
+    rv_integer    ,
+    rv_float      ,
   } kind;
 
   /// The bits of the runtime value.
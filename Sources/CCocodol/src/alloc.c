@@ -0,0 +1,93 @@
+#include <stdlib.h>
+
+#include "alloc.h"
+
+static void* default_allocate(void* user, size_t size, AllocCategory category) {
+  return malloc(size);
+}
+
+static void default_deallocate(void* user, void* ptr, size_t size, AllocCategory category) {
+  free(ptr);
+}
+
+/// The allocator currently installed.
+static Allocator allocator = { default_allocate, default_deallocate, NULL };
+
+/// The allocation statistics of each category.
+///
+/// The statistics are updated atomically, as the parser may allocate from several threads.
+static AllocStats stats[ac_count];
+
+#define stat_add(field, n)  __atomic_add_fetch(&(field), (n), __ATOMIC_RELAXED)
+#define stat_sub(field, n)  __atomic_sub_fetch(&(field), (n), __ATOMIC_RELAXED)
+
+void cocodol_set_allocator(const Allocator* new_allocator) {
+  if (new_allocator != NULL) {
+    allocator = *new_allocator;
+  } else {
+    allocator.allocate = default_allocate;
+    allocator.deallocate = default_deallocate;
+    allocator.user = NULL;
+  }
+}
+
+void* cocodol_alloc(AllocCategory category, size_t size) {
+  void* ptr = allocator.allocate(allocator.user, size, category);
+  if (ptr == NULL) { return NULL; }
+
+  AllocStats* s = &stats[category];
+  stat_add(s->alloc_count, 1);
+  stat_add(s->byte_count, size);
+  stat_add(s->live_count, 1);
+  size_t live = stat_add(s->live_byte_count, size);
+  size_t peak = __atomic_load_n(&s->peak_byte_count, __ATOMIC_RELAXED);
+  while (live > peak) {
+    if (__atomic_compare_exchange_n(
+      &s->peak_byte_count, &peak, live, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) { break; }
+  }
+
+  return ptr;
+}
+
+void cocodol_free(AllocCategory category, void* ptr, size_t size) {
+  if (ptr == NULL) { return; }
+  allocator.deallocate(allocator.user, ptr, size, category);
+
+  AllocStats* s = &stats[category];
+  stat_sub(s->live_count, 1);
+  stat_sub(s->live_byte_count, size);
+}
+
+AllocStats cocodol_alloc_stats(AllocCategory category) {
+  return stats[category];
+}
+
+size_t cocodol_live_alloc_count(void) {
+  size_t count = 0;
+  for (size_t i = 0; i < ac_count; ++i) {
+    count += stats[i].live_count;
+  }
+  return count;
+}
+
+void cocodol_reset_alloc_stats(void) {
+  for (size_t i = 0; i < ac_count; ++i) {
+    stats[i].alloc_count = stats[i].live_count;
+    stats[i].byte_count = stats[i].live_byte_count;
+    stats[i].peak_byte_count = stats[i].live_byte_count;
+  }
+}
+
+const char* alloc_category_name(AllocCategory category) {
+  switch (category) {
+    case ac_ident     : return "ident";
+    case ac_value     : return "value";
+    case ac_frame     : return "frame";
+    case ac_env       : return "env";
+    case ac_symtable  : return "symtable";
+    case ac_input     : return "input";
+    case ac_tokens    : return "tokens";
+    case ac_ast       : return "ast";
+    default           : return "unknown";
+  }
+}
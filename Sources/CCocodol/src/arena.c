@@ -0,0 +1,96 @@
+#include "alloc.h"
+#include "arena.h"
+
+/// The size of the first block allocated by an arena.
+#define INITIAL_BLOCK_SIZE  (64 << 10)
+
+/// The maximum size of the blocks allocated for small allocations.
+#define MAX_BLOCK_SIZE      (4 << 20)
+
+/// The alignment of arena allocations.
+#define ARENA_ALIGNMENT     16
+
+/// The size of a block header, rounded up so that the block's storage is aligned.
+#define BLOCK_HEADER_SIZE \
+  ((sizeof(ArenaBlock) + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1))
+
+void arena_init(Arena* self) {
+  self->head = NULL;
+  self->tail = NULL;
+  self->cursor = NULL;
+  self->limit = NULL;
+  self->next_block_size = INITIAL_BLOCK_SIZE;
+}
+
+void arena_deinit(Arena* self) {
+  ArenaBlock* block = self->head;
+  while (block != NULL) {
+    ArenaBlock* prev = block->prev;
+    cocodol_free(ac_ast, block, BLOCK_HEADER_SIZE + block->size);
+    block = prev;
+  }
+  arena_init(self);
+}
+
+/// Allocates a new block with at least `size` bytes of storage.
+static ArenaBlock* arena_new_block(Arena* self, size_t size) {
+  ArenaBlock* block = cocodol_alloc(ac_ast, BLOCK_HEADER_SIZE + size);
+  block->size = size;
+  if (self->tail == NULL) { self->tail = block; }
+  return block;
+}
+
+void* arena_alloc(Arena* self, size_t size) {
+  size = (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+  if ((size_t)(self->limit - self->cursor) >= size) {
+    void* ptr = self->cursor;
+    self->cursor += size;
+    return ptr;
+  }
+
+  // Allocate large requests in a block of their own, behind the current one, so that the
+  // remainder of the current block can still be used.
+  if (size > self->next_block_size / 4) {
+    ArenaBlock* block = arena_new_block(self, size);
+    if (self->head == NULL) {
+      block->prev = NULL;
+      self->head = block;
+      self->cursor = self->limit = (char*)block + BLOCK_HEADER_SIZE + size;
+    } else {
+      block->prev = self->head->prev;
+      self->head->prev = block;
+      if (self->tail == self->head) { self->tail = block; }
+    }
+    return (char*)block + BLOCK_HEADER_SIZE;
+  }
+
+  // Start a new block.
+  ArenaBlock* block = arena_new_block(self, self->next_block_size);
+  block->prev = self->head;
+  self->head = block;
+  self->cursor = (char*)block + BLOCK_HEADER_SIZE;
+  self->limit = self->cursor + block->size;
+  if (self->next_block_size < MAX_BLOCK_SIZE) {
+    self->next_block_size *= 2;
+  }
+
+  void* ptr = self->cursor;
+  self->cursor += size;
+  return ptr;
+}
+
+void arena_adopt(Arena* self, Arena* other) {
+  if (other->head == NULL) { return; }
+
+  // Insert the other arena's blocks behind the current one, so that allocation continues from the
+  // current block.
+  if (self->head == NULL) {
+    *self = *other;
+  } else {
+    other->tail->prev = self->head->prev;
+    self->head->prev = other->head;
+    if (self->tail == self->head) { self->tail = other->tail; }
+  }
+
+  arena_init(other);
+}
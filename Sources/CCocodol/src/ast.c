@@ -4,353 +4,310 @@
 
 #include <stdio.h>
 
+#include "alloc.h"
 #include "ast.h"
 #include "context.h"
 #include "token.h"
-#include "utils.h"
 
-void node_deinit(Node* self) {
+void node_relocate(Node* self, Context* context, NodeID node_offset, uint32_t extra_offset) {
+#define relocate(index) if ((index) != (NodeID)~0) { (index) += node_offset; }
   switch (self->kind) {
     case nk_top_decl:
-      free(self->bits.top_decl.stmtv);
-      self->bits.top_decl.stmtv = NULL;
-      self->bits.top_decl.stmtc = 0;
+      for (size_t i = 0; i < self->bits.top_decl.stmtc; ++i) {
+        relocate(*context_get_extra(context, self->bits.top_decl.stmts + i));
+      }
+      self->bits.top_decl.stmts += extra_offset;
       break;
 
-    case nk_fun_decl:
-      free(self->bits.fun_decl.paramv);
-      self->bits.fun_decl.paramv = NULL;
-      self->bits.fun_decl.paramc = 0;
+    case nk_var_decl:
+      relocate(self->bits.var_decl.initializer);
       break;
 
-    case nk_apply_expr:
-      free(self->bits.apply_expr.argv);
-      self->bits.apply_expr.argv = NULL;
-      self->bits.apply_expr.argc = 0;
+    case nk_fun_decl: {
+      uint32_t* captures = context_get_extra(context, self->bits.fun_decl.params) + 2;
+      if (*captures != UNRESOLVED_CAPTURES) { *captures += extra_offset; }
+      self->bits.fun_decl.params += extra_offset;
+      relocate(self->bits.fun_decl.body);
       break;
+    }
 
-    case nk_brace_stmt:
-      free(self->bits.brace_stmt.stmtv);
-      self->bits.brace_stmt.stmtv = NULL;
-      self->bits.brace_stmt.stmtc = 0;
-
-      DeclList* head = self->bits.brace_stmt.last_decl;
-      while (head != NULL) {
-        DeclList* next = head->prev;
-        free(head);
-        head = next;
-      }
+    case nk_obj_decl:
+      relocate(self->bits.obj_decl.body);
       break;
 
-    default:
+    case nk_unary_expr:
+      relocate(self->bits.unary_expr.subexpr);
       break;
-  }
-}
 
-bool node_walk(NodeID index,
-               struct Context* context,
-               void*  user,
-               bool   (*visit)(NodeID, NodeKind, bool, void*))
-{
-  Node* node = context_get_nodeptr(context, index);
-  NodeKind kind = node->kind;
-  if (!visit(index, kind, true, user)) { return true; }
-
-  switch (kind) {
-    case nk_top_decl: {
-      size_t  stmtc = node->bits.top_decl.stmtc;
-      NodeID* stmtv = node->bits.top_decl.stmtv;
-      for (size_t i = 0; i < stmtc; ++i) {
-        if (!node_walk(stmtv[i], context, user, visit)) { return false; }
-      }
+    case nk_binary_expr:
+      relocate(self->bits.binary_expr.lhs);
+      relocate(self->bits.binary_expr.rhs);
       break;
-    }
 
-    case nk_var_decl: {
-      NodeID init = node->bits.var_decl.initializer;
-      if (init != ~0) {
-        if (!node_walk(init, context, user, visit)) { return false; }
+    case nk_member_expr:
+      relocate(self->bits.member_expr.base);
+      break;
+
+    case nk_apply_expr:
+      relocate(self->bits.apply_expr.callee);
+      for (size_t i = 0; i < self->bits.apply_expr.argc; ++i) {
+        relocate(*context_get_extra(context, self->bits.apply_expr.args + i));
       }
+      self->bits.apply_expr.args += extra_offset;
       break;
-    }
 
-    case nk_fun_decl: {
-      NodeID body = node->bits.fun_decl.body;
-      if (!node_walk(body, context, user, visit)) { return false; }
+    case nk_paren_expr:
+      relocate(self->bits.paren_expr);
+      break;
+
+    case nk_brace_stmt:
+      for (size_t i = 0; i < self->bits.brace_stmt.stmtc; ++i) {
+        relocate(*context_get_extra(context, self->bits.brace_stmt.stmts + i));
+      }
+      self->bits.brace_stmt.stmts += extra_offset;
+      relocate(self->bits.brace_stmt.parent);
+
+      // Relocate the list of declarations, whose links are shifted along with the extra data.
+      for (uint32_t it = self->bits.brace_stmt.last_decl; it != (uint32_t)~0;) {
+        uint32_t* link = context_get_extra(context, it);
+        it = link[1];
+        relocate(link[0]);
+        if (link[1] != (uint32_t)~0) { link[1] += extra_offset; }
+      }
+      if (self->bits.brace_stmt.last_decl != (uint32_t)~0) {
+        self->bits.brace_stmt.last_decl += extra_offset;
+      }
       break;
-    }
 
-    case nk_obj_decl: {
-      NodeID body = node->bits.obj_decl.body;
-      if (!node_walk(body, context, user, visit)) { return false; }
+    case nk_expr_stmt:
+      relocate(self->bits.expr_stmt);
       break;
-    }
 
-    case nk_unary_expr: {
-      NodeID subexpr = node->bits.unary_expr.subexpr;
-      if (!node_walk(subexpr, context, user, visit)) { return false; }
+    case nk_if_stmt:
+      relocate(self->bits.if_stmt.cond);
+      relocate(self->bits.if_stmt.then_);
+      relocate(self->bits.if_stmt.else_);
       break;
-    }
 
-    case nk_binary_expr: {
-      NodeID lhs = node->bits.binary_expr.lhs;
-      NodeID rhs = node->bits.binary_expr.rhs;
-      if (!node_walk(lhs, context, user, visit)) { return false; }
-      if (!node_walk(rhs, context, user, visit)) { return false; }
+    case nk_while_stmt:
+      relocate(self->bits.while_stmt.cond);
+      relocate(self->bits.while_stmt.body);
       break;
-    }
 
-    case nk_member_expr: {
-      size_t base = node->bits.member_expr.base;
-      if (!node_walk(base, context, user, visit)) { return false; }
+    case nk_ret_stmt:
+      relocate(self->bits.ret_stmt);
       break;
-    }
 
-    case nk_apply_expr: {
-      NodeID callee = node->bits.apply_expr.callee;
-      size_t  argc = node->bits.apply_expr.argc;
-      NodeID* argv = node->bits.apply_expr.argv;
-      if (!node_walk(callee, context, user, visit)) { return false; }
-      for (size_t i = 0; i < argc; ++i) {
-        if (!node_walk(argv[i], context, user, visit)) { return false; }
-      }
+    default:
       break;
-    }
+  }
+#undef relocate
+}
+
+/// Shifts the offsets of a token, if it starts at or after `from`.
+static inline void token_shift(Token* token, uint32_t from, int64_t delta) {
+  if (token->start >= from) {
+    token->start = (uint32_t)(token->start + delta);
+    token->end = (uint32_t)(token->end + delta);
+  }
+}
 
-    case nk_paren_expr: {
-      NodeID subexpr = node->bits.paren_expr;
-      if (!node_walk(subexpr, context, user, visit)) { return false; }
+/// Shifts the offsets of `count` tokens stored as raw words in the extra data.
+static void tokens_shift(uint32_t* words, size_t count, uint32_t from, int64_t delta) {
+  for (size_t i = 0; i < count; ++i) {
+    Token token;
+    memcpy(&token, words + i * PARAM_WORD_COUNT, sizeof(Token));
+    token_shift(&token, from, delta);
+    memcpy(words + i * PARAM_WORD_COUNT, &token, sizeof(Token));
+  }
+}
+
+void node_shift(Node* self, Context* context, uint32_t from, int64_t delta) {
+  // The tokens of a node are within its range.
+  if (self->end < from) { return; }
+  if (self->start >= from) { self->start = (uint32_t)(self->start + delta); }
+  if (self->end >= from) { self->end = (uint32_t)(self->end + delta); }
+
+  switch (self->kind) {
+    case nk_var_decl:
+      token_shift(&self->bits.var_decl.name, from, delta);
       break;
-    }
 
-    case nk_brace_stmt: {
-      size_t  stmtc = node->bits.brace_stmt.stmtc;
-      NodeID* stmtv = node->bits.brace_stmt.stmtv;
-      for (size_t i = 0; i < stmtc; ++i) {
-        if (!node_walk(stmtv[i], context, user, visit)) { return false; }
+    case nk_fun_decl: {
+      token_shift(&self->bits.fun_decl.name, from, delta);
+
+      // Shift the parameters and the captured identifiers, which are stored as raw tokens in the
+      // extra data.
+      uint32_t* params = context_get_extra(context, self->bits.fun_decl.params);
+      tokens_shift(params + PARAM_HEADER_WORD_COUNT, params[0], from, delta);
+
+      if (params[2] != UNRESOLVED_CAPTURES) {
+        tokens_shift(context_get_extra(context, params[2]), params[1], from, delta);
       }
       break;
     }
 
-    case nk_expr_stmt: {
-      NodeID expr = node->bits.expr_stmt;
-      if (!node_walk(expr, context, user, visit)) { return false; }
+    case nk_obj_decl:
+      token_shift(&self->bits.obj_decl.name, from, delta);
       break;
-    }
 
-    case nk_if_stmt: {
-      NodeID cond  = node->bits.if_stmt.cond;
-      NodeID then  = node->bits.if_stmt.then_;
-      NodeID else_ = node->bits.if_stmt.else_;
-      if (!node_walk(cond, context, user, visit)) { return false; }
-      if (!node_walk(then, context, user, visit)) { return false; }
-      if (else_ != ~0) {
-        if (!node_walk(else_, context, user, visit)) { return false; }
-      }
+    case nk_declref_expr:
+      token_shift(&self->bits.declref_expr, from, delta);
       break;
-    }
 
-    case nk_while_stmt: {
-      NodeID cond = node->bits.while_stmt.cond;
-      NodeID body = node->bits.while_stmt.body;
-      if (!node_walk(cond, context, user, visit)) { return false; }
-      if (!node_walk(body, context, user, visit)) { return false; }
+    case nk_unary_expr:
+      token_shift(&self->bits.unary_expr.op, from, delta);
       break;
-    }
 
-    case nk_ret_stmt: {
-      NodeID value = node->bits.ret_stmt;
-      if (!node_walk(value, context, user, visit)) { return false; }
+    case nk_binary_expr:
+      token_shift(&self->bits.binary_expr.op, from, delta);
       break;
-    }
 
-    case nk_error:
-    case nk_declref_expr:
-    case nk_bool_expr:
-    case nk_integer_expr:
-    case nk_float_expr:
-    case nk_brk_stmt:
-    case nk_nxt_stmt:
+    case nk_member_expr:
+      token_shift(&self->bits.member_expr.member, from, delta);
       break;
-  }
 
-  return visit(index, kind, false, user);
+    default:
+      break;
+  }
 }
 
-typedef struct {
-  Context* context;
-  NodeID fun_index;
-  NodeID body_index;
-  NodeID scope;
-  size_t symc;
-  Token** symv;
-} CaptureVisitorEnv;
-
-bool ident_is_local(CaptureVisitorEnv* env, Token* lhs) {
-  Context* context = env->context;
-  Token* rhs = NULL;
-
-  // Search within the function's local scopes.
-  NodeID scope_index = env->scope;
-  while (scope_index != ~0) {
-    // Get the declaration list of the current scope.
-    Node* scope = context_get_nodeptr(context, scope_index);
-    assert(scope->kind == nk_brace_stmt);
-
-    // Search within the current scope.
-    DeclList* list = scope->bits.brace_stmt.last_decl;
-    while (list) {
-      Node* decl = context_get_nodeptr(context, list->decl);
-      list = list->prev;
-
-      switch (decl->kind) {
-        case nk_var_decl:
-          rhs = &decl->bits.var_decl.name;
-          break;
-
-        case nk_fun_decl:
-          rhs = &decl->bits.var_decl.name;
-          break;
-
-        default:
-          continue;
-      }
+/// The number of frames that `node_walk` keeps on the C stack before it allocates a buffer.
+#define WALK_INLINE_CAPACITY 32
 
-      if (token_text_equal(context, lhs, rhs)) {
-        // It's a reference to a local declaration; no further action required.
-        return true;
-      }
-    }
+/// The value of `WalkFrame.kind` for the frames that denote an entry.
+#define WALK_ENTRY ((uint32_t)~0)
 
-    // Move to the parent scope, unless we reached the function.
-    if (scope_index != env->body_index) {
-      scope_index = scope->bits.brace_stmt.parent;
-    } else {
-      scope_index = ~0;
-    }
-  }
+/// A pending visit of `node_walk`.
+typedef struct WalkFrame {
 
-  // Check the function's parameters.
-  Node* fun_decl = context_get_nodeptr(context, env->fun_index);
-  for (size_t i = 0; i < fun_decl->bits.fun_decl.paramc; ++i) {
-    rhs = &fun_decl->bits.fun_decl.paramv[i];
-    if (token_text_equal(context, lhs, rhs)) {
-      // It's a reference to a parameter; no further action required.
-      return true;
-    }
-  }
+  /// The index of the node to visit.
+  NodeID index;
 
-  // Check the function's name.
-  rhs = &fun_decl->bits.fun_decl.name;
-  if (token_text_equal(context, lhs, rhs)) {
-    // It's a recursive reference; no further action required.
-    return true;
-  }
+  /// The kind of the node if the frame denotes an exit, or `WALK_ENTRY` if it denotes an entry.
+  uint32_t kind;
 
-  // The symbol is defined externally.
-  return false;
-}
+} WalkFrame;
 
-bool capture_insert_symbol(Context* context, Token** symv, Token* new_sym) {
-  // Compute the index of the symbol to insert.
-  size_t h = fnv1_hash_buffer(context->source + new_sym->start, new_sym->end - new_sym->start);
-  size_t position = h % MAX_CAPTURE_COUNT;
-  size_t insert_position = position;
-  while (symv[insert_position] != NULL) {
-    if (token_text_equal(context, new_sym, symv[insert_position])) {
-      // The symbol is already in the capture list.
-      return false;
-    }
+/// Stores the entry frames of all the children of a node but the first, in reverse order, at the
+/// given position, and returns the first child.
+static inline NodeID walk_schedule(Context* context,
+                                   const Node* node,
+                                   size_t childc,
+                                   WalkFrame* frames)
+{
+  const NodeID* items;
+  switch (node->kind) {
+    case nk_top_decl:
+      items = context_get_extra(context, node->bits.top_decl.stmts);
+      break;
 
-    // Check the next position.
-    insert_position = (insert_position + 1) % MAX_CAPTURE_COUNT;
-    assert(insert_position != position);
-  }
+    case nk_brace_stmt:
+      items = context_get_extra(context, node->bits.brace_stmt.stmts);
+      break;
 
-  symv[insert_position] = new_sym;
-  return true;
-}
+    case nk_apply_expr:
+      // The arguments follow the callee.
+      items = context_get_extra(context, node->bits.apply_expr.args);
+      for (size_t i = childc - 1; i > 0; --i) {
+        *frames++ = (WalkFrame){ items[i - 1], WALK_ENTRY };
+      }
+      return node->bits.apply_expr.callee;
 
-bool capture_visitor(NodeID index, NodeKind kind, bool pre, void* user) {
-  CaptureVisitorEnv* env = (CaptureVisitorEnv*)user;
-  Context* context = env->context;
+    case nk_binary_expr:
+      *frames = (WalkFrame){ node->bits.binary_expr.rhs, WALK_ENTRY };
+      return node->bits.binary_expr.lhs;
 
-  switch (kind) {
-    case nk_fun_decl: {
-      assert(pre);
-
-      // Build and merge the nested function's capture list.
-      Token* symv[MAX_CAPTURE_COUNT];
-      capture_set(index, context, symv, false);
-
-      for (size_t i = 0; i < MAX_CAPTURE_COUNT; ++i) {
-        // Check whether the nested function's captured symbols also escape the current function.
-        if ((symv[i] != NULL) &&
-            !ident_is_local(env, symv[i]) &&
-            capture_insert_symbol(context, env->symv, symv[i])) {
-          env->symc++;
-        }
-      }
+    case nk_while_stmt:
+      *frames = (WalkFrame){ node->bits.while_stmt.body, WALK_ENTRY };
+      return node->bits.while_stmt.cond;
 
-      return false;
-    }
+    case nk_if_stmt:
+      if (childc == 3) {
+        *frames++ = (WalkFrame){ node->bits.if_stmt.else_, WALK_ENTRY };
+      }
+      *frames = (WalkFrame){ node->bits.if_stmt.then_, WALK_ENTRY };
+      return node->bits.if_stmt.cond;
 
-    case nk_obj_decl:
-      assert(false && "not implemented");
+    default:
+      // The other nodes have a single child.
+      return context_get_child(context, node, 0);
+  }
 
-    case nk_declref_expr: {
-      assert(pre);
+  // Lists are stored contiguously in the extra data.
+  for (size_t i = childc - 1; i > 0; --i) {
+    *frames++ = (WalkFrame){ items[i], WALK_ENTRY };
+  }
+  return items[0];
+}
 
-      // Lookup the symbol statically.
-      Node* expr = context_get_nodeptr(context, index);
-      Token* lhs = &expr->bits.declref_expr;
-      if (!ident_is_local(env, lhs) &&
-          capture_insert_symbol(context, env->symv, lhs)) {
-        env->symc++;
+bool node_walk(NodeID index,
+               struct Context* context,
+               void*  user,
+               bool   (*visit)(NodeID, NodeKind, bool, void*))
+{
+  // The pending visits are stored on an explicit stack, in reverse order, so that the depth of the
+  // AST is not limited by the size of the C stack. The first child of a node is entered directly.
+  WalkFrame  inline_frames[WALK_INLINE_CAPACITY];
+  WalkFrame* frames = inline_frames;
+  size_t     capacity = WALK_INLINE_CAPACITY;
+  size_t     count = 0;
+
+  bool result = true;
+  NodeID next = index;
+  while (true) {
+    if (next == (NodeID)~0) {
+      // Resume the last pending visit.
+      if (count == 0) { break; }
+      WalkFrame frame = frames[--count];
+      if (frame.kind == WALK_ENTRY) {
+        next = frame.index;
+      } else if (!visit(frame.index, (NodeKind)frame.kind, false, user)) {
+        result = false;
+        break;
       }
-
-      return false;
+      continue;
     }
 
-    case nk_brace_stmt:
-      if (pre) {
-        env->scope = index;
-      } else {
-        env->scope = context_get_nodeptr(context, index)->bits.brace_stmt.parent;
+    NodeID current = next;
+    Node* node = context_get_nodeptr(context, current);
+    NodeKind kind = node->kind;
+    next = ~0;
+    if (!visit(current, kind, true, user)) { continue; }
+
+    // Exit leaves right away.
+    size_t childc = context_get_childc(context, node);
+    if (childc == 0) {
+      if (!visit(current, kind, false, user)) {
+        result = false;
+        break;
       }
-      return true;
+      continue;
+    }
 
-    default:
-      // assert(pre);
-      return true;
-  }
-}
+    // Schedule the exit of the node, preceded by the visits of its children.
+    if (count + childc > capacity) {
+      size_t new_capacity = capacity * 2;
+      while (new_capacity < count + childc) {
+        new_capacity = new_capacity * 2;
+      }
 
-size_t capture_set(NodeID fun_index, Context* context, Token** symv, bool defrag) {
-  memset(symv, 0, MAX_CAPTURE_COUNT * sizeof(Token*));
-
-  NodeID body_index = context_get_nodeptr(context, fun_index)->bits.fun_decl.body;
-  CaptureVisitorEnv env = {
-    context   , // AST context
-    fun_index , // index of the declaration being visited
-    body_index, // index of the function's body
-    body_index, // initial search scope
-    0         , // identifier count
-    symv };
-
-  // Visit the function declaration.
-  node_walk(body_index, context, &env, capture_visitor);
-
-  // Defragment the results, if requested to.
-  if (defrag) {
-    size_t free_position = 0;
-    for (size_t i = 0; i < MAX_CAPTURE_COUNT; ++i) {
-      if (symv[i] != NULL) {
-        symv[free_position] = symv[i];
-        free_position += 1;
+      WalkFrame* new_frames = cocodol_alloc(ac_ast, new_capacity * sizeof(WalkFrame));
+      memcpy(new_frames, frames, count * sizeof(WalkFrame));
+      if (frames != inline_frames) {
+        cocodol_free(ac_ast, frames, capacity * sizeof(WalkFrame));
       }
+      frames = new_frames;
+      capacity = new_capacity;
     }
+
+    frames[count] = (WalkFrame){ current, kind };
+    next = walk_schedule(context, node, childc, frames + count + 1);
+    count += childc;
   }
 
-  return env.symc;
+  if (frames != inline_frames) {
+    cocodol_free(ac_ast, frames, capacity * sizeof(WalkFrame));
+  }
+  return result;
 }
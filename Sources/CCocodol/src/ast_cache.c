@@ -0,0 +1,548 @@
+#include <assert.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ast_cache.h"
+#include "context.h"
+#include "utils.h"
+
+/// The magic number at the beginning of each cache entry.
+#define CACHE_MAGIC       "CCDLAST"
+
+/// A value identifying the byte order of the machine that wrote an entry.
+#define CACHE_BYTE_ORDER  0x01020304
+
+/// The alignment of each section of an entry.
+#define SECTION_ALIGNMENT 64
+
+/// The maximum length of the path of a cache entry.
+#define CACHE_PATH_SIZE   4096
+
+/// The default maximum total size of the entries of the cache, in megabytes.
+#define CACHE_DEFAULT_CAPACITY 256
+
+/// The header of a cache entry.
+///
+/// The header is followed by the entry's sections, in order: nodes, extra data, symbols and
+/// top-level declarations. The nodes and the extra data are padded to whole segments, so that
+/// they can serve as the storage of a context. Each symbol is stored as the offset and the length
+/// of its first occurrence in the source.
+typedef struct AstCacheHeader {
+
+  /// The magic number of the format (see `CACHE_MAGIC`).
+  char magic[8];
+
+  /// The version of the format (see `AST_CACHE_VERSION`).
+  uint32_t version;
+
+  /// The byte order of the machine that wrote the entry (see `CACHE_BYTE_ORDER`).
+  uint32_t byte_order;
+
+  /// The size of a node, in bytes.
+  uint32_t node_size;
+
+  /// The number of nodes in a node segment.
+  uint32_t node_segment_size;
+
+  /// The number of words in an extra data segment.
+  uint32_t extra_segment_size;
+
+  /// The number of symbols, excluding the reserved ones.
+  uint32_t symbol_count;
+
+  /// The key of the source from which the entry was created.
+  uint64_t key;
+
+  /// The length of the source from which the entry was created.
+  uint64_t source_length;
+
+  /// The number of nodes.
+  uint64_t node_count;
+
+  /// The number of words of extra data.
+  uint64_t extra_count;
+
+  /// The number of top-level declarations.
+  uint64_t decl_count;
+
+  /// The size of the entry, in bytes.
+  uint64_t file_size;
+
+  /// The hash of the sections of the entry, including their padding (see `wide_hash_buffer`).
+  uint64_t checksum;
+
+} AstCacheHeader;
+
+/// The offsets of the sections of a cache entry.
+typedef struct AstCacheLayout {
+
+  /// The offset of the nodes.
+  size_t nodes;
+
+  /// The offset of the extra data.
+  size_t extra;
+
+  /// The offset of the symbols.
+  size_t symbols;
+
+  /// The offset of the top-level declarations.
+  size_t decls;
+
+  /// The size of the entry.
+  size_t end;
+
+} AstCacheLayout;
+
+/// Rounds the given offset up to a multiple of `SECTION_ALIGNMENT`.
+static inline size_t section_align(size_t offset) {
+  return (offset + SECTION_ALIGNMENT - 1) & ~(size_t)(SECTION_ALIGNMENT - 1);
+}
+
+/// Computes the layout of an entry with the given header.
+static AstCacheLayout ast_cache_layout(const AstCacheHeader* header) {
+  AstCacheLayout layout;
+  layout.nodes = section_align(sizeof(AstCacheHeader));
+  layout.extra = section_align(
+    layout.nodes + node_segment_align(header->node_count) * sizeof(Node));
+  layout.symbols = section_align(
+    layout.extra + extra_segment_align(header->extra_count) * sizeof(uint32_t));
+  layout.decls = section_align(
+    layout.symbols + header->symbol_count * 2 * sizeof(uint32_t));
+  layout.end = layout.decls + header->decl_count * sizeof(NodeID);
+  return layout;
+}
+
+/// Initializes the fields of a header that describe the format of the entries written by this
+/// program.
+static void ast_cache_header_init(AstCacheHeader* header) {
+  memset(header, 0, sizeof(AstCacheHeader));
+  memcpy(header->magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+  header->version = AST_CACHE_VERSION;
+  header->byte_order = CACHE_BYTE_ORDER;
+  header->node_size = sizeof(Node);
+  header->node_segment_size = NODE_SEGMENT_SIZE;
+  header->extra_segment_size = EXTRA_SEGMENT_SIZE;
+}
+
+uint64_t ast_cache_key(const char* source, size_t length) {
+  return wide_hash_buffer(source, length);
+}
+
+bool ast_cache_directory(char* buffer, size_t size) {
+  int n;
+  const char* dir = getenv("COCODOL_CACHE_DIR");
+  if ((dir != NULL) && (*dir != 0)) {
+    n = snprintf(buffer, size, "%s", dir);
+  } else if (((dir = getenv("XDG_CACHE_HOME")) != NULL) && (*dir != 0)) {
+    n = snprintf(buffer, size, "%s/cocodol", dir);
+  } else if (((dir = getenv("HOME")) != NULL) && (*dir != 0)) {
+    n = snprintf(buffer, size, "%s/.cache/cocodol", dir);
+  } else {
+    return false;
+  }
+  return (n > 0) && ((size_t)n < size);
+}
+
+size_t ast_cache_capacity(void) {
+  const char* size = getenv("COCODOL_CACHE_SIZE");
+  if ((size == NULL) || (*size == 0)) {
+    return (size_t)CACHE_DEFAULT_CAPACITY << 20;
+  }
+  return (size_t)strtoull(size, NULL, 10) << 20;
+}
+
+/// Writes the path of the entry with the given key into `buffer`, which has `CACHE_PATH_SIZE`
+/// bytes.
+static bool ast_cache_path(char* buffer, uint64_t key) {
+  char dir[CACHE_PATH_SIZE];
+  if (!ast_cache_directory(dir, sizeof(dir))) { return false; }
+
+  int n = snprintf(buffer, CACHE_PATH_SIZE, "%s/%016llx.ast", dir, (unsigned long long)key);
+  return (n > 0) && (n < CACHE_PATH_SIZE);
+}
+
+// ------------------------------------------------------------------------------------------------
+// MARK: Loading
+// ------------------------------------------------------------------------------------------------
+
+/// Returns whether the given header describes a valid entry for `context`'s source.
+static bool ast_cache_validate(const AstCacheHeader* header,
+                               const Context* context,
+                               uint64_t key,
+                               size_t file_size)
+{
+  AstCacheHeader expected;
+  ast_cache_header_init(&expected);
+  if ((memcmp(header->magic, expected.magic, sizeof(expected.magic)) != 0) ||
+      (header->version != expected.version) ||
+      (header->byte_order != expected.byte_order) ||
+      (header->node_size != expected.node_size) ||
+      (header->node_segment_size != expected.node_segment_size) ||
+      (header->extra_segment_size != expected.extra_segment_size))
+  {
+    return false;
+  }
+
+  // Make sure the entry was created from the same source.
+  if ((header->key != key) || (header->source_length != context->source_length)) {
+    return false;
+  }
+
+  // Make sure the entry is complete. Counts are bounded before the layout is computed, so that
+  // its offsets can't overflow.
+  if ((header->node_count > UINT32_MAX) || (header->extra_count > UINT32_MAX) ||
+      (header->decl_count > header->node_count))
+  {
+    return false;
+  }
+  AstCacheLayout layout = ast_cache_layout(header);
+  return (header->file_size == file_size) && (layout.end == file_size);
+}
+
+bool ast_cache_load(AstCacheFile* self,
+                    Context* context,
+                    uint64_t key,
+                    NodeID** declv,
+                    size_t* declc)
+{
+  self->base = NULL;
+  self->mapping_size = 0;
+  assert((context->node_count == 0) && (context->interner.count == sym_builtin_count));
+
+  char path[CACHE_PATH_SIZE];
+  if (!ast_cache_path(path, key)) { return false; }
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) { return false; }
+
+  struct stat info;
+  if ((fstat(fd, &info) != 0) || ((size_t)info.st_size < sizeof(AstCacheHeader))) {
+    close(fd);
+    return false;
+  }
+
+  // Map the entry privately, so that nodes can be added to its last segment without modifying
+  // the file.
+  size_t file_size = (size_t)info.st_size;
+  char* base = mmap(NULL, file_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) { return false; }
+
+  const AstCacheHeader* header = (const AstCacheHeader*)base;
+  if (!ast_cache_validate(header, context, key, file_size)) {
+    munmap(base, file_size);
+    return false;
+  }
+  AstCacheLayout layout = ast_cache_layout(header);
+
+  // Make sure the sections weren't damaged, as the nodes are trusted as they are.
+  if (wide_hash_buffer(base + layout.nodes, layout.end - layout.nodes) != header->checksum) {
+    munmap(base, file_size);
+    return false;
+  }
+
+  // Check the top-level declarations.
+  const NodeID* decls = (const NodeID*)(base + layout.decls);
+  for (size_t i = 0; i < header->decl_count; ++i) {
+    if (decls[i] >= header->node_count) {
+      munmap(base, file_size);
+      return false;
+    }
+  }
+
+  // Intern the names of the source in the same order as when the entry was created, so that they
+  // get the symbols that are stored in the nodes.
+  const uint32_t* symbols = (const uint32_t*)(base + layout.symbols);
+  for (size_t i = 0; i < header->symbol_count; ++i) {
+    size_t start = symbols[2 * i];
+    size_t length = symbols[2 * i + 1];
+    if ((start + length > context->source_length) ||
+        (interner_intern(&context->interner, context->source + start, length)
+          != sym_builtin_count + i))
+    {
+      interner_deinit(&context->interner);
+      interner_init(&context->interner);
+      munmap(base, file_size);
+      return false;
+    }
+  }
+
+  // Use the mapped nodes and extra data as the storage of the context.
+  context_attach(context,
+                 (Node*)(base + layout.nodes), header->node_count,
+                 (uint32_t*)(base + layout.extra), header->extra_count);
+
+  *declc = header->decl_count;
+  *declv = (*declc > 0) ? malloc(*declc * sizeof(NodeID)) : NULL;
+  if (*declc > 0) {
+    memcpy(*declv, decls, *declc * sizeof(NodeID));
+  }
+
+  // Mark the entry as recently used, so that it is evicted last.
+  utimensat(AT_FDCWD, path, NULL, 0);
+
+  self->base = base;
+  self->mapping_size = file_size;
+  return true;
+}
+
+void ast_cache_close(AstCacheFile* self) {
+  if (self->base != NULL) {
+    munmap(self->base, self->mapping_size);
+  }
+  self->base = NULL;
+  self->mapping_size = 0;
+}
+
+// ------------------------------------------------------------------------------------------------
+// MARK: Storing
+// ------------------------------------------------------------------------------------------------
+
+/// Creates the given directory and its parents, if they don't exist.
+static bool make_directories(char* path) {
+  for (char* p = path + 1; *p != 0; ++p) {
+    if (*p != '/') { continue; }
+    *p = 0;
+    bool ok = (mkdir(path, 0755) == 0) || (errno == EEXIST);
+    *p = '/';
+    if (!ok) { return false; }
+  }
+  return (mkdir(path, 0755) == 0) || (errno == EEXIST);
+}
+
+/// A stream into which the sections of an entry are written, and which computes their checksum.
+typedef struct CacheWriter {
+
+  /// The stream into which the entry is written.
+  FILE* stream;
+
+  /// The hasher of the bytes written after the header.
+  WideHasher hasher;
+
+} CacheWriter;
+
+/// Writes `count` bytes into the given stream.
+static bool write_bytes(CacheWriter* writer, const void* bytes, size_t count) {
+  wide_hasher_update(&writer->hasher, bytes, count);
+  return fwrite(bytes, 1, count, writer->stream) == count;
+}
+
+/// Writes `count` zero bytes into the given stream.
+static bool write_zeros(CacheWriter* writer, size_t count) {
+  static const char zeros[SECTION_ALIGNMENT * 16] = { 0 };
+  while (count > 0) {
+    size_t n = (count < sizeof(zeros)) ? count : sizeof(zeros);
+    if (!write_bytes(writer, zeros, n)) { return false; }
+    count -= n;
+  }
+  return true;
+}
+
+/// Writes the segments of a segmented array of `count` elements of the given size, and pads the
+/// last one with zeros.
+static bool write_segments(CacheWriter* writer,
+                           void** segments,
+                           size_t count,
+                           size_t segment_size,
+                           size_t element_size)
+{
+  for (size_t i = 0; i * segment_size < count; ++i) {
+    size_t n = count - i * segment_size;
+    if (n > segment_size) { n = segment_size; }
+    if (!write_bytes(writer, segments[i], n * element_size)) { return false; }
+  }
+
+  size_t remainder = count % segment_size;
+  return (remainder == 0) || write_zeros(writer, (segment_size - remainder) * element_size);
+}
+
+/// Writes the sections of an entry into the given stream, after the header.
+static bool ast_cache_write_sections(CacheWriter* writer,
+                                     const AstCacheHeader* header,
+                                     Context* context,
+                                     const NodeID* declv)
+{
+  AstCacheLayout layout = ast_cache_layout(header);
+
+  // Write the nodes. The padding of the last node segment is made of error nodes, which are all
+  // zeros.
+  if (!write_segments(writer, (void**)context->node_segments, header->node_count,
+                      NODE_SEGMENT_SIZE, sizeof(Node)))
+  {
+    return false;
+  }
+
+  // Write the extra data.
+  size_t offset = layout.nodes + node_segment_align(header->node_count) * sizeof(Node);
+  if (!write_zeros(writer, layout.extra - offset) ||
+      !write_segments(writer, (void**)context->extra_segments, header->extra_count,
+                      EXTRA_SEGMENT_SIZE, sizeof(uint32_t)))
+  {
+    return false;
+  }
+
+  // Write the symbols.
+  offset = layout.extra + extra_segment_align(header->extra_count) * sizeof(uint32_t);
+  if (!write_zeros(writer, layout.symbols - offset)) { return false; }
+  for (size_t i = sym_builtin_count; i < context->interner.count; ++i) {
+    const SymbolInfo* info = interner_get(&context->interner, (Symbol)i);
+    uint32_t words[2] = { (uint32_t)(info->text - context->source), info->length };
+    if (!write_bytes(writer, words, sizeof(words))) { return false; }
+  }
+
+  // Write the top-level declarations.
+  offset = layout.symbols + header->symbol_count * 2 * sizeof(uint32_t);
+  return write_zeros(writer, layout.decls - offset) &&
+    write_bytes(writer, declv, header->decl_count * sizeof(NodeID));
+}
+
+/// Writes the contents of an entry into the given stream.
+///
+/// The header is written last, once the checksum of the sections is known.
+static bool ast_cache_write(FILE* stream,
+                            AstCacheHeader* header,
+                            Context* context,
+                            const NodeID* declv)
+{
+  AstCacheLayout layout = ast_cache_layout(header);
+  CacheWriter writer = { stream };
+  wide_hasher_init(&writer.hasher, layout.end - layout.nodes);
+
+  if ((fseek(stream, (long)layout.nodes, SEEK_SET) != 0) ||
+      !ast_cache_write_sections(&writer, header, context, declv))
+  {
+    return false;
+  }
+
+  // The padding after the header is left as a hole, which reads as zeros.
+  header->checksum = wide_hasher_finalize(&writer.hasher);
+  return (fseek(stream, 0, SEEK_SET) == 0) &&
+    (fwrite(header, sizeof(AstCacheHeader), 1, stream) == 1);
+}
+
+/// An entry of the cache directory, considered for eviction.
+typedef struct CacheEntry {
+
+  /// The name of the entry's file.
+  char name[32];
+
+  /// The size of the entry, in bytes.
+  size_t size;
+
+  /// The last time the entry was stored or loaded.
+  time_t mtime;
+
+} CacheEntry;
+
+static int compare_entries_by_age(const void* lhs, const void* rhs) {
+  time_t a = ((const CacheEntry*)lhs)->mtime;
+  time_t b = ((const CacheEntry*)rhs)->mtime;
+  return (a < b) ? -1 : ((a > b) ? 1 : 0);
+}
+
+/// Removes the least recently used entries of the given cache directory until the total size of
+/// the remaining ones is at most `capacity` bytes.
+static void ast_cache_evict(const char* dir, size_t capacity) {
+  DIR* stream = opendir(dir);
+  if (stream == NULL) { return; }
+
+  CacheEntry* entries = NULL;
+  size_t count = 0;
+  size_t allocated = 0;
+  size_t total = 0;
+  char path[CACHE_PATH_SIZE + 32];
+
+  // List the entries, ignoring the temporary files of concurrent writers.
+  struct dirent* item;
+  while ((item = readdir(stream)) != NULL) {
+    size_t length = strlen(item->d_name);
+    if ((length < 4) || (length >= sizeof(entries->name)) ||
+        (strcmp(item->d_name + length - 4, ".ast") != 0))
+    {
+      continue;
+    }
+
+    struct stat info;
+    snprintf(path, sizeof(path), "%s/%s", dir, item->d_name);
+    if ((stat(path, &info) != 0) || !S_ISREG(info.st_mode)) { continue; }
+
+    if (count == allocated) {
+      allocated = (allocated > 0) ? allocated * 2 : 64;
+      CacheEntry* grown = realloc(entries, allocated * sizeof(CacheEntry));
+      if (grown == NULL) { break; }
+      entries = grown;
+    }
+    memcpy(entries[count].name, item->d_name, length + 1);
+    entries[count].size = (size_t)info.st_size;
+    entries[count].mtime = info.st_mtime;
+    total += entries[count].size;
+    count++;
+  }
+  closedir(stream);
+
+  // Remove the oldest entries first.
+  if (total > capacity) {
+    qsort(entries, count, sizeof(CacheEntry), compare_entries_by_age);
+    for (size_t i = 0; (i < count) && (total > capacity); ++i) {
+      snprintf(path, sizeof(path), "%s/%s", dir, entries[i].name);
+      if (unlink(path) == 0) { total -= entries[i].size; }
+    }
+  }
+  free(entries);
+}
+
+bool ast_cache_store(Context* context, uint64_t key, const NodeID* declv, size_t declc) {
+  context_settle(context);
+
+  AstCacheHeader header;
+  ast_cache_header_init(&header);
+  header.symbol_count = (uint32_t)(context->interner.count - sym_builtin_count);
+  header.key = key;
+  header.source_length = context->source_length;
+  header.node_count = context->node_count;
+  header.extra_count = context->extra_count;
+  header.decl_count = declc;
+  header.file_size = ast_cache_layout(&header).end;
+
+  // Don't store entries that can't fit in the cache.
+  size_t capacity = ast_cache_capacity();
+  if (header.file_size > capacity) { return false; }
+
+  // Create the cache directory.
+  char dir[CACHE_PATH_SIZE];
+  char path[CACHE_PATH_SIZE];
+  if (!ast_cache_directory(dir, sizeof(dir)) || !make_directories(dir)) { return false; }
+  if (!ast_cache_path(path, key)) { return false; }
+
+  // Write the entry into a temporary file, which is then renamed, so that readers never see a
+  // partially written entry.
+  char temp_path[CACHE_PATH_SIZE + 32];
+  snprintf(temp_path, sizeof(temp_path), "%s.%ld.tmp", path, (long)getpid());
+  int fd = open(temp_path, O_WRONLY | O_CREAT | O_TRUNC | O_EXCL, 0644);
+  if (fd < 0) { return false; }
+
+  FILE* stream = fdopen(fd, "wb");
+  if (stream == NULL) {
+    close(fd);
+    unlink(temp_path);
+    return false;
+  }
+
+  bool ok = ast_cache_write(stream, &header, context, declv);
+  ok = (fclose(stream) == 0) && ok;
+  if (!ok || (rename(temp_path, path) != 0)) {
+    unlink(temp_path);
+    return false;
+  }
+
+  // Keep the cache within its capacity.
+  ast_cache_evict(dir, capacity);
+  return true;
+}
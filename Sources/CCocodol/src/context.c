@@ -1,50 +1,462 @@
+#include <assert.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "alloc.h"
 #include "context.h"
 
-#define INITIAL_CAPACITY 16
+#define INITIAL_SEGMENT_TABLE_CAPACITY 16
 
-void context_init(Context* self, const char* source) {
-  self->source = source;
+/// Initializes the storage of a context's nodes and extra data.
+static void context_init_storage(Context* self) {
+  arena_init(&self->arena);
 
-  // Initialize the node vector.
-  self->nodes = malloc(INITIAL_CAPACITY * sizeof(Node));
+  // Initialize the node segments.
+  self->node_segments = NULL;
+  self->node_segment_count = 0;
+  self->node_segment_capacity = 0;
   self->node_count = 0;
-  self->node_capacity = INITIAL_CAPACITY;
+  self->free_list = ~0;
+  self->free_count = 0;
+
+  // Initialize the extra data segments.
+  self->extra_segments = NULL;
+  self->extra_segment_count = 0;
+  self->extra_segment_capacity = 0;
+  self->extra_count = 0;
+  for (size_t i = 0; i < EXTRA_FREE_LIST_COUNT; ++i) {
+    self->extra_free_lists[i] = ~0;
+  }
+
+  // Initialize the tracking of top-level nodes.
+  self->root_generations = NULL;
+  self->root_capacity = 0;
+  self->shift_log = NULL;
+  self->shift_generation = 1;
+  self->settled_generation = 1;
+  self->settle_cursor = 0;
+}
+
+void context_init(Context* self, const char* source, size_t source_length) {
+  self->source = source;
+  self->source_length = source_length;
+  interner_init(&self->interner);
+  context_init_storage(self);
 }
 
 void context_deinit(Context* self) {
   self->source = NULL;
+  self->source_length = 0;
 
-  // Deinitialize the node vector.
-  for (size_t i = 0; i < self->node_count; ++i) {
-    node_deinit(self->nodes + i);
+  interner_deinit(&self->interner);
+  cocodol_free(ac_ast, self->root_generations, self->root_capacity * sizeof(uint32_t));
+  if (self->shift_log != NULL) {
+    cocodol_free(ac_ast, self->shift_log, SHIFT_LOG_CAPACITY * sizeof(ShiftLogEntry));
   }
-  free(self->nodes);
-  self->nodes = NULL;
-  self->node_count = 0;
-  self->node_capacity = 0;
+
+  // Free all segments at once.
+  arena_deinit(&self->arena);
+  context_init_storage(self);
 }
 
-void context_resize_node_buffer(Context* self) {
-  size_t new_capacity = self->node_capacity * 2;
-  Node* new_buffer = malloc(new_capacity * sizeof(Node));
-  memcpy(new_buffer, self->nodes, self->node_count * sizeof(Node));
-  free(self->nodes);
-  self->nodes = new_buffer;
-  self->node_capacity = new_capacity;
+/// Returns a segment table with at least `min_capacity` entries, copying the `count` entries of
+/// the given one if it has to be reallocated.
+///
+/// Tables are allocated from the context's arena. A table that is outgrown is simply abandoned, as
+/// the tables' sizes grow geometrically.
+static void** context_grow_table(Context* self,
+                                 void** table,
+                                 size_t count,
+                                 size_t* capacity,
+                                 size_t min_capacity)
+{
+  if (min_capacity <= *capacity) { return table; }
+
+  size_t new_capacity = (*capacity > 0) ? *capacity : INITIAL_SEGMENT_TABLE_CAPACITY;
+  while (new_capacity < min_capacity) {
+    new_capacity = new_capacity * 2;
+  }
+
+  void** new_table = arena_alloc(&self->arena, new_capacity * sizeof(void*));
+  if (count > 0) {
+    memcpy(new_table, table, count * sizeof(void*));
+  }
+  *capacity = new_capacity;
+  return new_table;
 }
 
-size_t context_new_node(Context* self) {
-  if (self->node_count == self->node_capacity) {
-    context_resize_node_buffer(self);
+/// Allocates a new node segment.
+static void context_add_node_segment(Context* self) {
+  self->node_segments = (Node**)context_grow_table(
+    self, (void**)self->node_segments, self->node_segment_count,
+    &self->node_segment_capacity, self->node_segment_count + 1);
+  Node* segment = arena_alloc(&self->arena, NODE_SEGMENT_SIZE * sizeof(Node));
+  memset(segment, 0, NODE_SEGMENT_SIZE * sizeof(Node));
+  self->node_segments[self->node_segment_count] = segment;
+  self->node_segment_count++;
+}
+
+/// Allocates a new extra data segment.
+static void context_add_extra_segment(Context* self) {
+  self->extra_segments = (uint32_t**)context_grow_table(
+    self, (void**)self->extra_segments, self->extra_segment_count,
+    &self->extra_segment_capacity, self->extra_segment_count + 1);
+  uint32_t* segment = arena_alloc(&self->arena, EXTRA_SEGMENT_SIZE * sizeof(uint32_t));
+  memset(segment, 0, EXTRA_SEGMENT_SIZE * sizeof(uint32_t));
+  self->extra_segments[self->extra_segment_count] = segment;
+  self->extra_segment_count++;
+}
+
+NodeID context_new_node(Context* self) {
+  // Reuse the slot of the last deleted node, if any.
+  if (self->free_list != (NodeID)~0) {
+    NodeID index = self->free_list;
+    Node* node = context_get_nodeptr(self, index);
+    self->free_list = node->bits.paren_expr;
+    self->free_count--;
+    memset(node, 0, sizeof(Node));
+    return index;
+  }
+
+  if (self->node_count == (self->node_segment_count << NODE_SEGMENT_SHIFT)) {
+    context_add_node_segment(self);
   }
 
-  size_t index = self->node_count;
+  NodeID index = (NodeID)self->node_count;
   self->node_count++;
   return index;
 }
 
-void context_delete_node(Context* self, size_t index) {
+void context_reserve(Context* self, size_t count) {
+  while ((self->node_segment_count << NODE_SEGMENT_SHIFT) - self->node_count < count) {
+    context_add_node_segment(self);
+  }
+}
+
+uint32_t context_append_extra(Context* self, const uint32_t* words, size_t count) {
+  if (count == 0) { return (uint32_t)self->extra_count; }
+
+  // Reuse the last freed run of the same size, if any.
+  if ((count <= EXTRA_FREE_LIST_COUNT) && (self->extra_free_lists[count - 1] != (uint32_t)~0)) {
+    uint32_t position = self->extra_free_lists[count - 1];
+    uint32_t* run = context_get_extra(self, position);
+    self->extra_free_lists[count - 1] = run[0];
+    memcpy(run, words, count * sizeof(uint32_t));
+    return position;
+  }
+
+  size_t position = self->extra_count;
+  size_t offset = position & (EXTRA_SEGMENT_SIZE - 1);
+  if (count <= EXTRA_SEGMENT_SIZE) {
+    // Skip the end of the current segment if the words don't fit in it.
+    if (offset + count > EXTRA_SEGMENT_SIZE) {
+      position += EXTRA_SEGMENT_SIZE - offset;
+    }
+    while ((position + count) > (self->extra_segment_count << EXTRA_SEGMENT_SHIFT)) {
+      context_add_extra_segment(self);
+    }
+  } else {
+    // Allocate a run of consecutive segments that starts at the next segment boundary.
+    position = extra_segment_align(position);
+    size_t first = position >> EXTRA_SEGMENT_SHIFT;
+    size_t n = extra_segment_align(count) >> EXTRA_SEGMENT_SHIFT;
+    uint32_t* run = arena_alloc(&self->arena, n * EXTRA_SEGMENT_SIZE * sizeof(uint32_t));
+    memset(run + count, 0, (n * EXTRA_SEGMENT_SIZE - count) * sizeof(uint32_t));
+
+    self->extra_segments = (uint32_t**)context_grow_table(
+      self, (void**)self->extra_segments, self->extra_segment_count,
+      &self->extra_segment_capacity, first + n);
+    for (size_t i = 0; i < n; ++i) {
+      self->extra_segments[first + i] = run + i * EXTRA_SEGMENT_SIZE;
+    }
+    if (self->extra_segment_count < first + n) {
+      self->extra_segment_count = first + n;
+    }
+  }
+
+  assert(position + count <= UINT32_MAX);
+  memcpy(context_get_extra(self, (uint32_t)position), words, count * sizeof(uint32_t));
+  self->extra_count = position + count;
+  return (uint32_t)position;
+}
+
+void context_free_extra(Context* self, uint32_t position, size_t count) {
+  if ((count == 0) || (count > EXTRA_FREE_LIST_COUNT)) { return; }
+  *context_get_extra(self, position) = self->extra_free_lists[count - 1];
+  self->extra_free_lists[count - 1] = position;
+}
+
+void context_adopt(Context* self, Context* other) {
+  assert((other->free_count == 0) && (other->root_generations == NULL));
+
+  // Fill the end of the last node segment with error nodes.
+  size_t node_offset = node_segment_align(self->node_count);
+  for (size_t i = self->node_count; i < node_offset; ++i) {
+    Node* node = context_get_nodeptr(self, (NodeID)i);
+    node->kind = nk_error;
+    node->start = 0;
+    node->end = 0;
+  }
+
+  // Adopt the node segments.
+  size_t first = node_offset >> NODE_SEGMENT_SHIFT;
+  self->node_segments = (Node**)context_grow_table(
+    self, (void**)self->node_segments, self->node_segment_count,
+    &self->node_segment_capacity, first + other->node_segment_count);
+  memcpy(self->node_segments + first, other->node_segments,
+         other->node_segment_count * sizeof(Node*));
+  self->node_segment_count = first + other->node_segment_count;
+  self->node_count = node_offset + other->node_count;
+
+  // Adopt the extra data segments.
+  size_t extra_offset = extra_segment_align(self->extra_count);
+  first = extra_offset >> EXTRA_SEGMENT_SHIFT;
+  self->extra_segments = (uint32_t**)context_grow_table(
+    self, (void**)self->extra_segments, self->extra_segment_count,
+    &self->extra_segment_capacity, first + other->extra_segment_count);
+  memcpy(self->extra_segments + first, other->extra_segments,
+         other->extra_segment_count * sizeof(uint32_t*));
+  self->extra_segment_count = first + other->extra_segment_count;
+  self->extra_count = extra_offset + other->extra_count;
+
+  // Take the ownership of the other context's memory. The other context keeps its interner, as
+  // the symbols of the adopted nodes must have been assigned by this context's interner.
+  arena_adopt(&self->arena, &other->arena);
+  context_init_storage(other);
+}
+
+void context_attach(Context* self,
+                    Node* nodes,
+                    size_t node_count,
+                    uint32_t* extra,
+                    size_t extra_count)
+{
+  assert((self->node_count == 0) && (self->extra_count == 0));
+
+  // Point the segment tables into the given storage.
+  size_t n = node_segment_align(node_count) >> NODE_SEGMENT_SHIFT;
+  self->node_segments = (Node**)context_grow_table(
+    self, (void**)self->node_segments, 0, &self->node_segment_capacity, n);
+  for (size_t i = 0; i < n; ++i) {
+    self->node_segments[i] = nodes + (i << NODE_SEGMENT_SHIFT);
+  }
+  self->node_segment_count = n;
+  self->node_count = node_count;
+
+  n = extra_segment_align(extra_count) >> EXTRA_SEGMENT_SHIFT;
+  self->extra_segments = (uint32_t**)context_grow_table(
+    self, (void**)self->extra_segments, 0, &self->extra_segment_capacity, n);
+  for (size_t i = 0; i < n; ++i) {
+    self->extra_segments[i] = extra + (i << EXTRA_SEGMENT_SHIFT);
+  }
+  self->extra_segment_count = n;
+  self->extra_count = extra_count;
+}
+
+/// Frees the extra data runs of the given node.
+static void context_free_node_extra(Context* self, const Node* node) {
+  switch (node->kind) {
+    case nk_top_decl:
+      context_free_extra(self, node->bits.top_decl.stmts, node->bits.top_decl.stmtc);
+      break;
+
+    case nk_fun_decl: {
+      uint32_t* params = context_get_extra(self, node->bits.fun_decl.params);
+      if (params[2] != UNRESOLVED_CAPTURES) {
+        context_free_extra(self, params[2], params[1] * PARAM_WORD_COUNT);
+      }
+      context_free_extra(self, node->bits.fun_decl.params,
+                         PARAM_HEADER_WORD_COUNT + params[0] * PARAM_WORD_COUNT);
+      break;
+    }
+
+    case nk_apply_expr:
+      context_free_extra(self, node->bits.apply_expr.args, node->bits.apply_expr.argc);
+      break;
+
+    case nk_brace_stmt:
+      context_free_extra(self, node->bits.brace_stmt.stmts, node->bits.brace_stmt.stmtc);
+      for (uint32_t link = node->bits.brace_stmt.last_decl; link != (uint32_t)~0;) {
+        uint32_t previous = context_get_extra(self, link)[1];
+        context_free_extra(self, link, 2);
+        link = previous;
+      }
+      break;
+
+    default:
+      break;
+  }
+}
+
+void context_delete_node(Context* self, NodeID index) {
+  Node* node = context_get_nodeptr(self, index);
+  context_free_node_extra(self, node);
+  if (context_is_root(self, index)) { self->root_generations[index] = 0; }
+
+  memset(node, 0, sizeof(Node));
+  node->kind = nk_error;
+  node->bits.paren_expr = self->free_list;
+  self->free_list = index;
+  self->free_count++;
+}
+
+
+/// Returns the generation that follows `generation`, skipping 0.
+static inline uint32_t next_generation(uint32_t generation) {
+  return (generation == UINT32_MAX) ? 1 : generation + 1;
+}
+
+void context_track_root(Context* self, NodeID index) {
+  // Grow the table of generations to cover all allocated nodes.
+  if (index >= self->root_capacity) {
+    size_t new_capacity = self->node_segment_count << NODE_SEGMENT_SHIFT;
+    uint32_t* new_generations = cocodol_alloc(ac_ast, new_capacity * sizeof(uint32_t));
+    if (self->root_capacity > 0) {
+      memcpy(new_generations, self->root_generations, self->root_capacity * sizeof(uint32_t));
+    }
+    memset(new_generations + self->root_capacity, 0,
+           (new_capacity - self->root_capacity) * sizeof(uint32_t));
+    cocodol_free(ac_ast, self->root_generations, self->root_capacity * sizeof(uint32_t));
+    self->root_generations = new_generations;
+    self->root_capacity = new_capacity;
+  }
+  if (self->shift_log == NULL) {
+    self->shift_log = cocodol_alloc(ac_ast, SHIFT_LOG_CAPACITY * sizeof(ShiftLogEntry));
+    self->shift_log[self->shift_generation % SHIFT_LOG_CAPACITY] =
+      (ShiftLogEntry){ 0, UINT32_MAX, 0, 0, INT64_MIN };
+  }
+
+  if (self->root_generations[index] == 0) {
+    self->root_generations[index] = self->shift_generation;
+  }
+}
+
+uint32_t context_get_first_offset(Context* self, NodeID index) {
+  Node* node = context_get_nodeptr(self, index);
+  while (true) {
+    switch (node->kind) {
+      case nk_expr_stmt:    index = node->bits.expr_stmt; break;
+      case nk_binary_expr:  index = node->bits.binary_expr.lhs; break;
+      case nk_member_expr:  index = node->bits.member_expr.base; break;
+      case nk_apply_expr:   index = node->bits.apply_expr.callee; break;
+      default:              return node->start;
+    }
+    node = context_get_nodeptr(self, index);
+  }
+}
+
+uint32_t context_get_pending_shift(Context* self, NodeID index) {
+  if (!context_is_root(self, index)) { return 0; }
+
+  // Most nodes are moved either by all of the shifts recorded since they were last settled, or by
+  // none of them.
+  uint32_t start = context_get_first_offset(self, index);
+  uint32_t generation = self->root_generations[index];
+  const ShiftLogEntry* base = &self->shift_log[generation % SHIFT_LOG_CAPACITY];
+  if (start < base->min_from) { return 0; }
+  if ((int64_t)start - base->total >= base->max_threshold) {
+    const ShiftLogEntry* last = &self->shift_log[self->shift_generation % SHIFT_LOG_CAPACITY];
+    return (uint32_t)(last->total - base->total);
+  }
+
+  // Otherwise, replay the shifts. Each of them applies if the node started at or after its offset
+  // at the time it was recorded.
+  uint32_t shift = 0;
+  for (uint32_t g = generation; g != self->shift_generation;) {
+    g = next_generation(g);
+    const ShiftLogEntry* entry = &self->shift_log[g % SHIFT_LOG_CAPACITY];
+    if ((uint32_t)(start + shift) >= entry->from) {
+      shift = (uint32_t)(shift + entry->delta);
+    }
+  }
+  return shift;
+}
+
+/// The state of a walk that shifts the offsets of a subtree with `node_shift`.
+typedef struct ShiftWalk {
+
+  /// The context in which the nodes are stored.
+  Context* context;
+
+  /// The offset from which offsets are shifted.
+  uint32_t from;
+
+  /// The shift to apply.
+  int64_t delta;
+
+} ShiftWalk;
+
+static bool shift_visit(NodeID index, NodeKind kind, bool is_entering, void* user) {
+  if (!is_entering) { return true; }
+
+  // The descendants of a node are within its range, so they don't need to be shifted if it ends
+  // before the shifted offset.
+  ShiftWalk* walk = user;
+  Node* node = context_get_nodeptr(walk->context, index);
+  if (node->end < walk->from) { return false; }
+  node_shift(node, walk->context, walk->from, walk->delta);
+  return true;
+}
+
+/// Shifts the offsets of a top-level node with `node_shift`.
+///
+/// The statements of a top-level declaration are top-level nodes on their own, so only the offsets
+/// of the declaration itself are shifted.
+static void shift_root(Context* self, NodeID index, uint32_t from, int64_t delta) {
+  Node* node = context_get_nodeptr(self, index);
+  if (node->kind == nk_top_decl) {
+    node_shift(node, self, from, delta);
+  } else {
+    ShiftWalk walk = { self, from, delta };
+    node_walk(index, self, &walk, shift_visit);
+  }
+}
+
+void context_settle_root(Context* self, NodeID index) {
+  if (!context_is_root(self, index)) { return; }
+
+  // Offsets are shifted modulo 2^32, so the shift can be applied as an unsigned offset.
+  uint32_t shift = context_get_pending_shift(self, index);
+  self->root_generations[index] = self->shift_generation;
+  if (shift != 0) { shift_root(self, index, 0, shift); }
+}
+
+void context_shift_root(Context* self, NodeID index, uint32_t from, int64_t delta) {
+  context_settle_root(self, index);
+  shift_root(self, index, from, delta);
+}
+
+void context_log_shift(Context* self, uint32_t from, int64_t delta) {
+  if ((delta == 0) || (self->root_generations == NULL)) { return; }
+
+  // Update the summaries of the previous entries, including those that are stale.
+  const ShiftLogEntry* last = &self->shift_log[self->shift_generation % SHIFT_LOG_CAPACITY];
+  int64_t total = last->total;
+  int64_t threshold = (int64_t)from - total;
+  for (size_t i = 0; i < SHIFT_LOG_CAPACITY; ++i) {
+    ShiftLogEntry* entry = &self->shift_log[i];
+    if (from < entry->min_from) { entry->min_from = from; }
+    if (threshold > entry->max_threshold) { entry->max_threshold = threshold; }
+  }
+
+  self->shift_generation = next_generation(self->shift_generation);
+  self->shift_log[self->shift_generation % SHIFT_LOG_CAPACITY] =
+    (ShiftLogEntry){ from, UINT32_MAX, delta, total + delta, INT64_MIN };
+
+  // Settle enough top-level nodes for all of them to be settled before the log overflows, i.e.,
+  // in at most `SHIFT_LOG_CAPACITY / 2` shifts.
+  size_t count = (2 * self->root_capacity + SHIFT_LOG_CAPACITY - 1) / SHIFT_LOG_CAPACITY;
+  for (size_t i = 0; i < count; ++i) {
+    if (self->settle_cursor >= self->root_capacity) { self->settle_cursor = 0; }
+    context_settle_root(self, (NodeID)self->settle_cursor++);
+  }
+}
+
+void context_settle_all(Context* self) {
+  for (size_t i = 0; i < self->root_capacity; ++i) {
+    if (self->root_generations[i] != self->shift_generation) {
+      context_settle_root(self, (NodeID)i);
+    }
+  }
+  self->settled_generation = self->shift_generation;
 }
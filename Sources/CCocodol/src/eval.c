@@ -1,8 +1,13 @@
 #include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <unistd.h>
 
+#include "alloc.h"
 #include "ast.h"
 #include "builtins.h"
 #include "context.h"
@@ -12,18 +17,22 @@
 #define EVAL_STATUS_BRK 1
 #define EVAL_STATUS_ERR -1
 
+#define INPUT_BUFFER_SIZE (1 << 20)
+
 #define eval_stack_top(self)     (self->value_stack[(self)->value_index - 1])
 #define eval_stack(self, offset) (self->value_stack[(self)->value_index - 1 + (offset)])
 
+bool   eval_node(NodeID index, NodeKind kind, bool pre, void* user);
 void   eval_pop_frame(EvalState* self);
-void*  free_symbol_entry(const char* key, void* value);
+void   drop(RuntimeValue* value);
+void*  free_symbol_entry(Symbol key, void* value);
 void   value_copy(RuntimeValue* dst, RuntimeValue* src);
 
 /// An value identifier.
 typedef struct {
 
-  /// The name of the identifier, as a null-terminated character string.
-  char*  name;
+  /// The symbol of the identifier's name.
+  Symbol symbol;
 
   /// The index at which the identifier starts in the source input.
   size_t start;
@@ -34,18 +43,34 @@ typedef struct {
 } Ident;
 
 /// Initializes the value of an identifier with the given token.
-void ident_init(Ident* self, Context* context, Token* token) {
+void ident_init(Ident* self, Token* token) {
   assert(token->kind == tk_name);
+  assert(token->symbol != NO_SYMBOL);
 
-  size_t len = token->end - token->start;
-  self->name = malloc(len + 1);
-  memcpy(self->name, context->source + token->start, len);
-  self->name[len] = 0;
-
+  self->symbol = token->symbol;
   self->start = token->start;
   self->end = token->end;
 }
 
+/// Appends the name of an identifier to a diagnostic message.
+void ident_append_name(EvalState* self, char* msg, Ident* ident) {
+  const SymbolInfo* info = interner_get(&self->context->interner, ident->symbol);
+  strncat(msg, info->text, info->length);
+}
+
+/// Allocates a new runtime value, initialized as junk.
+RuntimeValue* value_alloc(void) {
+  RuntimeValue* value = cocodol_alloc(ac_value, sizeof(RuntimeValue));
+  value->kind = rv_junk;
+  return value;
+}
+
+/// Drops and deallocates a runtime value.
+void value_free(RuntimeValue* value) {
+  drop(value);
+  cocodol_free(ac_value, value, sizeof(RuntimeValue));
+}
+
 /// The kind of a frame.
 typedef enum {
   ef_function ,
@@ -69,6 +94,26 @@ typedef struct EvalFrame {
 
 } EvalFrame;
 
+/// A buffered reader for the standard input.
+typedef struct InputBuffer {
+
+  /// The file descriptor from which the input is read.
+  int fd;
+
+  /// The index of the next unread byte in `data`.
+  size_t index;
+
+  /// The number of valid bytes in `data`.
+  size_t count;
+
+  /// A flag indicating whether the end of the input has been reached.
+  bool eof;
+
+  /// The contents of the buffer.
+  char data[INPUT_BUFFER_SIZE];
+
+} InputBuffer;
+
 /// The evaluation environment of the AST walker.
 typedef struct {
 
@@ -85,8 +130,8 @@ void drop(RuntimeValue* value) {
       SymTable* fun_env = value->bits.function_v.env;
       if (fun_env != NULL) {
         symtable_map(fun_env, NULL, free_symbol_entry);
-        symtable_deinit(fun_env, true);
-        free(fun_env);
+        symtable_deinit(fun_env);
+        cocodol_free(ac_env, fun_env, sizeof(SymTable));
       }
       break;
     }
@@ -101,32 +146,35 @@ void drop(RuntimeValue* value) {
 /// Frees the values of a symbol table.
 ///
 /// Value pointers are allocated in the evaluation loop, when new symbols are created.
-void* free_symbol_entry(const char* key, void* value) {
-  drop((RuntimeValue*)value);
-  free(value);
+void* free_symbol_entry(Symbol key, void* value) {
+  value_free((RuntimeValue*)value);
   return NULL;
 }
 
 /// Copies the contents of a symbol table.
-void copy_symbol_entry(const char* key, void* value, void* user) {
-  size_t len = strlen(key);
-  char* new_key = malloc(len + 1);
-  strcpy(new_key, key);
+void copy_symbol_entry(Symbol key, void* value, void* user) {
+  SymTable* other = (SymTable*)user;
+  if (symtable_get(other, key) != NULL) {
+    // The symbol is shadowed in the destination table.
+    return;
+  }
 
-  RuntimeValue* new_value = malloc(sizeof(RuntimeValue));
-  new_value->kind = rv_junk;
+  RuntimeValue* new_value = value_alloc();
   value_copy(new_value, (RuntimeValue*)value);
-
-  SymTable* other = (SymTable*)user;
-  symtable_insert(other, new_key, new_value);
+  symtable_insert(other, key, new_value);
 }
 
 void eval_init(EvalState* self, Context* context) {
   self->context = context;
   self->status = EVAL_STATUS_OK;
   symtable_init(&self->globals);
+  resolver_init(&self->resolver, context);
   self->frame = NULL;
+  self->input = NULL;
   self->value_index = 0;
+  for (size_t i = 0; i < VALUE_STACK_SIZE; ++i) {
+    self->value_stack[i].kind = rv_junk;
+  }
 }
 
 void eval_deinit(EvalState* self) {
@@ -135,13 +183,21 @@ void eval_deinit(EvalState* self) {
 
   // Deinitialize the globals.
   symtable_map   (&self->globals, NULL, free_symbol_entry);
-  symtable_deinit(&self->globals, true);
+  symtable_deinit(&self->globals);
+  resolver_deinit(&self->resolver);
   while (self->frame != NULL) {
     eval_pop_frame(self);
   }
 
+  // Release the input buffer.
+  cocodol_free(ac_input, self->input, sizeof(InputBuffer));
+  self->input = NULL;
+
   // Clear the value stack.
-  self->value_index = 0;
+  while (self->value_index > 0) {
+    drop(&eval_stack_top(self));
+    self->value_index--;
+  }
 }
 
 // ------------------------------------------------------------------------------------------------
@@ -150,7 +206,7 @@ void eval_deinit(EvalState* self) {
 
 /// Pushes a new stack from.
 EvalFrame* eval_push_frame(EvalState* self, FrameKind frame_kind) {
-  EvalFrame* new_frame = malloc(sizeof(EvalFrame));
+  EvalFrame* new_frame = cocodol_alloc(ac_frame, sizeof(EvalFrame));
 
   symtable_init(&new_frame->locals);
   new_frame->kind = frame_kind;
@@ -168,8 +224,20 @@ void eval_pop_frame(EvalState* self) {
   self->frame = frame->prev;
 
   symtable_map   (&frame->locals, NULL, free_symbol_entry);
-  symtable_deinit(&frame->locals, true);
-  return;
+  symtable_deinit(&frame->locals);
+  cocodol_free(ac_frame, frame, sizeof(EvalFrame));
+}
+
+/// Returns the kind of the built-in function denoted by the given symbol, or `rv_junk` if the
+/// symbol does not denote a built-in function.
+int builtin_kind(Symbol symbol) {
+  switch (symbol) {
+    case sym_print      : return rv_print;
+    case sym_read_int   : return rv_read_int;
+    case sym_read_float : return rv_read_float;
+    case sym_at_eof     : return rv_at_eof;
+    default             : return rv_junk;
+  }
 }
 
 /// Inserts a new symbol in the given table.
@@ -182,19 +250,20 @@ bool insert_symbol(EvalState* self,
                    RuntimeValue* value,
                    EvalErrorCallback report_diag)
 {
-  if (strcmp(ident->name, "print") == 0) {
-    EvalError error = {
-      ident->start, ident->end,
-      "invalid declaration, 'print' is a reserved identifier"
-    };
+  if (builtin_kind(ident->symbol) != rv_junk) {
+    char msg[255] = { 0 };
+    strcpy(msg, "invalid declaration, '");
+    ident_append_name(self, msg, ident);
+    strcat(msg, "' is a reserved identifier");
+    EvalError error = { ident->start, ident->end, msg };
     report_diag(error, self);
     return false;
   }
 
-  if (symtable_insert(table, ident->name, value)) {
+  if (symtable_insert(table, ident->symbol, value)) {
     char msg[255] = { 0 };
     strcpy(msg, "duplicate declaration '");
-    strcat(msg, ident->name);
+    ident_append_name(self, msg, ident);
     strcat(msg, "'");
     EvalError error = { ident->start, ident->end, msg };
     report_diag(error, self);
@@ -214,6 +283,9 @@ void value_copy(RuntimeValue* dst, RuntimeValue* src) {
     case rv_float:
     case rv_lazy:
     case rv_print:
+    case rv_read_int:
+    case rv_read_float:
+    case rv_at_eof:
       *dst = *src;
       break;
 
@@ -221,7 +293,7 @@ void value_copy(RuntimeValue* dst, RuntimeValue* src) {
       dst->kind = rv_function;
       dst->bits.function_v.decl = src->bits.function_v.decl;
       if (src->bits.function_v.env != NULL) {
-        dst->bits.function_v.env = malloc(sizeof(SymTable));
+        dst->bits.function_v.env = cocodol_alloc(ac_env, sizeof(SymTable));
         symtable_init(dst->bits.function_v.env);
         symtable_foreach(src->bits.function_v.env, dst->bits.function_v.env, copy_symbol_entry);
       } else {
@@ -237,10 +309,13 @@ void value_copy(RuntimeValue* dst, RuntimeValue* src) {
 
 /// Looks up an identifier.
 RuntimeValue* ident_lookup(EvalState* self, Ident* ident, EvalErrorCallback report_diag) {
+  // The same symbol is searched in several tables, so its hash is computed once.
+  uint64_t hash = symtable_hash(ident->symbol);
+
   // Search the locals.
   EvalFrame* frame = self->frame;
   while (frame != NULL) {
-    RuntimeValue* value = (RuntimeValue*)symtable_get(&frame->locals, ident->name);
+    RuntimeValue* value = (RuntimeValue*)symtable_get_hashed(&frame->locals, ident->symbol, hash);
     if (value != NULL) {
       return value;
     } else if (frame->kind != ef_function) {
@@ -251,14 +326,14 @@ RuntimeValue* ident_lookup(EvalState* self, Ident* ident, EvalErrorCallback repo
   }
 
   // Search a global symbol.
-  RuntimeValue* value = (RuntimeValue*)symtable_get(&self->globals, ident->name);
+  RuntimeValue* value = (RuntimeValue*)symtable_get_hashed(&self->globals, ident->symbol, hash);
   if (value != NULL) {
     return value;
   }
 
   char msg[255] = { 0 };
   strcpy(msg, "undefined identifier '");
-  strcat(msg, ident->name);
+  ident_append_name(self, msg, ident);
   strcat(msg, "'");
   EvalError error = { ident->start, ident->end, msg };
   report_diag(error, self);
@@ -272,14 +347,18 @@ RuntimeValue* ident_lookup(EvalState* self, Ident* ident, EvalErrorCallback repo
 /// Returns a character string describing the type of the given value.
 const char* value_type_name(RuntimeValue* value) {
   switch (value->kind) {
-    case rv_junk    : return "Junk";
-    case rv_bool    : return "Bool";
-    case rv_integer : return "Int";
-    case rv_float   : return "Float";
-    case rv_lazy    :
-    case rv_print   :
-    case rv_function: return "Function";
+    case rv_junk      : return "Junk";
+    case rv_bool      : return "Bool";
+    case rv_integer   : return "Int";
+    case rv_float     : return "Float";
+    case rv_lazy      :
+    case rv_print     :
+    case rv_read_int  :
+    case rv_read_float:
+    case rv_at_eof    :
+    case rv_function  : return "Function";
   }
+  return "Junk";
 }
 
 /// Evaluates the built-in `print` function.
@@ -303,12 +382,228 @@ void eval_print(RuntimeValue* value) {
 
     case rv_lazy:
     case rv_print:
+    case rv_read_int:
+    case rv_read_float:
+    case rv_at_eof:
     case rv_function:
       fputs("$function\n", stdout);
       break;
   }
 }
 
+// ------------------------------------------------------------------------------------------------
+// MARK: Input
+// ------------------------------------------------------------------------------------------------
+
+/// Refills the given input buffer, discarding its contents.
+///
+/// This function returns `false` if the end of the input has been reached.
+bool input_refill(InputBuffer* self) {
+  if (self->eof) { return false; }
+
+  ssize_t count;
+  do {
+    count = read(self->fd, self->data, INPUT_BUFFER_SIZE);
+  } while (count < 0 && errno == EINTR);
+
+  self->index = 0;
+  self->count = count > 0 ? (size_t)count : 0;
+  self->eof = count <= 0;
+  return !self->eof;
+}
+
+/// Returns whether the given character is a white space.
+static inline bool input_isspace(char ch) {
+  return (ch == ' ') || ((ch >= '\t') && (ch <= '\r'));
+}
+
+/// Skips the white spaces at the beginning of the buffer.
+///
+/// This function returns `false` if the end of the input has been reached.
+bool input_skip_spaces(InputBuffer* self) {
+  while (true) {
+    while (self->index < self->count) {
+      if (!input_isspace(self->data[self->index])) { return true; }
+      self->index++;
+    }
+    if (!input_refill(self)) { return false; }
+  }
+}
+
+/// Returns the next character in the buffer without consuming it, or `-1` if the end of the input
+/// has been reached.
+static inline int input_peek(InputBuffer* self) {
+  if ((self->index == self->count) && !input_refill(self)) { return -1; }
+  return (unsigned char)self->data[self->index];
+}
+
+/// Consumes a sequence of decimal digits, accumulating them into `mantissa`.
+///
+/// At most 19 digits are accumulated; the number of digits that were consumed but not accumulated
+/// is added to `dropped`. The function returns the number of consumed digits.
+size_t input_take_digits(InputBuffer* self, uint64_t* mantissa, int* dropped) {
+  size_t count = 0;
+  while ((self->index < self->count) || input_refill(self)) {
+    unsigned int digit = (unsigned char)self->data[self->index] - '0';
+    if (digit > 9) { break; }
+
+    if (*mantissa < 1000000000000000000ull) {
+      *mantissa = *mantissa * 10 + digit;
+    } else {
+      *dropped += 1;
+    }
+    self->index++;
+    count++;
+  }
+  return count;
+}
+
+/// Reads a signed decimal integer from the input.
+///
+/// This function returns `false` if the next characters in the input do not represent an integer,
+/// or if that integer is not representable as a `long int`.
+bool input_read_int(InputBuffer* self, long int* result) {
+  if (!input_skip_spaces(self)) { return false; }
+
+  // Parse the sign.
+  bool negative = false;
+  int ch = input_peek(self);
+  if ((ch == '-') || (ch == '+')) {
+    negative = ch == '-';
+    self->index++;
+  }
+
+  // Parse the digits, consuming all of them even if the value overflows.
+  unsigned long int limit = negative ? (unsigned long int)LONG_MAX + 1 : LONG_MAX;
+  unsigned long int value = 0;
+  size_t count = 0;
+  bool overflow = false;
+  while ((self->index < self->count) || input_refill(self)) {
+    unsigned int digit = (unsigned char)self->data[self->index] - '0';
+    if (digit > 9) { break; }
+    if (value > (limit - digit) / 10) {
+      overflow = true;
+    } else {
+      value = value * 10 + digit;
+    }
+    self->index++;
+    count++;
+  }
+  if ((count == 0) || overflow) { return false; }
+
+  if (negative && (value > 0)) {
+    // Negate the magnitude without overflowing when it is `LONG_MAX + 1`.
+    *result = -(long int)(value - 1) - 1;
+  } else {
+    *result = (long int)value;
+  }
+  return true;
+}
+
+/// Reads a decimal floating-point number from the input.
+///
+/// The number may have a fractional part and an exponent (e.g., `-4.2e1`). This function returns
+/// `false` if the next characters in the input do not represent a number.
+bool input_read_float(InputBuffer* self, double* result) {
+  static const double powers[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+  };
+
+  if (!input_skip_spaces(self)) { return false; }
+
+  // Parse the sign.
+  bool negative = false;
+  int ch = input_peek(self);
+  if ((ch == '-') || (ch == '+')) {
+    negative = ch == '-';
+    self->index++;
+  }
+
+  // Parse the integral and fractional parts.
+  uint64_t mantissa = 0;
+  int exponent = 0;
+  size_t count = input_take_digits(self, &mantissa, &exponent);
+  if (input_peek(self) == '.') {
+    self->index++;
+    int dropped = 0;
+    size_t fraction_count = input_take_digits(self, &mantissa, &dropped);
+    exponent -= (int)fraction_count - dropped;
+    count += fraction_count;
+  }
+  if (count == 0) { return false; }
+
+  // Parse the exponent, if any.
+  ch = input_peek(self);
+  if ((ch == 'e') || (ch == 'E')) {
+    self->index++;
+    bool negative_exponent = false;
+    ch = input_peek(self);
+    if ((ch == '-') || (ch == '+')) {
+      negative_exponent = ch == '-';
+      self->index++;
+    }
+
+    uint64_t value = 0;
+    int dropped = 0;
+    if (input_take_digits(self, &value, &dropped) == 0) { return false; }
+    if (value > 9999) { value = 9999; }
+    exponent += negative_exponent ? -(int)value : (int)value;
+  }
+
+  // Compute the value, exactly whenever the mantissa and the exponent are small enough.
+  double value = (double)mantissa;
+  if ((mantissa < (1ull << 53)) && (exponent >= -22) && (exponent <= 22)) {
+    value = exponent < 0 ? value / powers[-exponent] : value * powers[exponent];
+  } else {
+    value = value * pow(10.0, exponent);
+  }
+
+  *result = negative ? -value : value;
+  return true;
+}
+
+/// Returns the input buffer of the given interpreter, allocating it if necessary.
+InputBuffer* eval_input(EvalState* self) {
+  if (self->input == NULL) {
+    self->input = cocodol_alloc(ac_input, sizeof(InputBuffer));
+    self->input->fd = STDIN_FILENO;
+    self->input->index = 0;
+    self->input->count = 0;
+    self->input->eof = false;
+  }
+  return self->input;
+}
+
+/// Evaluates the built-in input function of the given kind, storing its result at `result`.
+///
+/// This function returns `false` if the input could not be read.
+bool eval_read(EvalState* self, int kind, RuntimeValue* result) {
+  InputBuffer* input = eval_input(self);
+  switch (kind) {
+    case rv_read_int:
+      result->kind = rv_integer;
+      return input_read_int(input, &result->bits.integer_v);
+
+    case rv_read_float: {
+      double value;
+      result->kind = rv_float;
+      if (!input_read_float(input, &value)) { return false; }
+      result->bits.float_v = value;
+      return true;
+    }
+
+    case rv_at_eof:
+      result->kind = rv_bool;
+      result->bits.bool_v = !input_skip_spaces(input);
+      return true;
+
+    default:
+      assert(false && "not an input function");
+      return false;
+  }
+}
+
 // ------------------------------------------------------------------------------------------------
 // MARK: Eval loop
 // ------------------------------------------------------------------------------------------------
@@ -319,9 +614,8 @@ RuntimeValue* eval_lvalue(EvalState* self, NodeID index, EvalErrorCallback repor
   switch (node->kind) {
     case nk_declref_expr: {
       Ident ident;
-      ident_init(&ident, self->context, &node->bits.declref_expr);
+      ident_init(&ident, &node->bits.declref_expr);
       RuntimeValue* value = ident_lookup(self, &ident, report_diag);
-      free(ident.name);
       return value;
     }
 
@@ -330,6 +624,45 @@ RuntimeValue* eval_lvalue(EvalState* self, NodeID index, EvalErrorCallback repor
   }
 }
 
+/// Evaluates a logical operator (i.e., `and` or `or`) with short-circuit semantics.
+///
+/// The right operand is evaluated only if the left one does not determine the result. Either way,
+/// the result of the operation is pushed onto the value stack.
+void eval_logical(EvalState* self, NodeID index, EvalEnv* env) {
+  Node* node = context_get_nodeptr(self->context, index);
+  Token* op = &node->bits.binary_expr.op;
+  NodeID operands[2] = { node->bits.binary_expr.lhs, node->bits.binary_expr.rhs };
+
+  for (size_t i = 0; i < 2; ++i) {
+    node_walk(operands[i], self->context, env, eval_node);
+    if (self->status != EVAL_STATUS_OK) { return; }
+
+    // Make sure we've got a Boolean.
+    RuntimeValue* value = &eval_stack_top(self);
+    if (value->kind != rv_bool) {
+      char msg[255] = { 0 };
+      strcpy (msg, "operator '");
+      strncat(msg, self->context->source + op->start, op->end - op->start);
+      strcat (msg, "' is not defined for values of type '");
+      strcat (msg, value_type_name(value));
+      strcat (msg, "'");
+      Node* operand = context_get_nodeptr(self->context, operands[i]);
+      EvalError error = { operand->start, operand->end, msg };
+      env->report_diag(error, self);
+      self->status = EVAL_STATUS_ERR;
+      return;
+    }
+
+    // Stop if the left operand determines the result, i.e., if it is `false` for a conjunction or
+    // `true` for a disjunction.
+    if ((i == 0) && (value->bits.bool_v == (op->kind == tk_or))) { return; }
+    if (i == 0) {
+      drop(value);
+      self->value_index--;
+    }
+  }
+}
+
 /// Evaluates a node.
 bool eval_node(NodeID index, NodeKind kind, bool pre, void* user) {
   EvalEnv* env = (EvalEnv*)(user);
@@ -345,54 +678,53 @@ bool eval_node(NodeID index, NodeKind kind, bool pre, void* user) {
     switch (kind) {
       case nk_fun_decl: {
         // Create the function object.
-        RuntimeValue* fun_val = malloc(sizeof(RuntimeValue));
+        RuntimeValue* fun_val = value_alloc();
         fun_val->kind = rv_function;
         fun_val->bits.function_v.decl = index;
         fun_val->bits.function_v.env = NULL;
 
         // Store the function in the locals.
         Ident ident;
-        ident_init(&ident, self->context, &node->bits.fun_decl.name);
+        ident_init(&ident, &node->bits.fun_decl.name);
 
         SymTable* table = &self->frame->locals;
         if (!insert_symbol(self, table, &ident, fun_val, env->report_diag)) {
-          free(ident.name);
-          free(fun_val);
+          value_free(fun_val);
           self->status = EVAL_STATUS_ERR;
           return false;
         }
 
-        // Build the function's capture list.
-        Token* symv[MAX_CAPTURE_COUNT];
-        size_t symc = capture_set(index, self->context, symv, true);
+        // Read the function's capture list, which has been resolved by `eval_program`.
+        assert(context_get_captures(self->context, node) != UNRESOLVED_CAPTURES);
+        size_t symc = context_get_capturec(self->context, node);
 
         // Create the function's environment.
         if (symc > 0) {
           // Allocate a symbol table.
-          SymTable* fun_env = malloc(sizeof(SymTable));
+          SymTable* fun_env = cocodol_alloc(ac_env, sizeof(SymTable));
           symtable_init(fun_env);
           fun_val->bits.function_v.env = fun_env;
 
           // Copy each captured symbol.
           for (size_t i = 0; i < symc; ++i) {
-            ident_init(&ident, self->context, symv[i]);
+            Token capture = context_get_capture(self->context, node, i);
+            ident_init(&ident, &capture);
             RuntimeValue* value = ident_lookup(self, &ident, env->report_diag);
 
-            // Make sure the captured parameter exists.
+            // Make sure the captured parameter exists. Note that the function object is owned by
+            // the local table, which is cleaned up when the frame is popped.
             if (value == NULL) {
-              free(fun_val);
               self->status = EVAL_STATUS_ERR;
               return false;
             }
 
             // Capture the parameter if it's not already in the environment.
-            if (symtable_get(fun_env, ident.name) != NULL) {
-              free(ident.name);
+            if (symtable_get(fun_env, ident.symbol) != NULL) {
               continue;
             } else {
-              RuntimeValue* param = malloc(sizeof(RuntimeValue));
+              RuntimeValue* param = value_alloc();
               value_copy(param, value);
-              symtable_insert(fun_env, ident.name, param);
+              symtable_insert(fun_env, ident.symbol, param);
             }
           }
         }
@@ -401,8 +733,15 @@ bool eval_node(NodeID index, NodeKind kind, bool pre, void* user) {
       }
 
       case nk_binary_expr: {
-        // Non-assignment expressions are handled in the "post" phase only.
-        if (node->bits.binary_expr.op.kind != tk_assign) { return true; }
+        // Logical operators evaluate their operands conditionally.
+        TokenKind op = node->bits.binary_expr.op.kind;
+        if ((op == tk_and) || (op == tk_or)) {
+          eval_logical(self, index, env);
+          return false;
+        }
+
+        // Other non-assignment expressions are handled in the "post" phase only.
+        if (op != tk_assign) { return true; }
 
         // Evaluate the l-value first.
         RuntimeValue* lvalue = eval_lvalue(self, node->bits.binary_expr.lhs, env->report_diag);
@@ -506,20 +845,18 @@ bool eval_node(NodeID index, NodeKind kind, bool pre, void* user) {
 
     case nk_var_decl: {
       Ident ident;
-      ident_init(&ident, self->context, &node->bits.var_decl.name);
+      ident_init(&ident, &node->bits.var_decl.name);
 
-      RuntimeValue* value = malloc(sizeof(RuntimeValue));
+      RuntimeValue* value = value_alloc();
       if (node->bits.var_decl.initializer != ~0) {
         value_copy(value, &eval_stack_top(self));
         drop(&eval_stack_top(self));
         self->value_index--;
-      } else {
-        value->kind = rv_junk;
       }
 
       SymTable* table = &self->frame->locals;
       if (!insert_symbol(self, table, &ident, value, env->report_diag)) {
-        free(ident.name);
+        value_free(value);
         self->status = EVAL_STATUS_ERR;
         return false;
       } else {
@@ -532,11 +869,12 @@ bool eval_node(NodeID index, NodeKind kind, bool pre, void* user) {
 
     case nk_declref_expr: {
       Ident ident;
-      ident_init(&ident, self->context, &node->bits.declref_expr);
+      ident_init(&ident, &node->bits.declref_expr);
 
       // Check for reserved identifiers.
-      if (strcmp(ident.name, "print") == 0) {
-        eval_stack(self, +1).kind = rv_print;
+      int builtin = builtin_kind(ident.symbol);
+      if (builtin != rv_junk) {
+        eval_stack(self, +1).kind = builtin;
         self->value_index++;
         assert(self->value_index < VALUE_STACK_SIZE);
         break;
@@ -544,7 +882,6 @@ bool eval_node(NodeID index, NodeKind kind, bool pre, void* user) {
 
       // Lookup the identifier.
       RuntimeValue* value = ident_lookup(self, &ident, env->report_diag);
-      free(ident.name);
       if (value != NULL) {
         // If the value is lazy, evaluate it now.
         if (value->kind == rv_lazy) {
@@ -574,7 +911,7 @@ bool eval_node(NodeID index, NodeKind kind, bool pre, void* user) {
 
     case nk_integer_expr: {
       eval_stack(self, +1).kind = rv_integer;
-      eval_stack(self, +1).bits.integer_v = node->bits.integer_expr;
+      eval_stack(self, +1).bits.integer_v = node_integer_value(node);
       self->value_index++;
       assert(self->value_index < VALUE_STACK_SIZE);
       break;
@@ -582,7 +919,7 @@ bool eval_node(NodeID index, NodeKind kind, bool pre, void* user) {
 
     case nk_float_expr: {
       eval_stack(self, +1).kind = rv_float;
-      eval_stack(self, +1).bits.float_v = node->bits.float_expr;
+      eval_stack(self, +1).bits.float_v = node_float_value(node);
       self->value_index++;
       assert(self->value_index < VALUE_STACK_SIZE);
       break;
@@ -702,17 +1039,6 @@ bool eval_node(NodeID index, NodeKind kind, bool pre, void* user) {
             }
             break;
 
-          case rv_bool:
-            switch (node->bits.binary_expr.op.kind) {
-              BIN_CASE(tk_and     , COCODOL_LAND, bool_v)
-              BIN_CASE(tk_or      , COCODOL_LOR , bool_v)
-              default:
-                was_defined = false;
-                break;
-            }
-            break;
-
-
           default:
             was_defined = false;
             break;
@@ -754,23 +1080,53 @@ bool eval_node(NodeID index, NodeKind kind, bool pre, void* user) {
           self->value_index -= (argc + 1);
           break;
 
+        case rv_read_int:
+        case rv_read_float:
+        case rv_at_eof: {
+          // Input functions do not accept any argument.
+          if (argc != 0) {
+            char msg[255] = { 0 };
+            sprintf(msg, "invalid argument count: expected 0, got %zu", argc);
+            EvalError error = { node->start, node->end, msg };
+            env->report_diag(error, self);
+            self->status = EVAL_STATUS_ERR;
+            return false;
+          }
+
+          // The result of the call substitutes the callee, so its kind must be read first.
+          int kind = callee->kind;
+          if (!eval_read(self, kind, callee)) {
+            EvalError error = {
+              node->start, node->end,
+              kind == rv_read_int
+                ? "failed to read an integer from the standard input"
+                : "failed to read a float from the standard input"
+            };
+            env->report_diag(error, self);
+            self->status = EVAL_STATUS_ERR;
+            return false;
+          }
+          break;
+        }
+
         case rv_function: {
           // Get the declaration of the function being called.
           Node* fun_decl = context_get_nodeptr(self->context, callee->bits.function_v.decl);
 
           // Copies the function parameters into its locals.
           EvalFrame* frame = eval_push_frame(self, ef_function);
-          size_t paramc = fun_decl->bits.fun_decl.paramc;
+          size_t paramc = context_get_paramc(self->context, fun_decl);
 
           Ident ident;
           for (size_t i = 0; i < paramc; ++i) {
-            RuntimeValue* arg = malloc(sizeof(RuntimeValue));
+            RuntimeValue* arg = value_alloc();
             value_copy(arg, &eval_stack(self, -i));
             drop(&eval_stack(self, -i));
 
-            ident_init(&ident, self->context, &fun_decl->bits.fun_decl.paramv[paramc - i - 1]);
+            Token param = context_get_param(self->context, fun_decl, paramc - i - 1);
+            ident_init(&ident, &param);
             if (!insert_symbol(self, &frame->locals, &ident, arg, env->report_diag)) {
-              free(ident.name);
+              value_free(arg);
               self->status = EVAL_STATUS_ERR;
               return false;
             }
@@ -783,11 +1139,15 @@ bool eval_node(NodeID index, NodeKind kind, bool pre, void* user) {
           }
 
           // Call the function.
+          EvalFrame* caller_frame = frame->prev;
           node_walk(fun_decl->bits.fun_decl.body, self->context, user, eval_node);
-          while (self->frame != frame->prev) {
+          while (self->frame != caller_frame) {
             eval_pop_frame(self);
           }
 
+          // The body didn't produce a result if its evaluation failed.
+          if (self->status == EVAL_STATUS_ERR) { return false; }
+
           // Drop the callee and move the function result down.
           drop(callee);
           eval_stack(self, -1) = eval_stack_top(self);
@@ -847,6 +1207,12 @@ int eval_program(EvalState* self,
                  size_t decl_count,
                  EvalErrorCallback report_diag)
 {
+  // Apply the shifts deferred by incremental reparses, as diagnostics refer to node offsets.
+  context_settle(self->context);
+
+  // Resolve the captures of the program's functions.
+  resolve_captures(&self->resolver, decls, decl_count);
+
   // Create a buffer to cache top-level declarations.
   NodeID top_decls[decl_count];
   size_t top_decl_count = 0;
@@ -865,35 +1231,31 @@ int eval_program(EvalState* self,
 
     // Register a global variable.
     if (decl->kind == nk_var_decl) {
-      RuntimeValue* value = malloc(sizeof(RuntimeValue));
+      RuntimeValue* value = value_alloc();
       if (decl->bits.var_decl.initializer != ~0) {
         value->kind = rv_lazy;
         value->bits.lazy_v = decl->bits.var_decl.initializer;
-      } else {
-        value->kind = rv_junk;
       }
 
       Ident ident;
-      ident_init(&ident, self->context, &decl->bits.var_decl.name);
+      ident_init(&ident, &decl->bits.var_decl.name);
       if (!insert_symbol(self, &self->globals, &ident, value, report_diag)) {
-        free(ident.name);
-        free(value);
+        value_free(value);
       }
       continue;
     }
 
     // Register a global function.
     if (decl->kind == nk_fun_decl) {
-      RuntimeValue* value = malloc(sizeof(RuntimeValue));
+      RuntimeValue* value = value_alloc();
       value->kind = rv_function;
       value->bits.function_v.decl = decl_index;
       value->bits.function_v.env = NULL;
 
       Ident ident;
-      ident_init(&ident, self->context, &decl->bits.fun_decl.name);
+      ident_init(&ident, &decl->bits.fun_decl.name);
       if (!insert_symbol(self, &self->globals, &ident, value, report_diag)) {
-        free(ident.name);
-        free(value);
+        value_free(value);
       }
       continue;
     }
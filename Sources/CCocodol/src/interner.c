@@ -0,0 +1,140 @@
+#include <string.h>
+
+#include "alloc.h"
+#include "arena.h"
+#include "interner.h"
+#include "utils.h"
+
+#define INITIAL_CAPACITY 64
+
+/// The names of the reserved symbols, in order.
+static const char* const builtin_names[sym_builtin_count] = {
+  [sym_print]       = "print",
+  [sym_read_int]    = "read_int",
+  [sym_read_float]  = "read_float",
+  [sym_at_eof]      = "at_eof",
+};
+
+void interner_init(Interner* self) {
+  self->count = 0;
+  self->capacity = INITIAL_CAPACITY;
+  self->symbols = cocodol_alloc(ac_ident, self->capacity * sizeof(SymbolInfo));
+
+  // The hash table is kept at most half full.
+  self->slot_count = INITIAL_CAPACITY * 2;
+  self->slots = cocodol_alloc(ac_ident, self->slot_count * sizeof(Symbol));
+  memset(self->slots, 0xff, self->slot_count * sizeof(Symbol));
+
+  for (size_t i = 0; i < sym_builtin_count; ++i) {
+    interner_intern(self, builtin_names[i], strlen(builtin_names[i]));
+  }
+}
+
+void interner_deinit(Interner* self) {
+  cocodol_free(ac_ident, self->symbols, self->capacity * sizeof(SymbolInfo));
+  cocodol_free(ac_ident, self->slots, self->slot_count * sizeof(Symbol));
+  self->symbols = NULL;
+  self->count = 0;
+  self->capacity = 0;
+  self->slots = NULL;
+  self->slot_count = 0;
+}
+
+/// Doubles the capacity of an interner, rehashing its symbols.
+static void interner_resize(Interner* self) {
+  size_t new_capacity = self->capacity * 2;
+  SymbolInfo* new_symbols = cocodol_alloc(ac_ident, new_capacity * sizeof(SymbolInfo));
+  memcpy(new_symbols, self->symbols, self->count * sizeof(SymbolInfo));
+  cocodol_free(ac_ident, self->symbols, self->capacity * sizeof(SymbolInfo));
+  self->symbols = new_symbols;
+  self->capacity = new_capacity;
+
+  cocodol_free(ac_ident, self->slots, self->slot_count * sizeof(Symbol));
+  self->slot_count = new_capacity * 2;
+  self->slots = cocodol_alloc(ac_ident, self->slot_count * sizeof(Symbol));
+  memset(self->slots, 0xff, self->slot_count * sizeof(Symbol));
+
+  size_t mask = self->slot_count - 1;
+  for (size_t i = 0; i < self->count; ++i) {
+    size_t pos = self->symbols[i].hash & mask;
+    while (self->slots[pos] != NO_SYMBOL) {
+      pos = (pos + 1) & mask;
+    }
+    self->slots[pos] = (Symbol)i;
+  }
+}
+
+/// Returns the slot of the given name, which is either free or holds the name's symbol.
+static inline size_t interner_slot(const Interner* self,
+                                   const char* text,
+                                   size_t length,
+                                   uint32_t hash)
+{
+  size_t mask = self->slot_count - 1;
+  size_t pos = hash & mask;
+  while (self->slots[pos] != NO_SYMBOL) {
+    const SymbolInfo* info = &self->symbols[self->slots[pos]];
+    if ((info->hash == hash) && (info->length == length) &&
+        (memcmp(info->text, text, length) == 0))
+    {
+      break;
+    }
+    pos = (pos + 1) & mask;
+  }
+  return pos;
+}
+
+Symbol interner_intern(Interner* self, const char* text, size_t length) {
+  uint32_t hash = (uint32_t)name_hash_buffer(text, length);
+  size_t pos = interner_slot(self, text, length, hash);
+  if (self->slots[pos] != NO_SYMBOL) {
+    return self->slots[pos];
+  }
+
+  // Insert a new symbol.
+  if (self->count == self->capacity) {
+    interner_resize(self);
+    pos = interner_slot(self, text, length, hash);
+  }
+
+  Symbol symbol = (Symbol)self->count;
+  self->symbols[symbol].text = text;
+  self->symbols[symbol].length = (uint32_t)length;
+  self->symbols[symbol].hash = hash;
+  self->slots[pos] = symbol;
+  self->count++;
+  return symbol;
+}
+
+Symbol interner_find(const Interner* self, const char* text, size_t length) {
+  uint32_t hash = (uint32_t)name_hash_buffer(text, length);
+  return self->slots[interner_slot(self, text, length, hash)];
+}
+
+void interner_rebase(Interner* self,
+                     const char* old_source,
+                     size_t old_length,
+                     const char* new_source,
+                     size_t start,
+                     size_t end,
+                     int64_t delta,
+                     Arena* arena)
+{
+  uintptr_t base = (uintptr_t)old_source;
+  for (size_t i = sym_builtin_count; i < self->count; ++i) {
+    SymbolInfo* info = &self->symbols[i];
+    uintptr_t address = (uintptr_t)info->text;
+    if ((address < base) || (address >= base + old_length)) { continue; }
+
+    size_t offset = address - base;
+    if (offset + info->length <= start) {
+      info->text = new_source + offset;
+    } else if (offset >= end) {
+      info->text = new_source + (offset + delta);
+    } else {
+      char* copy = arena_alloc(arena, info->length);
+      memcpy(copy, info->text, info->length);
+      info->text = copy;
+    }
+  }
+}
@@ -1,206 +1,273 @@
-#include <ctype.h>
+#include <stdint.h>
 #include <stdio.h>
-#include <stdlib.h>
 #include <string.h>
 
+#include "interner.h"
 #include "lexer.h"
+#include "scan.h"
 #include "token.h"
 
-#define lexer_stream(self)  (self->source + self->index)
-#define lexer_peek(self)    (self->source[self->index])
+// ------------------------------------------------------------------------------------------------
+// MARK: Character classes
+// ------------------------------------------------------------------------------------------------
 
-int is_ident_char(int ch) {
-  return (isalnum(ch) || ch == '_');
+#define CC_SPACE  1
+#define CC_ALPHA  2
+#define CC_DIGIT  4
+
+/// The class of each character.
+///
+/// The table only recognizes ASCII characters, so that scanning doesn't depend on the locale.
+static const uint8_t char_class[256] = {
+  [' ']  = CC_SPACE, ['\t'] = CC_SPACE, ['\n'] = CC_SPACE,
+  ['\v'] = CC_SPACE, ['\f'] = CC_SPACE, ['\r'] = CC_SPACE,
+  ['a' ... 'z'] = CC_ALPHA,
+  ['A' ... 'Z'] = CC_ALPHA,
+  ['_'] = CC_ALPHA,
+  ['0' ... '9'] = CC_DIGIT,
+};
+
+/// The kind of the token starting with each character, assuming the token has a single character.
+///
+/// Characters that do not start any punctuation or operator are mapped onto `tk_error`.
+static const TokenKind punct_kind[256] = {
+  ['+'] = tk_plus,      ['-'] = tk_minus,     ['*'] = tk_star,      ['/'] = tk_slash,
+  ['%'] = tk_percent,   ['|'] = tk_pipe,      ['&'] = tk_amp,       ['^'] = tk_caret,
+  ['~'] = tk_tilde,     ['.'] = tk_dot,       [':'] = tk_colon,     [';'] = tk_semicolon,
+  [','] = tk_comma,     ['('] = tk_l_paren,   [')'] = tk_r_paren,   ['{'] = tk_l_brace,
+  ['}'] = tk_r_brace,   ['!'] = tk_not,       ['<'] = tk_lt,        ['>'] = tk_gt,
+  ['='] = tk_assign,    [(uint8_t)EOF] = tk_eof,
+};
+
+#define char_is(ch, cls)  ((char_class[(uint8_t)(ch)] & (cls)) != 0)
+
+// ------------------------------------------------------------------------------------------------
+// MARK: Keywords
+// ------------------------------------------------------------------------------------------------
+
+#define KEYWORD_MIN_LEN   2
+#define KEYWORD_MAX_LEN   5
+#define KEYWORD_SLOTS     32
+
+/// An entry of the keyword table.
+typedef struct Keyword {
+
+  /// The keyword's textual representation.
+  const char* text;
+
+  /// The keyword's length, or 0 if the slot is empty.
+  size_t len;
+
+  /// The kind of the token representing the keyword.
+  TokenKind kind;
+
+} Keyword;
+
+/// Computes the slot of an identifier of length `len` in the keyword table.
+///
+/// The function is a perfect hash over the keywords, which are discriminated by their first and
+/// last characters, together with their length.
+#define keyword_hash(id, len)  \
+  ((((uint8_t)(id)[0]) + 7 * ((uint8_t)(id)[(len) - 1]) + (len)) & (KEYWORD_SLOTS - 1))
+
+/// The keyword table, indexed by `keyword_hash`.
+static const Keyword keywords[KEYWORD_SLOTS] = {
+  [ 0] = { "and"  , 3, tk_and   },
+  [ 1] = { "ret"  , 3, tk_ret   },
+  [11] = { "fun"  , 3, tk_fun   },
+  [12] = { "else" , 4, tk_else  },
+  [14] = { "false", 5, tk_false },
+  [15] = { "or"   , 2, tk_or    },
+  [18] = { "brk"  , 3, tk_brk   },
+  [21] = { "if"   , 2, tk_if    },
+  [23] = { "var"  , 3, tk_var   },
+  [24] = { "obj"  , 3, tk_obj   },
+  [27] = { "true" , 4, tk_true  },
+  [29] = { "nxt"  , 3, tk_nxt   },
+  [31] = { "while", 5, tk_while },
+};
+
+/// Returns the kind of the keyword matching the identifier of length `len` at `id`, or `tk_name`
+/// if the identifier isn't a keyword.
+static inline TokenKind keyword_kind(const char* id, size_t len) {
+  if ((len < KEYWORD_MIN_LEN) || (len > KEYWORD_MAX_LEN)) { return tk_name; }
+
+  const Keyword* entry = &keywords[keyword_hash(id, len)];
+  if (entry->len != len) { return tk_name; }
+  for (size_t i = 0; i < len; ++i) {
+    if (entry->text[i] != id[i]) { return tk_name; }
+  }
+  return entry->kind;
 }
 
-void lexer_init(LexerState* self, const char* source) {
+// ------------------------------------------------------------------------------------------------
+// MARK: Scanning
+// ------------------------------------------------------------------------------------------------
+
+void lexer_init(LexerState* self, const char* source, Interner* interner) {
   self->source = source;
   self->index = 0;
+  self->scan = scan_kernels();
+  self->interner = interner;
 }
 
 void lexer_deinit(LexerState* self) {
   self->source = 0;
   self->index = 0;
+  self->scan = NULL;
+  self->interner = NULL;
 }
 
-/// Consumes the longest sequence of characters tht satisfy the given predicate from the lexer's
-/// input buffer.
-size_t lexer_take_while(LexerState* self, int (*predicate)(int)) {
-  const char* stream = lexer_stream(self);
-  if (!stream[0]) {
-    return 0;
+/// Assigns its symbol to a name token that starts at `stream` and has the given length.
+static inline void lexer_intern(LexerState* self, Token* token, const char* stream, size_t len) {
+  if (self->interner != NULL) {
+    token->symbol = interner_intern(self->interner, stream, len);
   }
+}
+
+/// The number of characters that are classified one at a time before bulk scanning is attempted.
+///
+/// Most runs are short, and skipping them inline is cheaper than calling a vectorized kernel.
+#define SCAN_INLINE_LIMIT 8
 
+/// Returns the number of leading characters of `stream` that belong to the given classes, up to
+/// `SCAN_INLINE_LIMIT`.
+static inline size_t run_length(const char* stream, uint8_t cls) {
   size_t i = 0;
-  while (stream[i] && predicate(stream[i])) {
-    i += 1;
+  while ((i < SCAN_INLINE_LIMIT) && char_is(stream[i], cls)) { i++; }
+  return i;
+}
+
+// The fast path of `lexer_next` handles short runs inline and hands long ones over to the functions
+// below, which scan them with the bulk scanning kernels. These functions are only ever tail-called
+// and are never inlined, so that the fast path doesn't have to preserve its state across calls.
+
+bool lexer_next(LexerState* self, Token* token);
+
+/// Skips a long run of whitespace characters and comments, and then scans the next token.
+__attribute__((noinline))
+static bool lexer_next_after_trivia(LexerState* self, Token* token) {
+  const char* stream = self->source + self->index;
+  while (true) {
+    stream = self->scan->skip_spaces(stream);
+    if ((stream[0] != '/') || (stream[1] != '/')) { break; }
+    stream = self->scan->skip_line(stream + 2);
   }
 
-  self->index += i;
-  return i;
+  self->index = stream - self->source;
+  return lexer_next(self, token);
 }
 
-bool lexer_next(LexerState* self, Token* token) {
-  char ch;
-
-  while (lexer_peek(self)) {
-    // Skip all leading whitespace characters.
-    lexer_take_while(self, &isspace);
-
-    // Skip the remainder of the line if we recognized a comment.
-    if (strncmp(lexer_stream(self), "//", 2) == 0) {
-      while ((ch = lexer_peek(self))) {
-        self->index++;
-        if ((ch == '\n') || (ch == '\r')) {
-          break;
-        }
-      }
-    } else {
-      // We're ready to consume a token.
-      break;
+/// Scans a name longer than `SCAN_INLINE_LIMIT`, whose first `SCAN_INLINE_LIMIT` characters have
+/// already been consumed.
+///
+/// The name can't be a keyword, as `SCAN_INLINE_LIMIT` is greater than `KEYWORD_MAX_LEN`.
+__attribute__((noinline))
+static bool lexer_next_long_name(LexerState* self, Token* token, const char* stream) {
+  const char* end = self->scan->skip_ident(stream);
+  token->kind = tk_name;
+  self->index = end - self->source;
+  token->end = (uint32_t)self->index;
+  lexer_intern(self, token, self->source + token->start, end - (self->source + token->start));
+  return true;
+}
+
+/// Scans a number that starts at `stream` and that has a run of digits longer than
+/// `SCAN_INLINE_LIMIT`.
+__attribute__((noinline))
+static bool lexer_next_long_number(LexerState* self, Token* token, const char* stream) {
+  const char* end = self->scan->skip_digits(stream);
+  token->kind = tk_integer;
+
+  // Look for a floating part.
+  if (*end == '.') {
+    if (char_is(end[1], CC_DIGIT)) {
+      end = self->scan->skip_digits(end + 2);
     }
+    token->kind = tk_float;
   }
 
-  if (!(ch = lexer_peek(self))) {
+  self->index = end - self->source;
+  token->end = (uint32_t)self->index;
+  return true;
+}
+
+bool lexer_next(LexerState* self, Token* token) {
+  const char* source = self->source;
+  const char* stream = source + self->index;
+
+  // Skip a single leading whitespace character. Longer runs and comments are skipped in bulk.
+  if (char_is(*stream, CC_SPACE)) { stream++; }
+  if (char_is(*stream, CC_SPACE) || ((stream[0] == '/') && (stream[1] == '/'))) {
+    self->index = stream - source;
+    return lexer_next_after_trivia(self, token);
+  }
+
+  char ch = *stream;
+  if (!ch) {
+    self->index = stream - source;
     return false;
   }
-  token->start = self->index;
+  token->start = (uint32_t)(stream - source);
+  token->symbol = NO_SYMBOL;
 
   // Scan identifiers and keywords.
-  if (isalpha(ch) || (ch == '_')) {
-    const char* id = lexer_stream(self);
-    lexer_take_while(self, &is_ident_char);
-    token->end = self->index;
-
-    if (strncmp(id, "if", 2) == 0) {
-      token->kind = tk_if;
-    } else if (strncmp(id, "or", 2) == 0) {
-      token->kind = tk_or;
-    } else if (strncmp(id, "var", 3) == 0) {
-      token->kind = tk_var;
-    } else if (strncmp(id, "fun", 3) == 0) {
-      token->kind = tk_fun;
-    } else if (strncmp(id, "ret", 3) == 0) {
-      token->kind = tk_ret;
-    } else if (strncmp(id, "obj", 3) == 0) {
-      token->kind = tk_obj;
-    } else if (strncmp(id, "brk", 3) == 0) {
-      token->kind = tk_brk;
-    } else if (strncmp(id, "nxt", 3) == 0) {
-      token->kind = tk_nxt;
-    } else if (strncmp(id, "and", 3) == 0) {
-      token->kind = tk_and;
-    } else if (strncmp(id, "true", 4) == 0) {
-      token->kind = tk_true;
-    } else if (strncmp(id, "else", 4) == 0) {
-      token->kind = tk_else;
-    } else if (strncmp(id, "false", 5) == 0) {
-      token->kind = tk_false;
-    } else if (strncmp(id, "while", 5) == 0) {
-      token->kind = tk_while;
-    } else {
-      token->kind = tk_name;
+  if (char_is(ch, CC_ALPHA)) {
+    size_t len = 1 + run_length(stream + 1, CC_ALPHA | CC_DIGIT);
+    if (len > SCAN_INLINE_LIMIT) {
+      return lexer_next_long_name(self, token, stream + len);
     }
 
+    token->kind = keyword_kind(stream, len);
+    self->index = (stream - source) + len;
+    token->end = (uint32_t)self->index;
+    if (token->kind == tk_name) {
+      lexer_intern(self, token, stream, len);
+    }
     return true;
   }
 
   // Scan for numbers.
-  if (isdigit(ch)) {
+  if (char_is(ch, CC_DIGIT)) {
+    size_t len = run_length(stream, CC_DIGIT);
+    const char* end = stream + len;
     token->kind = tk_integer;
-    lexer_take_while(self, &isdigit);
 
     // Look for a floating part.
-    if (lexer_peek(self) == '.') {
-      self->index++;
-      if (lexer_take_while(self, &isdigit) == 0) {
-        self->index--;
+    if (*end == '.') {
+      if (char_is(end[1], CC_DIGIT) && (len < SCAN_INLINE_LIMIT)) {
+        len = run_length(end + 1, CC_DIGIT);
+        end = end + 1 + len;
       }
       token->kind = tk_float;
     }
 
-    token->end = self->index;
+    if (len == SCAN_INLINE_LIMIT) {
+      return lexer_next_long_number(self, token, stream);
+    }
+
+    self->index = end - source;
+    token->end = (uint32_t)self->index;
     return true;
   }
 
   // Scan operators and punctuation.
-  char next = self->source[self->index + 1];
-  switch (ch) {
-    case '+': token->kind = tk_plus;      break;
-    case '-': token->kind = tk_minus;     break;
-    case '*': token->kind = tk_star;      break;
-    case '/': token->kind = tk_slash;     break;
-    case '%': token->kind = tk_percent;   break;
-    case '|': token->kind = tk_pipe;      break;
-    case '&': token->kind = tk_amp;       break;
-    case '^': token->kind = tk_caret;     break;
-    case '~': token->kind = tk_tilde;     break;
-    case '.': token->kind = tk_dot;       break;
-    case ':': token->kind = tk_colon;     break;
-    case ';': token->kind = tk_semicolon; break;
-    case ',': token->kind = tk_comma;     break;
-    case '(': token->kind = tk_l_paren;   break;
-    case ')': token->kind = tk_r_paren;   break;
-    case '{': token->kind = tk_l_brace;   break;
-    case '}': token->kind = tk_r_brace;   break;
-    case EOF: token->kind = tk_eof;       break;
-
-    case '!':
-      if (next == '=') {
-        self->index += 2;
-        token->kind = tk_ne;
-        token->end = self->index;
-        return true;
-      }
-      token->kind = tk_not;
-      break;
-
-    case '<':
-      if (next == '=') {
-        self->index += 2;
-        token->kind = tk_le;
-        token->end = self->index;
-        return true;
-      } else if (next == '<') {
-        self->index += 2;
-        token->kind = tk_l_shift;
-        token->end = self->index;
-        return true;
-      }
-      token->kind = tk_lt;
-      break;
-
-    case '>':
-      if (next == '=') {
-        self->index += 2;
-        token->kind = tk_ge;
-        token->end = self->index;
-        return true;
-      } else if (next == '>') {
-        self->index += 2;
-        token->kind = tk_r_shift;
-        token->end = self->index;
-        return true;
-      }
-      token->kind = tk_gt;
-      break;
-
-    case '=':
-      if (next == '=') {
-        self->index += 2;
-        token->kind = tk_eq;
-        token->end = self->index;
-        return true;
-      }
-      token->kind = tk_assign;
-      break;
-
-    default:
-      token->kind = tk_error;
-      break;
+  size_t len = 1;
+  token->kind = punct_kind[(uint8_t)ch];
+  if (stream[1] == '=') {
+    switch (ch) {
+      case '!': token->kind = tk_ne; len = 2; break;
+      case '<': token->kind = tk_le; len = 2; break;
+      case '>': token->kind = tk_ge; len = 2; break;
+      case '=': token->kind = tk_eq; len = 2; break;
+      default : break;
+    }
+  } else if ((stream[1] == ch) && ((ch == '<') || (ch == '>'))) {
+    token->kind = (ch == '<') ? tk_l_shift : tk_r_shift;
+    len = 2;
   }
 
-  self->index++;
-  token->end = self->index;
+  self->index = (stream - source) + len;
+  token->end = (uint32_t)self->index;
   return true;
 }
@@ -1,67 +1,186 @@
+#include <errno.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <unistd.h>
 
 #include "cocodol.h"
 
+/// The user data of the parser of a program read from a stream.
+typedef struct StreamRun {
+
+  /// The number of diagnostics reported by the parser.
+  size_t diag_count;
+
+  /// The state of the evaluator of the program.
+  EvalState* eval;
+
+} StreamRun;
+
 static void report_parse_error(ParseError error, const ParserState* state) {
   printf("%zu: error: %s\n", error.location, error.message);
+
+  // Count the diagnostics, so that programs that failed to parse are not cached.
+  if (state->user_data != NULL) {
+    (*(size_t*)state->user_data)++;
+  }
+}
+
+static void report_stream_parse_error(ParseError error, const ParserState* state) {
+  printf("%zu: error: %s\n", error.location, error.message);
+  ((StreamRun*)state->user_data)->diag_count++;
 }
 
 static void report_eval_error(EvalError error, const EvalState* state) {
   printf("%zu: error: %s\n", error.start, error.message);
 }
 
-int main(int argc, char** argv) {
-  // Get the path of the input file.
-  if (argc < 2) {
-    fputs("error: no input file\n", stdout);
-    return 1;
+/// Prints the allocation statistics of each category on the standard error.
+static void print_alloc_stats(void) {
+  fprintf(stderr, "%-10s %12s %14s %14s %8s\n", "category", "allocs", "bytes", "peak", "live");
+  for (size_t i = 0; i < ac_count; ++i) {
+    AllocStats stats = cocodol_alloc_stats(i);
+    fprintf(stderr, "%-10s %12zu %14zu %14zu %8zu\n",
+            alloc_category_name(i),
+            stats.alloc_count, stats.byte_count, stats.peak_byte_count, stats.live_count);
   }
+}
 
-  FILE* fp = fopen(argv[1], "r");
-  if (!fp) {
-    printf("error: file not found: '%s'\n", argv[1]);
-    return 1;
+/// Evaluates the declarations of a program read from a stream, as soon as they are parsed.
+///
+/// The declarations are evaluated one at a time, so that the output of a program doesn't depend on
+/// how the stream splits its input into chunks. Unlike in a file, a top-level statement therefore
+/// can't use a function or a variable that is declared after it.
+static void eval_decls(const NodeID* declv, size_t declc, void* user_data) {
+  EvalState* eval = ((StreamRun*)user_data)->eval;
+  for (size_t i = 0; (i < declc) && (eval->status == 0); ++i) {
+    eval_program(eval, declv + i, 1, report_eval_error);
   }
+  fflush(stdout);
+}
 
-  // Open and read the input file.
-  fseek(fp, 0L, SEEK_END);
-  long byte_count = ftell(fp);
-  fseek(fp, 0L, SEEK_SET);
-
-  char* source = calloc(byte_count, sizeof(char));
-  if (source == NULL) {
-    printf("error: not enough memory\n");
+/// Runs the program in the file at the given path.
+///
+/// The AST of the program is loaded from the cache if possible. Otherwise, the program is parsed
+/// and its AST is stored into the cache, unless `use_cache` is `false`.
+static int run_file(const char* path, long jobs, bool use_cache) {
+  // Map the input file.
+  SourceFile source;
+  if (!source_file_open(&source, path)) {
+    printf("error: cannot read file '%s': %s\n", path, strerror(errno));
     return 1;
   }
 
-  fread(source, sizeof(char), byte_count, fp);
-  fclose(fp);
-
-  // Parse the program.
+  // Load the program from the cache.
   Context context;
-  ParserState parser;
-  context_init(&context, source);
-  parser_init(&parser, &context, NULL);
+  context_init(&context, source.text, source.length);
 
-  NodeID** declv = malloc(sizeof(NodeID*));
-  size_t declc = parse(&parser, declv, report_parse_error);
+  AstCacheFile cache = { NULL, 0 };
+  uint64_t key = 0;
+  NodeID* declv = NULL;
+  size_t declc = 0;
+  bool cached = false;
+  if (use_cache) {
+    key = ast_cache_key(source.text, source.length);
+    cached = ast_cache_load(&cache, &context, key, &declv, &declc);
+  }
+
+  // Parse the program if it wasn't cached.
+  if (!cached) {
+    ParserState parser;
+    size_t diag_count = 0;
+    parser_init_buffered(&parser, &context, &diag_count);
+    declc = parse_parallel(&parser, &declv, (jobs > 1) ? jobs : 1, report_parse_error);
+    parser_deinit(&parser);
+
+    if (use_cache && (diag_count == 0)) {
+      ast_cache_store(&context, key, declv, declc);
+    }
+  }
 
   int status = 0;
   if (declc > 0) {
     // Evaluate the program.
     EvalState eval;
     eval_init(&eval, &context);
-    status = eval_program(&eval, *declv, declc, report_eval_error);
+    status = eval_program(&eval, declv, declc, report_eval_error);
     eval_deinit(&eval);
-    free(*declv);
+    free(declv);
+  }
+
+  // Cleanup.
+  context_deinit(&context);
+  ast_cache_close(&cache);
+  source_file_close(&source);
+  return status;
+}
+
+/// Runs the program read from the given file descriptor, evaluating its top-level declarations
+/// as soon as they have been read and parsed.
+static int run_stream(int fd) {
+  SourceStream source;
+  if (!source_stream_open(&source, fd)) {
+    printf("error: not enough memory\n");
+    return 1;
+  }
+
+  Context context;
+  EvalState eval;
+  context_init(&context, source.text, source.length);
+  eval_init(&eval, &context);
+
+  StreamRun run = { 0, &eval };
+  int status = 0;
+  if (!parse_stream(&context, &source, &run, report_stream_parse_error, eval_decls)) {
+    printf("error: cannot read input: %s\n", strerror(source.error));
+    status = 1;
+  } else {
+    status = eval.status;
   }
-  free(declv);
 
   // Cleanup.
-  parser_deinit(&parser);
+  eval_deinit(&eval);
   context_deinit(&context);
-  free(source);
+  source_stream_close(&source);
+  return status;
+}
+
+int main(int argc, char** argv) {
+  // Parse the command line.
+  bool mem_stats = false;
+  bool use_cache = true;
+  long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+  const char* path = NULL;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--mem-stats") == 0) {
+      mem_stats = true;
+    } else if (strcmp(argv[i], "--no-cache") == 0) {
+      use_cache = false;
+    } else if ((strcmp(argv[i], "--jobs") == 0) && (i + 1 < argc)) {
+      jobs = strtol(argv[++i], NULL, 10);
+    } else {
+      path = argv[i];
+    }
+  }
+
+  // Get the path of the input file.
+  if (path == NULL) {
+    fputs("error: no input file\n", stdout);
+    fputs("usage: cocodol [--mem-stats] [--no-cache] [--jobs <n>] <file | ->\n", stdout);
+    fputs("  -  read the program from the standard input; `read_int`, `read_float` and `at_eof`\n"
+          "     then read the same stream as the parser, so the program can't get separate input\n",
+          stdout);
+    return 1;
+  }
+
+  // Run the program, reading it from the standard input if the path is "-".
+  int status = (strcmp(path, "-") == 0)
+    ? run_stream(STDIN_FILENO)
+    : run_file(path, jobs, use_cache);
+
+  if (mem_stats) {
+    print_alloc_stats();
+  }
 
   return status;
 }
@@ -1,37 +1,110 @@
 #include <assert.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "alloc.h"
 #include "context.h"
 #include "parser.h"
+#include "source.h"
 
 #define INITIAL_VEC_CAPACITY 64
 #define MAX_PARAM_COUNT      64
 
+/// The minimum number of tokens in a chunk that is parsed in parallel with others.
+#define MIN_CHUNK_TOKEN_COUNT 4096
+
+/// The number of chunks assigned to each thread, so that work can be balanced between threads
+/// when chunks have uneven costs.
+#define CHUNKS_PER_THREAD     4
+
 #define token_isprefix(kind) (((kind) & TOK_PRFX_BIT) == TOK_PRFX_BIT)
 
 NodeID parse_brace_stmt(ParserState* self, ParseErrorCallback report_diag);
 
 void parser_init(ParserState* self, Context* context, void* user_data) {
-  lexer_init(&self->lexer, context->source);
+  lexer_init(&self->lexer, context->source, &context->interner);
   self->context = context;
+  self->tokens = NULL;
+  self->token_index = 0;
+  self->token_limit = 0;
+  self->owns_tokens = false;
   self->lookahead_start = 0;
   self->lookahead_end = 0;
   self->scope = ~0;
+  self->scratch = cocodol_alloc(ac_ast, INITIAL_VEC_CAPACITY * sizeof(NodeID));
+  self->scratch_count = 0;
+  self->scratch_capacity = INITIAL_VEC_CAPACITY;
   self->user_data = user_data;
 }
 
+void parser_init_buffered(ParserState* self, Context* context, void* user_data) {
+  parser_init(self, context, user_data);
+
+  TokenBuffer* tokens = cocodol_alloc(ac_tokens, sizeof(TokenBuffer));
+  if (token_buffer_init(tokens, context->source, &context->interner)) {
+    self->tokens = tokens;
+    self->token_limit = tokens->count;
+    self->owns_tokens = true;
+  } else {
+    token_buffer_deinit(tokens);
+    cocodol_free(ac_tokens, tokens, sizeof(TokenBuffer));
+  }
+}
+
+void parser_init_slice(ParserState* self,
+                       Context* context,
+                       TokenBuffer* tokens,
+                       size_t begin,
+                       size_t end,
+                       void* user_data)
+{
+  parser_init(self, context, user_data);
+  self->tokens = tokens;
+  self->token_index = begin;
+  self->token_limit = end;
+  self->lookahead_end = begin;
+}
+
 void parser_deinit(ParserState* self) {
   lexer_deinit(&self->lexer);
+  if (self->owns_tokens) {
+    token_buffer_deinit(self->tokens);
+    cocodol_free(ac_tokens, self->tokens, sizeof(TokenBuffer));
+  }
+  cocodol_free(ac_ast, self->scratch, self->scratch_capacity * sizeof(NodeID));
   self->context = NULL;
+  self->tokens = NULL;
+  self->token_index = 0;
+  self->token_limit = 0;
+  self->owns_tokens = false;
   self->lookahead_start = 0;
   self->lookahead_end = 0;
+  self->scratch = NULL;
+  self->scratch_count = 0;
+  self->scratch_capacity = 0;
   self->user_data = NULL;
 }
 
 /// Returns a pointer to the next token in the stream, or `NULL` if the parser reached the end of
 /// the stream.
 Token* peek(ParserState* self) {
+  // Read from the token buffer, if any.
+  if (self->tokens != NULL) {
+    size_t index = self->token_index;
+    Token* token_ptr = self->lookahead_buffer + (index % TOKEN_BUFFER_LENGTH);
+    if (index < self->lookahead_end) {
+      return token_ptr;
+    } else if (index < self->token_limit) {
+      token_buffer_get(self->tokens, index, token_ptr);
+      self->lookahead_end = index + 1;
+      return token_ptr;
+    } else {
+      return NULL;
+    }
+  }
+
+  // Pull the next token from the lexer.
   Token* token_ptr = self->lookahead_buffer + self->lookahead_start;
   if (self->lookahead_start < self->lookahead_end) {
     return token_ptr;
@@ -45,9 +118,16 @@ Token* peek(ParserState* self) {
   }
 }
 
-/// Consumes a token from the stream and returns a pointer to it.
+/// Consumes a token from the stream and returns a pointer to it, or `NULL` if the parser reached
+/// the end of the stream.
 Token* consume(ParserState* self) {
   Token* token_ptr = peek(self);
+  if (token_ptr == NULL) { return NULL; }
+  if (self->tokens != NULL) {
+    self->token_index++;
+    return token_ptr;
+  }
+
   self->lookahead_start++;
   if (self->lookahead_start == TOKEN_BUFFER_LENGTH) {
     self->lookahead_start = 0;
@@ -69,6 +149,17 @@ bool is_stmt_delimiter(Token* token, Context* context, TokenKind terminator) {
   }
 }
 
+/// Registers a named declaration in the current scope, if any.
+void register_decl(ParserState* self, NodeID decl_index) {
+  if (self->scope == ~0) { return; }
+
+  Node* scope = context_get_nodeptr(self->context, self->scope);
+  assert(scope->kind == nk_brace_stmt);
+
+  uint32_t link[2] = { decl_index, scope->bits.brace_stmt.last_decl };
+  scope->bits.brace_stmt.last_decl = context_append_extra(self->context, link, 2);
+}
+
 NodeID create_error_node(Context* context, size_t start, size_t end) {
   NodeID node_index = context_new_node(context);
   Node* node  = context_get_nodeptr(context, node_index);
@@ -89,7 +180,7 @@ size_t parse_param_list(ParserState* self, Token* paramv, ParseErrorCallback rep
 
   // Parse the opening parenthesis.
   if (!next || (next->kind != tk_l_paren)) {
-    size_t end = next ? next->start : strlen(self->context->source);
+    size_t end = next ? next->start : self->context->source_length;
     ParseError error = { end, "expected parameter list" };
     report_diag(error, self);
     return ~0;
@@ -113,19 +204,23 @@ size_t parse_param_list(ParserState* self, Token* paramv, ParseErrorCallback rep
       if (!next) { break; }
     }
 
-    // Parse one name.
-    paramv[count] = *next;
-    if (next->kind == tk_name) {
-      consume(self);
-    } else {
+    // Bail out if there are too many parameters.
+    if (count == MAX_PARAM_COUNT) {
+      ParseError error = { next->start, "too many parameters" };
+      report_diag(error, self);
+      break;
+    }
+
+    // Parse one name, skipping the offending token if it's not a name.
+    paramv[count] = *consume(self);
+    if (paramv[count].kind != tk_name) {
       paramv[count].kind = tk_error;
-      ParseError error = { next->start, "expected parameter name" };
+      ParseError error = { paramv[count].start, "expected parameter name" };
       report_diag(error, self);
     }
 
     // Increment the number of parameters.
     count++;
-    assert(count <= MAX_PARAM_COUNT);
 
     // Parse a separator, unless we reached the terminator.
     next = peek(self);
@@ -143,7 +238,7 @@ size_t parse_param_list(ParserState* self, Token* paramv, ParseErrorCallback rep
   if (next && next->kind == tk_r_paren) {
     consume(self);
   } else {
-    size_t end = next ? next->start : strlen(self->context->source);
+    size_t end = next ? next->start : self->context->source_length;
     ParseError error = { end, "missing closing parenthesis" };
     report_diag(error, self);
   }
@@ -160,35 +255,31 @@ NodeID parse_var_decl(ParserState* self, ParseErrorCallback report_diag) {
 #define the_decl context_get_nodeptr(self->context, decl_index)
   the_decl->kind = nk_var_decl;
   the_decl->start = next->start;
+  the_decl->end = next->end;
 
   // Parse the name of the variable.
   next = peek(self);
   if (next == NULL) {
     the_decl->kind = nk_error;
-    ParseError error = { strlen(self->context->source), "expected variable name" };
+    ParseError error = { self->context->source_length, "expected variable name" };
     report_diag(error, self);
     return decl_index;
   }
 
   if (next->kind == tk_name) {
     the_decl->bits.var_decl.name = *next;
+    the_decl->end = next->end;
     consume(self);
   } else {
     the_decl->bits.var_decl.name.kind = tk_error;
+    the_decl->bits.var_decl.name.start = the_decl->end;
+    the_decl->bits.var_decl.name.end = the_decl->end;
     ParseError error = { next->start, "expected variable name" };
     report_diag(error, self);
   }
 
   // Register the declaration in the current scope.
-  if (self->scope != ~0) {
-    Node* scope = context_get_nodeptr(self->context, self->scope);
-    assert(scope->kind == nk_brace_stmt);
-
-    DeclList* link = malloc(sizeof(DeclList));
-    link->decl = decl_index;
-    link->prev = scope->bits.brace_stmt.last_decl;
-    scope->bits.brace_stmt.last_decl = link;
-  }
+  register_decl(self, decl_index);
 
   // Parse the variable's initializer, if any.
   next = peek(self);
@@ -201,7 +292,6 @@ NodeID parse_var_decl(ParserState* self, ParseErrorCallback report_diag) {
     the_decl->end = context_get_nodeptr(self->context, expr_index)->end;
   } else {
     the_decl->bits.var_decl.initializer = ~0;
-    the_decl->end = next->end;
   }
 
   return decl_index;
@@ -217,12 +307,13 @@ NodeID parse_fun_decl(ParserState* self, ParseErrorCallback report_diag) {
 #define the_decl context_get_nodeptr(self->context, decl_index)
   the_decl->kind  = nk_fun_decl;
   the_decl->start = next->start;
+  the_decl->end   = next->end;
 
   // Parse the name of the function.
   next = peek(self);
   if (next == NULL) {
     the_decl->kind = nk_error;
-    ParseError error = { strlen(self->context->source), "expected function name" };
+    ParseError error = { self->context->source_length, "expected function name" };
     report_diag(error, self);
     return decl_index;
   }
@@ -232,31 +323,28 @@ NodeID parse_fun_decl(ParserState* self, ParseErrorCallback report_diag) {
     consume(self);
   } else {
     the_decl->bits.fun_decl.name.kind = tk_error;
+    the_decl->bits.fun_decl.name.start = the_decl->end;
+    the_decl->bits.fun_decl.name.end = the_decl->end;
     ParseError error = { next->start, "expected function name" };
     report_diag(error, self);
   }
 
   // Register the declaration in the current scope.
-  if (self->scope != ~0) {
-    Node* scope = context_get_nodeptr(self->context, self->scope);
-    assert(scope->kind == nk_brace_stmt);
+  register_decl(self, decl_index);
 
-    DeclList* link = malloc(sizeof(DeclList));
-    link->decl = decl_index;
-    link->prev = scope->bits.brace_stmt.last_decl;
-    scope->bits.brace_stmt.last_decl = link;
-  }
-
-  // Parse the list of parameters.
+  // Parse the list of parameters, and store them in the context's extra data, after their count
+  // and the position of the function's capture list, which is resolved later.
   Token paramv[MAX_PARAM_COUNT];
   size_t paramc = parse_param_list(self, paramv, report_diag);
-  the_decl->bits.fun_decl.paramc = paramc;
-  if (paramc > 0) {
-    the_decl->bits.fun_decl.paramv = malloc(paramc * sizeof(Token));
-    memcpy(the_decl->bits.fun_decl.paramv, paramv, paramc * sizeof(Token));
-  } else {
-    the_decl->bits.fun_decl.paramv = NULL;
-  }
+  if (paramc == (size_t)~0) { paramc = 0; }
+
+  uint32_t params[PARAM_HEADER_WORD_COUNT + MAX_PARAM_COUNT * PARAM_WORD_COUNT];
+  params[0] = (uint32_t)paramc;
+  params[1] = 0;
+  params[2] = UNRESOLVED_CAPTURES;
+  memcpy(params + PARAM_HEADER_WORD_COUNT, paramv, paramc * sizeof(Token));
+  the_decl->bits.fun_decl.params = context_append_extra(
+    self->context, params, PARAM_HEADER_WORD_COUNT + paramc * PARAM_WORD_COUNT);
 
   // Parse the body of the function.
   next = peek(self);
@@ -265,8 +353,9 @@ NodeID parse_fun_decl(ParserState* self, ParseErrorCallback report_diag) {
     the_decl->bits.fun_decl.body = body_index;
     the_decl->end = context_get_nodeptr(self->context, body_index)->end;
   } else {
-    size_t end = next ? next->start : strlen(self->context->source);
-    the_decl->bits.fun_decl.body = create_error_node(self->context, end, end);
+    size_t end = next ? next->start : self->context->source_length;
+    NodeID body_index = create_error_node(self->context, end, end);
+    the_decl->bits.fun_decl.body = body_index;
     the_decl->end = end;
     ParseError error = { end, "expected function body" };
     report_diag(error, self);
@@ -285,12 +374,13 @@ NodeID parse_obj_decl(ParserState* self, ParseErrorCallback report_diag) {
 #define the_decl context_get_nodeptr(self->context, decl_index)
   the_decl->kind = nk_obj_decl;
   the_decl->start = next->start;
+  the_decl->end = next->end;
 
   // Parse the name of the type.
   next = peek(self);
   if (next == NULL) {
     the_decl->kind = nk_error;
-    ParseError error = { strlen(self->context->source), "expected type name" };
+    ParseError error = { self->context->source_length, "expected type name" };
     report_diag(error, self);
     return decl_index;
   }
@@ -300,20 +390,14 @@ NodeID parse_obj_decl(ParserState* self, ParseErrorCallback report_diag) {
     consume(self);
   } else {
     the_decl->bits.obj_decl.name.kind = tk_error;
+    the_decl->bits.obj_decl.name.start = the_decl->end;
+    the_decl->bits.obj_decl.name.end = the_decl->end;
     ParseError error = { next->start, "expected type name" };
     report_diag(error, self);
   }
 
   // Register the declaration in the current scope.
-  if (self->scope != ~0) {
-    Node* scope = context_get_nodeptr(self->context, self->scope);
-    assert(scope->kind == nk_brace_stmt);
-
-    DeclList* link = malloc(sizeof(DeclList));
-    link->decl = decl_index;
-    link->prev = scope->bits.brace_stmt.last_decl;
-    scope->bits.brace_stmt.last_decl = link;
-  }
+  register_decl(self, decl_index);
 
   // Parse the body of the type.
   next = peek(self);
@@ -322,10 +406,11 @@ NodeID parse_obj_decl(ParserState* self, ParseErrorCallback report_diag) {
     the_decl->bits.obj_decl.body = body_index;
     the_decl->end = context_get_nodeptr(self->context, body_index)->end;
   } else {
-    size_t end = next ? next->start : strlen(self->context->source);
-    the_decl->bits.obj_decl.body = create_error_node(self->context, end, end);
+    size_t end = next ? next->start : self->context->source_length;
+    NodeID body_index = create_error_node(self->context, end, end);
+    the_decl->bits.obj_decl.body = body_index;
     the_decl->end = end;
-    ParseError error = { next->start, "expected type body" };
+    ParseError error = { end, "expected type body" };
     report_diag(error, self);
   }
 
@@ -336,7 +421,7 @@ NodeID parse_obj_decl(ParserState* self, ParseErrorCallback report_diag) {
 NodeID parse_decl(ParserState* self, ParseErrorCallback report_diag) {
   Token* head = peek(self);
   if (head == NULL) {
-    size_t loc = strlen(self->context->source);
+    size_t loc = self->context->source_length;
     ParseError error = { loc, "expected declaration" };
     report_diag(error, self);
     return create_error_node(self->context, loc, loc);
@@ -370,6 +455,13 @@ size_t parse_expr_list(ParserState* self, NodeID* items, ParseErrorCallback repo
     // Stop if we found the list terminator.
     if (next->kind == tk_r_paren) { break; }
 
+    // Bail out if there are too many items.
+    if (count == MAX_PARAM_COUNT) {
+      ParseError error = { next->start, "too many arguments" };
+      report_diag(error, self);
+      break;
+    }
+
     // Complain if there's a leading separator.
     if (next->kind == tk_comma) {
       ParseError error = { next->start, "expected expression" };
@@ -382,7 +474,6 @@ size_t parse_expr_list(ParserState* self, NodeID* items, ParseErrorCallback repo
     // Parse an item.
     items[count] = parse_expr(self, report_diag);
     count++;
-    assert(count <= MAX_PARAM_COUNT);
 
     // Parse a separator, unless we reached the terminator.
     next = peek(self);
@@ -401,7 +492,7 @@ size_t parse_expr_list(ParserState* self, NodeID* items, ParseErrorCallback repo
 NodeID parse_primary_expr(ParserState* self, ParseErrorCallback report_diag) {
   Token* head = consume(self);
   if (head == NULL) {
-    size_t loc = strlen(self->context->source);
+    size_t loc = self->context->source_length;
     ParseError error = { loc, "expected expression" };
     report_diag(error, self);
     return create_error_node(self->context, loc, loc);
@@ -436,10 +527,10 @@ NodeID parse_primary_expr(ParserState* self, ParseErrorCallback report_diag) {
 
     if (head->kind == tk_integer) {
       expr->kind = nk_integer_expr;
-      expr->bits.integer_expr = atoi(str);
+      node_set_integer_value(expr, atoi(str));
     } else {
       expr->kind = nk_float_expr;
-      expr->bits.float_expr = atof(str);
+      node_set_float_value(expr, atof(str));
     }
 
     return expr_index;
@@ -557,19 +648,15 @@ NodeID parse_post_expr(ParserState* self, ParseErrorCallback report_diag) {
       }
 
       // Create a new node.
+      uint32_t args = context_append_extra(self->context, argv, argc);
       NodeID expr_index = context_new_node(self->context);
       Node* expr = context_get_nodeptr(self->context, expr_index);
       expr->kind  = nk_apply_expr;
       expr->start = start;
       expr->end   = end;
       expr->bits.apply_expr.callee = subexpr_index;
-      expr->bits.apply_expr.argc = argc;
-      if (argc > 0) {
-        expr->bits.apply_expr.argv = malloc(argc * sizeof(NodeID));
-        memcpy(expr->bits.apply_expr.argv, argv, argc * sizeof(NodeID));
-      } else {
-        expr->bits.apply_expr.argv = NULL;
-      }
+      expr->bits.apply_expr.argc = (uint32_t)argc;
+      expr->bits.apply_expr.args = args;
 
       subexpr_index = expr_index;
       continue;
@@ -660,15 +747,26 @@ NodeID parse_expr(ParserState* self, ParseErrorCallback report_diag) {
 // MARK: Statements
 // ------------------------------------------------------------------------------------------------
 
-/// Parses a sequence of statements.
-size_t parse_stmt_list(ParserState* self,
-                       NodeID** stmtv,
-                       TokenKind terminator,
-                       ParseErrorCallback report_diag)
-{
-  NodeID* buffer = malloc(INITIAL_VEC_CAPACITY * sizeof(NodeID));
-  size_t count = 0;
-  size_t capacity = INITIAL_VEC_CAPACITY;
+/// Pushes a node index onto the parser's scratch stack.
+static void scratch_push(ParserState* self, NodeID index) {
+  if (self->scratch_count == self->scratch_capacity) {
+    size_t capacity = self->scratch_capacity;
+    NodeID* new_buffer = cocodol_alloc(ac_ast, capacity * 2 * sizeof(NodeID));
+    memcpy(new_buffer, self->scratch, self->scratch_count * sizeof(NodeID));
+    cocodol_free(ac_ast, self->scratch, capacity * sizeof(NodeID));
+    self->scratch = new_buffer;
+    self->scratch_capacity = capacity * 2;
+  }
+  self->scratch[self->scratch_count] = index;
+  self->scratch_count++;
+}
+
+/// Parses a sequence of statements, pushing their indices onto the parser's scratch stack.
+///
+/// The function returns the number of statements that have been parsed, which are at the top of
+/// the scratch stack. The caller is responsible for popping them.
+size_t parse_stmt_list(ParserState* self, TokenKind terminator, ParseErrorCallback report_diag) {
+  size_t base = self->scratch_count;
 
   // Parse the statements.
   Token* next;
@@ -682,18 +780,12 @@ size_t parse_stmt_list(ParserState* self,
     // Stop if we found the terminator.
     if (next->kind == terminator) { break; }
 
-    // Resize the statement buffer if necessary.
-    if (count == capacity) {
-      NodeID* new_buffer = malloc(capacity * 2 * sizeof(NodeID));
-      memcpy(new_buffer, buffer, count * sizeof(NodeID));
-      free(buffer);
-      buffer = new_buffer;
-    }
-
     // Parse a statement.
-    buffer[count] = parse_stmt(self, report_diag);
-    bool has_error = context_get_nodeptr(self->context, buffer[count])->kind == nk_error;
-    count++;
+    NodeID stmt_index = parse_stmt(self, report_diag);
+    bool has_error = context_get_nodeptr(self->context, stmt_index)->kind == nk_error;
+
+    // Push the statement onto the scratch stack, which may have been resized by nested lists.
+    scratch_push(self, stmt_index);
 
     // Upon failure, recover at the next statement delimiter.
     if (has_error) {
@@ -703,8 +795,7 @@ size_t parse_stmt_list(ParserState* self,
     }
   }
 
-  *stmtv = buffer;
-  return count;
+  return self->scratch_count - base;
 }
 
 NodeID parse_brace_stmt(ParserState* self, ParseErrorCallback report_diag) {
@@ -717,12 +808,12 @@ NodeID parse_brace_stmt(ParserState* self, ParseErrorCallback report_diag) {
   the_stmt->kind  = nk_brace_stmt;
   the_stmt->start = next->start;
   the_stmt->bits.brace_stmt.parent = self->scope;
-  the_stmt->bits.brace_stmt.last_decl = NULL;
+  the_stmt->bits.brace_stmt.last_decl = ~0;
   self->scope = stmt_index;
 
   // Parse the statements.
-  NodeID* buffer;
-  size_t count = parse_stmt_list(self, &buffer, tk_r_brace, report_diag);
+  size_t count = parse_stmt_list(self, tk_r_brace, report_diag);
+  NodeID* buffer = self->scratch + self->scratch_count - count;
 
   // Parse the closing brace.
   next = peek(self);
@@ -735,15 +826,17 @@ NodeID parse_brace_stmt(ParserState* self, ParseErrorCallback report_diag) {
     } else if (next) {
       the_stmt->end = next->start;
     } else {
-      the_stmt->end = strlen(self->context->source);
+      the_stmt->end = self->context->source_length;
     }
     ParseError error = { the_stmt->end, "missing closing brace" };
     report_diag(error, self);
   }
 
-  // Store the list of statements.
-  the_stmt->bits.brace_stmt.stmtc = count;
-  the_stmt->bits.brace_stmt.stmtv = buffer;
+  // Store the list of statements, popping it from the scratch stack.
+  uint32_t stmts = context_append_extra(self->context, buffer, count);
+  the_stmt->bits.brace_stmt.stmtc = (uint32_t)count;
+  the_stmt->bits.brace_stmt.stmts = stmts;
+  self->scratch_count -= count;
 
   self->scope = the_stmt->bits.brace_stmt.parent;
   return stmt_index;
@@ -761,7 +854,8 @@ NodeID parse_if_stmt(ParserState* self, ParseErrorCallback report_diag) {
   the_stmt->start = next->start;
 
   // Parse the condition.
-  the_stmt->bits.if_stmt.cond = parse_expr(self, report_diag);
+  NodeID cond_index = parse_expr(self, report_diag);
+  the_stmt->bits.if_stmt.cond = cond_index;
 
   // Parse the "then" branch.
   next = peek(self);
@@ -770,8 +864,9 @@ NodeID parse_if_stmt(ParserState* self, ParseErrorCallback report_diag) {
     the_stmt->bits.if_stmt.then_ = branch_index;
     the_stmt->end = context_get_nodeptr(self->context, branch_index)->end;
   } else {
-    size_t end = next ? next->start : strlen(self->context->source);
-    the_stmt->bits.if_stmt.then_ = create_error_node(self->context, end, end);
+    size_t end = next ? next->start : self->context->source_length;
+    NodeID branch_index = create_error_node(self->context, end, end);
+    the_stmt->bits.if_stmt.then_ = branch_index;
     the_stmt->end = end;
     ParseError error = { end, "expected '{' after 'if' condition" };
     report_diag(error, self);
@@ -803,7 +898,8 @@ NodeID parse_while_stmt(ParserState* self, ParseErrorCallback report_diag) {
   the_stmt->start = next->start;
 
   // Parse the condition.
-  the_stmt->bits.while_stmt.cond = parse_expr(self, report_diag);
+  NodeID cond_index = parse_expr(self, report_diag);
+  the_stmt->bits.while_stmt.cond = cond_index;
 
   // Parse the body of the statement.
   next = peek(self);
@@ -812,8 +908,9 @@ NodeID parse_while_stmt(ParserState* self, ParseErrorCallback report_diag) {
     the_stmt->bits.while_stmt.body = branch_index;
     the_stmt->end = context_get_nodeptr(self->context, branch_index)->end;
   } else {
-    size_t end = next ? next->start : strlen(self->context->source);
-    the_stmt->bits.while_stmt.body = create_error_node(self->context, end, end);
+    size_t end = next ? next->start : self->context->source_length;
+    NodeID branch_index = create_error_node(self->context, end, end);
+    the_stmt->bits.while_stmt.body = branch_index;
     the_stmt->end = end;
     ParseError error = { end, "expected '{' after 'while' condition" };
     report_diag(error, self);
@@ -873,7 +970,7 @@ NodeID parse_ret_stmt(ParserState* self, ParseErrorCallback report_diag) {
 NodeID parse_stmt(ParserState* self, ParseErrorCallback report_diag) {
   Token* next = peek(self);
   if (next == NULL) {
-    size_t loc = strlen(self->context->source);
+    size_t loc = self->context->source_length;
     ParseError error = { loc, "expected statement" };
     report_diag(error, self);
     return create_error_node(self->context, loc, loc);
@@ -912,45 +1009,38 @@ NodeID parse_stmt(ParserState* self, ParseErrorCallback report_diag) {
 // ------------------------------------------------------------------------------------------------
 
 NodeID create_top_decl(Context* context, NodeID* stmtv, size_t start, size_t end) {
-  size_t byte_count = (end - start) * sizeof(NodeID);
-  NodeID* buffer = malloc(byte_count);
-  memcpy(buffer, stmtv + start, byte_count);
+  uint32_t stmts = context_append_extra(context, stmtv + start, end - start);
 
+  // The statements may have pending shifts if they are reused by an incremental reparse.
   NodeID decl_index = context_new_node(context);
   Node* decl = context_get_nodeptr(context, decl_index);
   decl->kind  = nk_top_decl;
-  decl->start = context_get_nodeptr(context, stmtv[start])->start;
-  decl->end   = context_get_nodeptr(context, stmtv[end - 1])->end;
-  decl->bits.top_decl.stmtc = end - start;
-  decl->bits.top_decl.stmtv = buffer;
+  decl->start = context_get_nodeptr(context, stmtv[start])->start
+    + context_get_pending_shift(context, stmtv[start]);
+  decl->end   = context_get_nodeptr(context, stmtv[end - 1])->end
+    + context_get_pending_shift(context, stmtv[end - 1]);
+  decl->bits.top_decl.stmtc = (uint32_t)(end - start);
+  decl->bits.top_decl.stmts = stmts;
 
   return decl_index;
 }
 
-NodeID parse(ParserState* self, NodeID** declv, ParseErrorCallback report_diag) {
-  // Parse a sequence of "top-level" nodes.
-  NodeID* stmtv;
-  size_t stmtc = parse_stmt_list(self, &stmtv, tk_eof, report_diag);
-  if (stmtc == 0) {
-    *declv = NULL;
-    return 0;
-  }
-
-  // Allocate the return buffer.
-  *declv = malloc(stmtc * sizeof(NodeID));
+/// Gathers consecutive expressions and statements of the given top-level nodes into top-level
+/// declarations, writing the resulting declarations into `declv` and returning their number.
+///
+/// `declv` must be large enough to hold `stmtc` declarations.
+static size_t group_top_decls(Context* context, NodeID* stmtv, size_t stmtc, NodeID* declv) {
   size_t count = 0;
-
-  // Gather consecutive expressions and statements nodes into top-level declarations.
   size_t start = 0;
   for (size_t i = 0; i < stmtc; ++i) {
-    if ((context_get_nodeptr(self->context, stmtv[i])->kind & NODE_DECL_BIT) == NODE_DECL_BIT) {
+    if ((context_get_nodeptr(context, stmtv[i])->kind & NODE_DECL_BIT) == NODE_DECL_BIT) {
       // Wrap previous exprs and stmts into a top-level decl.
       if (start < i) {
-        (*declv)[count] = create_top_decl(self->context, stmtv, start, i);
+        declv[count] = create_top_decl(context, stmtv, start, i);
         count++;
       }
 
-      (*declv)[count] = stmtv[i];
+      declv[count] = stmtv[i];
       count++;
       start = i + 1;
     }
@@ -958,9 +1048,1001 @@ NodeID parse(ParserState* self, NodeID** declv, ParseErrorCallback report_diag)
 
   // Wrap the remaining non-declaration nodes, if necessary.
   if (start < stmtc) {
-    (*declv)[count] = create_top_decl(self->context, stmtv, start, stmtc);
+    declv[count] = create_top_decl(context, stmtv, start, stmtc);
     count++;
   }
 
   return count;
 }
+
+size_t parse(ParserState* self, NodeID** declv, ParseErrorCallback report_diag) {
+  // Make sure the source's offsets can be represented.
+  if (self->context->source_length > UINT32_MAX) {
+    ParseError error = { 0, "source file too large" };
+    report_diag(error, self);
+    *declv = NULL;
+    return 0;
+  }
+
+  // Parse a sequence of "top-level" nodes.
+  size_t stmtc = parse_stmt_list(self, tk_eof, report_diag);
+  NodeID* stmtv = self->scratch + self->scratch_count - stmtc;
+  if (stmtc == 0) {
+    *declv = NULL;
+    return 0;
+  }
+
+  // Allocate the return buffer.
+  *declv = malloc(stmtc * sizeof(NodeID));
+  size_t count = group_top_decls(self->context, stmtv, stmtc, *declv);
+
+  self->scratch_count -= stmtc;
+  return count;
+}
+
+// ------------------------------------------------------------------------------------------------
+// MARK: Parallel parsing
+// ------------------------------------------------------------------------------------------------
+
+/// A range of tokens that is parsed independently from the others, and the result of its parsing.
+typedef struct ParseChunk {
+
+  /// The position of the chunk's first token.
+  size_t begin;
+
+  /// The position past the chunk's last token.
+  size_t end;
+
+  /// The context in which the chunk is parsed.
+  Context* context;
+
+  /// The top-level declarations of the chunk, indexed in `context`.
+  NodeID* declv;
+
+  /// The number of top-level declarations in the chunk.
+  size_t declc;
+
+  /// The offset by which the chunk's node indices are shifted when it is merged.
+  NodeID offset;
+
+  /// The offset by which the chunk's extra data positions are shifted when it is merged.
+  uint32_t extra_offset;
+
+} ParseChunk;
+
+/// The state shared by the threads of a parallel parse.
+typedef struct ParallelParse {
+
+  /// The context into which the chunks are merged.
+  Context* context;
+
+  /// The tokens being parsed.
+  TokenBuffer* tokens;
+
+  /// The chunks to parse.
+  ParseChunk* chunks;
+
+  /// The number of chunks to parse.
+  size_t chunk_count;
+
+  /// The index of the next chunk to process.
+  size_t next_chunk;
+
+  /// A flag indicating whether a diagnostic has been reported in any chunk.
+  bool failed;
+
+} ParallelParse;
+
+/// Splits the tokens in the range [begin, end) into at most `max` chunks of about `target` tokens,
+/// writing the position of each chunk's first token into `bounds` and returning their number.
+///
+/// Chunks start with declarations that occur outside of any brace or parenthesis, where a serial
+/// parser would start a new top-level statement.
+static size_t split_tokens(const TokenBuffer* tokens,
+                           size_t begin,
+                           size_t end,
+                           size_t target,
+                           size_t* bounds,
+                           size_t max)
+{
+  size_t count = 0;
+  bounds[count++] = begin;
+
+  size_t depth = 0;
+  size_t next_bound = begin + target;
+  for (size_t i = begin; (i < end) && (count < max); ++i) {
+    switch (tokens->kinds[i]) {
+      case token_kind_code(tk_l_brace):
+      case token_kind_code(tk_l_paren):
+        depth++;
+        break;
+
+      case token_kind_code(tk_r_brace):
+      case token_kind_code(tk_r_paren):
+        if (depth > 0) { depth--; }
+        break;
+
+      case token_kind_code(tk_var):
+      case token_kind_code(tk_fun):
+      case token_kind_code(tk_obj):
+        if ((depth == 0) && (i >= next_bound)) {
+          bounds[count++] = i;
+          next_bound = i + target;
+        }
+        break;
+
+      case token_kind_code(tk_eof):
+        // The parser stops at the first end-of-file token, so the remainder can't be split.
+        return count;
+
+      default:
+        break;
+    }
+  }
+
+  return count;
+}
+
+/// Notes that a diagnostic has been reported in a chunk.
+static void note_chunk_diagnostic(ParseError error, const ParserState* state) {
+  ParallelParse* job = state->user_data;
+  __atomic_store_n(&job->failed, true, __ATOMIC_RELAXED);
+}
+
+/// Parses chunks until all of them have been claimed, or until a diagnostic has been reported.
+static void* parse_chunks(void* user_data) {
+  ParallelParse* job = user_data;
+  while (!__atomic_load_n(&job->failed, __ATOMIC_RELAXED)) {
+    size_t i = __atomic_fetch_add(&job->next_chunk, 1, __ATOMIC_RELAXED);
+    if (i >= job->chunk_count) { break; }
+
+    ParseChunk* chunk = job->chunks + i;
+    ParserState parser;
+    parser_init_slice(&parser, chunk->context, job->tokens, chunk->begin, chunk->end, job);
+    chunk->declc = parse(&parser, &chunk->declv, note_chunk_diagnostic);
+    parser_deinit(&parser);
+  }
+  return NULL;
+}
+
+/// Relocates the nodes of each chunk to their final indices in the merged context, until all
+/// chunks have been claimed.
+///
+/// The nodes are relocated in place. Their segments are adopted by the merged context afterward.
+static void* relocate_chunks(void* user_data) {
+  ParallelParse* job = user_data;
+  while (true) {
+    size_t i = __atomic_fetch_add(&job->next_chunk, 1, __ATOMIC_RELAXED);
+    if (i >= job->chunk_count) { break; }
+
+    ParseChunk* chunk = job->chunks + i;
+    if (chunk->context == job->context) { continue; }
+
+    for (size_t j = 0; j < chunk->context->node_count; ++j) {
+      Node* node = context_get_nodeptr(chunk->context, (NodeID)j);
+      node_relocate(node, chunk->context, chunk->offset, chunk->extra_offset);
+    }
+    for (size_t j = 0; j < chunk->declc; ++j) {
+      chunk->declv[j] += chunk->offset;
+    }
+  }
+  return NULL;
+}
+
+/// Runs `work` on `thread_count` threads, including the current one, and waits for all of them
+/// to complete.
+static void run_workers(ParallelParse* job, size_t thread_count, void* (*work)(void*)) {
+  job->next_chunk = 0;
+
+  pthread_t* threads = malloc((thread_count - 1) * sizeof(pthread_t));
+  size_t started = 0;
+  while (started < thread_count - 1) {
+    if (pthread_create(threads + started, NULL, work, job) != 0) { break; }
+    started++;
+  }
+  work(job);
+  for (size_t i = 0; i < started; ++i) {
+    pthread_join(threads[i], NULL);
+  }
+  free(threads);
+}
+
+size_t parse_parallel(ParserState* self,
+                      NodeID** declv,
+                      size_t thread_count,
+                      ParseErrorCallback report_diag)
+{
+  if ((self->tokens == NULL) || (thread_count < 2)) {
+    return parse(self, declv, report_diag);
+  }
+
+  // Split the input into chunks.
+  size_t max_chunk_count = thread_count * CHUNKS_PER_THREAD;
+  size_t target = (self->token_limit - self->token_index) / max_chunk_count;
+  if (target < MIN_CHUNK_TOKEN_COUNT) { target = MIN_CHUNK_TOKEN_COUNT; }
+
+  size_t* bounds = malloc((max_chunk_count + 1) * sizeof(size_t));
+  size_t chunk_count = split_tokens(
+    self->tokens, self->token_index, self->token_limit, target, bounds, max_chunk_count);
+  if (chunk_count < 2) {
+    free(bounds);
+    return parse(self, declv, report_diag);
+  }
+  bounds[chunk_count] = self->token_limit;
+
+  // The first chunk is parsed directly in the parser's context, so that its nodes don't have to
+  // be moved. The others are parsed in contexts of their own.
+  ParseChunk* chunks = malloc(chunk_count * sizeof(ParseChunk));
+  Context* contexts = malloc(chunk_count * sizeof(Context));
+  size_t initial_node_count = self->context->node_count;
+  size_t initial_extra_count = self->context->extra_count;
+  for (size_t i = 0; i < chunk_count; ++i) {
+    chunks[i].begin = bounds[i];
+    chunks[i].end = bounds[i + 1];
+    chunks[i].context = (i == 0) ? self->context : contexts + i;
+    if (i > 0) { context_init(contexts + i, self->context->source, self->context->source_length); }
+    chunks[i].declv = NULL;
+    chunks[i].declc = 0;
+    chunks[i].offset = 0;
+    chunks[i].extra_offset = 0;
+  }
+  free(bounds);
+
+  // Parse the chunks.
+  ParallelParse job = { self->context, self->tokens, chunks, chunk_count, 0, false };
+  if (thread_count > chunk_count) { thread_count = chunk_count; }
+  run_workers(&job, thread_count, parse_chunks);
+
+  // Merge the chunks into the parser's context, in order.
+  size_t count = 0;
+  if (!job.failed) {
+    // Each chunk's segments are appended at the next segment boundaries (see `context_adopt`).
+    size_t node_count = self->context->node_count;
+    size_t extra_count = self->context->extra_count;
+    size_t total = chunks[0].declc;
+    for (size_t i = 1; i < chunk_count; ++i) {
+      chunks[i].offset = (NodeID)node_segment_align(node_count);
+      chunks[i].extra_offset = (uint32_t)extra_segment_align(extra_count);
+      node_count = chunks[i].offset + chunks[i].context->node_count;
+      extra_count = chunks[i].extra_offset + chunks[i].context->extra_count;
+      total += chunks[i].declc;
+    }
+    assert((node_count <= UINT32_MAX) && (extra_count <= UINT32_MAX));
+
+    run_workers(&job, thread_count, relocate_chunks);
+    for (size_t i = 1; i < chunk_count; ++i) {
+      context_adopt(self->context, chunks[i].context);
+    }
+
+    *declv = (total > 0) ? malloc(total * sizeof(NodeID)) : NULL;
+    for (size_t i = 0; i < chunk_count; ++i) {
+      memcpy(*declv + count, chunks[i].declv, chunks[i].declc * sizeof(NodeID));
+      count += chunks[i].declc;
+    }
+    self->token_index = self->token_limit;
+  }
+
+  for (size_t i = 0; i < chunk_count; ++i) {
+    free(chunks[i].declv);
+    if (i > 0) { context_deinit(contexts + i); }
+  }
+  free(contexts);
+  free(chunks);
+
+  // Parse the input again if a diagnostic has been reported, so that all diagnostics are reported
+  // in the same order as they would have been by a serial parse. The nodes of the first chunk are
+  // discarded beforehand.
+  if (job.failed) {
+    self->context->node_count = initial_node_count;
+    self->context->extra_count = initial_extra_count;
+    return parse(self, declv, report_diag);
+  }
+  return count;
+}
+
+// ------------------------------------------------------------------------------------------------
+// MARK: Streaming
+// ------------------------------------------------------------------------------------------------
+
+/// The state of the scan that looks for the boundaries of complete top-level declarations in a
+/// token stream.
+typedef struct BoundaryScan {
+
+  /// The position of the next token to scan.
+  size_t index;
+
+  /// The current nesting depth of braces and parentheses.
+  size_t depth;
+
+  /// A flag indicating whether the current top-level declaration ends with its body.
+  bool ends_with_body;
+
+} BoundaryScan;
+
+/// Scans the tokens that have been added to the buffer since the last call, up to the first
+/// top-level declaration boundary after `boundary`, and returns the position of that boundary, or
+/// `boundary` if none was found.
+static size_t scan_boundaries(BoundaryScan* self, const TokenBuffer* tokens, size_t boundary) {
+  size_t start = boundary;
+  for (; (self->index < tokens->count) && (boundary == start); ++self->index) {
+    switch (tokens->kinds[self->index]) {
+      case token_kind_code(tk_l_brace):
+      case token_kind_code(tk_l_paren):
+        self->depth++;
+        break;
+
+      case token_kind_code(tk_r_brace):
+        if (self->depth > 0) { self->depth--; }
+        if ((self->depth == 0) && self->ends_with_body) {
+          boundary = self->index + 1;
+          self->ends_with_body = false;
+        }
+        break;
+
+      case token_kind_code(tk_r_paren):
+        if (self->depth > 0) { self->depth--; }
+        break;
+
+      case token_kind_code(tk_var):
+      case token_kind_code(tk_fun):
+      case token_kind_code(tk_obj):
+        if (self->depth == 0) {
+          boundary = self->index;
+          self->ends_with_body = (tokens->kinds[self->index] != token_kind_code(tk_var));
+        }
+        break;
+
+      default:
+        break;
+    }
+  }
+
+  return boundary;
+}
+
+bool parse_stream(Context* context,
+                  SourceStream* stream,
+                  void* user_data,
+                  ParseErrorCallback report_diag,
+                  ParseDeclsCallback handle_decls)
+{
+  assert(context->source == stream->text);
+
+  TokenBuffer tokens;
+  token_buffer_init_empty(&tokens, stream->text, &context->interner);
+
+  BoundaryScan scan = { 0, 0, false };
+  size_t lexed = 0;
+  size_t parsed = 0;
+
+  bool is_final = false;
+  while (!is_final) {
+    is_final = !source_stream_read(stream);
+    context->source_length = stream->length;
+
+    // Tokenize the new input and parse the declarations that are complete, one boundary at a
+    // time, so that they are handled in the same batches however the input was split.
+    lexed = token_buffer_append(&tokens, lexed, stream->length, is_final);
+    while (parsed < tokens.count) {
+      size_t boundary = scan_boundaries(&scan, &tokens, parsed);
+      if (boundary == parsed) {
+        if (!is_final) { break; }
+        boundary = tokens.count;
+      }
+
+      ParserState parser;
+      parser_init_slice(&parser, context, &tokens, parsed, boundary, user_data);
+      NodeID* declv;
+      size_t declc = parse(&parser, &declv, report_diag);
+      parser_deinit(&parser);
+      parsed = boundary;
+
+      if (declc > 0) {
+        handle_decls(declv, declc, user_data);
+        free(declv);
+      }
+    }
+  }
+
+  token_buffer_deinit(&tokens);
+  return stream->error == 0;
+}
+
+// ------------------------------------------------------------------------------------------------
+// MARK: Incremental parsing
+// ------------------------------------------------------------------------------------------------
+
+/// The maximum number of nested brace statements that are considered for an incremental reparse.
+#define MAX_REPARSE_DEPTH 16
+
+/// A brace statement that encloses an edit, and that may be reparsed on its own.
+typedef struct ReparseCandidate {
+
+  /// The index of the brace statement.
+  NodeID brace;
+
+  /// The location of the reference to the brace statement in its parent.
+  NodeID* slot;
+
+} ReparseCandidate;
+
+static bool delete_visit(NodeID index, NodeKind kind, bool is_entering, void* user) {
+  if (!is_entering) { context_delete_node(user, index); }
+  return true;
+}
+
+/// Returns the start of a top-level declaration or statement, whose shifts may be pending.
+static inline uint32_t top_level_start(Context* context, NodeID index) {
+  return context_get_nodeptr(context, index)->start + context_get_pending_shift(context, index);
+}
+
+/// Returns the end of a top-level declaration or statement, whose shifts may be pending.
+static inline uint32_t top_level_end(Context* context, NodeID index) {
+  return context_get_nodeptr(context, index)->end + context_get_pending_shift(context, index);
+}
+
+/// Returns the position of the first token of a top-level node, applying its pending shift.
+///
+/// The position of the first token of a top-level declaration is that of its first statement.
+static size_t first_token_start(Context* context, NodeID index) {
+  Node* node = context_get_nodeptr(context, index);
+  if (node->kind == nk_top_decl) {
+    index = *context_get_extra(context, node->bits.top_decl.stmts);
+  }
+  return (uint32_t)(context_get_first_offset(context, index)
+                    + context_get_pending_shift(context, index));
+}
+
+/// A position in the sequence of top-level statements of a program, which consists of its
+/// declarations and of the statements of its top-level declarations.
+typedef struct TopLevelCursor {
+
+  /// The index of the top-level declaration.
+  size_t decl;
+
+  /// The index of the statement in the top-level declaration, or 0 if the declaration is not a
+  /// top-level declaration.
+  size_t stmt;
+
+} TopLevelCursor;
+
+/// Returns whether the given node is a top-level declaration.
+static inline bool is_top_decl(Context* context, NodeID index) {
+  return context_get_nodeptr(context, index)->kind == nk_top_decl;
+}
+
+/// Returns the top-level statement at the given position, which must be valid.
+static NodeID top_level_stmt(Context* context, const NodeID* declv, TopLevelCursor cursor) {
+  Node* decl = context_get_nodeptr(context, declv[cursor.decl]);
+  return (decl->kind == nk_top_decl)
+    ? *context_get_extra(context, decl->bits.top_decl.stmts + cursor.stmt)
+    : declv[cursor.decl];
+}
+
+/// Moves a cursor to the next top-level statement.
+static void top_level_next(Context* context, const NodeID* declv, TopLevelCursor* cursor) {
+  Node* decl = context_get_nodeptr(context, declv[cursor->decl]);
+  if ((decl->kind == nk_top_decl) && (cursor->stmt + 1 < decl->bits.top_decl.stmtc)) {
+    cursor->stmt++;
+  } else {
+    cursor->decl++;
+    cursor->stmt = 0;
+  }
+}
+
+/// Returns whether a brace statement ends with its own closing brace.
+static bool brace_is_closed(Context* context, const Node* brace) {
+  if (context->source[brace->end - 1] != '}') { return false; }
+
+  // If the brace is not closed, it ends with its last statement.
+  size_t stmtc = brace->bits.brace_stmt.stmtc;
+  if (stmtc == 0) { return true; }
+  NodeID last = *context_get_extra(context, brace->bits.brace_stmt.stmts + stmtc - 1);
+  return context_get_nodeptr(context, last)->end < brace->end;
+}
+
+/// Returns whether a brace statement is closed and strictly encloses the given edit, so that
+/// neither of its braces is edited.
+static bool brace_encloses(Context* context, const Node* brace, SourceEdit edit) {
+  return (brace->start < edit.start) && (edit.end < brace->end) && brace_is_closed(context, brace);
+}
+
+/// Returns the location of the last statement of the given list that starts before `position`,
+/// or `NULL` if there is no such statement.
+static NodeID* stmt_before(Context* context, uint32_t stmts, size_t stmtc, size_t position) {
+  size_t lo = 0;
+  size_t hi = stmtc;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    NodeID stmt = *context_get_extra(context, stmts + (uint32_t)mid);
+    if (top_level_start(context, stmt) <= position) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return (lo > 0) ? context_get_extra(context, stmts + (uint32_t)(lo - 1)) : NULL;
+}
+
+/// Collects the brace statements enclosing an edit in the given top-level declaration, from the
+/// outermost to the innermost, and returns their number.
+///
+/// Only the innermost `MAX_REPARSE_DEPTH` brace statements are kept. The captures of the function
+/// declarations that enclose the edit are invalidated, as they depend on the edited bodies. The
+/// top-level statement that encloses the edit is settled.
+static size_t find_reparse_candidates(Context* context,
+                                      NodeID decl,
+                                      SourceEdit edit,
+                                      ReparseCandidate* candidates)
+{
+  size_t count = 0;
+  NodeID index = decl;
+  NodeID* slot = NULL;
+  context_settle_root(context, decl);
+  while (true) {
+    Node* node = context_get_nodeptr(context, index);
+    switch (node->kind) {
+      case nk_top_decl:
+        slot = stmt_before(context, node->bits.top_decl.stmts, node->bits.top_decl.stmtc,
+                           edit.start);
+        if (slot != NULL) { context_settle_root(context, *slot); }
+        break;
+
+      case nk_fun_decl: {
+        uint32_t* params = context_get_extra(context, node->bits.fun_decl.params);
+        if (params[2] != UNRESOLVED_CAPTURES) {
+          context_free_extra(context, params[2], params[1] * PARAM_WORD_COUNT);
+          params[2] = UNRESOLVED_CAPTURES;
+        }
+        slot = &node->bits.fun_decl.body;
+        break;
+      }
+
+      case nk_obj_decl:
+        slot = &node->bits.obj_decl.body;
+        break;
+
+      case nk_while_stmt:
+        slot = &node->bits.while_stmt.body;
+        break;
+
+      case nk_if_stmt:
+        if (edit.start < context_get_nodeptr(context, node->bits.if_stmt.then_)->end) {
+          slot = &node->bits.if_stmt.then_;
+        } else if (node->bits.if_stmt.else_ != (NodeID)~0) {
+          slot = &node->bits.if_stmt.else_;
+        } else {
+          slot = NULL;
+        }
+        break;
+
+      case nk_brace_stmt:
+        if (!brace_encloses(context, node, edit)) { return count; }
+
+        // Record the brace statement, dropping the outermost one if there are too many.
+        if (count == MAX_REPARSE_DEPTH) {
+          memmove(candidates, candidates + 1, (count - 1) * sizeof(ReparseCandidate));
+          count--;
+        }
+        candidates[count].brace = index;
+        candidates[count].slot = slot;
+        count++;
+
+        slot = stmt_before(context, node->bits.brace_stmt.stmts, node->bits.brace_stmt.stmtc,
+                           edit.start);
+        break;
+
+      default:
+        return count;
+    }
+
+    if (slot == NULL) { return count; }
+    index = *slot;
+  }
+}
+
+/// Reparses a brace statement of the edited source, which replaced the range [start, end).
+///
+/// The function returns the index of the new brace statement if the range still parses as a single
+/// brace statement that is closed by the last token of the range. Otherwise, it deletes the nodes
+/// that have been parsed and returns `~0`.
+static NodeID reparse_brace_stmt(Context* context,
+                                 size_t start,
+                                 size_t end,
+                                 NodeID scope,
+                                 void* user_data,
+                                 ParseErrorCallback report_diag)
+{
+  // Tokenize the range, i.e., the tokens that end before `end + 1`.
+  TokenBuffer tokens;
+  token_buffer_init_empty(&tokens, context->source, &context->interner);
+  token_buffer_append(&tokens, start, end + 1, false);
+
+  NodeID result = ~0;
+  size_t count = tokens.count;
+  if ((count > 1) &&
+      (token_buffer_kind(&tokens, count - 1) == tk_r_brace) &&
+      (tokens.starts[count - 1] == end - 1))
+  {
+    ParserState parser;
+    parser_init_slice(&parser, context, &tokens, 0, count, user_data);
+    parser.scope = scope;
+    result = parse_brace_stmt(&parser, report_diag);
+    Node* brace = context_get_nodeptr(context, result);
+    bool is_valid = (parser.token_index == count) && (brace->end == end) &&
+      brace_is_closed(context, brace);
+    parser_deinit(&parser);
+
+    if (!is_valid) {
+      node_walk(result, context, context, delete_visit);
+      result = ~0;
+    }
+  }
+
+  token_buffer_deinit(&tokens);
+  return result;
+}
+
+/// Returns whether two cursors denote the same top-level statement.
+static inline bool top_level_equal(TopLevelCursor lhs, TopLevelCursor rhs) {
+  return (lhs.decl == rhs.decl) && (lhs.stmt == rhs.stmt);
+}
+
+/// Returns the number of top-level statements in the given list whose first token starts before
+/// `position`.
+static size_t count_stmts_before(Context* context, uint32_t stmts, size_t stmtc, size_t position) {
+  size_t lo = 0;
+  size_t hi = stmtc;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (first_token_start(context, *context_get_extra(context, stmts + (uint32_t)mid)) < position) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+/// Returns the position of the first top-level statement whose first token starts at or after
+/// `position`, or the end position (i.e., `{ declc, 0 }`) if there is no such statement.
+static TopLevelCursor top_level_find(Context* context,
+                                     const NodeID* declv,
+                                     size_t declc,
+                                     size_t position)
+{
+  size_t lo = 0;
+  size_t hi = declc;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (first_token_start(context, declv[mid]) < position) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  if ((lo > 0) && is_top_decl(context, declv[lo - 1])) {
+    Node* decl = context_get_nodeptr(context, declv[lo - 1]);
+    size_t stmt = count_stmts_before(
+      context, decl->bits.top_decl.stmts, decl->bits.top_decl.stmtc, position);
+    if (stmt < decl->bits.top_decl.stmtc) { return (TopLevelCursor){ lo - 1, stmt }; }
+  }
+  return (TopLevelCursor){ lo, 0 };
+}
+
+/// Returns the number of top-level nodes in the given list that end before `position`.
+static size_t count_ending_before(Context* context,
+                                  const NodeID* nodes,
+                                  size_t count,
+                                  size_t position)
+{
+  size_t lo = 0;
+  size_t hi = count;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (top_level_end(context, nodes[mid]) < position) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+/// Shifts the offsets of the top-level declarations and statements that end at or after `from`.
+///
+/// The shifts of the nodes that follow `from` are only recorded, so that the cost of an edit does
+/// not depend on the size of the program that follows it. The nodes that enclose `from` are shifted
+/// right away, as only part of them moves.
+static void shift_top_level(Context* context,
+                            const NodeID* declv,
+                            size_t declc,
+                            uint32_t from,
+                            int64_t delta)
+{
+  if (delta == 0) { return; }
+
+  // A top-level declaration encloses `from` if it starts before it, whereas a statement does if
+  // its first token does (e.g., a binary expression starts at its operator).
+  NodeID enclosing[2];
+  size_t enclosing_count = 0;
+  size_t i = count_ending_before(context, declv, declc, from);
+  if (i < declc) {
+    Node* decl = context_get_nodeptr(context, declv[i]);
+    if (decl->kind == nk_top_decl) {
+      const NodeID* stmtv = context_get_extra(context, decl->bits.top_decl.stmts);
+      size_t stmtc = decl->bits.top_decl.stmtc;
+      size_t j = count_ending_before(context, stmtv, stmtc, from);
+      if ((j < stmtc) && (first_token_start(context, stmtv[j]) < from)) {
+        enclosing[enclosing_count++] = stmtv[j];
+      }
+      if (top_level_start(context, declv[i]) < from) {
+        enclosing[enclosing_count++] = declv[i];
+      }
+    } else if (first_token_start(context, declv[i]) < from) {
+      enclosing[enclosing_count++] = declv[i];
+    }
+  }
+
+  context_log_shift(context, from, delta);
+  for (size_t k = 0; k < enclosing_count; ++k) {
+    context_shift_root(context, enclosing[k], from, delta);
+  }
+}
+
+/// Tracks the top-level declarations in the given range and their statements as top-level nodes.
+static void track_top_level(Context* context, const NodeID* declv, size_t start, size_t end) {
+  for (size_t i = start; i < end; ++i) {
+    context_track_root(context, declv[i]);
+    Node* decl = context_get_nodeptr(context, declv[i]);
+    if (decl->kind == nk_top_decl) {
+      const NodeID* stmtv = context_get_extra(context, decl->bits.top_decl.stmts);
+      for (size_t j = 0; j < decl->bits.top_decl.stmtc; ++j) {
+        context_track_root(context, stmtv[j]);
+      }
+    }
+  }
+}
+
+/// Reparses the top-level statements around an edit, as described by `reparse`.
+///
+/// The nodes must have been shifted already. `resume` is the position of the first top-level
+/// statement that started after the edit in the old source.
+static size_t reparse_top_level(Context* context,
+                                const char* old_source,
+                                SourceEdit edit,
+                                TopLevelCursor resume,
+                                NodeID** declv,
+                                size_t declc,
+                                void* user_data,
+                                ParseErrorCallback report_diag)
+{
+  NodeID* decls = *declv;
+
+  // Find the last top-level statement whose first token precedes the edit.
+  size_t lo = 0;
+  size_t hi = declc;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (first_token_start(context, decls[mid]) < edit.start) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  TopLevelCursor first = { 0, 0 };
+  bool from_start = (lo == 0);
+  if (!from_start) {
+    first.decl = lo - 1;
+    Node* decl = context_get_nodeptr(context, decls[first.decl]);
+    if (decl->kind == nk_top_decl) {
+      first.stmt = count_stmts_before(
+        context, decl->bits.top_decl.stmts, decl->bits.top_decl.stmtc, edit.start) - 1;
+    }
+
+    // Start at the previous statement if the edit touches the first token of this one, which the
+    // parser may have peeked at to determine where the previous statement ends.
+    LexerState lexer;
+    Token token;
+    lexer_init(&lexer, old_source, NULL);
+    lexer.index = first_token_start(context, top_level_stmt(context, decls, first));
+    bool is_touched = !lexer_next(&lexer, &token) || (edit.start <= token.end);
+    lexer_deinit(&lexer);
+
+    if (is_touched) {
+      if (first.stmt > 0) {
+        first.stmt--;
+      } else if (first.decl > 0) {
+        first.decl--;
+        Node* prev = context_get_nodeptr(context, decls[first.decl]);
+        first.stmt = (prev->kind == nk_top_decl) ? prev->bits.top_decl.stmtc - 1 : 0;
+      } else {
+        from_start = true;
+      }
+    }
+  }
+
+  // Parse statements until the parser reaches the first token of a statement that followed the
+  // edit, from which it would parse the same statements as before.
+  ParserState parser;
+  parser_init(&parser, context, user_data);
+  parser.lexer.index = from_start
+    ? 0
+    : first_token_start(context, top_level_stmt(context, decls, first));
+
+  TopLevelCursor last = resume;
+  bool is_synchronized = false;
+  Token* next;
+  while ((next = peek(&parser))) {
+    // Skip any number of leading semicolons.
+    if (next->kind == tk_semicolon) {
+      consume(&parser);
+      continue;
+    }
+
+    // Stop if we found the end of the input.
+    if (next->kind == tk_eof) { break; }
+
+    // Stop if we reached the first token of a statement that followed the edit.
+    if (next->start >= edit.start + edit.length) {
+      for (; last.decl < declc; top_level_next(context, decls, &last)) {
+        size_t start = first_token_start(context, top_level_stmt(context, decls, last));
+        if (start >= next->start) {
+          is_synchronized = start == next->start;
+          break;
+        }
+      }
+      if (is_synchronized) { break; }
+    }
+
+    // Parse a statement.
+    NodeID stmt_index = parse_stmt(&parser, report_diag);
+    bool has_error = context_get_nodeptr(context, stmt_index)->kind == nk_error;
+    scratch_push(&parser, stmt_index);
+
+    // Upon failure, recover at the next statement delimiter.
+    if (has_error) {
+      while((next = peek(&parser)) && !is_stmt_delimiter(next, context, tk_eof)) {
+        consume(&parser);
+      }
+    }
+  }
+
+  // All remaining statements are replaced if the parser didn't synchronize.
+  if (!is_synchronized) {
+    last = (TopLevelCursor){ declc, 0 };
+  }
+
+  // Determine the range of declarations to regroup, extending it to the adjacent top-level
+  // declarations so that consecutive statements are gathered as they would be by `parse`.
+  size_t decl_start = first.decl;
+  size_t decl_end = ((last.stmt > 0) && (last.decl < declc)) ? last.decl + 1 : last.decl;
+  if ((decl_start > 0) && is_top_decl(context, decls[decl_start - 1])) { decl_start--; }
+  if ((decl_end < declc) && is_top_decl(context, decls[decl_end])) { decl_end++; }
+
+  // Gather the statements of the regrouped range, replacing the reparsed ones.
+  size_t stmtc = parser.scratch_count;
+  TopLevelCursor it;
+  for (size_t i = decl_start; i < decl_end; ++i) {
+    Node* decl = context_get_nodeptr(context, decls[i]);
+    stmtc += (decl->kind == nk_top_decl) ? decl->bits.top_decl.stmtc : 1;
+  }
+  NodeID* stmtv = malloc(stmtc * sizeof(NodeID));
+  stmtc = 0;
+
+  it = (TopLevelCursor){ decl_start, 0 };
+  for (; !top_level_equal(it, first); top_level_next(context, decls, &it)) {
+    stmtv[stmtc++] = top_level_stmt(context, decls, it);
+  }
+  for (; !top_level_equal(it, last); top_level_next(context, decls, &it)) {
+    node_walk(top_level_stmt(context, decls, it), context, context, delete_visit);
+  }
+  memcpy(stmtv + stmtc, parser.scratch, parser.scratch_count * sizeof(NodeID));
+  stmtc += parser.scratch_count;
+  for (; it.decl < decl_end; top_level_next(context, decls, &it)) {
+    stmtv[stmtc++] = top_level_stmt(context, decls, it);
+  }
+  parser_deinit(&parser);
+
+  // Delete the regrouped top-level declarations, whose statements have been gathered.
+  for (size_t i = decl_start; i < decl_end; ++i) {
+    if (is_top_decl(context, decls[i])) { context_delete_node(context, decls[i]); }
+  }
+
+  // Regroup the statements and splice the resulting declarations.
+  size_t suffix = declc - decl_end;
+  NodeID* result = malloc((decl_start + stmtc + suffix) * sizeof(NodeID));
+  memcpy(result, decls, decl_start * sizeof(NodeID));
+  size_t count = decl_start + group_top_decls(context, stmtv, stmtc, result + decl_start);
+  track_top_level(context, result, decl_start, count);
+  memcpy(result + count, decls + decl_end, suffix * sizeof(NodeID));
+  count += suffix;
+
+  free(stmtv);
+  free(decls);
+  *declv = result;
+  return count;
+}
+
+size_t reparse(Context* context,
+               const char* source,
+               size_t source_length,
+               SourceEdit edit,
+               NodeID** declv,
+               size_t declc,
+               void* user_data,
+               ParseErrorCallback report_diag)
+{
+  assert((edit.start <= edit.end) && (edit.end <= context->source_length));
+  assert(source_length == context->source_length - (edit.end - edit.start) + edit.length);
+  int64_t delta = (int64_t)edit.length - (int64_t)(edit.end - edit.start);
+
+  // Make sure the source's offsets can be represented.
+  if (source_length > UINT32_MAX) {
+    ParserState parser;
+    parser_init(&parser, context, user_data);
+    ParseError error = { 0, "source file too large" };
+    report_diag(error, &parser);
+    parser_deinit(&parser);
+    free(*declv);
+    *declv = NULL;
+    return 0;
+  }
+
+  // Track the offsets of the top-level nodes, which are shifted lazily.
+  if (context->root_generations == NULL) { track_top_level(context, *declv, 0, declc); }
+
+  // Find the brace statements that enclose the edit, and the first top-level statement that
+  // follows it, before the source is replaced.
+  ReparseCandidate candidates[MAX_REPARSE_DEPTH];
+  size_t candidate_count = 0;
+  {
+    size_t lo = 0;
+    size_t hi = declc;
+    while (lo < hi) {
+      size_t mid = lo + (hi - lo) / 2;
+      if (top_level_start(context, (*declv)[mid]) <= edit.start) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+    if (lo > 0) {
+      candidate_count = find_reparse_candidates(context, (*declv)[lo - 1], edit, candidates);
+    }
+  }
+  TopLevelCursor resume = top_level_find(context, *declv, declc, edit.end);
+
+  // Replace the source, moving the interned names that point into the old one.
+  const char* old_source = context->source;
+  interner_rebase(&context->interner, old_source, context->source_length, source,
+                  edit.start, edit.end, delta, &context->arena);
+  context->source = source;
+  context->source_length = source_length;
+
+  // Shift the nodes that follow the edit. The nodes that overlap it are either reparsed or, if
+  // they enclose it, keep their start and move their end.
+  shift_top_level(context, *declv, declc, (uint32_t)edit.end, delta);
+
+  // Reparse the innermost brace statement that still parses on its own.
+  for (size_t i = candidate_count; i > 0; --i) {
+    ReparseCandidate* candidate = &candidates[i - 1];
+    Node* brace = context_get_nodeptr(context, candidate->brace);
+    NodeID result = reparse_brace_stmt(
+      context, brace->start, brace->end, brace->bits.brace_stmt.parent, user_data, report_diag);
+    if (result == (NodeID)~0) { continue; }
+
+    // Substitute the new brace statement.
+    bool is_root = context_is_root(context, candidate->brace);
+    node_walk(candidate->brace, context, context, delete_visit);
+    *candidate->slot = result;
+    if (is_root) { context_track_root(context, result); }
+    return declc;
+  }
+
+  // Fall back to reparsing top-level statements.
+  return reparse_top_level(
+    context, old_source, edit, resume, declv, declc, user_data, report_diag);
+}
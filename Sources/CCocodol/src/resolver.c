@@ -0,0 +1,260 @@
+#include <assert.h>
+#include <string.h>
+
+#include "alloc.h"
+#include "context.h"
+#include "resolver.h"
+
+#define INITIAL_UNDO_CAPACITY     64
+#define INITIAL_CAPTURE_CAPACITY  16
+
+void resolver_init(ResolverState* self, Context* context) {
+  self->context = context;
+  self->levels = NULL;
+  self->marks = NULL;
+  self->symbol_capacity = 0;
+  self->undo = cocodol_alloc(ac_ast, INITIAL_UNDO_CAPACITY * sizeof(uint32_t));
+  self->undo_count = 0;
+  self->undo_capacity = INITIAL_UNDO_CAPACITY;
+  self->captures = cocodol_alloc(ac_ast, INITIAL_CAPTURE_CAPACITY * sizeof(Token));
+  self->saved_marks = cocodol_alloc(ac_ast, INITIAL_CAPTURE_CAPACITY * sizeof(uint32_t));
+  self->capture_count = 0;
+  self->capture_capacity = INITIAL_CAPTURE_CAPACITY;
+}
+
+void resolver_deinit(ResolverState* self) {
+  cocodol_free(ac_ast, self->levels, self->symbol_capacity * sizeof(uint32_t));
+  cocodol_free(ac_ast, self->marks, self->symbol_capacity * sizeof(uint32_t));
+  cocodol_free(ac_ast, self->undo, self->undo_capacity * sizeof(uint32_t));
+  cocodol_free(ac_ast, self->captures, self->capture_capacity * sizeof(Token));
+  cocodol_free(ac_ast, self->saved_marks, self->capture_capacity * sizeof(uint32_t));
+  self->context = NULL;
+  self->levels = NULL;
+  self->marks = NULL;
+  self->symbol_capacity = 0;
+  self->undo = NULL;
+  self->undo_count = 0;
+  self->undo_capacity = 0;
+  self->captures = NULL;
+  self->saved_marks = NULL;
+  self->capture_count = 0;
+  self->capture_capacity = 0;
+}
+
+/// Grows the tables of a resolver so that they have an entry for every symbol of its context.
+static void resolver_reserve_symbols(ResolverState* self) {
+  size_t count = self->context->interner.count;
+  if (count <= self->symbol_capacity) { return; }
+
+  size_t capacity = (self->symbol_capacity > 0) ? self->symbol_capacity : 64;
+  while (capacity < count) {
+    capacity = capacity * 2;
+  }
+
+  uint32_t** tables[2] = { &self->levels, &self->marks };
+  for (size_t i = 0; i < 2; ++i) {
+    uint32_t* table = cocodol_alloc(ac_ast, capacity * sizeof(uint32_t));
+    memset(table, 0, capacity * sizeof(uint32_t));
+    cocodol_free(ac_ast, *tables[i], self->symbol_capacity * sizeof(uint32_t));
+    *tables[i] = table;
+  }
+  self->symbol_capacity = capacity;
+}
+
+/// Pushes a word onto the undo log of a resolver.
+static void undo_push(ResolverState* self, uint32_t word) {
+  if (self->undo_count == self->undo_capacity) {
+    size_t capacity = self->undo_capacity;
+    uint32_t* new_undo = cocodol_alloc(ac_ast, capacity * 2 * sizeof(uint32_t));
+    memcpy(new_undo, self->undo, self->undo_count * sizeof(uint32_t));
+    cocodol_free(ac_ast, self->undo, capacity * sizeof(uint32_t));
+    self->undo = new_undo;
+    self->undo_capacity = capacity * 2;
+  }
+  self->undo[self->undo_count] = word;
+  self->undo_count++;
+}
+
+/// The state of a walk that resolves captures.
+typedef struct ResolveWalk {
+
+  /// The resolver.
+  ResolverState* resolver;
+
+  /// The nesting level of the function being resolved, or 0 outside of any function.
+  uint32_t level;
+
+  /// The position in the undo log at which the current scope starts.
+  size_t scope_start;
+
+} ResolveWalk;
+
+/// Enters a new scope.
+static void scope_enter(ResolveWalk* walk) {
+  undo_push(walk->resolver, (uint32_t)walk->scope_start);
+  walk->scope_start = walk->resolver->undo_count;
+}
+
+/// Leaves the current scope, unbinding the names that it declared.
+static void scope_leave(ResolveWalk* walk) {
+  ResolverState* self = walk->resolver;
+  while (self->undo_count > walk->scope_start) {
+    self->undo_count -= 2;
+    self->levels[self->undo[self->undo_count]] = self->undo[self->undo_count + 1];
+  }
+  self->undo_count--;
+  walk->scope_start = self->undo[self->undo_count];
+}
+
+/// Binds the given name in the current scope.
+static void scope_bind(ResolveWalk* walk, const Token* name) {
+  if (name->kind != tk_name) { return; }
+
+  ResolverState* self = walk->resolver;
+  undo_push(self, name->symbol);
+  undo_push(self, self->levels[name->symbol]);
+  self->levels[name->symbol] = walk->level;
+}
+
+/// Records that the function being resolved captures the given identifier, unless it refers to a
+/// local binding or if it has been captured already.
+static void capture(ResolveWalk* walk, const Token* ident) {
+  ResolverState* self = walk->resolver;
+  Symbol symbol = ident->symbol;
+  assert(symbol != NO_SYMBOL);
+  if ((self->levels[symbol] >= walk->level) || (self->marks[symbol] == walk->level)) { return; }
+
+  if (self->capture_count == self->capture_capacity) {
+    size_t capacity = self->capture_capacity;
+    Token* new_captures = cocodol_alloc(ac_ast, capacity * 2 * sizeof(Token));
+    uint32_t* new_marks = cocodol_alloc(ac_ast, capacity * 2 * sizeof(uint32_t));
+    memcpy(new_captures, self->captures, self->capture_count * sizeof(Token));
+    memcpy(new_marks, self->saved_marks, self->capture_count * sizeof(uint32_t));
+    cocodol_free(ac_ast, self->captures, capacity * sizeof(Token));
+    cocodol_free(ac_ast, self->saved_marks, capacity * sizeof(uint32_t));
+    self->captures = new_captures;
+    self->saved_marks = new_marks;
+    self->capture_capacity = capacity * 2;
+  }
+
+  self->captures[self->capture_count] = *ident;
+  self->saved_marks[self->capture_count] = self->marks[symbol];
+  self->capture_count++;
+  self->marks[symbol] = walk->level;
+}
+
+/// Records the identifiers captured by a nested function that escape the function being resolved.
+static void capture_nested(ResolveWalk* walk, const Node* fun_decl) {
+  Context* context = walk->resolver->context;
+  size_t capturec = context_get_capturec(context, fun_decl);
+  for (size_t i = 0; i < capturec; ++i) {
+    Token ident = context_get_capture(context, fun_decl, i);
+    capture(walk, &ident);
+  }
+}
+
+/// Starts resolving the given function declaration.
+static void fun_enter(ResolveWalk* walk, Node* fun_decl) {
+  ResolverState* self = walk->resolver;
+  undo_push(self, (uint32_t)self->capture_count);
+  scope_enter(walk);
+  walk->level++;
+
+  // The function's name and parameters are bound in its body.
+  scope_bind(walk, &fun_decl->bits.fun_decl.name);
+  size_t paramc = context_get_paramc(self->context, fun_decl);
+  for (size_t i = 0; i < paramc; ++i) {
+    Token param = context_get_param(self->context, fun_decl, i);
+    scope_bind(walk, &param);
+  }
+}
+
+/// Finishes resolving the given function declaration, storing its capture list.
+static void fun_leave(ResolveWalk* walk, NodeID fun_index) {
+  ResolverState* self = walk->resolver;
+  Context* context = self->context;
+  scope_leave(walk);
+  self->undo_count--;
+  size_t base = self->undo[self->undo_count];
+
+  // Store the capture list.
+  size_t capturec = self->capture_count - base;
+  uint32_t position = context_append_extra(
+    context, (const uint32_t*)(self->captures + base), capturec * PARAM_WORD_COUNT);
+  uint32_t* params = context_get_extra(
+    context, context_get_nodeptr(context, fun_index)->bits.fun_decl.params);
+  params[1] = (uint32_t)capturec;
+  params[2] = position;
+
+  // Restore the marks of the enclosing functions.
+  for (size_t i = self->capture_count; i > base; --i) {
+    self->marks[self->captures[i - 1].symbol] = self->saved_marks[i - 1];
+  }
+  self->capture_count = base;
+  walk->level--;
+
+  // The enclosing function captures the identifiers that escape it.
+  if (walk->level > 0) {
+    capture_nested(walk, context_get_nodeptr(context, fun_index));
+  }
+}
+
+static bool resolve_visit(NodeID index, NodeKind kind, bool is_entering, void* user) {
+  ResolveWalk* walk = user;
+  Context* context = walk->resolver->context;
+  Node* node = context_get_nodeptr(context, index);
+
+  switch (kind) {
+    case nk_fun_decl:
+      if (!is_entering) {
+        fun_leave(walk, index);
+      } else if (context_get_captures(context, node) != UNRESOLVED_CAPTURES) {
+        // The function and its descendants have been resolved already.
+        if (walk->level > 0) { capture_nested(walk, node); }
+        return false;
+      } else {
+        fun_enter(walk, node);
+      }
+      return true;
+
+    case nk_brace_stmt:
+      if (walk->level == 0) { return true; }
+      if (!is_entering) {
+        scope_leave(walk);
+        return true;
+      }
+
+      // Bind all the names declared in the scope, regardless of their position.
+      scope_enter(walk);
+      for (uint32_t link = node->bits.brace_stmt.last_decl; link != (uint32_t)~0;) {
+        uint32_t* words = context_get_extra(context, link);
+        Node* decl = context_get_nodeptr(context, words[0]);
+        link = words[1];
+        if (decl->kind == nk_var_decl) {
+          scope_bind(walk, &decl->bits.var_decl.name);
+        } else if (decl->kind == nk_fun_decl) {
+          scope_bind(walk, &decl->bits.fun_decl.name);
+        }
+      }
+      return true;
+
+    case nk_declref_expr:
+      if (is_entering && (walk->level > 0)) {
+        capture(walk, &node->bits.declref_expr);
+      }
+      return false;
+
+    default:
+      return true;
+  }
+}
+
+void resolve_captures(ResolverState* self, const NodeID* declv, size_t declc) {
+  resolver_reserve_symbols(self);
+
+  ResolveWalk walk = { self, 0, 0 };
+  for (size_t i = 0; i < declc; ++i) {
+    node_walk(declv[i], self->context, &walk, resolve_visit);
+  }
+  assert((self->undo_count == 0) && (self->capture_count == 0));
+}
@@ -0,0 +1,223 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "scan.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SCAN_HAS_X86 1
+#endif
+
+/// Disables address sanitizing for the functions that may read past the end of their buffer.
+#if defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define SCAN_NO_SANITIZE __attribute__((no_sanitize_address))
+#endif
+#elif defined(__SANITIZE_ADDRESS__)
+#define SCAN_NO_SANITIZE __attribute__((no_sanitize_address))
+#endif
+#ifndef SCAN_NO_SANITIZE
+#define SCAN_NO_SANITIZE
+#endif
+
+// ------------------------------------------------------------------------------------------------
+// MARK: Scalar kernels
+// ------------------------------------------------------------------------------------------------
+
+#define is_space(ch)  (((ch) == ' ') || ((uint8_t)((ch) - '\t') <= ('\r' - '\t')))
+#define is_eol(ch)    (((ch) == 0) || ((ch) == '\n') || ((ch) == '\r'))
+#define is_alpha(ch)  (((uint8_t)(((ch) | 0x20) - 'a') <= ('z' - 'a')) || ((ch) == '_'))
+#define is_digit(ch)  ((uint8_t)((ch) - '0') <= 9)
+
+static const char* scalar_skip_spaces(const char* stream) {
+  while (is_space(*stream)) { stream++; }
+  return stream;
+}
+
+static const char* scalar_skip_line(const char* stream) {
+  while (!is_eol(*stream)) { stream++; }
+  return stream;
+}
+
+static const char* scalar_skip_ident(const char* stream) {
+  while (is_alpha(*stream) || is_digit(*stream)) { stream++; }
+  return stream;
+}
+
+static const char* scalar_skip_digits(const char* stream) {
+  while (is_digit(*stream)) { stream++; }
+  return stream;
+}
+
+static const ScanKernels scalar_kernels = {
+  "scalar",
+  scalar_skip_spaces,
+  scalar_skip_line,
+  scalar_skip_ident,
+  scalar_skip_digits,
+};
+
+#ifdef SCAN_HAS_X86
+
+// ------------------------------------------------------------------------------------------------
+// MARK: SSE2 kernels
+// ------------------------------------------------------------------------------------------------
+
+// All kernels follow the same pattern. They load the aligned block containing the first character
+// and discard the bits of the characters that precede it. Then, they compute a bit mask of the
+// characters that do *not* belong to the run, one block at a time, until it is non-zero.
+
+/// Returns a mask of the bytes of `v` in the range [lo, lo + len].
+#define sse2_in_range(v, lo, len)                                                                 \
+  _mm_cmpeq_epi8(_mm_min_epu8(_mm_sub_epi8(v, _mm_set1_epi8(lo)), _mm_set1_epi8(len)),            \
+                 _mm_sub_epi8(v, _mm_set1_epi8(lo)))
+
+static inline __attribute__((target("sse2"))) unsigned sse2_space_mask(__m128i v) {
+  __m128i m = _mm_or_si128(
+    _mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), sse2_in_range(v, '\t', '\r' - '\t'));
+  return ~_mm_movemask_epi8(m) & 0xffff;
+}
+
+static inline __attribute__((target("sse2"))) unsigned sse2_eol_mask(__m128i v) {
+  __m128i m = _mm_or_si128(
+    _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))),
+    _mm_cmpeq_epi8(v, _mm_setzero_si128()));
+  return _mm_movemask_epi8(m);
+}
+
+static inline __attribute__((target("sse2"))) unsigned sse2_ident_mask(__m128i v) {
+  __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+  __m128i m = _mm_or_si128(
+    _mm_or_si128(sse2_in_range(lower, 'a', 'z' - 'a'), sse2_in_range(v, '0', 9)),
+    _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+  return ~_mm_movemask_epi8(m) & 0xffff;
+}
+
+static inline __attribute__((target("sse2"))) unsigned sse2_digit_mask(__m128i v) {
+  return ~_mm_movemask_epi8(sse2_in_range(v, '0', 9)) & 0xffff;
+}
+
+#define SSE2_KERNEL(name, mask_fn)                                                                \
+  static SCAN_NO_SANITIZE __attribute__((target("sse2")))                                         \
+  const char* name(const char* stream) {                                                          \
+    uintptr_t offset = (uintptr_t)stream & 15;                                                    \
+    const __m128i* block = (const __m128i*)(stream - offset);                                     \
+    unsigned mask = mask_fn(_mm_load_si128(block)) & (0xffffu << offset);                         \
+    while (mask == 0) {                                                                           \
+      block++;                                                                                    \
+      mask = mask_fn(_mm_load_si128(block));                                                      \
+    }                                                                                             \
+    return (const char*)block + __builtin_ctz(mask);                                              \
+  }
+
+SSE2_KERNEL(sse2_skip_spaces, sse2_space_mask)
+SSE2_KERNEL(sse2_skip_line  , sse2_eol_mask)
+SSE2_KERNEL(sse2_skip_ident , sse2_ident_mask)
+SSE2_KERNEL(sse2_skip_digits, sse2_digit_mask)
+
+static const ScanKernels sse2_kernels = {
+  "sse2",
+  sse2_skip_spaces,
+  sse2_skip_line,
+  sse2_skip_ident,
+  sse2_skip_digits,
+};
+
+// ------------------------------------------------------------------------------------------------
+// MARK: AVX2 kernels
+// ------------------------------------------------------------------------------------------------
+
+/// Returns a mask of the bytes of `v` in the range [lo, lo + len].
+#define avx2_in_range(v, lo, len)                                                                 \
+  _mm256_cmpeq_epi8(                                                                              \
+    _mm256_min_epu8(_mm256_sub_epi8(v, _mm256_set1_epi8(lo)), _mm256_set1_epi8(len)),             \
+    _mm256_sub_epi8(v, _mm256_set1_epi8(lo)))
+
+static inline __attribute__((target("avx2"))) uint32_t avx2_space_mask(__m256i v) {
+  __m256i m = _mm256_or_si256(
+    _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), avx2_in_range(v, '\t', '\r' - '\t'));
+  return ~(uint32_t)_mm256_movemask_epi8(m);
+}
+
+static inline __attribute__((target("avx2"))) uint32_t avx2_eol_mask(__m256i v) {
+  __m256i m = _mm256_or_si256(
+    _mm256_or_si256(
+      _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r'))),
+    _mm256_cmpeq_epi8(v, _mm256_setzero_si256()));
+  return (uint32_t)_mm256_movemask_epi8(m);
+}
+
+static inline __attribute__((target("avx2"))) uint32_t avx2_ident_mask(__m256i v) {
+  __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+  __m256i m = _mm256_or_si256(
+    _mm256_or_si256(avx2_in_range(lower, 'a', 'z' - 'a'), avx2_in_range(v, '0', 9)),
+    _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')));
+  return ~(uint32_t)_mm256_movemask_epi8(m);
+}
+
+static inline __attribute__((target("avx2"))) uint32_t avx2_digit_mask(__m256i v) {
+  return ~(uint32_t)_mm256_movemask_epi8(avx2_in_range(v, '0', 9));
+}
+
+#define AVX2_KERNEL(name, mask_fn)                                                                \
+  static SCAN_NO_SANITIZE __attribute__((target("avx2")))                                         \
+  const char* name(const char* stream) {                                                          \
+    uintptr_t offset = (uintptr_t)stream & 31;                                                    \
+    const __m256i* block = (const __m256i*)(stream - offset);                                     \
+    uint32_t mask = mask_fn(_mm256_load_si256(block)) & (0xffffffffu << offset);                  \
+    while (mask == 0) {                                                                           \
+      block++;                                                                                    \
+      mask = mask_fn(_mm256_load_si256(block));                                                   \
+    }                                                                                             \
+    return (const char*)block + __builtin_ctz(mask);                                              \
+  }
+
+AVX2_KERNEL(avx2_skip_spaces, avx2_space_mask)
+AVX2_KERNEL(avx2_skip_line  , avx2_eol_mask)
+AVX2_KERNEL(avx2_skip_ident , avx2_ident_mask)
+AVX2_KERNEL(avx2_skip_digits, avx2_digit_mask)
+
+static const ScanKernels avx2_kernels = {
+  "avx2",
+  avx2_skip_spaces,
+  avx2_skip_line,
+  avx2_skip_ident,
+  avx2_skip_digits,
+};
+
+#endif
+
+// ------------------------------------------------------------------------------------------------
+// MARK: Dispatch
+// ------------------------------------------------------------------------------------------------
+
+const ScanKernels* scan_kernels_named(const char* name) {
+  if (strcmp(name, "scalar") == 0) { return &scalar_kernels; }
+
+#ifdef SCAN_HAS_X86
+  __builtin_cpu_init();
+  if ((strcmp(name, "sse2") == 0) && __builtin_cpu_supports("sse2")) { return &sse2_kernels; }
+  if ((strcmp(name, "avx2") == 0) && __builtin_cpu_supports("avx2")) { return &avx2_kernels; }
+#endif
+
+  return NULL;
+}
+
+const ScanKernels* scan_kernels(void) {
+  // The selection is idempotent, so concurrent calls can safely race to store their result.
+  static const ScanKernels* selected = NULL;
+  if (selected != NULL) { return selected; }
+
+  const ScanKernels* kernels = &scalar_kernels;
+#ifdef SCAN_HAS_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    kernels = &avx2_kernels;
+  } else if (__builtin_cpu_supports("sse2")) {
+    kernels = &sse2_kernels;
+  }
+#endif
+
+  selected = kernels;
+  return kernels;
+}
@@ -0,0 +1,150 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "source.h"
+
+/// The maximum size of a streamed source.
+///
+/// The offsets of a source must fit on 32 bits to be stored in a token buffer.
+#define STREAM_RESERVED_SIZE  ((size_t)UINT32_MAX)
+
+/// The number of bytes read from a stream at once.
+#define STREAM_CHUNK_SIZE     (64 << 10)
+
+/// The granularity at which the reservation of a stream is committed.
+#define STREAM_COMMIT_SIZE    (1 << 20)
+
+bool source_file_open(SourceFile* self, const char* path) {
+  self->text = NULL;
+  self->length = 0;
+  self->mapping_size = 0;
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) { return false; }
+
+  // Only regular files can be mapped.
+  struct stat info;
+  if (fstat(fd, &info) != 0) {
+    close(fd);
+    return false;
+  } else if (!S_ISREG(info.st_mode)) {
+    close(fd);
+    errno = EINVAL;
+    return false;
+  }
+
+  // Reserve enough pages to hold the file and at least one more byte. The file is then mapped
+  // over the first pages, so that whatever follows its contents reads as zero, whether it is the
+  // remainder of its last page or the anonymous page reserved after it.
+  size_t length = (size_t)info.st_size;
+  size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+  size_t mapping_size = (length / page_size + 1) * page_size;
+
+  char* base = mmap(NULL, mapping_size, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (base == MAP_FAILED) {
+    close(fd);
+    return false;
+  }
+
+  if (length > 0) {
+    if (mmap(base, length, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+      int error = errno;
+      munmap(base, mapping_size);
+      close(fd);
+      errno = error;
+      return false;
+    }
+
+    // The lexer reads the source from start to end.
+    madvise(base, length, MADV_SEQUENTIAL);
+  }
+  close(fd);
+
+  self->text = base;
+  self->length = length;
+  self->mapping_size = mapping_size;
+  return true;
+}
+
+void source_file_close(SourceFile* self) {
+  if (self->text != NULL) {
+    munmap((void*)self->text, self->mapping_size);
+  }
+  self->text = NULL;
+  self->length = 0;
+  self->mapping_size = 0;
+}
+
+bool source_stream_open(SourceStream* self, int fd) {
+  self->text = NULL;
+  self->length = 0;
+  self->committed_size = 0;
+  self->reserved_size = 0;
+  self->fd = fd;
+  self->error = 0;
+  self->at_end = false;
+
+  void* base = mmap(
+    NULL, STREAM_RESERVED_SIZE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (base == MAP_FAILED) { return false; }
+
+  self->text = base;
+  self->reserved_size = STREAM_RESERVED_SIZE;
+  return true;
+}
+
+bool source_stream_read(SourceStream* self) {
+  if (self->at_end) { return false; }
+
+  // Make sure there is room for a chunk and for the sentinel that follows it.
+  size_t available = self->reserved_size - self->length - 1;
+  size_t chunk_size = (available < STREAM_CHUNK_SIZE) ? available : STREAM_CHUNK_SIZE;
+  if (chunk_size == 0) {
+    self->error = EFBIG;
+    self->at_end = true;
+    return false;
+  }
+
+  if (self->length + chunk_size + 1 > self->committed_size) {
+    size_t new_size = self->committed_size + STREAM_COMMIT_SIZE;
+    if (new_size > self->reserved_size) { new_size = self->reserved_size; }
+    if (mprotect((char*)self->text + self->committed_size,
+                 new_size - self->committed_size, PROT_READ | PROT_WRITE) != 0)
+    {
+      self->error = errno;
+      self->at_end = true;
+      return false;
+    }
+    self->committed_size = new_size;
+  }
+
+  // Read the chunk. Committed pages are zero-filled, so the sentinel is already in place.
+  ssize_t count;
+  do {
+    count = read(self->fd, (char*)self->text + self->length, chunk_size);
+  } while ((count < 0) && (errno == EINTR));
+
+  if (count <= 0) {
+    self->error = (count < 0) ? errno : 0;
+    self->at_end = true;
+    return false;
+  }
+
+  self->length += count;
+  return true;
+}
+
+void source_stream_close(SourceStream* self) {
+  if (self->text != NULL) {
+    munmap((void*)self->text, self->reserved_size);
+  }
+  self->text = NULL;
+  self->length = 0;
+  self->committed_size = 0;
+  self->reserved_size = 0;
+  self->fd = -1;
+}
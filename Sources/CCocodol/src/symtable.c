@@ -2,202 +2,386 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "alloc.h"
+#include "interner.h"
 #include "symtable.h"
-#include "utils.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define SYMTABLE_HAS_SSE2 1
+#endif
 
 #define INITIAL_CAPACITY  16
-#define LOAD_FACTOR       0.75
 
-#define TOMB_BIT          1
-#define USED_BIT          2
-#define is_tomb(key)      ((key & TOMB_BIT) == TOMB_BIT)
-#define is_used(key)      ((key & USED_BIT) == USED_BIT)
-#define is_free(key)      ((key & (TOMB_BIT | USED_BIT)) == 0)
-#define extract_ptr(key)  ((const char*)(key & ~(TOMB_BIT | USED_BIT)))
+/// The control byte of an empty slot.
+#define CTRL_EMPTY        ((int8_t)-128)
 
-typedef struct SymTableEntry {
-  uintptr_t key;
-  void*     val;
-  uint64_t  h;
-} SymTableEntry;
+/// The control byte of a deleted slot (i.e., a tombstone).
+#define CTRL_DELETED      ((int8_t)-2)
 
-void symtable_init(SymTable* self) {
-  // Initialize the buckets.
-  size_t length = INITIAL_CAPACITY * sizeof(SymTableEntry);
-  self->buckets = malloc(length);
-  memset(self->buckets, 0, length);
+/// Returns the position of the first group probed for the given hash.
+#define hash_position(hash)  ((size_t)(uint32_t)(hash))
 
-  self->count = 0;
-  self->capacity = INITIAL_CAPACITY;
+/// Returns the 7 bits of the given hash that are stored in the control byte of a full slot.
+#define hash_ctrl(hash)      ((int8_t)((hash) >> 57))
+
+// ------------------------------------------------------------------------------------------------
+// MARK: Control groups
+// ------------------------------------------------------------------------------------------------
+
+#ifdef SYMTABLE_HAS_SSE2
+
+/// The number of control bytes that are compared at once.
+#define GROUP_WIDTH 16
+
+/// A set of positions in a group, as a bit mask.
+typedef uint32_t GroupMask;
+
+/// The number of bits of a group mask that correspond to each position.
+#define GROUP_MASK_STRIDE 1
+
+/// Returns the position of the lowest member of a non-empty group mask.
+#define group_mask_first(mask) ((size_t)__builtin_ctz(mask))
+
+/// Returns the positions of the control bytes equal to `ctrl` in the group at `group`.
+static inline GroupMask group_match(const int8_t* group, int8_t ctrl) {
+  __m128i g = _mm_loadu_si128((const __m128i*)group);
+  return (GroupMask)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(ctrl), g));
 }
 
-void symtable_deinit(SymTable* self, bool delete_keys) {
-  // Free the keys if requested.
-  if (delete_keys) {
-    for (size_t i = 0; i < self->capacity; ++i) {
-      if (!is_free(self->buckets[i].key)) {
-        free((char*)extract_ptr(self->buckets[i].key));
-      }
-    }
+/// Returns the positions of the empty slots in the group at `group`.
+static inline GroupMask group_match_empty(const int8_t* group) {
+  return group_match(group, CTRL_EMPTY);
+}
+
+/// Returns the positions of the empty or deleted slots in the group at `group`.
+static inline GroupMask group_match_free(const int8_t* group) {
+  // Empty and deleted slots are the only ones whose control byte is negative.
+  __m128i g = _mm_loadu_si128((const __m128i*)group);
+  return (GroupMask)_mm_movemask_epi8(g);
+}
+
+/// Returns the positions of the full slots in the group at `group`.
+static inline GroupMask group_match_full(const int8_t* group) {
+  return group_match_free(group) ^ 0xffff;
+}
+
+#else
+
+/// The number of control bytes that are compared at once.
+#define GROUP_WIDTH 8
+
+/// A set of positions in a group, as the most significant bits of the matching bytes.
+typedef uint64_t GroupMask;
+
+/// The number of bits of a group mask that correspond to each position.
+#define GROUP_MASK_STRIDE 8
+
+#define GROUP_LSBS 0x0101010101010101ull
+#define GROUP_MSBS 0x8080808080808080ull
+
+/// Returns the position of the lowest member of a non-empty group mask.
+#define group_mask_first(mask) ((size_t)__builtin_ctzll(mask) >> 3)
+
+/// Loads the group at `group` so that the first control byte is the least significant one.
+static inline uint64_t group_load(const int8_t* group) {
+  uint64_t word;
+  memcpy(&word, group, sizeof(word));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  word = __builtin_bswap64(word);
+#endif
+  return word;
+}
+
+/// Returns the positions of the control bytes equal to `ctrl` in the group at `group`.
+///
+/// The mask may contain false positives, which are rejected when keys are compared.
+static inline GroupMask group_match(const int8_t* group, int8_t ctrl) {
+  uint64_t x = group_load(group) ^ (GROUP_LSBS * (uint8_t)ctrl);
+  return (x - GROUP_LSBS) & ~x & GROUP_MSBS;
+}
+
+/// Returns the positions of the empty slots in the group at `group`.
+static inline GroupMask group_match_empty(const int8_t* group) {
+  // Empty slots are the only ones whose control byte has its 2 most significant bits set to 10.
+  uint64_t word = group_load(group);
+  return word & (~word << 6) & GROUP_MSBS;
+}
+
+/// Returns the positions of the empty or deleted slots in the group at `group`.
+static inline GroupMask group_match_free(const int8_t* group) {
+  return group_load(group) & GROUP_MSBS;
+}
+
+/// Returns the positions of the full slots in the group at `group`.
+static inline GroupMask group_match_full(const int8_t* group) {
+  return ~group_load(group) & GROUP_MSBS;
+}
+
+#endif
+
+// ------------------------------------------------------------------------------------------------
+// MARK: Table storage
+// ------------------------------------------------------------------------------------------------
+
+/// Returns the number of bytes allocated for a table with the given capacity.
+static inline size_t symtable_storage_size(size_t capacity) {
+  return capacity * sizeof(SymTableEntry) + capacity + GROUP_WIDTH - 1;
+}
+
+/// Returns the maximum number of entries in a table with the given capacity.
+static inline size_t symtable_max_count(size_t capacity) {
+  return capacity - capacity / 8;
+}
+
+/// Sets the control byte of the slot at the given position.
+static inline void symtable_set_ctrl(SymTable* self, size_t position, int8_t ctrl) {
+  self->ctrl[position] = ctrl;
+
+  // Update the copy that follows the last slot, if any.
+  if (position < GROUP_WIDTH - 1) {
+    self->ctrl[self->capacity + position] = ctrl;
   }
+}
+
+/// Allocates empty storage with the given capacity, which must be a power of two.
+static void symtable_allocate(SymTable* self, size_t capacity) {
+  assert((capacity >= GROUP_WIDTH) && ((capacity & (capacity - 1)) == 0));
+
+  // Slots and control bytes are stored in a single allocation. Slots that aren't full have their
+  // key set to `NO_SYMBOL`.
+  char* storage = cocodol_alloc(ac_symtable, symtable_storage_size(capacity));
+  self->slots = (SymTableEntry*)storage;
+  memset(self->slots, 0xff, capacity * sizeof(SymTableEntry));
+  self->ctrl = (int8_t*)(storage + capacity * sizeof(SymTableEntry));
+  memset(self->ctrl, CTRL_EMPTY, capacity + GROUP_WIDTH - 1);
 
-  free(self->buckets);
-  self->buckets = NULL;
   self->count = 0;
-  self->capacity = 0;
+  self->capacity = capacity;
+  self->growth_left = symtable_max_count(capacity);
 }
 
-/// Resizes the table, doubling its capacity.
-void symtable_resize(SymTable* self) {
-  // Create a new bucket array.
-  size_t new_capacity = self->capacity * 2;
-  SymTableEntry* new_buckets = malloc(new_capacity * sizeof(SymTableEntry));
-  memset(new_buckets, 0, new_capacity * sizeof(SymTableEntry));
-
-  // Re-insert the entries.
-  size_t new_count = 0;
-  for (size_t i = 0; i < self->capacity; ++i) {
-    if (is_used(self->buckets[i].key)) {
-      size_t position = self->buckets[i].h % new_capacity;
-      while (!is_free(new_buckets[position].key)) {
-        position = (position + 1) % new_capacity;
-      }
-      new_buckets[position] = self->buckets[i];
-      new_count++;
+/// Returns the position of the first empty or deleted slot in the probe sequence of a hash.
+static size_t symtable_find_free(const SymTable* self, uint64_t hash) {
+  size_t mask = self->capacity - 1;
+  size_t position = hash_position(hash) & mask;
+  for (size_t stride = GROUP_WIDTH; ; stride += GROUP_WIDTH) {
+    GroupMask free = group_match_free(self->ctrl + position);
+    if (free != 0) {
+      return (position + group_mask_first(free)) & mask;
     }
+    position = (position + stride) & mask;
   }
+}
 
-  // Substitute the old bucket array for the new one.
-  free(self->buckets);
-  self->buckets = new_buckets;
-  self->count = new_count;
-  self->capacity = new_capacity;
+/// Moves the entries of the table into new storage with the given capacity, dropping tombstones.
+static void symtable_rehash(SymTable* self, size_t new_capacity) {
+  SymTable old = *self;
+  symtable_allocate(self, new_capacity);
+
+  for (size_t i = 0; i < old.capacity; ++i) {
+    if (old.ctrl[i] < 0) { continue; }
+
+    uint64_t hash = symtable_hash(old.slots[i].key);
+    size_t position = symtable_find_free(self, hash);
+    symtable_set_ctrl(self, position, hash_ctrl(hash));
+    self->slots[position] = old.slots[i];
+  }
+  self->count = old.count;
+  self->growth_left -= old.count;
+
+  cocodol_free(ac_symtable, old.slots, symtable_storage_size(old.capacity));
 }
 
 /// Finds the entry for the given key.
-SymTableEntry* symtable_search(SymTable* self, const char* key) {
-  // Search for `key`.
-  size_t h = fnv1_hash_string(key);
-  size_t pos = h % self->capacity;
-
-  while (!is_free(self->buckets[pos].key)) {
-    // Skip tombstones.
-    if (is_tomb(self->buckets[pos].key)) { continue; }
-
-    // Check for equality.
-    if ((self->buckets[pos].h == h) &&
-        (strcmp(extract_ptr(self->buckets[pos].key), key) == 0)) {
-      return &self->buckets[pos];
+static inline SymTableEntry* symtable_search(SymTable* self, Symbol key, uint64_t hash) {
+  assert(key != NO_SYMBOL);
+  if (self->capacity == 0) {
+    for (size_t i = 0; i < self->count; ++i) {
+      if (self->small[i].key == key) { return &self->small[i]; }
     }
+    return NULL;
+  }
 
-    // Move to the next position.
-    pos = (pos + 1) % self->capacity;
+  size_t mask = self->capacity - 1;
+  size_t position = hash_position(hash) & mask;
+
+  // Most symbols sit in the first slot of their probe sequence, as symbols are dense. Since the
+  // slots that aren't full have no key, a hit there can be detected without reading control bytes.
+  if (self->slots[position].key == key) {
+    return &self->slots[position];
   }
 
-  return NULL;
+  // Probe groups of slots until one contains an empty slot. Deleted slots are skipped, as they
+  // never match a hash.
+  int8_t ctrl = hash_ctrl(hash);
+  for (size_t stride = GROUP_WIDTH; ; stride += GROUP_WIDTH) {
+    const int8_t* group = self->ctrl + position;
+    for (GroupMask match = group_match(group, ctrl); match != 0; match &= match - 1) {
+      SymTableEntry* entry = &self->slots[(position + group_mask_first(match)) & mask];
+      if (entry->key == key) { return entry; }
+    }
+
+    if (group_match_empty(group) != 0) { return NULL; }
+    position = (position + stride) & mask;
+  }
 }
 
-void* symtable_insert(SymTable* self, const char* key, void* val) {
-  // Resize the table if we reached its load factor.
-  if (((float)self->count / (float)self->capacity) > LOAD_FACTOR) {
-    symtable_resize(self);
+/// Moves the inline entries of a table to the heap.
+static void symtable_spill(SymTable* self) {
+  size_t count = self->count;
+  symtable_allocate(self, INITIAL_CAPACITY);
+  for (size_t i = 0; i < count; ++i) {
+    uint64_t hash = symtable_hash(self->small[i].key);
+    size_t position = symtable_find_free(self, hash);
+    symtable_set_ctrl(self, position, hash_ctrl(hash));
+    self->slots[position] = self->small[i];
   }
+  self->count = count;
+  self->growth_left -= count;
+}
 
-  // Search for a free bucket.
-  size_t h = fnv1_hash_string(key);
-  size_t pos = h % self->capacity;
-  size_t insert_position = self->capacity;
+// ------------------------------------------------------------------------------------------------
+// MARK: API
+// ------------------------------------------------------------------------------------------------
 
-  while (!is_free(self->buckets[pos].key)) {
-    if (is_tomb(self->buckets[pos].key)) {
-      // Remember the position of the first tombstone.
-      if (insert_position == self->capacity) {
-        insert_position = pos;
-      }
-    } else if ((self->buckets[pos].h == h) &&
-               (strcmp(extract_ptr(self->buckets[pos].key), key) == 0)) {
-      // `key` is already in the map.
-      return self->buckets[pos].val;
-    }
+void symtable_init(SymTable* self) {
+  // Entries are stored inline until they outnumber `small`, as most tables (e.g., the locals of
+  // most frames) remain small or empty.
+  self->ctrl = NULL;
+  self->slots = NULL;
+  self->count = 0;
+  self->capacity = 0;
+  self->growth_left = 0;
+}
 
-    // Move to the next position.
-    pos = (pos + 1) % self->capacity;
+void symtable_deinit(SymTable* self) {
+  if (self->capacity > 0) {
+    cocodol_free(ac_symtable, self->slots, symtable_storage_size(self->capacity));
   }
+  symtable_init(self);
+}
 
-  // Insert the new entry.
-  if (insert_position == self->capacity) {
-    insert_position = pos;
-    self->count++;
+void* symtable_insert_hashed(SymTable* self, Symbol key, uint64_t hash, void* val) {
+  SymTableEntry* entry = symtable_search(self, key, hash);
+  if (entry != NULL) {
+    // `key` is already in the map.
+    return entry->val;
+  }
+
+  if (self->capacity == 0) {
+    if (self->count < SYMTABLE_INLINE_CAPACITY) {
+      self->small[self->count] = (SymTableEntry){ key, val };
+      self->count++;
+      return NULL;
+    }
+    symtable_spill(self);
+  }
+
+  // Reuse a tombstone if there is one in the probe sequence. Otherwise, make sure an empty slot
+  // can be filled, growing the table or dropping its tombstones.
+  size_t position = symtable_find_free(self, hash);
+  if (self->ctrl[position] == CTRL_EMPTY) {
+    if (self->growth_left == 0) {
+      size_t new_capacity = (self->count < symtable_max_count(self->capacity) / 2)
+        ? self->capacity
+        : self->capacity * 2;
+      symtable_rehash(self, new_capacity);
+      position = symtable_find_free(self, hash);
+    }
+    self->growth_left--;
   }
-  self->buckets[pos].key = (uintptr_t)key | USED_BIT;
-  self->buckets[pos].val = val;
-  self->buckets[pos].h   = h;
 
+  // Insert the new entry.
+  symtable_set_ctrl(self, position, hash_ctrl(hash));
+  self->slots[position].key = key;
+  self->slots[position].val = val;
+  self->count++;
   return NULL;
 }
 
-void* symtable_update(SymTable* self, const char* key, void* value) {
-  SymTableEntry* entry = symtable_search(self, key);
+void* symtable_insert(SymTable* self, Symbol key, void* val) {
+  return symtable_insert_hashed(self, key, symtable_hash(key), val);
+}
+
+void* symtable_update(SymTable* self, Symbol key, void* value) {
+  uint64_t hash = symtable_hash(key);
+  SymTableEntry* entry = symtable_search(self, key, hash);
   if (entry != NULL) {
-    assert(!is_tomb(entry->key));
     void* val = entry->val;
     entry->val = value;
     return val;
   }
 
-  return symtable_insert(self, key, value);
+  return symtable_insert_hashed(self, key, hash, value);
 }
 
-void* symtable_remove(SymTable* self, const char* key) {
-  SymTableEntry* entry = symtable_search(self, key);
-  if (entry != NULL) {
-    // Create a tombstone.
-    assert(!is_tomb(entry->key));
-    entry->key = entry->key & ~USED_BIT;
-    return entry->val;
-  } else {
-    return NULL;
+void* symtable_remove(SymTable* self, Symbol key) {
+  SymTableEntry* entry = symtable_search(self, key, symtable_hash(key));
+  if (entry == NULL) { return NULL; }
+  void* val = entry->val;
+
+  // Keep inline entries contiguous, moving the last one into the hole.
+  if (self->capacity == 0) {
+    self->count--;
+    *entry = self->small[self->count];
+    return val;
   }
+
+  // Create a tombstone, so that the probe sequences that go through the slot are not cut short.
+  size_t position = (size_t)(entry - self->slots);
+  symtable_set_ctrl(self, position, CTRL_DELETED);
+  entry->key = NO_SYMBOL;
+  self->count--;
+  return val;
 }
 
-void* symtable_get(SymTable* self, const char* key) {
-  SymTableEntry* entry = symtable_search(self, key);
-  if (entry != NULL) {
-    assert(!is_tomb(entry->key));
-    return entry->val;
-  } else {
-    return NULL;
-  }
+void* symtable_get_probing(SymTable* self, Symbol key, uint64_t hash) {
+  SymTableEntry* entry = symtable_search(self, key, hash);
+  return (entry != NULL) ? entry->val : NULL;
 }
 
 size_t symtable_entry_count(SymTable* self) {
-  size_t count = 0;
-  for (size_t i = 0; i < self->capacity; ++i) {
-    if (is_used(self->buckets[i].key)) {
-      count++;
-    }
+  return self->count;
+}
+
+/// Returns the position of the next full slot of a table, starting from the given position.
+static inline size_t symtable_next_full(const SymTable* self, size_t position) {
+  // Skip whole groups of empty or deleted slots.
+  size_t group = position & ~(size_t)(GROUP_WIDTH - 1);
+  GroupMask full = group_match_full(self->ctrl + group);
+  full &= ~(GroupMask)0 << ((position - group) * GROUP_MASK_STRIDE);
+  while (full == 0) {
+    group += GROUP_WIDTH;
+    full = group_match_full(self->ctrl + group);
   }
-  return count;
+  return group + group_mask_first(full);
 }
 
-size_t symtable_map(SymTable* self, void** results, void*(*transform)(const char*, void*)) {
-  size_t count = 0;
-  for (size_t i = 0; i < self->capacity; ++i) {
-    if (is_used(self->buckets[i].key)) {
-      void* rv = transform(extract_ptr(self->buckets[i].key), self->buckets[i].val);
-      if (results) {
-        results[count] = rv;
-        count++;
-      }
+size_t symtable_map(SymTable* self, void** results, void*(*transform)(Symbol, void*)) {
+  SymTableEntry* entries = (self->capacity == 0) ? self->small : self->slots;
+  size_t position = 0;
+  for (size_t i = 0; i < self->count; ++i) {
+    if (self->capacity > 0) {
+      position = symtable_next_full(self, position);
+    }
+    void* rv = transform(entries[position].key, entries[position].val);
+    if (results) {
+      results[i] = rv;
     }
+    position++;
   }
-  return count;
+  return results ? self->count : 0;
 }
 
-void symtable_foreach(SymTable* self, void* user, void(*action)(const char*, void*, void*)) {
-  for (size_t i = 0; i < self->capacity; ++i) {
-    if (is_used(self->buckets[i].key)) {
-      action(extract_ptr(self->buckets[i].key), self->buckets[i].val, user);
+void symtable_foreach(SymTable* self, void* user, void(*action)(Symbol, void*, void*)) {
+  SymTableEntry* entries = (self->capacity == 0) ? self->small : self->slots;
+  size_t position = 0;
+  for (size_t i = 0; i < self->count; ++i) {
+    if (self->capacity > 0) {
+      position = symtable_next_full(self, position);
     }
+    action(entries[position].key, entries[position].val, user);
+    position++;
   }
 }
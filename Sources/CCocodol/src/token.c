@@ -1,9 +1,14 @@
 #include <string.h>
 
 #include "context.h"
+#include "interner.h"
 #include "token.h"
 
 bool token_text_equal(Context* context, Token* lhs, Token* rhs) {
+  if ((lhs->symbol != NO_SYMBOL) && (rhs->symbol != NO_SYMBOL)) {
+    return lhs->symbol == rhs->symbol;
+  }
+
   size_t len = token_text_len(lhs);
   if (len != token_text_len(rhs)) { return false; }
 
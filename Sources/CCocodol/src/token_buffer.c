@@ -0,0 +1,189 @@
+#include <assert.h>
+#include <string.h>
+
+#include "alloc.h"
+#include "interner.h"
+#include "lexer.h"
+#include "token_buffer.h"
+
+#define INITIAL_CAPACITY 256
+
+/// The kind of the token denoted by each code.
+static const TokenKind code_kinds[256] = {
+#define K(kind) [token_kind_code(kind)] = kind
+  K(tk_error),    K(tk_name),     K(tk_true),     K(tk_false),    K(tk_integer),
+  K(tk_float),    K(tk_dot),      K(tk_colon),    K(tk_semicolon), K(tk_comma),
+  K(tk_l_paren),  K(tk_r_paren),  K(tk_l_brace),  K(tk_r_brace),  K(tk_eof),
+  K(tk_var),      K(tk_fun),      K(tk_obj),
+  K(tk_if),       K(tk_else),     K(tk_while),    K(tk_brk),      K(tk_nxt),
+  K(tk_ret),
+  K(tk_l_shift),  K(tk_r_shift),  K(tk_star),     K(tk_slash),    K(tk_percent),
+  K(tk_plus),     K(tk_minus),    K(tk_pipe),     K(tk_amp),      K(tk_caret),
+  K(tk_lt),       K(tk_le),       K(tk_gt),       K(tk_ge),       K(tk_eq),
+  K(tk_ne),       K(tk_and),      K(tk_or),       K(tk_assign),   K(tk_not),
+  K(tk_tilde),
+#undef K
+};
+
+/// The length of the token denoted by each code, or 0 if the length must be derived from the
+/// source (i.e., for names and numbers).
+static const uint8_t code_lengths[256] = {
+#define L(kind, len) [token_kind_code(kind)] = len
+  L(tk_error, 1),     L(tk_true, 4),      L(tk_false, 5),     L(tk_dot, 1),
+  L(tk_colon, 1),     L(tk_semicolon, 1), L(tk_comma, 1),     L(tk_l_paren, 1),
+  L(tk_r_paren, 1),   L(tk_l_brace, 1),   L(tk_r_brace, 1),   L(tk_eof, 1),
+  L(tk_var, 3),       L(tk_fun, 3),       L(tk_obj, 3),
+  L(tk_if, 2),        L(tk_else, 4),      L(tk_while, 5),     L(tk_brk, 3),
+  L(tk_nxt, 3),       L(tk_ret, 3),
+  L(tk_l_shift, 2),   L(tk_r_shift, 2),   L(tk_star, 1),      L(tk_slash, 1),
+  L(tk_percent, 1),   L(tk_plus, 1),      L(tk_minus, 1),     L(tk_pipe, 1),
+  L(tk_amp, 1),       L(tk_caret, 1),     L(tk_lt, 1),        L(tk_le, 2),
+  L(tk_gt, 1),        L(tk_ge, 2),        L(tk_eq, 2),        L(tk_ne, 2),
+  L(tk_and, 3),       L(tk_or, 2),        L(tk_assign, 1),    L(tk_not, 1),
+  L(tk_tilde, 1),
+#undef L
+};
+
+#define is_digit(ch)  ((uint8_t)((ch) - '0') <= 9)
+#define is_ident(ch)  \
+  (((uint8_t)(((ch) | 0x20) - 'a') <= ('z' - 'a')) || ((ch) == '_') || is_digit(ch))
+
+/// Grows the arrays of a token buffer, doubling its capacity.
+static void token_buffer_resize(TokenBuffer* self) {
+  size_t new_capacity = self->capacity * 2;
+
+  uint8_t* new_kinds = cocodol_alloc(ac_tokens, new_capacity * sizeof(uint8_t));
+  memcpy(new_kinds, self->kinds, self->count * sizeof(uint8_t));
+  cocodol_free(ac_tokens, self->kinds, self->capacity * sizeof(uint8_t));
+  self->kinds = new_kinds;
+
+  uint32_t* new_starts = cocodol_alloc(ac_tokens, new_capacity * sizeof(uint32_t));
+  memcpy(new_starts, self->starts, self->count * sizeof(uint32_t));
+  cocodol_free(ac_tokens, self->starts, self->capacity * sizeof(uint32_t));
+  self->starts = new_starts;
+
+  Symbol* new_symbols = cocodol_alloc(ac_tokens, new_capacity * sizeof(Symbol));
+  memcpy(new_symbols, self->symbols, self->count * sizeof(Symbol));
+  cocodol_free(ac_tokens, self->symbols, self->capacity * sizeof(Symbol));
+  self->symbols = new_symbols;
+
+  self->capacity = new_capacity;
+}
+
+void token_buffer_init_empty(TokenBuffer* self, const char* source, Interner* interner) {
+  self->source = source;
+  self->interner = interner;
+  self->count = 0;
+  self->capacity = INITIAL_CAPACITY;
+  self->kinds = cocodol_alloc(ac_tokens, self->capacity * sizeof(uint8_t));
+  self->starts = cocodol_alloc(ac_tokens, self->capacity * sizeof(uint32_t));
+  self->symbols = cocodol_alloc(ac_tokens, self->capacity * sizeof(Symbol));
+}
+
+bool token_buffer_init(TokenBuffer* self, const char* source, Interner* interner) {
+  token_buffer_init_empty(self, source, interner);
+
+  LexerState lexer;
+  Token token;
+  lexer_init(&lexer, source, interner);
+  while (lexer_next(&lexer, &token)) {
+    // Make sure the token's offsets can be represented.
+    if (lexer.index > UINT32_MAX) {
+      self->count = 0;
+      lexer_deinit(&lexer);
+      return false;
+    }
+
+    if (self->count == self->capacity) {
+      token_buffer_resize(self);
+    }
+    self->kinds[self->count] = token_kind_code(token.kind);
+    self->starts[self->count] = token.start;
+    self->symbols[self->count] = token.symbol;
+    self->count++;
+  }
+  lexer_deinit(&lexer);
+
+  return true;
+}
+
+size_t token_buffer_append(TokenBuffer* self, size_t start, size_t length, bool is_final) {
+  LexerState lexer;
+  Token token;
+  lexer_init(&lexer, self->source, self->interner);
+  lexer.index = start;
+
+  size_t resume = start;
+  while (lexer_next(&lexer, &token)) {
+    // Stop before a token that may continue in the part of the source that hasn't been read yet.
+    if (!is_final && (lexer.index >= length)) { break; }
+    assert(lexer.index <= UINT32_MAX);
+
+    if (self->count == self->capacity) {
+      token_buffer_resize(self);
+    }
+    self->kinds[self->count] = token_kind_code(token.kind);
+    self->starts[self->count] = token.start;
+    self->symbols[self->count] = token.symbol;
+    self->count++;
+    resume = lexer.index;
+  }
+
+  // Trailing whitespaces and comments can be skipped once the whole source has been read.
+  if (is_final) { resume = lexer.index; }
+  lexer_deinit(&lexer);
+  return resume;
+}
+
+void token_buffer_deinit(TokenBuffer* self) {
+  cocodol_free(ac_tokens, self->kinds, self->capacity * sizeof(uint8_t));
+  cocodol_free(ac_tokens, self->starts, self->capacity * sizeof(uint32_t));
+  cocodol_free(ac_tokens, self->symbols, self->capacity * sizeof(Symbol));
+  self->source = NULL;
+  self->interner = NULL;
+  self->kinds = NULL;
+  self->starts = NULL;
+  self->symbols = NULL;
+  self->count = 0;
+  self->capacity = 0;
+}
+
+TokenKind token_buffer_kind(const TokenBuffer* self, size_t position) {
+  return code_kinds[self->kinds[position]];
+}
+
+size_t token_buffer_end(const TokenBuffer* self, size_t position) {
+  uint8_t code = self->kinds[position];
+  size_t start = self->starts[position];
+  if (code_lengths[code] > 0) {
+    return start + code_lengths[code];
+  }
+
+  // Interned names have the length of their symbol.
+  Symbol symbol = self->symbols[position];
+  if (symbol != NO_SYMBOL) {
+    return start + interner_get(self->interner, symbol)->length;
+  }
+
+  // Re-scan the source to derive the length of other names and numbers.
+  const char* stream = self->source + start;
+  size_t i = 1;
+  if (code == token_kind_code(tk_name)) {
+    while (is_ident(stream[i])) { i++; }
+  } else {
+    while (is_digit(stream[i])) { i++; }
+    if ((code == token_kind_code(tk_float)) && (stream[i] == '.') && is_digit(stream[i + 1])) {
+      i += 2;
+      while (is_digit(stream[i])) { i++; }
+    }
+  }
+
+  return start + i;
+}
+
+void token_buffer_get(const TokenBuffer* self, size_t position, Token* token) {
+  token->kind = code_kinds[self->kinds[position]];
+  token->start = self->starts[position];
+  token->end = token_buffer_end(self, position);
+  token->symbol = self->symbols[position];
+}
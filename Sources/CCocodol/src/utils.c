@@ -1,8 +1,12 @@
+#include <string.h>
+
 #include "utils.h"
 
 #define FNV_BASIS 0xcbf29ce484222325
 #define FNV_PRIME 0x100000001b3
 
+#define WIDE_PRIME 0x9e3779b97f4a7c15
+
 uint64_t fnv1_hash_buffer(const char* bytes, size_t count) {
   uint64_t h = FNV_BASIS;
   for (size_t i = 0; i < count; ++i) {
@@ -23,3 +27,110 @@ uint64_t fnv1_hash_string(const char* str) {
   return h;
 }
 
+
+/// Mixes the bits of a 64-bit value, so that each input bit affects every output bit.
+static inline uint64_t mix64(uint64_t h) {
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccd;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53;
+  h ^= h >> 33;
+  return h;
+}
+
+uint64_t wide_hash_buffer(const char* bytes, size_t count) {
+  uint64_t h = FNV_BASIS ^ (count * WIDE_PRIME);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    uint64_t word;
+    memcpy(&word, bytes + i, 8);
+    h = (h ^ mix64(word)) * WIDE_PRIME;
+  }
+
+  // Hash the remaining bytes as a zero-padded word.
+  if (i < count) {
+    uint64_t word = 0;
+    memcpy(&word, bytes + i, count - i);
+    h = (h ^ mix64(word)) * WIDE_PRIME;
+  }
+
+  return mix64(h);
+}
+
+void wide_hasher_init(WideHasher* self, size_t count) {
+  self->state = FNV_BASIS ^ (count * WIDE_PRIME);
+  self->word_count = 0;
+}
+
+void wide_hasher_update(WideHasher* self, const char* bytes, size_t count) {
+  // Complete the pending word, if any.
+  size_t i = 0;
+  if (self->word_count > 0) {
+    for (; (i < count) && (self->word_count < 8); ++i) {
+      self->word[self->word_count++] = bytes[i];
+    }
+    if (self->word_count < 8) { return; }
+
+    uint64_t word;
+    memcpy(&word, self->word, 8);
+    self->state = (self->state ^ mix64(word)) * WIDE_PRIME;
+    self->word_count = 0;
+  }
+
+  for (; i + 8 <= count; i += 8) {
+    uint64_t word;
+    memcpy(&word, bytes + i, 8);
+    self->state = (self->state ^ mix64(word)) * WIDE_PRIME;
+  }
+
+  // Keep the remaining bytes for the next update.
+  memcpy(self->word, bytes + i, count - i);
+  self->word_count = count - i;
+}
+
+uint64_t wide_hasher_finalize(WideHasher* self) {
+  // Hash the remaining bytes as a zero-padded word.
+  if (self->word_count > 0) {
+    uint64_t word = 0;
+    memcpy(&word, self->word, self->word_count);
+    self->state = (self->state ^ mix64(word)) * WIDE_PRIME;
+  }
+  return mix64(self->state);
+}
+
+uint64_t name_hash_buffer(const char* bytes, size_t count) {
+  uint64_t h = FNV_BASIS ^ count;
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    uint64_t word;
+    memcpy(&word, bytes + i, 8);
+    h = (h ^ word) * WIDE_PRIME;
+    h ^= h >> 29;
+  }
+
+  // Hash the remaining bytes as a zero-padded word, with fixed-size loads.
+  uint64_t word = 0;
+  size_t shift = 0;
+  const char* tail = bytes + i;
+  if ((count - i) & 4) {
+    uint32_t part;
+    memcpy(&part, tail, 4);
+    word = part;
+    shift = 32;
+    tail += 4;
+  }
+  if ((count - i) & 2) {
+    uint16_t part;
+    memcpy(&part, tail, 2);
+    word |= (uint64_t)part << shift;
+    shift += 16;
+    tail += 2;
+  }
+  if ((count - i) & 1) {
+    word |= (uint64_t)(uint8_t)*tail << shift;
+  }
+
+  // Fold the high bits into the low ones, which are used to index hash tables.
+  h = (h ^ word) * WIDE_PRIME;
+  return h ^ (h >> 32);
+}
@@ -11,13 +11,19 @@ public struct NodeHandle {
   let context: Context
 
   /// The ID of the node.
-  let id: Int
+  let id: NodeID
 
   /// A pointer to the node storage.
   ///
-  /// - Important: Do not store this property. The pointer may be invalidated every time the owning
-  ///   context is mutated.
-  var pointer: NodePointer { UnsafePointer(context_get_nodeptr(context.state, id)) }
+  /// The shifts deferred by incremental reparses are applied before the node is accessed, so that
+  /// its offsets are up to date.
+  ///
+  /// - Important: Do not store this property. The pointer is valid only as long as the owning
+  ///   context is alive.
+  var pointer: NodePointer {
+    context_settle(context.state)
+    return UnsafePointer(context_get_nodeptr(context.state, id))
+  }
 
   /// The kind of the node.
   var kind: NodeKind { pointer.pointee.kind }
@@ -26,7 +32,7 @@ public struct NodeHandle {
   var contents: CCocodol.NodeContents { pointer.pointee.bits }
 
   /// The range of the node in the source input.
-  public var range: Range<Int> { pointer.pointee.start ..< pointer.pointee.end }
+  public var range: Range<Int> { Int(pointer.pointee.start) ..< Int(pointer.pointee.end) }
 
   /// A value describing the type of an AST walk event.
   public enum WalkEvent {
@@ -268,8 +274,8 @@ public struct TopDecl: Decl {
   public var stmts: Statements {
     return Statements(
       context: handle.context,
-      stmtv: handle.contents.brace_stmt.stmtv,
-      endIndex: handle.contents.brace_stmt.stmtc)
+      stmts: handle.contents.top_decl.stmts,
+      endIndex: Int(handle.contents.top_decl.stmtc))
   }
 
   public func unparse() -> String {
@@ -301,8 +307,13 @@ public struct VarDecl: Decl {
   public var name: CharacterView {
     return CharacterView(
       buffer: handle.context.source,
-      startIndex: handle.contents.var_decl.name.start,
-      endIndex: handle.contents.var_decl.name.end)
+      startIndex: Int(handle.contents.var_decl.name.start),
+      endIndex: Int(handle.contents.var_decl.name.end))
+  }
+
+  /// The symbol of the variable's name.
+  public var symbol: Symbol {
+    return handle.contents.var_decl.name.symbol
   }
 
   /// The variable's initializer, if any.
@@ -338,19 +349,23 @@ public struct FunDecl: Decl {
   public var name: CharacterView {
     return CharacterView(
       buffer: handle.context.source,
-      startIndex: handle.contents.fun_decl.name.start,
-      endIndex: handle.contents.fun_decl.name.end)
+      startIndex: Int(handle.contents.fun_decl.name.start),
+      endIndex: Int(handle.contents.fun_decl.name.end))
+  }
+
+  /// The symbol of the function's name.
+  public var symbol: Symbol {
+    return handle.contents.fun_decl.name.symbol
   }
 
   /// The parameters of the function.
   public var params: [Token] {
-    var value: [Token] = []
-    value.reserveCapacity(handle.contents.fun_decl.paramc)
-    for i in 0 ..< handle.contents.fun_decl.paramc {
-      value.append(
-        Token(cToken: handle.contents.fun_decl.paramv[i], buffer: handle.context.source))
-    }
-    return value
+    let state = handle.context.state
+    let paramc = context_get_paramc(state, handle.pointer)
+    return (0 ..< paramc).map({ (i) -> Token in
+      Token(
+        cToken: context_get_param(state, handle.pointer, i), buffer: handle.context.source)
+    })
   }
 
   /// The body of the function.
@@ -358,17 +373,20 @@ public struct FunDecl: Decl {
     return NodeHandle(context: handle.context, id: handle.contents.fun_decl.body)
   }
 
-  /// The identifiers captured by the function.
-  public var captures: [CharacterView] {
-    let tokens = UnsafeMutablePointer<UnsafeMutablePointer<CCocodol.Token>?>.allocate(
-      capacity: Int(truncatingIfNeeded: MAX_CAPTURE_COUNT))
-    defer { tokens.deallocate() }
+  /// The identifiers captured by the function, in the order of their first occurrence.
+  ///
+  /// The captures are resolved the first time they are requested, together with those of the
+  /// functions declared in the function's body, and cached in the context.
+  public var captures: [Token] {
+    let state = handle.context.state
+    if context_get_captures(state, handle.pointer) == UInt32.max {
+      handle.context.resolveCaptures(in: [self])
+    }
 
-    let count = capture_set(handle.id, handle.context.state, tokens, true)
-    return (0 ..< count).map({ (i) -> CharacterView in
-      let cToken = tokens[i]!.pointee
-      return CharacterView(
-        buffer: handle.context.source, startIndex: cToken.start, endIndex: cToken.end)
+    let capturec = context_get_capturec(state, handle.pointer)
+    return (0 ..< capturec).map({ (i) -> Token in
+      Token(
+        cToken: context_get_capture(state, handle.pointer, i), buffer: handle.context.source)
     })
   }
 
@@ -398,8 +416,8 @@ public struct ObjDecl: Decl {
   public var name: CharacterView {
     return CharacterView(
       buffer: handle.context.source,
-      startIndex: handle.contents.obj_decl.name.start,
-      endIndex: handle.contents.obj_decl.name.end)
+      startIndex: Int(handle.contents.obj_decl.name.start),
+      endIndex: Int(handle.contents.obj_decl.name.end))
   }
 
   /// The body of the type.
@@ -448,8 +466,13 @@ public struct DeclRefExpr: Expr {
   public var name: CharacterView {
     return CharacterView(
       buffer: handle.context.source,
-      startIndex: handle.contents.declref_expr.start,
-      endIndex: handle.contents.declref_expr.end)
+      startIndex: Int(handle.contents.declref_expr.start),
+      endIndex: Int(handle.contents.declref_expr.end))
+  }
+
+  /// The symbol of the name of the declaration being referred.
+  public var symbol: Symbol {
+    return handle.contents.declref_expr.symbol
   }
 
   public func unparse() -> String {
@@ -486,7 +509,7 @@ public struct IntegerExpr: Expr {
 
   /// The value of the literal.
   public var value: Int {
-    return handle.contents.integer_expr
+    return Int(node_integer_value(handle.pointer))
   }
 
   public init?(handle: NodeHandle) {
@@ -507,7 +530,7 @@ public struct FloatExpr: Expr {
 
   /// The value of the literal.
   public var value: Double {
-    return handle.contents.float_expr
+    return node_float_value(handle.pointer)
   }
 
   public init?(handle: NodeHandle) {
@@ -604,8 +627,8 @@ public struct MemberExpr: Expr {
   public var member: CharacterView {
     return CharacterView(
       buffer: handle.context.source,
-      startIndex: handle.contents.member_expr.member.start,
-      endIndex: handle.contents.member_expr.member.end)
+      startIndex: Int(handle.contents.member_expr.member.start),
+      endIndex: Int(handle.contents.member_expr.member.end))
   }
 
   public func unparse() -> String {
@@ -633,12 +656,11 @@ public struct ApplyExpr: Expr {
 
   /// The arguments of the call.
   public var args: [NodeHandle] {
-    var value: [NodeHandle] = []
-    value.reserveCapacity(handle.contents.apply_expr.argc)
-    for i in 0 ..< handle.contents.apply_expr.argc {
-      value.append(NodeHandle(context: handle.context, id: handle.contents.apply_expr.argv[i]))
-    }
-    return value
+    let args = handle.contents.apply_expr.args
+    return (0 ..< handle.contents.apply_expr.argc).map({ (i) -> NodeHandle in
+      let id = context_get_extra(handle.context.state, args + i)!.pointee
+      return NodeHandle(context: handle.context, id: id)
+    })
   }
 
   public func unparse() -> String {
@@ -695,8 +717,8 @@ public struct BraceStmt: Stmt {
   public var stmts: Statements {
     return Statements(
       context: handle.context,
-      stmtv: handle.contents.brace_stmt.stmtv,
-      endIndex: handle.contents.brace_stmt.stmtc)
+      stmts: handle.contents.brace_stmt.stmts,
+      endIndex: Int(handle.contents.brace_stmt.stmtc))
   }
 
   /// The parent lexical scope, if any.
@@ -920,8 +942,8 @@ public struct Statements: BidirectionalCollection {
   /// The context in which the nodes are stored.
   fileprivate let context: Context
 
-  /// The wrapped buffer.
-  fileprivate let stmtv: UnsafeMutablePointer<NodeID>!
+  /// The position of the statement indices in the context's extra data.
+  fileprivate let stmts: UInt32
 
   public var startIndex: Int { 0 }
 
@@ -936,7 +958,8 @@ public struct Statements: BidirectionalCollection {
   }
 
   public subscript(position: Int) -> NodeHandle {
-    NodeHandle(context: context, id: stmtv[position])
+    let id = context_get_extra(context.state, stmts + UInt32(position))!.pointee
+    return NodeHandle(context: context, id: id)
   }
 
 }
@@ -13,17 +13,84 @@ public final class Context {
   /// The input string representing the program source.
   var source: ManagedStringBuffer
 
+  /// The AST cache entry backing the nodes of the context, if any.
+  var cacheFile = AstCacheFile(base: nil, mapping_size: 0)
+
   /// Creates a new context, initialized with the given program source.
   ///
   /// - Parameter source: A program source.
   public init(source: String) {
     self.source = ManagedStringBuffer(copying: source)
     state = .allocate(capacity: 1)
-    context_init(state, self.source.data)
+    context_init(state, self.source.data, self.source.count)
+  }
+
+  /// Creates a new context, initialized with the contents of the file at the given path.
+  ///
+  /// The file is mapped into memory rather than copied. The initializer returns `nil` if the file
+  /// could not be read.
+  ///
+  /// - Parameter path: The path of a program source.
+  public init?(contentsOfFile path: String) {
+    guard let source = ManagedStringBuffer(mapping: path) else { return nil }
+    self.source = source
+    state = .allocate(capacity: 1)
+    context_init(state, self.source.data, self.source.count)
   }
 
+  /// A pointer to the interner that assigns a symbol to each name of the program source.
+  ///
+  /// The pointer is valid as long as the context is alive.
+  var interner: UnsafeMutablePointer<Interner> {
+    let offset = MemoryLayout<CCocodol.Context>.offset(of: \CCocodol.Context.interner)!
+    return (UnsafeMutableRawPointer(state!) + offset).assumingMemoryBound(to: Interner.self)
+  }
+
+  /// Loads the top-level declarations of the program source from the AST cache.
+  ///
+  /// The context must be empty. The method returns `nil` if there is no valid cache entry for the
+  /// program source, in which case the context is left unchanged.
+  public func loadCachedDecls() -> [Decl]? {
+    var declv: UnsafeMutablePointer<NodeID>?
+    var declc = 0
+    guard ast_cache_load(&cacheFile, state, cacheKey, &declv, &declc) else { return nil }
+    defer { declv?.deallocate() }
+
+    return (0 ..< declc).map({ i in NodeHandle(context: self, id: declv![i]).adaptAsDecl()! })
+  }
+
+  /// Stores the given top-level declarations of the program source into the AST cache.
+  ///
+  /// - Returns: `true` if the cache entry was written; otherwise, `false`.
+  @discardableResult
+  public func storeCachedDecls(_ decls: [Decl]) -> Bool {
+    let ids = decls.map({ decl in decl.handle.id })
+    return ids.withUnsafeBufferPointer({ buffer in
+      ast_cache_store(state, cacheKey, buffer.baseAddress, buffer.count)
+    })
+  }
+
+  /// Resolves the identifiers captured by the function declarations in the given declarations and
+  /// in their descendants.
+  ///
+  /// Functions whose captures have already been resolved are skipped.
+  public func resolveCaptures(in decls: [Decl]) {
+    var resolver = ResolverState()
+    resolver_init(&resolver, state)
+    defer { resolver_deinit(&resolver) }
+
+    let ids = decls.map({ decl in decl.handle.id })
+    ids.withUnsafeBufferPointer({ buffer in
+      resolve_captures(&resolver, buffer.baseAddress, buffer.count)
+    })
+  }
+
+  /// The key identifying the AST cache entry of the program source.
+  var cacheKey: UInt64 { ast_cache_key(source.data, source.count) }
+
   deinit {
     context_deinit(state)
+    ast_cache_close(&cacheFile)
     state!.deallocate()
   }
 
@@ -6,15 +6,18 @@ public final class Lexer: IteratorProtocol {
   /// The internal state of the lexer.
   var state = LexerState()
 
+  /// The context whose source is tokenized, and whose interner assigns symbols to names.
+  let context: Context
+
   /// The input string representing the program source.
-  let source: ManagedStringBuffer
+  var source: ManagedStringBuffer { context.source }
 
   /// Creates a new lexer in the given context.
   ///
   /// - Parameter context: An AST context.
   public init(in context: Context) {
-    self.source = context.source
-    lexer_init(&state, self.source.data)
+    self.context = context
+    lexer_init(&state, context.source.data, context.interner)
   }
 
   deinit {
@@ -29,3 +32,42 @@ public final class Lexer: IteratorProtocol {
   }
 
 }
+
+/// A random access collection of the tokens of a source file, tokenized up front.
+///
+/// Tokens are stored in a compact buffer and materialized on access, so that iterating over the
+/// stream does not allocate memory.
+public final class TokenStream: RandomAccessCollection {
+
+  /// The internal state of the token buffer.
+  var state = TokenBuffer()
+
+  /// The context whose source is tokenized, and whose interner assigns symbols to names.
+  let context: Context
+
+  /// The input string representing the program source.
+  var source: ManagedStringBuffer { context.source }
+
+  /// Creates a new token stream with the source of the given context.
+  ///
+  /// - Parameter context: An AST context.
+  public init(in context: Context) {
+    self.context = context
+    token_buffer_init(&state, context.source.data, context.interner)
+  }
+
+  deinit {
+    token_buffer_deinit(&state)
+  }
+
+  public var startIndex: Int { 0 }
+
+  public var endIndex: Int { state.count }
+
+  public subscript(position: Int) -> Token {
+    var cToken = CCocodol.Token()
+    token_buffer_get(&state, position, &cToken)
+    return Token(cToken: cToken, buffer: source)
+  }
+
+}
@@ -1,11 +1,20 @@
+import CCocodol
+
 /// A managed C string.
 final class ManagedStringBuffer {
 
   var data: UnsafeMutablePointer<CChar>?
 
+  /// The number of bytes in the string, excluding its null terminator.
+  let count: Int
+
+  /// The memory mapping holding the string, if it has been loaded from a file.
+  private var file: SourceFile?
+
   init(copying string: String) {
     guard !string.isEmpty else {
       data = nil
+      count = 0
       return
     }
 
@@ -14,10 +23,46 @@ final class ManagedStringBuffer {
       buf.assign(from: cstr.baseAddress!, count: cstr.count)
       return buf
     })
+    count = string.utf8.count
+  }
+
+  /// Creates a buffer holding the contents of `base`, in which the bytes in `range` have been
+  /// replaced by the UTF-8 representation of `replacement`.
+  init(replacing range: Range<Int>, of base: ManagedStringBuffer, with replacement: String) {
+    let inserted = Array(replacement.utf8)
+    count = base.count - range.count + inserted.count
+
+    let buf = UnsafeMutablePointer<CChar>.allocate(capacity: count + 1)
+    if range.lowerBound > 0 {
+      buf.assign(from: base.data!, count: range.lowerBound)
+    }
+    UnsafeMutableRawPointer(buf + range.lowerBound)
+      .copyMemory(from: inserted, byteCount: inserted.count)
+    if range.upperBound < base.count {
+      (buf + range.lowerBound + inserted.count)
+        .assign(from: base.data! + range.upperBound, count: base.count - range.upperBound)
+    }
+    buf[count] = 0
+    data = buf
+  }
+
+  /// Creates a buffer mapping the contents of the file at the given path, or returns `nil` if the
+  /// file could not be read.
+  init?(mapping path: String) {
+    var file = SourceFile()
+    guard source_file_open(&file, path) else { return nil }
+
+    self.file = file
+    data = UnsafeMutablePointer(mutating: file.text)
+    count = file.length
   }
 
   deinit {
-    data?.deallocate()
+    if file != nil {
+      source_file_close(&file!)
+    } else {
+      data?.deallocate()
+    }
   }
 
   subscript(position: Int) -> CChar {
@@ -0,0 +1,11 @@
+import CCocodol
+
+/// A namespace for the memory allocation statistics of the C core.
+public enum Memory {
+
+  /// The number of allocations performed by the C core that have not been freed yet.
+  public static var liveAllocationCount: Int {
+    return cocodol_live_alloc_count()
+  }
+
+}
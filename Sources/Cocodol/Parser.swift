@@ -9,22 +9,35 @@ public final class Parser {
   /// The context in which the parser operates.
   public let context: Context
 
+  /// The storage of `diagnosticCount`, which is updated by the C parser through its user data.
+  private let diagnosticCounter: UnsafeMutablePointer<Int>
+
+  /// The number of diagnostics reported by the parser so far.
+  public var diagnosticCount: Int { diagnosticCounter.pointee }
+
   /// Creates a new parser in the given context.
   ///
   /// - Parameter context: An AST context.
   public init(in context: Context) {
     self.context = context
-    parser_init(&state, context.state, nil)
+    diagnosticCounter = .allocate(capacity: 1)
+    diagnosticCounter.initialize(to: 0)
+    parser_init_buffered(&state, context.state, diagnosticCounter)
   }
 
   deinit {
     parser_deinit(&state)
+    diagnosticCounter.deallocate()
   }
 
   /// Parses a sequence of top-level declarations from the input buffer.
-  public func parse() -> [Decl] {
+  ///
+  /// - Parameter threadCount: The maximum number of threads used to parse the input. Large inputs
+  ///   are split at top-level declaration boundaries and parsed concurrently.
+  public func parse(threadCount: Int = 1) -> [Decl] {
     var stmtv: UnsafeMutablePointer<NodeID>?
-    let stmtc = CCocodol.parse(&state, &stmtv, reportDiagnostic(error:user:))
+    let stmtc = CCocodol.parse_parallel(
+      &state, &stmtv, max(threadCount, 1), reportDiagnostic(error:user:))
     guard stmtc > 0 else { return [] }
 
     let decls: [Decl] = Array(
@@ -41,6 +54,36 @@ public final class Parser {
     return decls
   }
 
+  /// Updates the top-level declarations of the program after the bytes in `range` have been
+  /// replaced by `replacement`, reparsing only the part of the program affected by the edit.
+  ///
+  /// `decls` must be the top-level declarations of the context's current source, as returned by
+  /// `parse` or by a previous call to this method. The context's source is replaced. Nodes that
+  /// are not affected by the edit are reused, while the others are deleted, so that references to
+  /// nodes within the reparsed region are invalidated.
+  public func reparse(
+    _ decls: [Decl], replacing range: Range<Int>, with replacement: String
+  ) -> [Decl] {
+    let source = ManagedStringBuffer(replacing: range, of: context.source, with: replacement)
+    let edit = SourceEdit(
+      start: range.lowerBound,
+      end: range.upperBound,
+      length: source.count - (context.source.count - range.count))
+
+    var declv: UnsafeMutablePointer<NodeID>? = .allocate(capacity: max(decls.count, 1))
+    for (i, decl) in decls.enumerated() {
+      declv![i] = decl.handle.id
+    }
+
+    let declc = CCocodol.reparse(
+      context.state, source.data, source.count, edit, &declv, decls.count, diagnosticCounter,
+      reportDiagnostic(error:user:))
+    context.source = source
+    defer { declv?.deallocate() }
+
+    return (0 ..< declc).map({ i in NodeHandle(context: context, id: declv![i]).adaptAsDecl()! })
+  }
+
   /// Parses a single declaration.
   public func parseDecl() -> Decl? {
     let id = CCocodol.parse_decl(&state, reportDiagnostic(error:user:))
@@ -65,4 +108,5 @@ public final class Parser {
 private func reportDiagnostic(error: ParseError, user: UnsafePointer<ParserState>?) {
   let message = String(cString: error.message)
   print("\(error.location): error: \(message)")
+  user?.pointee.user_data?.assumingMemoryBound(to: Int.self).pointee += 1
 }
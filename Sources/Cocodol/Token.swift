@@ -66,9 +66,14 @@ public struct Token {
   /// The token's value.
   public let value: CharacterView
 
+  /// The symbol of the token's value if the token is an interned name, or `nil` otherwise.
+  public let symbol: Symbol?
+
   init(cToken: CCocodol.Token, buffer: ManagedStringBuffer) {
     self.kind = Kind(cToken.kind)
-    self.value = CharacterView(buffer: buffer, startIndex: cToken.start, endIndex: cToken.end)
+    self.value = CharacterView(
+      buffer: buffer, startIndex: Int(cToken.start), endIndex: Int(cToken.end))
+    self.symbol = cToken.symbol != ~0 ? cToken.symbol : nil
   }
 
 }
@@ -0,0 +1,195 @@
+import CCocodol
+import Cocodol
+
+/// An analysis that determines which local function is called by each function application whose
+/// callee is a local binding, when that binding provably always refers to the same function.
+///
+/// A local function's name refers to that function unless it is assigned. A local variable refers
+/// to a function if it is initialized with a reference to a binding that does, and if neither of
+/// them is ever assigned. Parameters and captured identifiers are dynamic.
+///
+/// Names are resolved as in the emitter: a declaration is visible from its position to the end of
+/// the enclosing scope, and each function only sees its own locals, parameters and captures.
+final class CalleeAnalysis {
+
+  /// A local binding.
+  private enum Binding {
+
+    /// A local variable or function, identified by its declaration.
+    case local(NodeHandle)
+
+    /// A parameter or a captured identifier.
+    case opaque
+
+  }
+
+  /// The local functions of the program, indexed by declaration.
+  private var functions: [NodeHandle: FunDecl] = [:]
+
+  /// The binding with which each local variable initialized with a reference is initialized,
+  /// indexed by declaration.
+  private var aliases: [NodeHandle: NodeHandle] = [:]
+
+  /// The local variables and functions that are assigned.
+  private var assigned: Set<NodeHandle> = []
+
+  /// The binding called by each function application whose callee is a local binding.
+  private var callees: [NodeHandle: NodeHandle] = [:]
+
+  /// The local bindings of each lexical scope of the function being analyzed.
+  private var scopes: [[Symbol: Binding]] = []
+
+  /// The functions declared in the function being analyzed.
+  private var nestedFunctions: [FunDecl] = []
+
+  /// Analyzes the given program.
+  init(program decls: [Decl]) {
+    // The top-level code is emitted in the `main` function, where global functions and variables
+    // are not local bindings.
+    analyze(body: { () in
+      for decl in decls {
+        if let d = decl as? TopDecl {
+          d.stmts.forEach({ stmt in self.analyze(stmt: stmt) })
+        } else if let initializer = (decl as? VarDecl)?.initializer {
+          self.analyze(expr: initializer)
+        }
+      }
+    }, bindings: [])
+
+    // Global functions capture nothing.
+    for case let decl as FunDecl in decls {
+      analyze(function: decl, isTopLevel: true)
+    }
+  }
+
+  /// Returns the local function called by the given function application, if it is statically
+  /// known.
+  func callee(of expr: ApplyExpr) -> FunDecl? {
+    guard var decl = callees[expr.handle] else { return nil }
+    while !assigned.contains(decl) {
+      if let fun = functions[decl] {
+        return fun
+      }
+      guard let next = aliases[decl] else { break }
+      decl = next
+    }
+    return nil
+  }
+
+  /// Analyzes a function declaration and the functions that it contains.
+  private func analyze(function decl: FunDecl, isTopLevel: Bool) {
+    var bindings = isTopLevel ? [] : decl.captures.compactMap({ $0.symbol })
+    bindings.append(contentsOf: decl.params.compactMap({ $0.symbol }))
+    analyze(body: { () in self.analyze(stmt: decl.body) }, bindings: bindings)
+  }
+
+  /// Analyzes a function, given a closure that visits its body and the names that are bound by its
+  /// declaration.
+  private func analyze(body visitBody: () -> Void, bindings: [Symbol]) {
+    scopes = [[:]]
+    for symbol in bindings {
+      scopes[0][symbol] = .opaque
+    }
+    nestedFunctions = []
+    visitBody()
+
+    // Analyze the nested functions.
+    let functions = nestedFunctions
+    for decl in functions {
+      analyze(function: decl, isTopLevel: false)
+    }
+  }
+
+  /// Returns the declaration of the local variable or function bound to the given symbol, if any.
+  private func local(_ symbol: Symbol) -> NodeHandle? {
+    for scope in scopes.reversed() {
+      guard let binding = scope[symbol] else { continue }
+      if case .local(let decl) = binding {
+        return decl
+      }
+      return nil
+    }
+    return nil
+  }
+
+  /// Analyzes a statement.
+  private func analyze(stmt node: NodeHandle) {
+    switch node.adaptAsAny() {
+    case let d as VarDecl:
+      // The variable is bound before its initializer is emitted.
+      scopes[scopes.count - 1][d.symbol] = .local(d.handle)
+      if let initializer = d.initializer {
+        // A variable initialized with itself holds junk.
+        if let ref = initializer.adapt(as: DeclRefExpr.self),
+           let target = local(ref.symbol),
+           target != d.handle
+        {
+          aliases[d.handle] = target
+        }
+        analyze(expr: initializer)
+      }
+
+    case let d as FunDecl:
+      scopes[scopes.count - 1][d.symbol] = .local(d.handle)
+      functions[d.handle] = d
+      nestedFunctions.append(d)
+
+    case let s as BraceStmt:
+      scopes.append([:])
+      s.stmts.forEach({ stmt in analyze(stmt: stmt) })
+      scopes.removeLast()
+
+    case let s as ExprStmt:
+      analyze(expr: s.expr)
+
+    case let s as IfStmt:
+      analyze(expr: s.cond)
+      analyze(stmt: s.then_)
+      if let else_ = s.else_ {
+        analyze(stmt: else_)
+      }
+
+    case let s as WhileStmt:
+      analyze(expr: s.cond)
+      analyze(stmt: s.body)
+
+    case let s as RetStmt:
+      analyze(expr: s.value)
+
+    default:
+      break
+    }
+  }
+
+  /// Analyzes an expression.
+  private func analyze(expr node: NodeHandle) {
+    switch node.adaptAsExpr() {
+    case let e as ParenExpr:
+      analyze(expr: e.subexpr)
+
+    case let e as UnaryExpr:
+      analyze(expr: e.subexpr)
+
+    case let e as BinaryExpr:
+      if (e.op.kind == .assign),
+         let lhs = e.lhs.adapt(as: DeclRefExpr.self),
+         let decl = local(lhs.symbol)
+      {
+        assigned.insert(decl)
+      }
+      analyze(expr: e.lhs)
+      analyze(expr: e.rhs)
+
+    case let e as ApplyExpr:
+      if let ref = e.callee.adapt(as: DeclRefExpr.self), let decl = local(ref.symbol) {
+        callees[e.handle] = decl
+      }
+      analyze(expr: e.callee)
+      e.args.forEach({ arg in analyze(expr: arg) })
+
+    default:
+      break
+    }
+  }
+
+}
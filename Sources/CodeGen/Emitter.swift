@@ -1,3 +1,4 @@
+import CCocodol
 import Cocodol
 import LLVM
 
@@ -7,6 +8,24 @@ public final class Emitter {
   /// The builder that is used to generate LLVM IR instructions.
   let builder: IRBuilder
 
+  /// The global declarations of the program being emitted.
+  let globals: GlobalAnalysis
+
+  /// The types inferred for the program being emitted.
+  let types: TypeInference
+
+  /// The last uses of the local variables of the program being emitted.
+  let lastUses: LastUseAnalysis
+
+  /// The way the local functions of the program being emitted may escape.
+  let escapes: EscapeAnalysis
+
+  /// The local functions called by the function applications of the program being emitted.
+  let callees: CalleeAnalysis
+
+  /// The LLVM functions emitted for local function declarations.
+  var localFunctions: [NodeHandle: Function] = [:]
+
   /// A collection with information about each function traversed by the code generator.
   var functionContexts = [FunContext(decl: nil)]
 
@@ -15,9 +34,28 @@ public final class Emitter {
 
   /// Creates a new generator.
   ///
-  /// - Parameter builder: An instruction builder.
-  init(builder: IRBuilder) {
+  /// - Parameters:
+  ///   - builder: An instruction builder.
+  ///   - globals: The global declarations of the program being emitted.
+  ///   - types: The types inferred for the program being emitted.
+  ///   - lastUses: The last uses of the local variables of the program being emitted.
+  ///   - escapes: The way the local functions of the program being emitted may escape.
+  ///   - callees: The local functions called by the function applications of the program being
+  ///     emitted.
+  init(
+    builder: IRBuilder,
+    globals: GlobalAnalysis,
+    types: TypeInference,
+    lastUses: LastUseAnalysis,
+    escapes: EscapeAnalysis,
+    callees: CalleeAnalysis
+  ) {
     self.builder = builder
+    self.globals = globals
+    self.types = types
+    self.lastUses = lastUses
+    self.escapes = escapes
+    self.callees = callees
   }
 
   /// The LLVM context owning the module.
@@ -26,6 +64,9 @@ public final class Emitter {
   /// The LLVM module being generated.
   var module: Module { builder.module }
 
+  /// The `i1` type.
+  var i1: IntType { IntType(width: 1, in: llvm) }
+
   /// The `i32` type.
   var i32: IntType { IntType(width: 32, in: llvm) }
 
@@ -46,6 +87,15 @@ public final class Emitter {
     return ty
   }()
 
+  /// Returns the native type of the values of the given kind.
+  func nativeType(of kind: ObjectKind) -> IRType {
+    switch kind {
+    case .bool  : return i1
+    case .float : return f64
+    default     : return i64
+    }
+  }
+
   /// Returns the type of a user function for the given number of parameters.
   func userFunType(paramCount: Int) -> FunctionType {
     return FunctionType(
@@ -64,6 +114,17 @@ public final class Emitter {
       "malloc", type: FunctionType([i64], PointerType.toVoid))
   }
 
+  /// The function that initializes the header of a closure environment.
+  var envInitFunction: Function {
+    if let fun = module.function(named: "_cocodol_env_init") {
+      return fun
+    }
+
+    // Forward-declare the function
+    return builder.addFunction(
+      "_cocodol_env_init", type: FunctionType([PointerType(pointee: any), i64, i64], void))
+  }
+
   /// Cocodol's built-in `drop` function.
   var dropFunction: Function {
     if let fun = module.function(named: "_cocodol_drop") {
@@ -87,25 +148,35 @@ public final class Emitter {
   }
 
   /// The function that implements Cocodol's built-in unary operators.
+  ///
+  /// Operators are applied inline on scalars, so that the runtime is only called on the slow path
+  /// of an application, which is marked cold.
   var unaryOperator: Function {
     if let fun = module.function(named: "_cocodol_unop") {
       return fun
     }
 
     // Forward-declare the function
-    return builder.addFunction(
+    var fun = builder.addFunction(
       "_cocodol_unop", type: FunctionType([i64, i64, i32], any))
+    fun.addAttribute(.cold, to: .function)
+    return fun
   }
 
   /// The function that implements Cocodol's built-in binary operators.
+  ///
+  /// Operators are applied inline on scalars, so that the runtime is only called on the slow path
+  /// of an application, which is marked cold.
   var binaryOperator: Function {
     if let fun = module.function(named: "_cocodol_binop") {
       return fun
     }
 
     // Forward-declare the function
-    return builder.addFunction(
+    var fun = builder.addFunction(
       "_cocodol_binop", type: FunctionType([i64, i64, i64, i64, i32], any))
+    fun.addAttribute(.cold, to: .function)
+    return fun
   }
 
   /// Cocodol's built-in `print` function.
@@ -122,7 +193,7 @@ public final class Emitter {
   /// Cocodol's built-in `print` function, wrapped as a function object.
   var printFunctionObject: IRValue {
     if let fun = module.function(named: "_cocodol_print.wrapper") {
-      return fun
+      return constObject(fun: fun)
     }
 
     // Save the current insertion pointer.
@@ -155,6 +226,54 @@ public final class Emitter {
     return constObject(fun: fun)
   }
 
+  /// Returns Cocodol's built-in input function whose name has the given symbol, or `nil` if
+  /// `symbol` does not denote an input function.
+  func inputFunction(for symbol: Symbol) -> Function? {
+    let name: String
+    switch symbol {
+    case Symbol(sym_read_int)   : name = "_cocodol_read_int"
+    case Symbol(sym_read_float) : name = "_cocodol_read_float"
+    case Symbol(sym_at_eof)     : name = "_cocodol_at_eof"
+    default: return nil
+    }
+
+    if let fun = module.function(named: name) {
+      return fun
+    }
+
+    // Forward-declare the function
+    return builder.addFunction(name, type: FunctionType([], any))
+  }
+
+  /// Returns Cocodol's built-in input function whose name has the given symbol, wrapped as a
+  /// function object, or `nil` if `symbol` does not denote an input function.
+  func inputFunctionObject(for symbol: Symbol) -> IRValue? {
+    guard let input = inputFunction(for: symbol) else { return nil }
+    if let fun = module.function(named: "\(input.name).wrapper") {
+      return constObject(fun: fun)
+    }
+
+    // Save the current insertion pointer.
+    let current = builder.insertBlock
+
+    var fun = builder.addFunction(
+      "\(input.name).wrapper", type: userFunType(paramCount: 0))
+    fun.linkage = .private
+    fun.addAttribute(.norecurse , to: .function)
+    fun.addAttribute(.nounwind  , to: .function)
+    fun.addAttribute(.ssp       , to: .function)
+    fun.addAttribute(.nocapture , to: .argument(0))
+    fun.addAttribute(.readnone  , to: .argument(0))
+
+    let entry = fun.appendBasicBlock(named: "entry")
+    builder.positionAtEnd(of: entry)
+    builder.buildRet(builder.buildCall(input, args: []))
+
+    // Restore the insertion pointer.
+    current.map(builder.positionAtEnd(of:))
+    return constObject(fun: fun)
+  }
+
   /// Creates an alloca at the beginning of the current function.
   ///
   /// - Parameters:
@@ -221,18 +340,35 @@ public final class Emitter {
     let entry = main.appendBasicBlock(named: "entry")
     builder.positionAtEnd(of: entry)
 
-    // Scan the top-level declarations to forward-declare global functions.
-    for case let decl as FunDecl in decls {
-      let name = String(decl.name)
-      guard module.function(named: name) == nil else {
-        throw EmitterError(message: "duplicate function '\(name)'", range: decl.handle.range)
+    // Scan the top-level declarations to forward-declare global functions and variables, which can
+    // be referred to before their declaration.
+    for decl in decls {
+      switch decl {
+      case let d as FunDecl:
+        let name = String(d.name)
+        guard module.function(named: name) == nil else {
+          throw EmitterError(message: "duplicate function '\(name)'", range: d.handle.range)
+        }
+        _ = builder.addFunction(name, type: userFunType(paramCount: d.params.count))
+
+      case let d as VarDecl where !globals.isLocalToMain(d):
+        let name = String(d.name)
+        guard module.global(named: name) == nil else {
+          throw EmitterError(message: "duplicate identifier '\(name)'", range: d.handle.range)
+        }
+        _ = builder.addGlobal(name, initializer: constObject(kind: .junk))
+
+      default:
+        break
       }
-      _ = builder.addFunction(name, type: userFunType(paramCount: decl.params.count))
     }
 
     // Emit the program's top-level declarations.
     try decls.forEach({ decl in try emit(any: decl, isTopLevel: true) })
 
+    // Drop the global variables that are local to `main`.
+    emit(drop: functionContexts[0].scopes[0])
+
     // Emit the return statement of the main function.
     builder.buildRet(i32.constant(0))
   }
@@ -268,52 +404,38 @@ public final class Emitter {
 
   /// Emits a variable declaration.
   func emit(decl: VarDecl, isTopLevel: Bool = false) throws {
-    if (isTopLevel) {
+    // Global variables that no function refers to are emitted as locals of the `main` function.
+    if isTopLevel && !globals.isLocalToMain(decl) {
       assert(builder.currentFunction?.name == "main")
 
-      // Emit a global variable.
-      let name = String(decl.name)
-      guard module.global(named: name) == nil else {
-        throw EmitterError(message: "duplicate identifier '\(name)'", range: decl.handle.range)
-      }
-      let global = builder.addGlobal(name, initializer: constObject(kind: .junk))
+      // Global variables are forward-declared.
+      let global = module.global(named: String(decl.name))!
 
-      // If the variable has an initializer, wrap it in an function `() -> Any` that's called at
-      // the beginning of the `main` function.
+      // If the variable has an initializer, emit it in the `main` function, where the locals of
+      // the top-level code are bound.
       if let initializer = decl.initializer {
-        // Save the current insertion pointer.
-        let current = builder.insertBlock
-
-        // Create the init function.
-        let fun = builder.addFunction("\(name).initializer", type: FunctionType([], any))
-        fun.addAttribute(.norecurse , to: .function)
-        fun.addAttribute(.nounwind  , to: .function)
-        fun.addAttribute(.ssp       , to: .function)
-
-        let entry = fun.appendBasicBlock(named: "entry")
-        builder.positionAtEnd(of: entry)
-
-        // Emit the initializer's expression within the init function.
-        builder.buildRet(try emit(expr: initializer.adaptAsExpr()!))
-
-        // Restore the insertion pointer.
-        current.map(builder.positionAtEnd(of:))
-
-        // Call the initializer from the main function.
-        let initValue = builder.buildCall(fun, args: [])
-        builder.buildStore(initValue, to: global)
+        builder.buildStore(try emit(owned: initializer.adaptAsExpr()!), to: global)
       }
     } else {
       assert(!functionContexts.isEmpty)
 
+      // Store the variable unboxed if its type is statically known to be a scalar. Such a variable
+      // always has an initializer.
+      if let kind = types.type(of: decl).scalarKind {
+        let local = addEntryAlloca(type: nativeType(of: kind), name: String(decl.name))
+        functionContexts[functionContexts.count - 1].bind(value: local, kind: kind, to: decl.symbol)
+        builder.buildStore(
+          try emit(native: decl.initializer!.adaptAsExpr()!, kind: kind), to: local)
+        return
+      }
+
       // Allocate space for the variable.
-      let name = String(decl.name)
-      let local = addEntryAlloca(type: any, name: name)
-      functionContexts[functionContexts.count - 1].bind(value: local, to: name)
+      let local = addEntryAlloca(type: any, name: String(decl.name))
+      functionContexts[functionContexts.count - 1].bind(value: local, to: decl.symbol)
 
       // Emit the variable's initialization.
       if let initializer = decl.initializer {
-        let initValue = try emit(expr: initializer.adaptAsExpr()!)
+        let initValue = try emit(owned: initializer.adaptAsExpr()!)
         builder.buildStore(initValue, to: local)
       } else {
         builder.buildStore(constObject(kind: .junk), to: local)
@@ -342,7 +464,12 @@ public final class Emitter {
       guard module.function(named: name) == nil else {
         throw EmitterError(message: "duplicate function '\(name)'", range: decl.handle.range)
       }
-      fun = builder.addFunction(name, type: userFunType(paramCount: decl.params.count))
+      // Local functions are only called from within the module, either directly or through
+      // function objects, so they can be internalized.
+      var local = builder.addFunction(name, type: userFunType(paramCount: decl.params.count))
+      local.linkage = .internal
+      localFunctions[decl.handle] = local
+      fun = local
     }
 
     // Emit the function.
@@ -354,28 +481,41 @@ public final class Emitter {
       ? []
       : decl.captures
 
+    // Allocate the environments of the functions that don't escape on the stack.
+    let isEnvOnStack = !isTopLevel && (escapes.escape(of: decl) != .escaping)
+
     var env: IRValue
     if !captures.isEmpty {
       // Allocate and populate the function's environment.
-      let size = builder.buildAdd(
-        emit(sizeOf: i64),
-        builder.buildMul(i64.constant(captures.count), emit(sizeOf: any)))
-      env = builder.buildCall(mallocFunction, args: [size])
-
-      // Store the size of the environment.
-      let count = builder.buildBitCast(env, type: PointerType(pointee: i64))
-      builder.buildStore(i64.constant(captures.count), to: count)
+      if isEnvOnStack {
+        let storage = addEntryAlloca(
+          type: ArrayType(elementType: i64, count: 1 + 2 * captures.count),
+          name: String(decl.name) + ".env")
+        env = builder.buildBitCast(storage, type: PointerType.toVoid)
+      } else {
+        let size = builder.buildAdd(
+          emit(sizeOf: i64),
+          builder.buildMul(i64.constant(captures.count), emit(sizeOf: any)))
+        env = builder.buildCall(mallocFunction, args: [size])
+      }
 
       // Store the captured parameters.
       env = builder.buildGEP(env, type: PointerType.toVoid.pointee, indices: [emit(sizeOf: i64)])
       env = builder.buildBitCast(env, type: PointerType(pointee: any))
 
       for (i, capture) in captures.enumerated() {
-        let val = builder.buildLoad(
-          functionContexts.last!.value(boundTo: String(capture))!, type: any)
+        let binding = functionContexts.last!.binding(of: capture.symbol!)!
+        assert(binding.stackEnvSize == nil, "a function with a stack environment is copied")
+        let val = emit(load: binding)
         let loc = builder.buildGEP(env, type: any, indices: [i64.constant(i)])
         builder.buildStore(emit(copy: val), to: loc)
       }
+
+      // Initialize the environment's header, which stores its size and its reference count.
+      let isMutating = assignsCaptures(of: decl)
+      _ = builder.buildCall(
+        envInitFunction,
+        args: [env, i64.constant(captures.count), i64.constant(isMutating ? 1 : 0)])
     } else {
       env = PointerType(pointee: any).null()
     }
@@ -387,7 +527,8 @@ public final class Emitter {
       let _1 = builder.buildStructGEP(loc, type: any, index: 1)
       builder.buildStore(builder.buildPtrToInt(env, type: i64), to: _1)
 
-      functionContexts[functionContexts.count - 1].bind(value: loc, to: String(decl.name))
+      functionContexts[functionContexts.count - 1].bind(
+        value: loc, stackEnvSize: isEnvOnStack ? captures.count : nil, to: decl.symbol)
     }
 
     var funCtx = FunContext(decl: decl)
@@ -397,14 +538,22 @@ public final class Emitter {
     // Configure the local scope to map captured symbols onto the function's environment.
     for (i, capture) in captures.enumerated() {
       let loc = builder.buildGEP(fun.parameters.last!, type: any, indices: [i32.constant(i)])
-      funCtx.bind(value: loc, to: String(capture))
+      funCtx.bind(value: loc, to: capture.symbol!)
     }
 
-    // Configure the parameters.
+    // Configure the parameters, unboxing those whose type is statically known to be a scalar.
+    let paramTypes = types.parameterTypes(of: decl)
     for (i, param) in decl.params.enumerated() {
 //      fun.addAttribute(.byval     , to: .argument(i))
       fun.addAttribute(.nocapture , to: .argument(i))
-      funCtx.bind(value: fun.parameter(at: i)!, to: String(param.value))
+      if let kind = paramTypes[i].scalarKind {
+        let local = addEntryAlloca(type: nativeType(of: kind), name: String(param.value))
+        builder.buildStore(
+          emit(unbox: builder.buildLoad(fun.parameter(at: i)!, type: any), kind: kind), to: local)
+        funCtx.bind(value: local, kind: kind, to: param.symbol!)
+      } else {
+        funCtx.bind(value: fun.parameter(at: i)!, to: param.symbol!)
+      }
     }
 
     // Emit the function's body.
@@ -422,8 +571,44 @@ public final class Emitter {
     current.map(builder.positionAtEnd(of:))
   }
 
-  /// Emits an expression.
+  /// Returns whether the given function may assign any of the identifiers that it captures, in
+  /// which case its environment cannot be shared between its copies.
+  ///
+  /// The analysis is conservative, as it ignores shadowing. The assignments made by nested
+  /// functions are not considered, since these functions capture copies of the values.
+  func assignsCaptures(of decl: FunDecl) -> Bool {
+    let captures = Set(decl.captures.compactMap({ $0.symbol }))
+    var result = false
+
+    decl.body.walk(with: { (node, event) -> Bool in
+      // Abort the walk as soon as an assignment has been found.
+      guard event == .enter else { return !result }
+
+      switch node.adaptAsAny() {
+      case is FunDecl:
+        return false
+      case let e as BinaryExpr:
+        if (e.op.kind == .assign),
+           let lhs = e.lhs.adapt(as: DeclRefExpr.self),
+           captures.contains(lhs.symbol)
+        {
+          result = true
+        }
+        return true
+      default:
+        return true
+      }
+    })
+    return result
+  }
+
+  /// Emits an expression, as an object.
   func emit(expr: Expr) throws -> IRValue {
+    // Apply operators natively if their result is statically known to be a scalar.
+    if (expr is UnaryExpr) || (expr is BinaryExpr), let kind = types.type(of: expr).scalarKind {
+      return emit(box: try emit(native: expr, kind: kind), kind: kind)
+    }
+
     switch expr {
     case let e as DeclRefExpr : return try emit(expr: e)
     case let e as BoolExpr    : return emit(expr: e)
@@ -440,17 +625,22 @@ public final class Emitter {
   /// Emits a declaration reference.
   func emit(expr: DeclRefExpr) throws -> IRValue {
     // Emit the built-in `print` function.
-    if expr.name == "print" {
+    if expr.symbol == Symbol(sym_print) {
       return printFunctionObject
     }
 
+    // Emit the built-in input functions.
+    if let fun = inputFunctionObject(for: expr.symbol) {
+      return fun
+    }
+
     // Search within the locals.
-    let name = String(expr.name)
-    if let loc = functionContexts.last?.value(boundTo: name) {
-      return builder.buildLoad(loc, type: any)
+    if let binding = functionContexts.last?.binding(of: expr.symbol) {
+      return emit(load: binding)
     }
 
     // Search within the global variables.
+    let name = String(expr.name)
     if let global = module.global(named: name) {
       assert(!global.isAFunction)
       return builder.buildLoad(global, type: any)
@@ -467,13 +657,12 @@ public final class Emitter {
   /// Emits a declaration reference as an l-value.
   func emit(lvalue expr: DeclRefExpr) throws -> IRValue {
     // Search within the locals.
-    let name = String(expr.name)
-    if let loc = functionContexts.last?.value(boundTo: name) {
-      return loc
+    if let binding = functionContexts.last?.binding(of: expr.symbol) {
+      return binding.location
     }
 
     // Search within the globals.
-    guard let global = module.global(named: name) else {
+    guard let global = module.global(named: String(expr.name)) else {
       throw EmitterError(message: "unbound identifier '\(expr.name)'", range: expr.handle.range)
     }
     return global
@@ -495,18 +684,36 @@ public final class Emitter {
   }
 
   /// Emits a unary expression
+  ///
+  /// The operator is applied inline if the operand is a scalar that supports it, and through the
+  /// runtime otherwise.
   func emit(expr: UnaryExpr) throws -> IRValue {
     // Emit the operands.
-    let subexpr = try emit(expr: expr.subexpr.adaptAsExpr()!)
-
-    // Emit a call to the built-in unary operator.
-    return builder.buildCall(
-      unaryOperator,
-      args: [
-        builder.buildExtractValue(subexpr, index: 0),
-        builder.buildExtractValue(subexpr, index: 1),
-        i32.constant(expr.op.kind.rawValue),
-      ])
+    let subexpr = expr.subexpr.adaptAsExpr()!
+    let operand = try emit(expr: subexpr)
+
+    // Emit a fast path for each kind of operand that supports the operator.
+    let op = expr.op.kind
+    let kinds = [ObjectKind.integer, .float, .bool].filter({ (kind) -> Bool in
+      StaticType(kind).applying(unary: op) != .any
+    })
+
+    return emit(
+      operator: [operand], types: [types.type(of: subexpr)], fastPathKinds: kinds,
+      fast: { (kind, values) in
+        let result = self.emit(nativeOperator: op, values[0])
+        return self.emit(box: result, kind: StaticType(kind).applying(unary: op).scalarKind!)
+      },
+      slow: { () in
+        // Emit a call to the built-in unary operator.
+        self.builder.buildCall(
+          self.unaryOperator,
+          args: [
+            self.builder.buildExtractValue(operand, index: 0),
+            self.builder.buildExtractValue(operand, index: 1),
+            i32.constant(op.rawValue),
+          ])
+      })
   }
 
   /// Emits a binary expression
@@ -516,35 +723,160 @@ public final class Emitter {
       return try emit(assignment: expr)
     }
 
+    // Handle logical operators.
+    guard (expr.op.kind != .and) && (expr.op.kind != .or) else {
+      return emit(box: try emit(logical: expr), kind: .bool)
+    }
+
     // Emit the operands.
-    let lhs = try emit(expr: expr.lhs.adaptAsExpr()!)
-    let rhs = try emit(expr: expr.rhs.adaptAsExpr()!)
+    let lhsExpr = expr.lhs.adaptAsExpr()!
+    let rhsExpr = expr.rhs.adaptAsExpr()!
+    let lhs = try emit(expr: lhsExpr)
+    let rhs = try emit(expr: rhsExpr)
+
+    // Emit a fast path for each kind of operands that supports the operator.
+    let op = expr.op.kind
+    let kinds = [ObjectKind.integer, .float].filter({ (kind) -> Bool in
+      StaticType(kind).applying(binary: op, to: StaticType(kind)) != .any
+    })
+
+    return emit(
+      operator: [lhs, rhs], types: [types.type(of: lhsExpr), types.type(of: rhsExpr)],
+      fastPathKinds: kinds,
+      fast: { (kind, values) in
+        let result = self.emit(nativeOperator: op, values[0], values[1], kind: kind)
+        let type = StaticType(kind).applying(binary: op, to: StaticType(kind))
+        return self.emit(box: result, kind: type.scalarKind!)
+      },
+      slow: { () in
+        // Emit a call to the built-in binary operator.
+        self.builder.buildCall(
+          self.binaryOperator,
+          args: [
+            self.builder.buildExtractValue(lhs, index: 0),
+            self.builder.buildExtractValue(lhs, index: 1),
+            self.builder.buildExtractValue(rhs, index: 0),
+            self.builder.buildExtractValue(rhs, index: 1),
+            i32.constant(op.rawValue),
+          ])
+      })
+  }
+
+  /// Emits the application of an operator on objects whose kinds are not statically known.
+  ///
+  /// For each of the given kinds, the operands' tags are compared against that kind and, if they
+  /// all match, the operator is applied natively by a fast path. The first test is expected to
+  /// succeed, so that the optimizer lays out the remaining ones out of the hot path. The runtime is
+  /// called only if no test succeeds.
+  ///
+  /// - Parameters:
+  ///   - operands: The operands, as objects.
+  ///   - operandTypes: The static type of each operand. Operands already known to be of the kind
+  ///     being tested are not checked, and kinds that an operand is known not to have are skipped.
+  ///   - kinds: The kinds of operands for which a fast path is emitted, by order of preference.
+  ///   - fast: A closure that emits the native application of the operator on operands of the
+  ///     given kind, and returns its result as an object.
+  ///   - slow: A closure that emits the application of the operator by the runtime.
+  func emit(
+    operator operands: [IRValue],
+    types operandTypes: [StaticType],
+    fastPathKinds kinds: [ObjectKind],
+    fast: (ObjectKind, [IRValue]) -> IRValue,
+    slow: () -> IRValue
+  ) -> IRValue {
+    let candidates = kinds.filter({ (kind) -> Bool in
+      operandTypes.allSatisfy({ ($0.scalarKind == nil) || ($0.scalarKind == kind) })
+    })
+    guard !candidates.isEmpty else { return slow() }
 
-    // Emit a call to the built-in binary operator.
-    return builder.buildCall(
-      binaryOperator,
-      args: [
-        builder.buildExtractValue(lhs, index: 0),
-        builder.buildExtractValue(lhs, index: 1),
-        builder.buildExtractValue(rhs, index: 0),
-        builder.buildExtractValue(rhs, index: 1),
-        i32.constant(expr.op.kind.rawValue),
-      ])
+    let fun = builder.currentFunction!
+    let joinBB = fun.appendBasicBlock(named: "join")
+    var incoming: [(IRValue, BasicBlock)] = []
+
+    for kind in candidates {
+      // Check the tags of the operands whose kind is not statically known.
+      var cond: IRValue = i1.constant(1)
+      for (operand, type) in zip(operands, operandTypes) where type.scalarKind != kind {
+        cond = builder.buildAnd(cond, emit(operand, isA: kind))
+      }
+
+      let fastBB = fun.appendBasicBlock(named: "fast")
+      let nextBB = fun.appendBasicBlock(named: "next")
+      emit(likely: cond, then: fastBB, else: nextBB)
+
+      // Emit the fast path.
+      builder.positionAtEnd(of: fastBB)
+      let result = fast(kind, operands.map({ emit(unbox: $0, kind: kind) }))
+      incoming.append((result, builder.insertBlock!))
+      builder.buildBr(joinBB)
+      builder.positionAtEnd(of: nextBB)
+    }
+
+    // Emit the slow path.
+    incoming.append((slow(), builder.insertBlock!))
+    builder.buildBr(joinBB)
+
+    // Merge the results.
+    builder.positionAtEnd(of: joinBB)
+    let phi = builder.buildPhi(any)
+    phi.addIncoming(incoming)
+    return phi
+  }
+
+  /// Emits a logical operator (i.e., `and` or `or`) with short-circuit semantics, as an `i1`.
+  ///
+  /// The right operand is evaluated in its own block, which is entered only if the left operand
+  /// does not determine the result. Both values are then merged with a phi node.
+  func emit(logical expr: BinaryExpr) throws -> IRValue {
+    let fun = builder.currentFunction!
+
+    // Emit the left operand.
+    let lhsValue = try emit(condition: expr.lhs.adaptAsExpr()!)
+    let lhsBB = builder.insertBlock!
+
+    // Emit the branch.
+    let rhsBB = fun.appendBasicBlock(named: "rhs")
+    let joinBB = fun.appendBasicBlock(named: "join")
+    if expr.op.kind == .and {
+      builder.buildCondBr(condition: lhsValue, then: rhsBB, else: joinBB)
+    } else {
+      builder.buildCondBr(condition: lhsValue, then: joinBB, else: rhsBB)
+    }
+
+    // Emit the right operand.
+    builder.positionAtEnd(of: rhsBB)
+    let rhsValue = try emit(condition: expr.rhs.adaptAsExpr()!)
+    let rhsEndBB = builder.insertBlock!
+    builder.buildBr(joinBB)
+
+    // Merge the results.
+    builder.positionAtEnd(of: joinBB)
+    let phi = builder.buildPhi(i1)
+    phi.addIncoming([(lhsValue, lhsBB), (rhsValue, rhsEndBB)])
+    return phi
   }
 
   /// Emits an assignment.
   func emit(assignment: BinaryExpr) throws -> IRValue {
-    // Emit the left operand as an l-value.
-    let lvalue: IRValue
-    if let lhs = assignment.lhs.adapt(as: DeclRefExpr.self) {
-      lvalue = try emit(lvalue: lhs)
-    } else {
+    guard let lhs = assignment.lhs.adapt(as: DeclRefExpr.self) else {
       throw EmitterError(message: "invalid l-value", range: assignment.lhs.range)
     }
+    let rhs = assignment.rhs.adaptAsExpr()!
 
-    // Emit the assignment.
-    let rvalue = try emit(expr: assignment.rhs.adaptAsExpr()!)
-    builder.buildStore(emit(copy: rvalue), to: lvalue)
+    // Assign unboxed variables natively.
+    if let binding = functionContexts.last?.binding(of: lhs.symbol), let kind = binding.kind {
+      builder.buildStore(try emit(native: rhs, kind: kind), to: binding.location)
+      return constObject(kind: .junk)
+    }
+
+    // Emit the right operand, then the left operand as an l-value.
+    let rvalue = try emit(owned: rhs)
+    let lvalue = try emit(lvalue: lhs)
+
+    // Emit the assignment, dropping the old value.
+    let old = builder.buildLoad(lvalue, type: any)
+    builder.buildStore(rvalue, to: lvalue)
+    emit(drop: old)
     return constObject(kind: .junk)
   }
 
@@ -552,13 +884,12 @@ public final class Emitter {
   func emit(expr: ApplyExpr) throws -> IRValue {
     var global: Function?
     var object: IRValue?
+    var direct: (fun: Function, env: IRValue)?
 
     // Handle direct calls to statically known functions.
     if let ref = expr.callee.adapt(as: DeclRefExpr.self) {
-      let name = String(ref.name)
-
       // Handle direct calls to `print`.
-      if name == "print" {
+      if ref.symbol == Symbol(sym_print) {
         // There should exactly one argument.
         guard expr.args.count == 1 else {
           throw EmitterError(
@@ -566,23 +897,47 @@ public final class Emitter {
             range: ref.handle.range)
         }
 
-        // Emit the call.
-        let arg = try emit(expr: expr.args[0].adaptAsExpr()!)
+        // Emit the call, borrowing the argument.
+        let argExpr = expr.args[0].adaptAsExpr()!
+        let arg = try emit(expr: argExpr)
         let _0 = builder.buildExtractValue(arg, index: 0)
         let _1 = builder.buildExtractValue(arg, index: 1)
         _ = builder.buildCall(printFunction, args: [_0, _1])
+        if isTemporary(argExpr) && (types.type(of: argExpr).scalarKind == nil) {
+          emit(drop: arg)
+        }
         return constObject(kind: .junk)
       }
 
-      // Search within the locals.
-      if let loc = functionContexts.last?.value(boundTo: name) {
-        object = builder.buildLoad(loc, type: any)
+      // Handle direct calls to the input functions.
+      if let fun = inputFunction(for: ref.symbol) {
+        // There should be no argument.
+        guard expr.args.isEmpty else {
+          throw EmitterError(
+            message: "invalid argument count: expected 0, got \(expr.args.count)",
+            range: ref.handle.range)
+        }
+
+        return builder.buildCall(fun, args: [])
+      }
+
+      // Search within the locals, calling statically known local functions directly.
+      if let binding = functionContexts.last?.binding(of: ref.symbol) {
+        if let decl = callees.callee(of: expr),
+           decl.params.count == expr.args.count,
+           let fun = localFunctions[decl.handle]
+        {
+          direct = (fun: fun, env: emit(extractEnvFromPointer: binding.location))
+        } else {
+          object = emit(load: binding)
+        }
       }
 
       // Search for a global function.
+      let name = String(ref.name)
       global = module.function(named: name)
 
-      if (object == nil) && (global == nil) {
+      if (object == nil) && (global == nil) && (direct == nil) {
         guard let g = module.global(named: name) else {
           throw EmitterError(message: "unbound identifier '\(name)'", range: expr.callee.range)
         }
@@ -597,14 +952,15 @@ public final class Emitter {
     for subexpr in expr.args {
       let arg = addEntryAlloca(type: any)
       args.append(arg)
-
-      let val = try emit(expr: subexpr.adaptAsExpr()!)
-      builder.buildStore(emit(copy: val), to: arg)
+      builder.buildStore(try emit(owned: subexpr.adaptAsExpr()!), to: arg)
     }
 
     // If we found a function object, apply it.
     let result: Call
-    if let callee = object {
+    if let callee = direct {
+      // Emit a direct call to a local function, passing the environment of its binding.
+      result = builder.buildCall(callee.fun, args: args + [callee.env])
+    } else if let callee = object {
       // Extract the function pointer.
       emit(assert: callee, isA: .function)
       let fun = emit(
@@ -621,10 +977,14 @@ public final class Emitter {
       unreachable()
     }
 
-    // Drop the arguments.
-    for arg in args {
+    // Drop the arguments, except scalars, and the callee if it is a temporary.
+    for (arg, subexpr) in zip(args, expr.args)
+    where types.type(of: subexpr.adaptAsExpr()!).scalarKind == nil {
       emit(dropPointer: arg)
     }
+    if let callee = object, isTemporary(expr.callee.adaptAsExpr()!) {
+      emit(drop: callee)
+    }
 
     return result
   }
@@ -634,6 +994,177 @@ public final class Emitter {
     return try emit(expr: expr.subexpr.adaptAsExpr()!)
   }
 
+  /// Emits an expression whose value is statically known to be of the given scalar kind, as a
+  /// native value (i.e., an `i1`, an `i64` or a `double`).
+  func emit(native expr: Expr, kind: ObjectKind) throws -> IRValue {
+    switch expr {
+    case let e as BoolExpr:
+      return i1.constant(e.value ? 1 : 0)
+
+    case let e as IntegerExpr:
+      return i64.constant(Int64(e.value))
+
+    case let e as FloatExpr:
+      return f64.constant(e.value)
+
+    case let e as ParenExpr:
+      return try emit(native: e.subexpr.adaptAsExpr()!, kind: kind)
+
+    case let e as DeclRefExpr:
+      if let binding = functionContexts.last?.binding(of: e.symbol), binding.kind == kind {
+        return builder.buildLoad(binding.location, type: nativeType(of: kind))
+      }
+
+    case let e as UnaryExpr:
+      if types.type(of: e).scalarKind == kind {
+        return try emit(nativeUnary: e, kind: kind)
+      }
+
+    case let e as BinaryExpr:
+      if (e.op.kind == .and) || (e.op.kind == .or) {
+        return try emit(logical: e)
+      } else if types.type(of: e).scalarKind == kind {
+        return try emit(nativeBinary: e)
+      }
+
+    default:
+      break
+    }
+
+    // Other expressions produce objects whose kind is guaranteed at runtime (e.g., the result of
+    // `read_int`), from which the value can be extracted without any check.
+    return emit(unbox: try emit(expr: expr), kind: kind)
+  }
+
+  /// Emits a unary expression whose operand is statically known to be of the given scalar kind,
+  /// as a native instruction.
+  func emit(nativeUnary expr: UnaryExpr, kind: ObjectKind) throws -> IRValue {
+    let operand = try emit(native: expr.subexpr.adaptAsExpr()!, kind: kind)
+    return emit(nativeOperator: expr.op.kind, operand)
+  }
+
+  /// Emits the application of a unary operator on a native value whose kind supports it.
+  func emit(nativeOperator op: Token.Kind, _ operand: IRValue) -> IRValue {
+    switch op {
+    case .plus          : return operand
+    case .minus         : return builder.buildNeg(operand)
+    case .not, .tilde   : return builder.buildNot(operand)
+    default             : unreachable()
+    }
+  }
+
+  /// Emits a binary expression whose operands are statically known to be of the same scalar kind,
+  /// as a native instruction.
+  func emit(nativeBinary expr: BinaryExpr) throws -> IRValue {
+    let lhsExpr = expr.lhs.adaptAsExpr()!
+    let kind = types.type(of: lhsExpr).scalarKind!
+    let lhs = try emit(native: lhsExpr, kind: kind)
+    let rhs = try emit(native: expr.rhs.adaptAsExpr()!, kind: kind)
+    return emit(nativeOperator: expr.op.kind, lhs, rhs, kind: kind)
+  }
+
+  /// Emits the application of a binary operator on native values of the given scalar kind, which
+  /// must support it.
+  func emit(
+    nativeOperator op: Token.Kind, _ lhs: IRValue, _ rhs: IRValue, kind: ObjectKind
+  ) -> IRValue {
+    if kind == .float {
+      switch op {
+      case .star    : return builder.buildMul(lhs, rhs)
+      case .slash   : return builder.buildDiv(lhs, rhs)
+      case .percent : return builder.buildRem(lhs, rhs)
+      case .plus    : return builder.buildAdd(lhs, rhs)
+      case .minus   : return builder.buildSub(lhs, rhs)
+      case .lt      : return builder.buildFCmp(lhs, rhs, .orderedLessThan)
+      case .le      : return builder.buildFCmp(lhs, rhs, .orderedLessThanOrEqual)
+      case .gt      : return builder.buildFCmp(lhs, rhs, .orderedGreaterThan)
+      case .ge      : return builder.buildFCmp(lhs, rhs, .orderedGreaterThanOrEqual)
+      case .eq      : return builder.buildFCmp(lhs, rhs, .orderedEqual)
+      case .ne      : return builder.buildFCmp(lhs, rhs, .unorderedNotEqual)
+      default       : unreachable()
+      }
+    } else {
+      switch op {
+      case .lShift  : return builder.buildShl(lhs, rhs)
+      case .rShift  : return builder.buildShr(lhs, rhs, isArithmetic: true)
+      case .star    : return builder.buildMul(lhs, rhs)
+      case .slash   : return builder.buildDiv(lhs, rhs, signed: true)
+      case .percent : return builder.buildRem(lhs, rhs, signed: true)
+      case .plus    : return builder.buildAdd(lhs, rhs)
+      case .minus   : return builder.buildSub(lhs, rhs)
+      case .pipe    : return builder.buildOr(lhs, rhs)
+      case .amp     : return builder.buildAnd(lhs, rhs)
+      case .caret   : return builder.buildXor(lhs, rhs)
+      case .lt      : return builder.buildICmp(lhs, rhs, .signedLessThan)
+      case .le      : return builder.buildICmp(lhs, rhs, .signedLessThanOrEqual)
+      case .gt      : return builder.buildICmp(lhs, rhs, .signedGreaterThan)
+      case .ge      : return builder.buildICmp(lhs, rhs, .signedGreaterThanOrEqual)
+      case .eq      : return builder.buildICmp(lhs, rhs, .equal)
+      case .ne      : return builder.buildICmp(lhs, rhs, .notEqual)
+      default       : unreachable()
+      }
+    }
+  }
+
+  /// Emits a condition, as an `i1`, trapping unless its value is a Boolean.
+  func emit(condition expr: Expr) throws -> IRValue {
+    // Conditions that are statically known to be Booleans need no check.
+    if types.type(of: expr) == .bool {
+      return try emit(native: expr, kind: .bool)
+    }
+
+    let value = try emit(expr: expr)
+    emit(assert: value, isA: .bool)
+    return emit(unbox: value, kind: .bool)
+  }
+
+  /// Emits an expression, as an object owned by the caller.
+  ///
+  /// Temporaries and scalars are moved. A local variable is moved on its last use, leaving junk in
+  /// its storage so that dropping its scope has no effect. Other values are copied.
+  func emit(owned expr: Expr) throws -> IRValue {
+    if isTemporary(expr) || (types.type(of: expr).scalarKind != nil) {
+      return try emit(expr: expr)
+    }
+
+    // The escape analysis only allocates the environment of a function on the stack if its value
+    // is never moved or copied out of the scope that declares it.
+    assert(!refersToStackEnv(expr), "a function with a stack environment escapes")
+
+    if let ref = expr as? DeclRefExpr, lastUses.isLastUse(ref),
+       let binding = functionContexts.last?.binding(of: ref.symbol)
+    {
+      let value = emit(load: binding)
+      builder.buildStore(constObject(kind: .junk), to: binding.location)
+      return value
+    }
+
+    return emit(copy: try emit(expr: expr))
+  }
+
+  /// Returns whether the value of the given expression is a temporary, owned by the code that
+  /// emits it, rather than a value borrowed from a variable or a constant.
+  func isTemporary(_ expr: Expr) -> Bool {
+    switch expr {
+    case let e as ParenExpr : return isTemporary(e.subexpr.adaptAsExpr()!)
+    case is DeclRefExpr     : return false
+    default                 : return true
+    }
+  }
+
+  /// Returns whether the given expression refers to a local function whose environment is
+  /// allocated on the stack.
+  func refersToStackEnv(_ expr: Expr) -> Bool {
+    switch expr {
+    case let e as ParenExpr:
+      return refersToStackEnv(e.subexpr.adaptAsExpr()!)
+    case let e as DeclRefExpr:
+      return functionContexts.last?.binding(of: e.symbol)?.stackEnvSize != nil
+    default:
+      return false
+    }
+  }
+
   /// Emits a brace statement.
   func emit(stmt: BraceStmt) throws -> EmitterAction {
     functionContexts[functionContexts.count - 1].pushScope(stmt: stmt)
@@ -656,8 +1187,16 @@ public final class Emitter {
 
   /// Emits an expression statement.
   func emit(stmt: ExprStmt) throws -> EmitterAction {
-    let value = try emit(expr: stmt.expr.adaptAsExpr()!)
-    emit(drop: value)
+    let expr = stmt.expr.adaptAsExpr()!
+    if let kind = types.type(of: expr).scalarKind {
+      // Scalars need not be boxed nor dropped.
+      _ = try emit(native: expr, kind: kind)
+    } else if isTemporary(expr) {
+      emit(drop: try emit(expr: expr))
+    } else {
+      // Borrowed values are not owned by the statement.
+      _ = try emit(expr: expr)
+    }
     return .proceed
   }
 
@@ -666,10 +1205,7 @@ public final class Emitter {
     let fun = builder.currentFunction!
 
     // Emit the condition.
-    let cond = try emit(expr: stmt.cond.adaptAsExpr()!)
-    emit(assert: cond, isA: .bool)
-    var condValue = builder.buildExtractValue(cond, index: 1)
-    condValue = builder.buildICmp(condValue, i64.zero(), .notEqual)
+    let condValue = try emit(condition: stmt.cond.adaptAsExpr()!)
 
     // Emit the branch.
     let thenBB = fun.appendBasicBlock(named: "then")
@@ -731,10 +1267,7 @@ public final class Emitter {
     builder.buildBr(headBB)
     builder.positionAtEnd(of: headBB)
 
-    let cond = try emit(expr: stmt.cond.adaptAsExpr()!)
-    emit(assert: cond, isA: .bool)
-    var condValue = builder.buildExtractValue(cond, index: 1)
-    condValue = builder.buildICmp(condValue, i64.zero(), .notEqual)
+    let condValue = try emit(condition: stmt.cond.adaptAsExpr()!)
 
     // Emit the loop's body.
     let bodyBB = fun.appendBasicBlock(named: "body")
@@ -802,7 +1335,7 @@ public final class Emitter {
     }
 
     // Emit the return value and copy it.
-    let rvalue = emit(copy: try emit(expr: stmt.value.adaptAsExpr()!))
+    let rvalue = try emit(owned: stmt.value.adaptAsExpr()!)
 
     // Drop all local scopes.
     for scope in ctx.scopes.reversed() {
@@ -816,6 +1349,36 @@ public final class Emitter {
     return .unwind(dest: decl.handle)
   }
 
+  /// Emits the load of the value of the given binding, as an object.
+  func emit(load binding: FunContext.Binding) -> IRValue {
+    if let kind = binding.kind {
+      return emit(box: builder.buildLoad(binding.location, type: nativeType(of: kind)), kind: kind)
+    } else {
+      return builder.buildLoad(binding.location, type: any)
+    }
+  }
+
+  /// Emits the boxing of a native value of the given scalar kind into an object.
+  func emit(box value: IRValue, kind: ObjectKind) -> IRValue {
+    let _1: IRValue
+    switch kind {
+    case .bool  : _1 = builder.buildZExt(value, type: i64)
+    case .float : _1 = builder.buildBitCast(value, type: i64)
+    default     : _1 = value
+    }
+    return builder.buildInsertValue(aggregate: constObject(kind: kind), element: _1, index: 1)
+  }
+
+  /// Emits the extraction of the native value of an object of the given scalar kind.
+  func emit(unbox object: IRValue, kind: ObjectKind) -> IRValue {
+    let _1 = builder.buildExtractValue(object, index: 1)
+    switch kind {
+    case .bool  : return builder.buildICmp(_1, i64.zero(), .notEqual)
+    case .float : return builder.buildBitCast(_1, type: f64)
+    default     : return _1
+    }
+  }
+
   /// Emits a copy of the given value.
   func emit(copy value: IRValue) -> IRValue {
     let _0 = builder.buildExtractValue(value, index: 0)
@@ -826,6 +1389,9 @@ public final class Emitter {
   /// Emits the destruction of the given value.
   /// Emits a piece of code that drops (i.e., deinitializes and deallocate) the give value.
   func emit(drop value: IRValue) {
+    // Constants (e.g., the junk produced by assignments) own no memory.
+    guard !value.isConstant else { return }
+
     let _0 = builder.buildExtractValue(value, index: 0)
     let _1 = builder.buildExtractValue(value, index: 1)
     _ = builder.buildCall(dropFunction, args: [_0, _1])
@@ -843,7 +1409,19 @@ public final class Emitter {
   /// Emits a piece of code that drops (i.e., deinitializes and deallocate) the values bound to the
   /// given scope.
   func emit(drop scope: FunContext.Scope) {
-    scope.bindings.values.forEach(emit(dropPointer:))
+    // Unboxed values are scalars, which need not be dropped.
+    for binding in scope.bindings.values where binding.kind == nil {
+      if let size = binding.stackEnvSize {
+        // Functions whose environment is on the stack only drop the values they captured.
+        guard size > 0 else { continue }
+        let env = emit(extractEnvFromPointer: binding.location)
+        for i in 0 ..< size {
+          emit(dropPointer: builder.buildGEP(env, type: any, indices: [i64.constant(i)]))
+        }
+      } else {
+        emit(dropPointer: binding.location)
+      }
+    }
   }
 
   /// Emits a piece of code that checks whether the given tag denotes the specified type.
@@ -879,13 +1457,21 @@ public final class Emitter {
     let fail = fun.appendBasicBlock(named: "fail")
     let next = fun.appendBasicBlock(named: "next")
 
-    builder.buildCondBr(condition: cond, then: next, else: fail)
+    // `llvm.trap` is cold, so the failure block is moved out of the hot path.
+    emit(likely: cond, then: next, else: fail)
     builder.positionAtEnd(of: fail)
     _ = builder.buildCall(module.intrinsic(Intrinsic.ID.llvm_trap)!, args: [])
     builder.buildUnreachable()
     builder.positionAtEnd(of: next)
   }
 
+  /// Emits a conditional branch on a condition that is expected to hold.
+  func emit(likely cond: IRValue, then thenBB: BasicBlock, else elseBB: BasicBlock) {
+    let expect = module.intrinsic(Intrinsic.ID.llvm_expect, parameters: [i1])!
+    let hint = builder.buildCall(expect, args: [cond, i1.constant(1)])
+    builder.buildCondBr(condition: hint, then: thenBB, else: elseBB)
+  }
+
   /// Emits the extraction of a function pointer from the lower part of an object.
   func emit(extractFunFrom object: IRValue, type: FunctionType) -> IRValue {
     var _0 = builder.buildExtractValue(object, index: 0)
@@ -926,7 +1512,14 @@ public final class Emitter {
   public static func emit(program decls: [Decl]) throws -> Module {
     let module  = Module(name: "main")
     let builder = IRBuilder(module: module)
-    let emitter = Emitter(builder: builder)
+    let globals = GlobalAnalysis(program: decls)
+    let emitter = Emitter(
+      builder: builder,
+      globals: globals,
+      types: TypeInference(program: decls, globals: globals),
+      lastUses: LastUseAnalysis(program: decls, globals: globals),
+      escapes: EscapeAnalysis(program: decls),
+      callees: CalleeAnalysis(program: decls))
 
     try emitter.emit(program: decls)
     try module.verify()
@@ -949,17 +1542,20 @@ struct FunContext {
     self.scopes = [Scope(node: decl?.handle)]
   }
 
-  func value(boundTo name: String) -> IRValue? {
+  func binding(of symbol: Symbol) -> Binding? {
     for scope in scopes.reversed() {
-      if let value = scope.bindings[name] {
-        return value
+      if let binding = scope.bindings[symbol] {
+        return binding
       }
     }
     return nil
   }
 
-  mutating func bind(value: IRValue, to name: String) {
-    scopes[scopes.count - 1].bindings[name] = value
+  mutating func bind(
+    value: IRValue, kind: ObjectKind? = nil, stackEnvSize: Int? = nil, to symbol: Symbol
+  ) {
+    scopes[scopes.count - 1].bindings[symbol] = Binding(
+      location: value, kind: kind, stackEnvSize: stackEnvSize)
   }
 
   mutating func pushScope(stmt: BraceStmt) {
@@ -971,13 +1567,28 @@ struct FunContext {
     assert(!scopes.isEmpty)
   }
 
+  struct Binding {
+
+    /// The location of the bound value.
+    let location: IRValue
+
+    /// The kind of the bound value if it is stored unboxed, as a native value, or `nil` if it is
+    /// stored as an object.
+    let kind: ObjectKind?
+
+    /// The number of values captured by the bound function if its environment is allocated on the
+    /// stack, or `nil` otherwise.
+    let stackEnvSize: Int?
+
+  }
+
   struct Scope {
 
     /// The node that delimits the scope.
     let node: NodeHandle?
 
-    /// The local bindings of the scope.
-    var bindings: [String: IRValue] = [:]
+    /// The local bindings of the scope, indexed by the symbols of their names.
+    var bindings: [Symbol: Binding] = [:]
 
   }
 
@@ -0,0 +1,189 @@
+import CCocodol
+import Cocodol
+
+/// The way a local function's value may outlive the scope in which the function is declared.
+enum Escape: Int, Comparable {
+
+  /// The value is only called, or evaluated without being used.
+  case none
+
+  /// The value is passed to callees that never retain it (i.e., `print`).
+  case nocapture
+
+  /// The value may be copied into a variable, an environment or the result of a call.
+  case escaping
+
+  static func < (lhs: Escape, rhs: Escape) -> Bool {
+    return lhs.rawValue < rhs.rawValue
+  }
+
+}
+
+/// An escape analysis, which determines whether the value of each local function may outlive the
+/// scope in which the function is declared.
+///
+/// The environment of a function that does not escape can be allocated on the stack of the
+/// function that declares it, as no copy of its value is ever made.
+///
+/// Names are resolved as in the emitter: a declaration is visible from its position to the end of
+/// the enclosing scope, and each function only sees its own locals, parameters and captures.
+final class EscapeAnalysis {
+
+  /// A local binding.
+  private enum Binding {
+
+    /// A local function, identified by its declaration.
+    case function(NodeHandle)
+
+    /// A variable, a parameter or a captured identifier.
+    case opaque
+
+  }
+
+  /// The way each local function escapes, indexed by declaration.
+  private var escapes: [NodeHandle: Escape] = [:]
+
+  /// The local bindings of each lexical scope of the function being analyzed.
+  private var scopes: [[Symbol: Binding]] = []
+
+  /// The functions declared in the function being analyzed.
+  private var nestedFunctions: [FunDecl] = []
+
+  /// Analyzes the given program.
+  init(program decls: [Decl]) {
+    // The top-level code is emitted in the `main` function, where global functions and variables
+    // are not local bindings.
+    analyze(body: { () in
+      for decl in decls {
+        if let d = decl as? TopDecl {
+          d.stmts.forEach({ stmt in self.analyze(stmt: stmt) })
+        } else if let initializer = (decl as? VarDecl)?.initializer {
+          self.analyze(expr: initializer, escape: .escaping)
+        }
+      }
+    }, bindings: [])
+
+    // Global functions capture nothing.
+    for case let decl as FunDecl in decls {
+      analyze(function: decl, isTopLevel: true)
+    }
+  }
+
+  /// Returns the way the value of the given local function may escape.
+  func escape(of decl: FunDecl) -> Escape {
+    return escapes[decl.handle] ?? .escaping
+  }
+
+  /// Analyzes a function declaration and the functions that it contains.
+  private func analyze(function decl: FunDecl, isTopLevel: Bool) {
+    var bindings = isTopLevel ? [] : decl.captures.compactMap({ $0.symbol })
+    bindings.append(contentsOf: decl.params.compactMap({ $0.symbol }))
+    analyze(body: { () in self.analyze(stmt: decl.body) }, bindings: bindings)
+  }
+
+  /// Analyzes a function, given a closure that visits its body and the names that are bound by its
+  /// declaration.
+  private func analyze(body visitBody: () -> Void, bindings: [Symbol]) {
+    scopes = [[:]]
+    for symbol in bindings {
+      scopes[0][symbol] = .opaque
+    }
+    nestedFunctions = []
+    visitBody()
+
+    // Analyze the nested functions.
+    let functions = nestedFunctions
+    for decl in functions {
+      analyze(function: decl, isTopLevel: false)
+    }
+  }
+
+  /// Records that the value bound to the given symbol may escape as specified.
+  private func use(_ symbol: Symbol, escape: Escape) {
+    for scope in scopes.reversed() {
+      guard let binding = scope[symbol] else { continue }
+      if case .function(let decl) = binding {
+        escapes[decl] = max(escapes[decl] ?? .none, escape)
+      }
+      return
+    }
+  }
+
+  /// Analyzes a statement.
+  private func analyze(stmt node: NodeHandle) {
+    switch node.adaptAsAny() {
+    case let d as VarDecl:
+      // The variable is bound before its initializer is emitted.
+      scopes[scopes.count - 1][d.symbol] = .opaque
+      if let initializer = d.initializer {
+        analyze(expr: initializer, escape: .escaping)
+      }
+
+    case let d as FunDecl:
+      // The function copies its captures into its environment, which may escape.
+      for capture in d.captures {
+        use(capture.symbol!, escape: .escaping)
+      }
+      scopes[scopes.count - 1][d.symbol] = .function(d.handle)
+      escapes[d.handle] = Escape.none
+      nestedFunctions.append(d)
+
+    case let s as BraceStmt:
+      scopes.append([:])
+      s.stmts.forEach({ stmt in analyze(stmt: stmt) })
+      scopes.removeLast()
+
+    case let s as ExprStmt:
+      // The value of the expression is dropped right away.
+      analyze(expr: s.expr, escape: .none)
+
+    case let s as IfStmt:
+      analyze(expr: s.cond, escape: .escaping)
+      analyze(stmt: s.then_)
+      if let else_ = s.else_ {
+        analyze(stmt: else_)
+      }
+
+    case let s as WhileStmt:
+      analyze(expr: s.cond, escape: .escaping)
+      analyze(stmt: s.body)
+
+    case let s as RetStmt:
+      analyze(expr: s.value, escape: .escaping)
+
+    default:
+      break
+    }
+  }
+
+  /// Analyzes an expression whose value may escape as specified.
+  private func analyze(expr node: NodeHandle, escape: Escape) {
+    switch node.adaptAsExpr() {
+    case let e as DeclRefExpr:
+      use(e.symbol, escape: escape)
+
+    case let e as ParenExpr:
+      analyze(expr: e.subexpr, escape: escape)
+
+    case let e as UnaryExpr:
+      analyze(expr: e.subexpr, escape: .escaping)
+
+    case let e as BinaryExpr:
+      // An assignment to a function would drop its environment.
+      analyze(expr: e.lhs, escape: .escaping)
+      analyze(expr: e.rhs, escape: .escaping)
+
+    case let e as ApplyExpr:
+      // Calling a function does not copy it.
+      analyze(expr: e.callee, escape: .none)
+
+      // `print` does not retain its argument.
+      let isPrint = e.callee.adapt(as: DeclRefExpr.self)?.symbol == Symbol(sym_print)
+      e.args.forEach({ arg in analyze(expr: arg, escape: isPrint ? .nocapture : .escaping) })
+
+    default:
+      break
+    }
+  }
+
+}
@@ -0,0 +1,126 @@
+import CCocodol
+import Cocodol
+
+/// An analysis of the global declarations of a program, which finds the global variables that can
+/// be stored in the locals of the `main` function, and the global functions whose callers are all
+/// statically known.
+///
+/// A global variable is local to `main` if its name is declared only once in the program, if no
+/// function refers to it and if it isn't referred to before its declaration, as it is then only
+/// accessed by the top-level code that follows it. A global function is
+/// only called directly if its name is declared only once in the program and if every reference to
+/// that name is the callee of a function application with as many arguments as the function has
+/// parameters, so that its value never escapes.
+final class GlobalAnalysis {
+
+  /// The global variables that are local to `main`.
+  private var mainLocals: Set<NodeHandle> = []
+
+  /// The global functions that are only called directly, indexed by the symbols of their names.
+  private var directlyCalledFunctions: [Symbol: FunDecl] = [:]
+
+  /// Analyzes the given program.
+  init(program decls: [Decl]) {
+    // The number of declarations of each name, including parameters.
+    var declCounts: [Symbol: Int] = [:]
+
+    // The names that are referred to from within a function.
+    var referencedInFunctions: Set<Symbol> = []
+
+    // The names that have been declared so far, in the order of the program's text.
+    var declared: Set<Symbol> = []
+
+    // The names that are referred to before any of their declarations.
+    var referencedBeforeDeclaration: Set<Symbol> = []
+
+    // The number of arguments of each application, indexed by the reference that is its callee.
+    var calleeArgCounts: [NodeHandle: Int] = [:]
+
+    // The number of arguments passed with each reference to a name, or `nil` if that reference is
+    // not a callee.
+    var references: [Symbol: [Int?]] = [:]
+
+    for decl in decls {
+      var depth = 0
+      decl.handle.walk(with: { (node, event) -> Bool in
+        guard event == .enter else {
+          if node.adapt(as: FunDecl.self) != nil {
+            depth -= 1
+          }
+          return true
+        }
+
+        switch node.adaptAsAny() {
+        case let d as VarDecl:
+          declCounts[d.symbol, default: 0] += 1
+          declared.insert(d.symbol)
+
+        case let d as FunDecl:
+          declCounts[d.symbol, default: 0] += 1
+          declared.insert(d.symbol)
+          for case let symbol? in d.params.map({ $0.symbol }) {
+            declCounts[symbol, default: 0] += 1
+          }
+          depth += 1
+
+        case let e as ApplyExpr:
+          if let ref = e.callee.adapt(as: DeclRefExpr.self) {
+            calleeArgCounts[ref.handle] = e.args.count
+          }
+
+        case let e as DeclRefExpr:
+          references[e.symbol, default: []].append(calleeArgCounts[e.handle])
+          if depth > 0 {
+            referencedInFunctions.insert(e.symbol)
+          }
+          if !declared.contains(e.symbol) {
+            referencedBeforeDeclaration.insert(e.symbol)
+          }
+
+        default:
+          break
+        }
+        return true
+      })
+    }
+
+    for decl in decls {
+      switch decl {
+      case let d as VarDecl:
+        if (declCounts[d.symbol] == 1),
+           !referencedInFunctions.contains(d.symbol),
+           !referencedBeforeDeclaration.contains(d.symbol)
+        {
+          mainLocals.insert(d.handle)
+        }
+
+      case let d as FunDecl:
+        let paramCount = d.params.count
+        if (declCounts[d.symbol] == 1),
+           (references[d.symbol] ?? []).allSatisfy({ $0 == paramCount })
+        {
+          directlyCalledFunctions[d.symbol] = d
+        }
+
+      default:
+        break
+      }
+    }
+  }
+
+  /// Returns whether the given global variable is local to `main`.
+  func isLocalToMain(_ decl: VarDecl) -> Bool {
+    return mainLocals.contains(decl.handle)
+  }
+
+  /// Returns the global function whose name has the given symbol if it is only called directly.
+  func directlyCalledFunction(named symbol: Symbol) -> FunDecl? {
+    return directlyCalledFunctions[symbol]
+  }
+
+  /// Returns whether the given global function is only called directly.
+  func isOnlyCalledDirectly(_ decl: FunDecl) -> Bool {
+    return directlyCalledFunctions[decl.symbol]?.handle == decl.handle
+  }
+
+}
@@ -0,0 +1,195 @@
+import CCocodol
+import Cocodol
+
+/// An analysis that finds the references to local variables that are their last use, from which
+/// the emitter can move values rather than copy them.
+///
+/// A reference is the last use of a variable if no other use of that variable follows it in the
+/// text of the function, and if it is not nested in a loop that doesn't also contain the variable's
+/// declaration, as the next iteration would otherwise read a moved value. Assignments to the
+/// variable and captures by nested functions are uses from which values are never moved. The
+/// analysis is conservative across branches: a use in the `then` branch of a conditional is not
+/// the last if the `else` branch uses the same variable.
+///
+/// Names are resolved as in the emitter: a declaration is visible from its position to the end of
+/// the enclosing scope, and each function only sees its own locals, parameters and captures.
+final class LastUseAnalysis {
+
+  /// A local binding.
+  private enum Binding {
+
+    /// A local variable or function, identified by its declaration, declared in the given number
+    /// of loops.
+    case variable(NodeHandle, loopDepth: Int)
+
+    /// A parameter or a captured identifier, which is never moved.
+    case opaque
+
+  }
+
+  /// The references that are the last use of a local variable.
+  private var moves: Set<NodeHandle> = []
+
+  /// The last use of each variable of the function being analyzed, indexed by declaration, or
+  /// `nil` if that use cannot move the variable's value.
+  private var lastUses: [NodeHandle: NodeHandle?] = [:]
+
+  /// The local bindings of each lexical scope of the function being analyzed.
+  private var scopes: [[Symbol: Binding]] = []
+
+  /// The number of loops containing the node being analyzed, in the function being analyzed.
+  private var loopDepth = 0
+
+  /// The functions declared in the function being analyzed.
+  private var nestedFunctions: [FunDecl] = []
+
+  /// Analyzes the given program.
+  init(program decls: [Decl], globals: GlobalAnalysis) {
+    // The top-level code is emitted in the `main` function, where global functions and variables
+    // are not local bindings, unless the variables are local to `main`.
+    analyze(body: { () in
+      for decl in decls {
+        if let d = decl as? TopDecl {
+          d.stmts.forEach({ stmt in self.analyze(stmt: stmt) })
+        } else if let d = decl as? VarDecl, globals.isLocalToMain(d) {
+          self.analyze(stmt: d.handle)
+        } else if let initializer = (decl as? VarDecl)?.initializer {
+          self.analyze(expr: initializer)
+        }
+      }
+    }, bindings: [])
+
+    // Global functions capture nothing.
+    for case let decl as FunDecl in decls {
+      analyze(function: decl, isTopLevel: true)
+    }
+  }
+
+  /// Returns whether the given reference is the last use of a local variable.
+  func isLastUse(_ expr: DeclRefExpr) -> Bool {
+    return moves.contains(expr.handle)
+  }
+
+  /// Analyzes a function declaration and the functions that it contains.
+  private func analyze(function decl: FunDecl, isTopLevel: Bool) {
+    var bindings = isTopLevel ? [] : decl.captures.compactMap({ $0.symbol })
+    bindings.append(contentsOf: decl.params.compactMap({ $0.symbol }))
+    analyze(body: { () in self.analyze(stmt: decl.body) }, bindings: bindings)
+  }
+
+  /// Analyzes a function, given a closure that visits its body and the names that are bound by its
+  /// declaration.
+  private func analyze(body visitBody: () -> Void, bindings: [Symbol]) {
+    scopes = [[:]]
+    for symbol in bindings {
+      scopes[0][symbol] = .opaque
+    }
+    lastUses = [:]
+    loopDepth = 0
+    nestedFunctions = []
+    visitBody()
+
+    for case let use? in lastUses.values {
+      moves.insert(use)
+    }
+
+    // Analyze the nested functions.
+    let functions = nestedFunctions
+    for decl in functions {
+      analyze(function: decl, isTopLevel: false)
+    }
+  }
+
+  /// Records a use of the given symbol, which can move its value if `ref` is not `nil`.
+  private func use(_ symbol: Symbol, at ref: NodeHandle?) {
+    for scope in scopes.reversed() {
+      guard let binding = scope[symbol] else { continue }
+      if case .variable(let decl, let depth) = binding {
+        lastUses[decl] = .some((depth == loopDepth) ? ref : nil)
+      }
+      return
+    }
+  }
+
+  /// Analyzes a statement.
+  private func analyze(stmt node: NodeHandle) {
+    switch node.adaptAsAny() {
+    case let d as VarDecl:
+      // The variable is bound before its initializer is emitted.
+      scopes[scopes.count - 1][d.symbol] = .variable(d.handle, loopDepth: loopDepth)
+      if let initializer = d.initializer {
+        analyze(expr: initializer)
+      }
+
+    case let d as FunDecl:
+      // The function copies its captures when it is declared.
+      for capture in d.captures {
+        use(capture.symbol!, at: nil)
+      }
+      scopes[scopes.count - 1][d.symbol] = .variable(d.handle, loopDepth: loopDepth)
+      nestedFunctions.append(d)
+
+    case let s as BraceStmt:
+      scopes.append([:])
+      s.stmts.forEach({ stmt in analyze(stmt: stmt) })
+      scopes.removeLast()
+
+    case let s as ExprStmt:
+      analyze(expr: s.expr)
+
+    case let s as IfStmt:
+      analyze(expr: s.cond)
+      analyze(stmt: s.then_)
+      if let else_ = s.else_ {
+        analyze(stmt: else_)
+      }
+
+    case let s as WhileStmt:
+      loopDepth += 1
+      analyze(expr: s.cond)
+      analyze(stmt: s.body)
+      loopDepth -= 1
+
+    case let s as RetStmt:
+      analyze(expr: s.value)
+
+    default:
+      break
+    }
+  }
+
+  /// Analyzes an expression.
+  private func analyze(expr node: NodeHandle) {
+    switch node.adaptAsExpr() {
+    case let e as DeclRefExpr:
+      use(e.symbol, at: e.handle)
+
+    case let e as ParenExpr:
+      analyze(expr: e.subexpr)
+
+    case let e as UnaryExpr:
+      analyze(expr: e.subexpr)
+
+    case let e as BinaryExpr:
+      if e.op.kind == .assign {
+        // The right operand is evaluated first.
+        analyze(expr: e.rhs)
+        if let lhs = e.lhs.adapt(as: DeclRefExpr.self) {
+          use(lhs.symbol, at: nil)
+        }
+      } else {
+        analyze(expr: e.lhs)
+        analyze(expr: e.rhs)
+      }
+
+    case let e as ApplyExpr:
+      // The callee is borrowed until the call returns, so it must not be moved by an argument.
+      e.args.forEach({ arg in analyze(expr: arg) })
+      analyze(expr: e.callee)
+
+    default:
+      break
+    }
+  }
+
+}
@@ -0,0 +1,451 @@
+import CCocodol
+import Cocodol
+
+/// The type of a value, as inferred at compile time.
+enum StaticType: Equatable {
+
+  /// The type of a value that has not been observed yet (i.e., the bottom of the lattice).
+  case never
+
+  /// The type of Boolean values.
+  case bool
+
+  /// The type of integer values.
+  case integer
+
+  /// The type of floating-point values.
+  case float
+
+  /// The type of values whose kind is known only at runtime (i.e., the top of the lattice).
+  case any
+
+  /// Creates the type of the objects of the given kind.
+  init(_ kind: ObjectKind) {
+    switch kind {
+    case .bool    : self = .bool
+    case .integer : self = .integer
+    case .float   : self = .float
+    default       : self = .any
+    }
+  }
+
+  /// The kind of the objects of this type, if it is a scalar type whose values can be unboxed.
+  var scalarKind: ObjectKind? {
+    switch self {
+    case .bool    : return .bool
+    case .integer : return .integer
+    case .float   : return .float
+    default       : return nil
+    }
+  }
+
+  /// Returns the least type that includes both this type and `other`.
+  func join(_ other: StaticType) -> StaticType {
+    if (self == other) || (other == .never) {
+      return self
+    } else if self == .never {
+      return other
+    } else {
+      return .any
+    }
+  }
+
+  /// Returns the type of the result of the given unary operator applied to an operand of this
+  /// type, or `any` if the operation may fail at runtime.
+  func applying(unary op: Token.Kind) -> StaticType {
+    switch (self, op) {
+    case (.never, _):
+      return .never
+    case (.bool, .not):
+      return .bool
+    case (.integer, .plus), (.integer, .minus), (.integer, .tilde):
+      return .integer
+    case (.float, .plus), (.float, .minus):
+      return .float
+    default:
+      return .any
+    }
+  }
+
+  /// Returns the type of the result of the given binary operator applied to a left operand of
+  /// this type and a right operand of type `rhs`, or `any` if the operation may fail at runtime.
+  ///
+  /// Logical operators and assignments are not handled by this method.
+  func applying(binary op: Token.Kind, to rhs: StaticType) -> StaticType {
+    guard (self != .never) && (rhs != .never) else { return .never }
+    guard self == rhs else { return .any }
+
+    switch (self, op) {
+    case (.integer, .lShift), (.integer, .rShift), (.integer, .star), (.integer, .slash),
+         (.integer, .percent), (.integer, .plus), (.integer, .minus), (.integer, .pipe),
+         (.integer, .amp), (.integer, .caret):
+      return .integer
+    case (.float, .star), (.float, .slash), (.float, .percent), (.float, .plus), (.float, .minus):
+      return .float
+    case (.integer, .lt), (.integer, .le), (.integer, .gt), (.integer, .ge), (.integer, .eq),
+         (.integer, .ne),
+         (.float, .lt), (.float, .le), (.float, .gt), (.float, .ge), (.float, .eq), (.float, .ne):
+      return .bool
+    default:
+      return .any
+    }
+  }
+
+}
+
+/// A type inference pass, which proves local variables and expressions to be integers, floats or
+/// Booleans, so that the emitter can represent them as native values rather than boxed objects.
+///
+/// The type of a local variable is the join of the types of all the values assigned to it. The
+/// pass iterates over each function until these types reach a fixed point. Global variables that
+/// are local to `main` are typed as its locals. Other global variables, and the parameters and
+/// captured identifiers of most functions, are always of type `any`, as they are dynamic
+/// boundaries: their values come from code that is not part of the function, or may be read before
+/// they are initialized.
+///
+/// The signatures of the global functions that are only called directly are inferred as well: the
+/// type of a parameter is the join of the types of the arguments passed to it and of the values
+/// assigned to it, and the type of the result is the join of the types of the returned values. As
+/// these types depend on each other across functions, the whole program is visited until they
+/// reach a fixed point.
+///
+/// Names are resolved as in the emitter: a declaration is visible from its position to the end of
+/// the enclosing scope, and each function only sees its own locals, parameters and captures.
+final class TypeInference {
+
+  /// A local binding.
+  private enum Binding {
+
+    /// A local variable, identified by its declaration.
+    case variable(NodeHandle)
+
+    /// The parameter at the given index of a global function whose signature is inferred.
+    case parameter(NodeHandle, index: Int)
+
+    /// A parameter, a captured identifier or a local function, whose type is always `any`.
+    case opaque
+
+  }
+
+  /// The signature of a global function.
+  private struct Signature: Equatable {
+
+    /// The type of each parameter.
+    var params: [StaticType]
+
+    /// The type of the result.
+    var result: StaticType
+
+  }
+
+  /// The global declarations of the program being inferred.
+  private let globals: GlobalAnalysis
+
+  /// The inferred type of each expression.
+  private var exprTypes: [NodeHandle: StaticType] = [:]
+
+  /// The inferred type of each local variable, indexed by declaration.
+  private var varTypes: [NodeHandle: StaticType] = [:]
+
+  /// The inferred signature of each global function that is only called directly, indexed by
+  /// declaration.
+  private var signatures: [NodeHandle: Signature] = [:]
+
+  /// The global function whose signature is inferred and whose body is being visited, if any.
+  private var currentFunction: NodeHandle?
+
+  /// The local bindings of each lexical scope of the function being inferred.
+  private var scopes: [[Symbol: Binding]] = []
+
+  /// The functions declared in the function being inferred.
+  private var nestedFunctions: [FunDecl] = []
+
+  /// A flag that indicates whether the type of a variable has changed during the current pass.
+  private var hasChanged = false
+
+  /// Infers the types of the given program.
+  init(program decls: [Decl], globals: GlobalAnalysis) {
+    self.globals = globals
+
+    // The signatures of the functions that are only called directly are unknown until a call or a
+    // return statement is visited.
+    for case let decl as FunDecl in decls where globals.isOnlyCalledDirectly(decl) {
+      signatures[decl.handle] = Signature(
+        params: Array(repeating: .never, count: decl.params.count), result: .never)
+    }
+
+    // Visit the program until the signatures of the global functions are stable.
+    var previous: [NodeHandle: Signature]
+    repeat {
+      previous = signatures
+
+      // The top-level code is emitted in the `main` function, where global functions and variables
+      // are not local bindings, unless the variables are local to `main`.
+      infer(body: { () in
+        for decl in decls {
+          if let d = decl as? TopDecl {
+            d.stmts.forEach({ stmt in self.infer(stmt: stmt) })
+          } else if let d = decl as? VarDecl, globals.isLocalToMain(d) {
+            self.infer(stmt: d.handle)
+          } else if let initializer = (decl as? VarDecl)?.initializer {
+            self.infer(expr: initializer)
+          }
+        }
+      }, bindings: [])
+
+      // Global functions capture nothing.
+      for case let decl as FunDecl in decls {
+        infer(function: decl, isTopLevel: true)
+      }
+    } while signatures != previous
+  }
+
+  /// Returns the inferred type of the given expression.
+  func type(of expr: Expr) -> StaticType {
+    return exprTypes[expr.handle] ?? .any
+  }
+
+  /// Returns the inferred type of the given local variable.
+  func type(of decl: VarDecl) -> StaticType {
+    return varTypes[decl.handle] ?? .any
+  }
+
+  /// Returns the inferred type of each parameter of the given function.
+  func parameterTypes(of decl: FunDecl) -> [StaticType] {
+    return signatures[decl.handle]?.params ?? Array(repeating: .any, count: decl.params.count)
+  }
+
+  /// Infers the types of a function declaration and of the functions that it contains.
+  private func infer(function decl: FunDecl, isTopLevel: Bool) {
+    if isTopLevel && (signatures[decl.handle] != nil) {
+      // The parameters are typed by the signature, and the result is of type `any` if the control
+      // flow may reach the end of the function, which returns junk.
+      let bindings = decl.params.indices.map({ (i) -> (Symbol?, Binding) in
+        (decl.params[i].symbol, .parameter(decl.handle, index: i))
+      })
+      currentFunction = decl.handle
+      infer(body: { () in self.infer(stmt: decl.body) }, bindings: bindings)
+      currentFunction = nil
+
+      if !TypeInference.alwaysReturns(decl.body) {
+        signatures[decl.handle]!.result = signatures[decl.handle]!.result.join(.any)
+      }
+      return
+    }
+
+    // Captures are bound before parameters, which may shadow them.
+    var bindings: [(Symbol?, Binding)] = isTopLevel
+      ? []
+      : decl.captures.map({ ($0.symbol, .opaque) })
+    bindings.append(contentsOf: decl.params.map({ ($0.symbol, .opaque) }))
+    infer(body: { () in self.infer(stmt: decl.body) }, bindings: bindings)
+  }
+
+  /// Infers the types of a function, given a closure that visits its body and the names that are
+  /// bound by its declaration.
+  private func infer(body visitBody: () -> Void, bindings: [(Symbol?, Binding)]) {
+    // Visit the function until the types of its variables are stable.
+    var functions: [FunDecl] = []
+    repeat {
+      hasChanged = false
+      scopes = [[:]]
+      for case let (symbol?, binding) in bindings {
+        scopes[0][symbol] = binding
+      }
+      nestedFunctions = []
+      visitBody()
+      functions = nestedFunctions
+    } while hasChanged
+
+    // Infer the types of the nested functions, whose return statements are their own.
+    let current = currentFunction
+    currentFunction = nil
+    for decl in functions {
+      infer(function: decl, isTopLevel: false)
+    }
+    currentFunction = current
+  }
+
+  /// Returns whether the execution of the given statement always ends with a return statement.
+  private static func alwaysReturns(_ node: NodeHandle) -> Bool {
+    switch node.adaptAsAny() {
+    case is RetStmt:
+      return true
+    case let s as BraceStmt:
+      return s.stmts.contains(where: { alwaysReturns($0) })
+    case let s as IfStmt:
+      return alwaysReturns(s.then_) && (s.else_.map({ alwaysReturns($0) }) ?? false)
+    default:
+      return false
+    }
+  }
+
+  /// Returns the binding of the given symbol in the function being inferred, if any.
+  private func binding(of symbol: Symbol) -> Binding? {
+    for scope in scopes.reversed() {
+      if let binding = scope[symbol] {
+        return binding
+      }
+    }
+    return nil
+  }
+
+  /// Returns the type of the value bound to the given binding.
+  private func type(of binding: Binding?) -> StaticType {
+    switch binding {
+    case .variable(let decl)?:
+      return varTypes[decl] ?? .never
+    case .parameter(let decl, let i)?:
+      return signatures[decl]!.params[i]
+    default:
+      return .any
+    }
+  }
+
+  /// Records that a value of the given type is assigned to the specified binding.
+  private func assign(_ type: StaticType, to binding: Binding?) {
+    switch binding {
+    case .variable(let decl)?:
+      let old = varTypes[decl] ?? .never
+      let new = old.join(type)
+      if new != old {
+        varTypes[decl] = new
+        hasChanged = true
+      }
+
+    case .parameter(let decl, let i)?:
+      let old = signatures[decl]!.params[i]
+      let new = old.join(type)
+      if new != old {
+        signatures[decl]!.params[i] = new
+        hasChanged = true
+      }
+
+    default:
+      break
+    }
+  }
+
+  /// Infers the types of a statement.
+  private func infer(stmt node: NodeHandle) {
+    switch node.adaptAsAny() {
+    case let d as VarDecl:
+      // The variable is bound before its initializer is emitted.
+      scopes[scopes.count - 1][d.symbol] = .variable(d.handle)
+      if let initializer = d.initializer {
+        assign(infer(expr: initializer), to: .variable(d.handle))
+      } else {
+        assign(.any, to: .variable(d.handle))
+      }
+
+    case let d as FunDecl:
+      scopes[scopes.count - 1][d.symbol] = .opaque
+      nestedFunctions.append(d)
+
+    case let s as BraceStmt:
+      scopes.append([:])
+      s.stmts.forEach({ stmt in infer(stmt: stmt) })
+      scopes.removeLast()
+
+    case let s as ExprStmt:
+      infer(expr: s.expr)
+
+    case let s as IfStmt:
+      infer(expr: s.cond)
+      infer(stmt: s.then_)
+      if let else_ = s.else_ {
+        infer(stmt: else_)
+      }
+
+    case let s as WhileStmt:
+      infer(expr: s.cond)
+      infer(stmt: s.body)
+
+    case let s as RetStmt:
+      let type = infer(expr: s.value)
+      if let decl = currentFunction {
+        signatures[decl]!.result = signatures[decl]!.result.join(type)
+      }
+
+    default:
+      break
+    }
+  }
+
+  /// Infers the type of an expression.
+  @discardableResult
+  private func infer(expr node: NodeHandle) -> StaticType {
+    let type: StaticType
+
+    switch node.adaptAsExpr() {
+    case is BoolExpr:
+      type = .bool
+
+    case is IntegerExpr:
+      type = .integer
+
+    case is FloatExpr:
+      type = .float
+
+    case let e as DeclRefExpr:
+      type = self.type(of: binding(of: e.symbol))
+
+    case let e as ParenExpr:
+      type = infer(expr: e.subexpr)
+
+    case let e as UnaryExpr:
+      type = infer(expr: e.subexpr).applying(unary: e.op.kind)
+
+    case let e as BinaryExpr:
+      switch e.op.kind {
+      case .assign:
+        // Assignments produce junk.
+        let rhs = infer(expr: e.rhs)
+        if let lhs = e.lhs.adapt(as: DeclRefExpr.self) {
+          assign(rhs, to: binding(of: lhs.symbol))
+        }
+        type = .any
+
+      case .and, .or:
+        // The emitter traps unless both operands are Booleans.
+        infer(expr: e.lhs)
+        infer(expr: e.rhs)
+        type = .bool
+
+      default:
+        let lhs = infer(expr: e.lhs)
+        type = lhs.applying(binary: e.op.kind, to: infer(expr: e.rhs))
+      }
+
+    case let e as ApplyExpr:
+      let argTypes = e.args.map({ arg in infer(expr: arg) })
+      if let ref = e.callee.adapt(as: DeclRefExpr.self) {
+        // The input functions always return a value of the same kind.
+        switch ref.symbol {
+        case Symbol(sym_read_int)   : type = .integer
+        case Symbol(sym_read_float) : type = .float
+        case Symbol(sym_at_eof)     : type = .bool
+        default                     : type = .any
+        }
+
+        // The arguments of a function that is only called directly are its parameters' values.
+        if let decl = globals.directlyCalledFunction(named: ref.symbol) {
+          for (i, argType) in argTypes.enumerated() {
+            assign(argType, to: .parameter(decl.handle, index: i))
+          }
+          type = signatures[decl.handle]!.result
+        }
+      } else {
+        infer(expr: e.callee)
+        type = .any
+      }
+
+    default:
+      type = .any
+    }
+
+    exprTypes[node] = type
+    return type
+  }
+
+}
@@ -1,6 +1,7 @@
 import Foundation
 
 import ArgumentParser
+import CLLVMLinker
 import Cocodol
 import CodeGen
 import LLVM
@@ -30,6 +31,13 @@ struct Cocodoc: ParsableCommand {
     (try? exec("/usr/bin/which", args: ["clang"])) ?? "/usr/bin/clang"
   }()
 
+  @Option(name: [.short, .customLong("jobs")],
+          help: ArgumentHelp("The number of threads used to parse the program.", valueName: "n"))
+  var jobs = ProcessInfo.processInfo.activeProcessorCount
+
+  @Flag(help: "Parse the program without reading or writing the AST cache.")
+  var noCache = false
+
   @Flag(help: "Print the program as it has been parsed without compiling it.")
   var unparse = false
 
@@ -57,13 +65,22 @@ struct Cocodoc: ParsableCommand {
   }
 
   mutating func run() throws {
-    // Open and read the input file.
-    let source = try String(contentsOf: inputFile)
+    // Map the input file.
+    guard let context = Context(contentsOfFile: inputFile.path) else {
+      throw CocoaError(.fileReadNoSuchFile, userInfo: [NSFilePathErrorKey: inputFile.path])
+    }
 
-    // Parse the program.
-    let context = Context(source: source)
-    let parser = Parser(in: context)
-    let decls = parser.parse()
+    // Load the program from the cache, or parse it.
+    let decls: [Decl]
+    if !noCache, let cached = context.loadCachedDecls() {
+      decls = cached
+    } else {
+      let parser = Parser(in: context)
+      decls = parser.parse(threadCount: jobs)
+      if !noCache && (parser.diagnosticCount == 0) {
+        context.storeCachedDecls(decls)
+      }
+    }
 
     // Unparse the program, if requested to.
     if unparse {
@@ -85,6 +102,11 @@ struct Cocodoc: ParsableCommand {
 
     // Apply optimizations, if requested to.
     if optimize {
+      // Link the runtime's bitcode, if available, so that its functions can be inlined.
+      if let path = searchLibrary(named: "libcocodol_rt.bc") {
+        try linkRuntime(bitcodeFile: path, into: module)
+      }
+
       let pipeliner = PassPipeliner(module: module)
       pipeliner.addStandardModulePipeline("opt", optimization: .default, size: .default)
       pipeliner.execute()
@@ -137,26 +159,74 @@ struct Cocodoc: ParsableCommand {
       create: true)
 
     // Search for the runtime library.
+    let runtimePath = searchLibrary(named: "libcocodol_rt.a") ?? "libcocodol_rt.a"
+
+    // Compile the LLVM module.
+    let moduleObject = tmp.appendingPathComponent(module.name).appendingPathExtension("o")
+    try target.emitToFile(module: module, type: .object, path: moduleObject.path)
+
+    // Produce the executable.
+    try exec(clangPath, args: [moduleObject.path, runtimePath, "-lm", "-o", productFile.path])
+  }
+
+  /// Returns the path of the given library in the library search paths, if it exists.
+  func searchLibrary(named name: String) -> String? {
     var searchPaths = Cocodoc.librarySearchPaths
     if let customPath = customLibrarySearchPath {
       searchPaths.insert(customPath, at: 0)
     }
 
-    var runtimePath = "libcocodol_rt.a"
     for directory in searchPaths {
-      let path = URL(fileURLWithPath: directory).appendingPathComponent("libcocodol_rt.a").path
-      if manager.fileExists(atPath: path) {
-        runtimePath = path
-        break
+      let path = URL(fileURLWithPath: directory).appendingPathComponent(name).path
+      if FileManager.default.fileExists(atPath: path) {
+        return path
       }
     }
+    return nil
+  }
 
-    // Compile the LLVM module.
-    let moduleObject = tmp.appendingPathComponent(module.name).appendingPathExtension("o")
-    try target.emitToFile(module: module, type: .object, path: moduleObject.path)
+  /// Links the runtime library, compiled as LLVM bitcode, into the given module.
+  ///
+  /// The functions defined by the runtime are internalized once linked, so that the optimizer can
+  /// inline and specialize them at each call site (e.g., folding the operator switches of
+  /// `_cocodol_binop` on constant operators), and remove those that are no longer used. The static
+  /// library is still linked into the executable, providing the functions that were not
+  /// linked here.
+  func linkRuntime(bitcodeFile path: String, into module: Module) throws {
+    // Parse the bitcode, in the context of the module.
+    var buffer: LLVMMemoryBufferRef?
+    var message: UnsafeMutablePointer<CChar>?
+    guard LLVMCreateMemoryBufferWithContentsOfFile(path, &buffer, &message) == 0 else {
+      LLVMDisposeMessage(message)
+      throw CocoaError(.fileReadNoSuchFile, userInfo: [NSFilePathErrorKey: path])
+    }
+    defer { LLVMDisposeMemoryBuffer(buffer) }
 
-    // Produce the executable.
-    try exec(clangPath, args: [moduleObject.path, runtimePath, "-lm", "-o", productFile.path])
+    var runtime: LLVMModuleRef?
+    guard LLVMParseBitcodeInContext2(LLVMGetModuleContext(module.llvm), buffer, &runtime) == 0
+    else {
+      throw CocoaError(.fileReadCorruptFile, userInfo: [NSFilePathErrorKey: path])
+    }
+
+    // Collect the names of the functions defined by the runtime.
+    var definitions: [String] = []
+    var fun = LLVMGetFirstFunction(runtime)
+    while let f = fun {
+      if LLVMIsDeclaration(f) == 0 {
+        definitions.append(String(cString: LLVMGetValueName(f)))
+      }
+      fun = LLVMGetNextFunction(f)
+    }
+
+    // Link the runtime, which destroys it, and internalize its definitions.
+    guard LLVMLinkModules2(module.llvm, runtime) == 0 else {
+      throw CocoaError(.fileReadCorruptFile, userInfo: [NSFilePathErrorKey: path])
+    }
+    for name in definitions {
+      if var f = module.function(named: name) {
+        f.linkage = .internal
+      }
+    }
   }
 
 }
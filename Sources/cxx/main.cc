@@ -1,3 +1,4 @@
+#include <cstring>
 #include <iostream>
 #include <memory>
 
@@ -9,6 +10,8 @@ extern "C" {
 #include "cocodol.h"
 }
 
+#include "walker.h"
+
 static llvm::LLVMContext TheLLVMContext;
 static std::unique_ptr<llvm::Module>      TheModule;
 static std::unique_ptr<llvm::IRBuilder<>> TheBuilder;
@@ -24,15 +27,23 @@ int main(int argc, char* argv[]) {
   // Parse the program.
   Context context;
   ParserState parser;
-  context_init(&context, source);
+  context_init(&context, source, strlen(source));
   parser_init(&parser, &context, NULL);
 
-  NodeID** declv = (NodeID**)malloc(sizeof(NodeID*));
-  size_t declc = parse(&parser, declv, report_parse_error);
+  NodeID* declv = NULL;
+  size_t declc = parse(&parser, &declv, report_parse_error);
 
-  if (declc > 0) {
-    free(*declv);
+  // Count the nodes of the program.
+  cocodol::Walker walker(&context);
+  size_t node_count = 0;
+  for (size_t i = 0; i < declc; ++i) {
+    walker.walk(declv[i], [&](NodeID, NodeKind, bool is_entering) {
+      node_count += is_entering;
+      return true;
+    });
   }
+  std::cerr << "; " << node_count << " nodes" << std::endl;
+  free(declv);
 
   using namespace llvm;
 
@@ -0,0 +1,102 @@
+#ifndef COCODOL_WALKER_H
+#define COCODOL_WALKER_H
+
+#include <cstddef>
+#include <vector>
+
+extern "C" {
+#include "context.h"
+}
+
+namespace cocodol {
+
+/// An AST walker that calls a visitor known at compile time, so that visits can be inlined.
+///
+/// The walker visits nodes in the same order as `node_walk`, using an explicit stack rather than
+/// recursion. The stack is kept from one walk to the next, so that walking many small trees with
+/// the same walker doesn't allocate. Visitors may start nested walks with the same walker.
+class Walker {
+public:
+
+  /// Creates a walker for the nodes of the given context.
+  explicit Walker(Context* context): context(context) {
+    frames.reserve(32);
+  }
+
+  /// Walks the AST rooted by the node at the given index, calling `visitor` every time the walker
+  /// enters or exits a node.
+  ///
+  /// `visitor` must be callable as `bool(NodeID index, NodeKind kind, bool is_entering)`. Its
+  /// return value has the same meaning as that of the `visit` function of `node_walk`, and so
+  /// does the return value of this method.
+  template <typename Visitor>
+  bool walk(NodeID index, Visitor&& visitor) {
+    size_t base = frames.size();
+    NodeID next = index;
+    while (true) {
+      if (next == (NodeID)~0) {
+        // Resume the last pending visit.
+        if (frames.size() == base) { return true; }
+        Frame frame = frames.back();
+        frames.pop_back();
+        if (frame.is_entering) {
+          next = frame.index;
+        } else if (!visitor(frame.index, frame.kind, false)) {
+          frames.resize(base);
+          return false;
+        }
+        continue;
+      }
+
+      NodeID current = next;
+      const Node* node = context_get_nodeptr(context, current);
+      NodeKind kind = node->kind;
+      next = ~0;
+      if (!visitor(current, kind, true)) { continue; }
+
+      // Exit leaves right away.
+      size_t childc = context_get_childc(context, node);
+      if (childc == 0) {
+        if (!visitor(current, kind, false)) {
+          frames.resize(base);
+          return false;
+        }
+        continue;
+      }
+
+      // Schedule the exit of the node, preceded by the visits of its children.
+      frames.push_back(Frame{ current, kind, false });
+      for (size_t i = childc - 1; i > 0; --i) {
+        frames.push_back(Frame{ context_get_child(context, node, i), nk_error, true });
+      }
+      next = context_get_child(context, node, 0);
+    }
+  }
+
+private:
+
+  /// A pending visit.
+  struct Frame {
+
+    /// The index of the node to visit.
+    NodeID index;
+
+    /// The kind of the node, if the frame denotes an exit.
+    NodeKind kind;
+
+    /// A flag indicating whether the frame denotes an entry (`true`) or an exit (`false`).
+    bool is_entering;
+
+  };
+
+  /// The context of the nodes being walked.
+  Context* context;
+
+  /// The pending visits, in reverse order.
+  std::vector<Frame> frames;
+
+};
+
+}
+
+#endif
@@ -13,6 +13,34 @@ class LexerTests: XCTestCase {
     return tokens
   }
 
+  func testTokenStream() {
+    let source = """
+    fun iffy(x) {
+      // Returns twice its argument.
+      ret x * 2.5 + 4. >= 10
+    }
+    """
+
+    let tokens = TokenStream(in: Context(source: source))
+    let expected = tokenize(source)
+    XCTAssertEqual(tokens.count, expected.count)
+    for (a, b) in zip(tokens, expected) {
+      XCTAssertEqual(a.kind, b.kind)
+      XCTAssertEqual(a.value.startIndex, b.value.startIndex)
+      XCTAssertEqual(a.value.endIndex, b.value.endIndex)
+      XCTAssertEqual(a.symbol, b.symbol)
+    }
+  }
+
+  func testInternNames() {
+    let tokens = tokenize("foo bar foo while 42")
+    XCTAssertNotNil(tokens[0].symbol)
+    XCTAssertEqual(tokens[0].symbol, tokens[2].symbol)
+    XCTAssertNotEqual(tokens[0].symbol, tokens[1].symbol)
+    XCTAssertNil(tokens[3].symbol)
+    XCTAssertNil(tokens[4].symbol)
+  }
+
   func testLexName() throws {
     var token = try XCTUnwrap(tokenize("CoCoDo").first)
     XCTAssertEqual(token.kind, .name)
@@ -23,6 +51,27 @@ class LexerTests: XCTestCase {
     XCTAssert(token.value == "_CoD0_D0")
   }
 
+  func testLexKeyword() throws {
+    let keywords: [(String, Token.Kind)] = [
+      ("var", .var_), ("fun", .fun), ("obj", .obj), ("ret", .ret), ("if", .if_),
+      ("else", .else_), ("while", .while_), ("brk", .brk), ("nxt", .nxt), ("true", .true_),
+      ("false", .false_), ("and", .and), ("or", .or),
+    ]
+
+    for (text, kind) in keywords {
+      let token = try XCTUnwrap(tokenize(text).first)
+      XCTAssertEqual(token.kind, kind)
+      XCTAssert(token.value == text)
+    }
+
+    // Identifiers that start with a keyword are names.
+    for text in ["iffy", "variable", "funny", "order", "truest", "whiles"] {
+      let token = try XCTUnwrap(tokenize(text).first)
+      XCTAssertEqual(token.kind, .name)
+      XCTAssert(token.value == text)
+    }
+  }
+
   func testLexInteger() throws {
     let token = try XCTUnwrap(tokenize("42").first)
     XCTAssertEqual(token.kind, .integer)
@@ -0,0 +1,37 @@
+import Foundation
+import XCTest
+import Cocodol
+
+class MemoryTests: XCTestCase {
+
+  /// The URL of the directory containing the examples.
+  let examplesURL = URL(fileURLWithPath: #file)
+    .deletingLastPathComponent()
+    .deletingLastPathComponent()
+    .deletingLastPathComponent()
+    .appendingPathComponent("Examples")
+
+  func run(program source: String) {
+    let context = Context(source: source)
+    let parser = Parser(in: context)
+    let decls = parser.parse()
+
+    let interpreter = Interpreter(in: context)
+    interpreter.eval(program: decls)
+  }
+
+  func testExamplesDoNotLeak() throws {
+    let urls = try FileManager.default
+      .contentsOfDirectory(at: examplesURL, includingPropertiesForKeys: nil)
+      .filter({ $0.pathExtension == "cocodol" })
+    XCTAssertFalse(urls.isEmpty)
+
+    for url in urls {
+      let source = try String(contentsOf: url)
+      let liveCount = Memory.liveAllocationCount
+      run(program: source)
+      XCTAssertEqual(Memory.liveAllocationCount, liveCount, url.lastPathComponent)
+    }
+  }
+
+}
@@ -0,0 +1,131 @@
+import Foundation
+import XCTest
+import Cocodol
+
+class ParserTests: XCTestCase {
+
+  func testParseMappedFile() throws {
+    let url = URL(fileURLWithPath: #file)
+      .deletingLastPathComponent()
+      .deletingLastPathComponent()
+      .deletingLastPathComponent()
+      .appendingPathComponent("Examples/Factorial.cocodol")
+
+    let mapped = try XCTUnwrap(Context(contentsOfFile: url.path))
+    let copied = Context(source: try String(contentsOf: url))
+    let a = Parser(in: mapped).parse()
+    let b = Parser(in: copied).parse()
+    XCTAssertEqual(a.map({ $0.unparse() }), b.map({ $0.unparse() }))
+    XCTAssertNil(Context(contentsOfFile: url.appendingPathExtension("missing").path))
+  }
+
+  func testParseExtraData() throws {
+    let context = Context(source: "fun f(a, b) { ret a + b }\nprint(f(1, 2.5))")
+    let decls = Parser(in: context).parse()
+    XCTAssertEqual(decls.count, 2)
+
+    let fun = try XCTUnwrap(decls[0] as? FunDecl)
+    XCTAssertEqual(fun.params.map({ String(describing: $0.value) }), ["a", "b"])
+
+    let top = try XCTUnwrap(decls[1] as? TopDecl)
+    let stmt = try XCTUnwrap(top.stmts.first?.adapt(as: ExprStmt.self))
+    let outer = try XCTUnwrap(stmt.expr.adapt(as: ApplyExpr.self))
+    let call = try XCTUnwrap(outer.args.first?.adapt(as: ApplyExpr.self))
+    XCTAssertEqual(call.args.count, 2)
+    XCTAssertEqual(call.args[0].adapt(as: IntegerExpr.self)?.value, 1)
+    XCTAssertEqual(call.args[1].adapt(as: FloatExpr.self)?.value, 2.5)
+  }
+
+  func testParallelParse() {
+    // Generate a program large enough to be split into several chunks.
+    var source = ""
+    for i in 0 ..< 2000 {
+      source += """
+      fun f\(i)(x) {
+        var y = x * \(i)
+        if y > 10 { ret y - 1 } else { ret (y + 1) }
+      }
+      print(f\(i)(\(i)))
+
+      """
+    }
+
+    let serial = Parser(in: Context(source: source)).parse()
+    let parallel = Parser(in: Context(source: source)).parse(threadCount: 4)
+    XCTAssertEqual(serial.count, parallel.count)
+    for (a, b) in zip(serial, parallel) {
+      XCTAssertEqual(a.unparse(), b.unparse())
+    }
+  }
+
+  func testCachedParse() throws {
+    let directory = FileManager.default.temporaryDirectory
+      .appendingPathComponent("cocodol-cache-\(ProcessInfo.processInfo.processIdentifier)")
+    setenv("COCODOL_CACHE_DIR", directory.path, 1)
+    defer {
+      unsetenv("COCODOL_CACHE_DIR")
+      try? FileManager.default.removeItem(at: directory)
+    }
+
+    let source = "fun f(a, b) { ret a + b }\nprint(f(1, 2.5))"
+    XCTAssertNil(Context(source: source).loadCachedDecls())
+
+    let original = Context(source: source)
+    let parsed = Parser(in: original).parse()
+    XCTAssert(original.storeCachedDecls(parsed))
+
+    let context = Context(source: source)
+    let cached = try XCTUnwrap(context.loadCachedDecls())
+    XCTAssertEqual(cached.map({ $0.unparse() }), parsed.map({ $0.unparse() }))
+    XCTAssertNil(Context(source: source + " ").loadCachedDecls())
+  }
+
+  func testReparse() {
+    let parser = Parser(in: Context(source: "fun f(a) {\n  ret a + 1\n}\nprint(f(2))\n"))
+    var decls = parser.parse()
+
+    // Edit the body of the function, which is reparsed on its own.
+    decls = parser.reparse(decls, replacing: 21 ..< 22, with: "10")
+    let a = Parser(in: Context(source: "fun f(a) {\n  ret a + 10\n}\nprint(f(2))\n")).parse()
+    XCTAssertEqual(decls.map({ $0.unparse() }), a.map({ $0.unparse() }))
+
+    // Edit a top-level statement.
+    decls = parser.reparse(decls, replacing: 34 ..< 35, with: "f(3)")
+    let b = Parser(in: Context(source: "fun f(a) {\n  ret a + 10\n}\nprint(f(f(3)))\n")).parse()
+    XCTAssertEqual(decls.map({ $0.unparse() }), b.map({ $0.unparse() }))
+    XCTAssertEqual(parser.diagnosticCount, 0)
+  }
+
+  func testReparseShiftsFollowingStatements() {
+    let body = (0 ..< 20).map({ i in "fun f\(i)(a) { ret a + \(i) }\nprint(f\(i)(1))\n" })
+    let parser = Parser(in: Context(source: "var x = 1\n" + body.joined()))
+    var decls = parser.parse()
+
+    // Edit the first statement more times than shifts can be pending, so that the statements that
+    // follow it are settled while they are being shifted.
+    for i in 0 ..< 600 {
+      decls = i % 2 == 0
+        ? parser.reparse(decls, replacing: 9 ..< 9, with: "23")
+        : parser.reparse(decls, replacing: 9 ..< 11, with: "")
+    }
+    decls = parser.reparse(decls, replacing: 8 ..< 9, with: "42")
+
+    let expected = Parser(in: Context(source: "var x = 42\n" + body.joined())).parse()
+    XCTAssertEqual(decls.map({ $0.unparse() }), expected.map({ $0.unparse() }))
+    XCTAssertEqual(parser.diagnosticCount, 0)
+  }
+
+  func testCaptures() throws {
+    // Capture more identifiers than the former fixed-size capture set could hold.
+    let names = (0 ..< 70).map({ i in "v\(i)" })
+    let source = "fun f(a) { fun g() { ret \(names.joined(separator: " + ")) + a + g() } }"
+    let decls = Parser(in: Context(source: source)).parse()
+
+    let f = try XCTUnwrap(decls.first as? FunDecl)
+    let body = try XCTUnwrap(f.body.adapt(as: BraceStmt.self))
+    let g = try XCTUnwrap(body.stmts.first?.adapt(as: FunDecl.self))
+    XCTAssertEqual(g.captures.map({ String(describing: $0.value) }), names + ["a"])
+    XCTAssertEqual(f.captures.map({ String(describing: $0.value) }), names)
+  }
+
+}
@@ -6,16 +6,45 @@ extension LexerTests {
     //   `swift test --generate-linuxmain`
     // to regenerate.
     static let __allTests__LexerTests = [
+        ("testInternNames", testInternNames),
         ("testLexFloat", testLexFloat),
         ("testLexInteger", testLexInteger),
+        ("testLexKeyword", testLexKeyword),
         ("testLexName", testLexName),
         ("testLexOperator", testLexOperator),
+        ("testTokenStream", testTokenStream),
+    ]
+}
+
+extension MemoryTests {
+    // DO NOT MODIFY: This is autogenerated, use:
+    //   `swift test --generate-linuxmain`
+    // to regenerate.
+    static let __allTests__MemoryTests = [
+        ("testExamplesDoNotLeak", testExamplesDoNotLeak),
+    ]
+}
+
+extension ParserTests {
+    // DO NOT MODIFY: This is autogenerated, use:
+    //   `swift test --generate-linuxmain`
+    // to regenerate.
+    static let __allTests__ParserTests = [
+        ("testCachedParse", testCachedParse),
+        ("testCaptures", testCaptures),
+        ("testParallelParse", testParallelParse),
+        ("testParseExtraData", testParseExtraData),
+        ("testParseMappedFile", testParseMappedFile),
+        ("testReparse", testReparse),
+        ("testReparseShiftsFollowingStatements", testReparseShiftsFollowingStatements),
     ]
 }
 
 public func __allTests() -> [XCTestCaseEntry] {
     return [
         testCase(LexerTests.__allTests__LexerTests),
+        testCase(MemoryTests.__allTests__MemoryTests),
+        testCase(ParserTests.__allTests__ParserTests),
     ]
 }
 #endif
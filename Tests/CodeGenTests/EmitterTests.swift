@@ -0,0 +1,194 @@
+import Foundation
+import XCTest
+import Cocodol
+import CodeGen
+import LLVM
+
+class EmitterTests: XCTestCase {
+
+  /// The URL of the directory containing the examples.
+  let examplesURL = URL(fileURLWithPath: #file)
+    .deletingLastPathComponent()
+    .deletingLastPathComponent()
+    .deletingLastPathComponent()
+    .appendingPathComponent("Examples")
+
+  /// Emits the given program, returning the textual IR of its module.
+  func emit(program source: String, optimized: Bool = false) throws -> String {
+    let parser = Parser(in: Context(source: source))
+    let decls = parser.parse()
+    XCTAssertEqual(parser.diagnosticCount, 0)
+
+    let module = try Emitter.emit(program: decls)
+    if optimized {
+      let pipeliner = PassPipeliner(module: module)
+      pipeliner.addStandardModulePipeline("opt", optimization: .default, size: .default)
+      pipeliner.execute()
+    }
+    return module.description
+  }
+
+  /// Returns the textual IR of the definition of the function with the given name in the
+  /// specified module.
+  func function(named name: String, in ir: String) -> String {
+    var lines: [Substring] = []
+    for line in ir.split(separator: "\n", omittingEmptySubsequences: false) {
+      if !lines.isEmpty {
+        lines.append(line)
+        if line == "}" { break }
+      } else if line.hasPrefix("define ") && line.contains(" @\(name)(") {
+        lines.append(line)
+      }
+    }
+    return lines.joined(separator: "\n")
+  }
+
+  /// Returns the label and the textual IR of each basic block of the given function.
+  func blocks(of function: String) -> [(label: String, body: String)] {
+    var result: [(label: String, body: String)] = []
+    for line in function.split(separator: "\n").dropFirst() where line != "}" {
+      if let first = line.first, first != " ", let colon = line.firstIndex(of: ":") {
+        result.append((label: String(line[..<colon]), body: ""))
+      } else if !result.isEmpty {
+        result[result.count - 1].body += line + "\n"
+      }
+    }
+    return result
+  }
+
+  func testExamplesVerify() throws {
+    let urls = try FileManager.default
+      .contentsOfDirectory(at: examplesURL, includingPropertiesForKeys: nil)
+      .filter({ $0.pathExtension == "cocodol" })
+    XCTAssertFalse(urls.isEmpty)
+
+    for url in urls {
+      // `Emitter.emit(program:)` verifies the module.
+      XCTAssertNoThrow(try emit(program: String(contentsOf: url)), url.lastPathComponent)
+    }
+  }
+
+  func testTopLevelCounterIsNative() throws {
+    let source = try String(contentsOf: examplesURL.appendingPathComponent("Factorial.cocodol"))
+    let main = function(named: "main", in: try emit(program: source))
+
+    // `i` is a local of `main`, stored as an `i64` and updated natively.
+    XCTAssert(main.contains("%i = alloca i64"))
+    XCTAssert(main.contains("icmp slt i64"))
+    XCTAssert(main.contains("add i64"))
+    XCTAssertFalse(main.contains("@_cocodol_binop"))
+    XCTAssertFalse(main.contains("@i.initializer"))
+  }
+
+  func testDirectlyCalledFunctionIsNative() throws {
+    let source = try String(contentsOf: examplesURL.appendingPathComponent("Inc.cocodol"))
+    let ir = try emit(program: source)
+
+    // `inc` is only called with integers, and returns integers.
+    let main = function(named: "main", in: ir)
+    XCTAssert(main.contains("%i = alloca i64"))
+    XCTAssert(main.contains("icmp slt i64"))
+    XCTAssertFalse(main.contains("@_cocodol_binop"))
+
+    let inc = function(named: "inc", in: ir)
+    XCTAssert(inc.contains("%value = alloca i64"))
+    XCTAssert(inc.contains("%bit = alloca i64"))
+    XCTAssertFalse(inc.contains("@_cocodol_binop"))
+    XCTAssertFalse(inc.contains("@_cocodol_drop"))
+  }
+
+  func testHotLoopCallsNoRuntimeFunction() throws {
+    let source = try String(contentsOf: examplesURL.appendingPathComponent("Inc.cocodol"))
+    let main = function(named: "main", in: try emit(program: source, optimized: true))
+
+    // The loop of the optimized program is a block that branches to itself.
+    let loops = blocks(of: main).filter({ $0.body.contains("label %\($0.label)") })
+    XCTAssertFalse(loops.isEmpty)
+    for block in loops {
+      XCTAssertFalse(block.body.contains("@_cocodol_"), block.body)
+    }
+  }
+
+  func testSlowPathsAreCold() throws {
+    // `add` is used as a value, so the kinds of its operands are unknown.
+    let source = "fun add(a, b) {\n  ret a + b\n}\nvar f = add\nprint(f(1, 2))\n"
+    let ir = try emit(program: source, optimized: true)
+
+    // The runtime's operator is cold.
+    let declaration = try XCTUnwrap(
+      ir.split(separator: "\n").first(where: { $0.hasPrefix("declare %_Any @_cocodol_binop(") }))
+    let group = try XCTUnwrap(declaration.split(separator: " ").last)
+    XCTAssert(ir.split(separator: "\n").contains(where: { (line) -> Bool in
+      line.hasPrefix("attributes \(group) = {") && line.contains(" cold ")
+    }))
+
+    // It is only called on the unlikely side of the operand checks.
+    let add = blocks(of: function(named: "add", in: ir))
+    let slow = try XCTUnwrap(add.first(where: { $0.body.contains("@_cocodol_binop(") }))
+    let branches = add.flatMap({ $0.body.split(separator: "\n") })
+      .filter({ $0.contains("br i1") && $0.contains("label %\(slow.label)") })
+    XCTAssertFalse(branches.isEmpty)
+    for branch in branches {
+      XCTAssert(branch.contains(", label %\(slow.label), !prof !"), String(branch))
+    }
+  }
+
+  func testKnownLocalFunctionsAreCalledDirectly() throws {
+    let source = try String(contentsOf: examplesURL.appendingPathComponent("Compose.cocodol"))
+    let ir = try emit(program: source)
+
+    // `step` and its alias `g` are called without checking the tag of their value.
+    let shift = function(named: "shift", in: ir)
+    let calls = shift.split(separator: "\n").filter({ $0.contains("call %_Any @_F") })
+    XCTAssertEqual(calls.count, 2)
+    XCTAssert(calls.allSatisfy({ $0.contains("step(") }))
+    XCTAssertFalse(shift.contains("@llvm.trap"))
+
+    // `f` is a parameter, whose tag is checked before each call.
+    let twice = function(named: "twice", in: ir)
+    XCTAssertEqual(twice.components(separatedBy: "@llvm.expect.i1(").count - 1, 2)
+    XCTAssert(twice.contains("@llvm.trap"))
+    XCTAssertFalse(twice.contains("call %_Any @_F"))
+  }
+
+  func testNonEscapingClosureEnvironmentIsOnStack() throws {
+    let source = try String(contentsOf: examplesURL.appendingPathComponent("Accumulate.cocodol"))
+    let accumulate = function(named: "accumulate", in: try emit(program: source))
+
+    // `add` is passed to `print` and called in a loop, without ever being copied.
+    XCTAssert(accumulate.contains("%add.env = alloca"))
+    XCTAssertFalse(accumulate.contains("@malloc("))
+  }
+
+  func testGlobalsReferencedByFunctionsAreBoxed() throws {
+    let ir = try emit(program: "var n = 1\nfun f() {\n  ret n\n}\nn = n + f()\nprint(n)\n")
+    XCTAssert(ir.contains("@n = global %_Any"))
+    XCTAssertFalse(function(named: "main", in: ir).contains("alloca i64"))
+  }
+
+  func testLocalsOfMainAreDroppedOnExit() throws {
+    let source = "fun make(x) {\n  fun get() {\n    ret x\n  }\n  ret get\n}\n"
+      + "var f = make(1)\nprint(f())\n"
+    let main = function(named: "main", in: try emit(program: source))
+
+    // `f` is a local of `main`, whose closure is dropped before the program exits.
+    XCTAssert(main.contains("%f = alloca %_Any"))
+    let lines = main.split(separator: "\n")
+    let exit = try XCTUnwrap(lines.firstIndex(where: { $0.contains("ret i32 0") }))
+    XCTAssert(lines[exit - 1].contains("call void @_cocodol_drop("), String(lines[exit - 1]))
+  }
+
+  func testGlobalsReadBeforeTheirDeclarationAreBoxed() throws {
+    // A global can be read by a statement or a function that precedes its declaration.
+    var ir = try emit(program: "print(x)\nvar x = 2\nprint(x)\n")
+    XCTAssert(ir.contains("@x = global %_Any"))
+    ir = try emit(program: "fun f() {\n  ret n\n}\nvar n = 1\nprint(f())\n")
+    XCTAssert(ir.contains("@n = global %_Any"))
+  }
+
+  func testFunctionsUsedAsValuesAreBoxed() throws {
+    let ir = try emit(program: "fun f(x) {\n  ret x + 1\n}\nvar g = f\nprint(f(1))\nprint(g(2))\n")
+    XCTAssertFalse(function(named: "f", in: ir).contains("alloca i64"))
+  }
+
+}
@@ -0,0 +1,28 @@
+#if !canImport(ObjectiveC)
+import XCTest
+
+extension EmitterTests {
+    // DO NOT MODIFY: This is autogenerated, use:
+    //   `swift test --generate-linuxmain`
+    // to regenerate.
+    static let __allTests__EmitterTests = [
+        ("testDirectlyCalledFunctionIsNative", testDirectlyCalledFunctionIsNative),
+        ("testExamplesVerify", testExamplesVerify),
+        ("testFunctionsUsedAsValuesAreBoxed", testFunctionsUsedAsValuesAreBoxed),
+        ("testGlobalsReadBeforeTheirDeclarationAreBoxed", testGlobalsReadBeforeTheirDeclarationAreBoxed),
+        ("testGlobalsReferencedByFunctionsAreBoxed", testGlobalsReferencedByFunctionsAreBoxed),
+        ("testHotLoopCallsNoRuntimeFunction", testHotLoopCallsNoRuntimeFunction),
+        ("testKnownLocalFunctionsAreCalledDirectly", testKnownLocalFunctionsAreCalledDirectly),
+        ("testLocalsOfMainAreDroppedOnExit", testLocalsOfMainAreDroppedOnExit),
+        ("testNonEscapingClosureEnvironmentIsOnStack", testNonEscapingClosureEnvironmentIsOnStack),
+        ("testSlowPathsAreCold", testSlowPathsAreCold),
+        ("testTopLevelCounterIsNative", testTopLevelCounterIsNative),
+    ]
+}
+
+public func __allTests() -> [XCTestCaseEntry] {
+    return [
+        testCase(EmitterTests.__allTests__EmitterTests),
+    ]
+}
+#endif
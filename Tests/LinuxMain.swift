@@ -1,8 +1,10 @@
 import XCTest
 
 import CocodolTests
+import CodeGenTests
 
 var tests = [XCTestCaseEntry]()
 tests += CocodolTests.__allTests()
+tests += CodeGenTests.__allTests()
 
 XCTMain(tests)
@@ -15,9 +15,13 @@ cd ..
 # Compile cocodoc.
 swift build -c release
 
-# Install the binaries.
+# Install the binaries. The runtime's bitcode is only built if clang is available.
 cp Runtime/build/libcocodol_rt.a ${LIB_DIR}
-cp .build/release/cocodoc ${BIN_DIR}
-
 echo "Runtime library installed at ${LIB_DIR}/libcocodol_rt.a"
+if [ -f Runtime/build/libcocodol_rt.bc ]; then
+  cp Runtime/build/libcocodol_rt.bc ${LIB_DIR}
+  echo "Runtime bitcode installed at ${LIB_DIR}/libcocodol_rt.bc"
+fi
+
+cp .build/release/cocodoc ${BIN_DIR}
 echo "Compiler binary installed at ${BIN_DIR}/cocodoc"